@@ -0,0 +1,150 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef BENCHUTILS_HPP
+#define BENCHUTILS_HPP
+
+// standard libraries
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// system headers
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tffm { namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/*  returns the resident set size of the current process in KiB, read from `/proc/self/status` */
+inline long residentKiB() {
+    auto f = std::fopen("/proc/self/status", "r");
+    if (!f) return -1;
+    char line[256];
+    long rss = -1;
+    while (std::fgets(line, sizeof line, f)) {
+        if (std::strncmp(line, "VmRSS:", 6) == 0) {
+            rss = std::strtol(line + 6, nullptr, 10);
+            break;
+        }
+    }
+    std::fclose(f);
+    return rss;
+}
+
+/*  creates `count` files of `fileSize` bytes named `prefix<n>` in `dir`; returns false on the first failure */
+inline bool populateDirectory(std::string const& dir, long count, std::string const& prefix = "file_", long fileSize = 0) {
+    mkdir(dir.c_str(), 0755);
+    const int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) return false;
+    const auto contents = std::string(static_cast<std::size_t>(fileSize), 'x');
+    bool ok = true;
+    for (long n = 0; n < count && ok; ++n) {
+        const auto name = prefix + std::to_string(n);
+        const int fd = openat(dirfd, name.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        ok = fd >= 0 && write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size());
+        if (fd >= 0) close(fd);
+    }
+    close(dirfd);
+    return ok;
+}
+
+/*  creates `files` files of `fileSize` bytes in `root`, spread over sub-directories of `filesPerDirectory` files each */
+inline bool populateTree(std::string const& root, long files, long filesPerDirectory, long fileSize = 0) {
+    mkdir(root.c_str(), 0755);
+    for (long d = 0; d * filesPerDirectory < files; ++d) {
+        const auto count = std::min(filesPerDirectory, files - d * filesPerDirectory);
+        if (!populateDirectory(root + "/dir_" + std::to_string(d), count, "file_", fileSize)) return false;
+    }
+    return true;
+}
+
+/*  creates a chain of `depth` nested directories under `root`, with `filesPerLevel` empty files in each */
+inline bool populateDeepTree(std::string const& root, long depth, long filesPerLevel) {
+    auto dir = root;
+    mkdir(dir.c_str(), 0755);
+    for (long level = 0; level < depth; ++level) {
+        if (!populateDirectory(dir, filesPerLevel)) return false;
+        dir += "/level_" + std::to_string(level);
+        if (mkdir(dir.c_str(), 0755) != 0) return false;
+    }
+    return true;
+}
+
+/*  creates `count` files in `dir` whose sizes are spread evenly over the orders of magnitude from
+    0 bytes up to `maxSize` (mostly small files, a few large ones, as in a typical home directory) */
+inline bool populateMixedSizes(std::string const& dir, long count, long maxSize, unsigned seed = 1) {
+    mkdir(dir.c_str(), 0755);
+    auto contents = std::string(static_cast<std::size_t>(maxSize), 'x');
+    auto state = seed;
+    bool ok = true;
+    for (long n = 0; n < count && ok; ++n) {
+        state = state * 1103515245 + 12345; // any cheap deterministic generator does
+        const auto magnitude = static_cast<double>((state >> 8) % 1000) / 1000.0;
+        const auto size = static_cast<std::size_t>(std::pow(static_cast<double>(maxSize), magnitude)) - 1;
+        const auto path = dir + "/mixed_" + std::to_string(n);
+        const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ok = fd >= 0 && write(fd, contents.data(), size) == static_cast<ssize_t>(size);
+        if (fd >= 0) close(fd);
+    }
+    return ok;
+}
+
+/*  creates a file of `size` bytes at `path` that only has `extents` extents of 1 MiB of data, spread
+    evenly, and holes everywhere else */
+inline bool createSparseFile(std::string const& path, long long size, int extents) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const auto data = std::string(1 << 20, 'x');
+    bool ok = ftruncate(fd, size) == 0;
+    for (int e = 0; e < extents && ok; ++e) {
+        const auto offset = size / extents * e;
+        ok = pwrite(fd, data.data(), data.size(), offset) == static_cast<ssize_t>(data.size());
+    }
+    close(fd);
+    return ok;
+}
+
+}}
+
+#endif // BENCHUTILS_HPP
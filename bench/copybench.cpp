@@ -0,0 +1,139 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+Compares copying a tree of small files with `tffm::CopyEngine` on its thread
+pool against the same engine on io_uring. A tree is generated under DIR and
+copied once with each backend, starting from storage rather than the page
+cache each time, then removed along with the copies:
+
+    tffm_copy_bench [FILES [FILE_SIZE [QUEUE_DEPTH [DIR]]]]
+
+FILES defaults to 100000, FILE_SIZE (in bytes) to 4096, QUEUE_DEPTH to 64 and
+DIR to a directory in /tmp. Point DIR at the storage of interest: the io_uring
+backend pays off where each request has a high latency, such as a network file
+system, far more than on a local SSD.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/copyengine.hpp"
+
+// standard libraries
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Qt classes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+// system headers
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+
+namespace {
+
+/*  drops the cached pages of the files under `dir`, so that each backend reads them from the storage */
+void dropCachedPages(std::string const& dir) {
+    nftw(dir.c_str(), [](const char* path, const struct stat*, int type, struct FTW*) {
+        if (type != FTW_F) return 0;
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+        return 0;
+    }, 64, FTW_PHYS);
+}
+
+/*  copies `src` to `dest` with a queue depth of `depth` (0 for the thread pool); returns the time taken in ms */
+double timeCopy(QCoreApplication& app, std::string const& src, std::string const& dest, int depth, qint64& filesCopied) {
+    tffm::CopyEngine engine;
+    engine.setQueueDepth(depth);
+    QObject::connect(&engine, &tffm::CopyEngine::finished, &app, [&app, &filesCopied](qint64 copied, QStringList const& errors, bool) {
+        filesCopied = copied;
+        for (auto&& error : errors) std::fprintf(stderr, "%s\n", qPrintable(error));
+        app.quit();
+    });
+
+    sync();
+    dropCachedPages(src);
+    const auto start = tffm::bench::Clock::now();
+    engine.start(tffm::CopyEngine::CopyList{qMakePair(QFile::decodeName(src.c_str()), QFile::decodeName(dest.c_str()))});
+    app.exec();
+    return tffm::bench::millisecondsSince(start);
+}
+
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app{argc, argv};
+
+    const long files = argc > 1 ? std::atol(argv[1]) : 100000;
+    const long fileSize = argc > 2 ? std::atol(argv[2]) : 4096;
+    const int depth = argc > 3 ? std::atoi(argv[3]) : 64;
+    const std::string root = argc > 4 ? argv[4] : "/tmp/tffm_copy_bench";
+
+    {
+        tffm::CopyEngine probe;
+        if (!probe.usesIoUring()) {
+            std::fprintf(stderr, "io_uring isn't available here\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::fprintf(stderr, "generating %ld files of %ld bytes in %s...\n", files, fileSize, root.c_str());
+    mkdir(root.c_str(), 0755);
+    if (!tffm::bench::populateTree(root + "/src", files, 1000, fileSize)) {
+        std::perror("failed to generate tree");
+        return EXIT_FAILURE;
+    }
+
+    qint64 poolFiles = 0;
+    qint64 ringFiles = 0;
+    const double poolMs = timeCopy(app, root + "/src", root + "/pool", 0, poolFiles);
+    const double ringMs = timeCopy(app, root + "/src", root + "/ring", depth, ringFiles);
+
+    // only what the bench generated, as DIR may hold other things
+    for (auto&& tree : {"/src", "/pool", "/ring"}) {
+        QDir{QFile::decodeName((root + tree).c_str())}.removeRecursively();
+    }
+    rmdir(root.c_str());
+    std::printf("{\"files\": %ld, \"file_size\": %ld, \"queue_depth\": %d, \"thread_pool_ms\": %.1f, \"io_uring_ms\": %.1f, "
+                "\"thread_pool_files_per_s\": %.0f, \"io_uring_files_per_s\": %.0f, \"speedup\": %.2f}\n",
+                files, fileSize, depth, poolMs, ringMs, poolFiles * 1000 / poolMs, ringFiles * 1000 / ringMs, poolMs / ringMs);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+Compares removing a synthetic tree with `QDir::removeRecursively()` (which is
+what `QFileSystemModel::remove()` does for directories) against
+`tffm::DeleteEngine`. Two identical trees are generated under DIR, one for
+each contender:
+
+    tffm_delete_bench [FILES [FILES_PER_DIRECTORY [DIR]]]
+
+FILES defaults to 1000000, FILES_PER_DIRECTORY to 1000 and DIR to a directory
+in /tmp.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/deleteengine.hpp"
+
+// standard libraries
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Qt classes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+int main(int argc, char** argv) {
+    QCoreApplication app{argc, argv};
+
+    const long files = argc > 1 ? std::atol(argv[1]) : 1000000;
+    const long filesPerDirectory = argc > 2 ? std::atol(argv[2]) : 1000;
+    const std::string root = argc > 3 ? argv[3] : "/tmp/tffm_delete_bench";
+
+    std::fprintf(stderr, "generating 2 x %ld files in %s...\n", files, root.c_str());
+    mkdir(root.c_str(), 0755);
+    if (!tffm::bench::populateTree(root + "/qdir", files, filesPerDirectory) ||
+        !tffm::bench::populateTree(root + "/tffm", files, filesPerDirectory)) {
+        std::perror("failed to generate tree");
+        return EXIT_FAILURE;
+    }
+    sync();
+
+    auto start = tffm::bench::Clock::now();
+    QDir{QFile::decodeName((root + "/qdir").c_str())}.removeRecursively();
+    const double qdirMs = tffm::bench::millisecondsSince(start);
+
+    tffm::DeleteEngine engine;
+    QObject::connect(&engine, &tffm::DeleteEngine::finished, &app, &QCoreApplication::quit);
+    start = tffm::bench::Clock::now();
+    engine.start(QFile::decodeName(root.c_str()), QStringList{QStringLiteral("tffm")});
+    app.exec();
+    const double engineMs = tffm::bench::millisecondsSince(start);
+
+    rmdir(root.c_str());
+    std::printf("{\"files\": %ld, \"qdir_remove_recursively_ms\": %.1f, \"delete_engine_ms\": %.1f, \"speedup\": %.2f}\n",
+                files, qdirMs, engineMs, qdirMs / engineMs);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+Compares how long `QFileSystemModel` and `tffm::DirectoryModel` take to show the
+first row of a directory and to finish loading it, and how much memory each
+one holds on to afterwards. Each run measures a single model so that the
+resident set size is not polluted by the other one:
+
+    tffm_dirmodel_bench qfs  DIR
+    tffm_dirmodel_bench tffm DIR [VIEWS]
+    tffm_dirmodel_bench --populate N DIR    (creates N empty files in DIR)
+
+With VIEWS, that many `tffm::DirectoryModel`s sharing one `ListingStore` show
+DIR one after the other, as split panes would; the others should cost little
+time and memory on top of the first one.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/directorymodel.hpp"
+
+// standard libraries
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Qt classes
+#include <QApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileSystemModel>
+#include <QTimer>
+
+namespace {
+
+struct Result {
+    double firstRowMs = -1;
+    double loadedMs = -1;
+    int rows = 0;
+};
+
+/*
+sets the root path of `model` and spins the event loop until `directoryLoaded`
+is emitted, recording when the first row becomes available
+*/
+template <typename Model>
+Result measure(Model& model, QString const& path) {
+    auto result = Result{};
+    bool loaded = false;
+    QEventLoop loop;
+    const auto start = tffm::bench::Clock::now();
+
+    auto recordFirstRow = [&]() {
+        if (result.firstRowMs < 0 && model.rowCount(model.index(path)) > 0) {
+            result.firstRowMs = tffm::bench::millisecondsSince(start);
+        }
+    };
+    QObject::connect(&model, &QAbstractItemModel::rowsInserted, recordFirstRow);
+    QObject::connect(&model, &QAbstractItemModel::modelReset, recordFirstRow);
+    QObject::connect(&model, &Model::directoryLoaded, [&](QString const&) {
+        recordFirstRow();
+        result.loadedMs = tffm::bench::millisecondsSince(start);
+        loaded = true;
+        loop.quit();
+    });
+    QTimer::singleShot(120000, &loop, &QEventLoop::quit);
+
+    model.setRootPath(path);
+    // `QFileSystemModel` only populates a directory once its children are asked for
+    if (model.canFetchMore(model.index(path))) model.fetchMore(model.index(path));
+    // a directory another model already shows can be loaded before `setRootPath` returns
+    if (!loaded) loop.exec();
+
+    result.rows = model.rowCount(model.index(path));
+    return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && std::strcmp(argv[1], "--populate") == 0) {
+        return tffm::bench::populateDirectory(argv[3], std::atol(argv[2])) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    const bool qfs = argc == 3 && std::strcmp(argv[1], "qfs") == 0;
+    const bool tffm = (argc == 3 || argc == 4) && std::strcmp(argv[1], "tffm") == 0;
+    const int views = argc == 4 ? std::atoi(argv[3]) : 1;
+    if ((!qfs && !tffm) || views < 1) {
+        std::fprintf(stderr, "usage: %s qfs DIR\n       %s tffm DIR [VIEWS]\n       %s --populate N DIR\n", argv[0], argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    QApplication app{argc, argv};
+    const auto path = QFile::decodeName(argv[2]);
+    const auto rssBefore = tffm::bench::residentKiB();
+
+    auto result = Result{};
+    if (qfs) {
+        QFileSystemModel model;
+        result = measure(model, path);
+        std::printf("model=QFileSystemModel rows=%d first_row_ms=%.2f loaded_ms=%.2f rss_delta_kib=%ld\n",
+                    result.rows, result.firstRowMs, result.loadedMs, tffm::bench::residentKiB() - rssBefore);
+    }
+    else if (views == 1) {
+        tffm::DirectoryModel model;
+        result = measure(model, path);
+        std::printf("model=DirectoryModel rows=%d first_row_ms=%.2f loaded_ms=%.2f rss_delta_kib=%ld\n",
+                    result.rows, result.firstRowMs, result.loadedMs, tffm::bench::residentKiB() - rssBefore);
+    }
+    else {
+        auto store = std::make_shared<tffm::ListingStore>();
+        auto models = std::vector<std::unique_ptr<tffm::DirectoryModel>>{};
+        models.push_back(std::make_unique<tffm::DirectoryModel>(store));
+        result = measure(*models.front(), path);
+        const auto rssFirst = tffm::bench::residentKiB();
+
+        double othersMs = 0;
+        for (int v = 1; v < views; ++v) {
+            models.push_back(std::make_unique<tffm::DirectoryModel>(store));
+            othersMs += measure(*models.back(), path).loadedMs;
+        }
+        std::printf("model=DirectoryModel views=%d rows=%d first_row_ms=%.2f loaded_ms=%.2f other_views_loaded_ms=%.2f "
+                    "rss_delta_kib=%ld other_views_rss_delta_kib=%ld\n",
+                    views, result.rows, result.firstRowMs, result.loadedMs, othersMs,
+                    rssFirst - rssBefore, tffm::bench::residentKiB() - rssFirst);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+Compares `find DIR | grep -c PATTERN` against `tffm::FindEngine` on the same
+tree. The page cache is warmed up by a first, untimed `find` so both start
+from the same state:
+
+    tffm_find_bench DIR PATTERN
+    tffm_find_bench --populate FILES FILES_PER_DIRECTORY DIR PATTERN
+
+With `--populate`, a tree of FILES empty files is generated under DIR first.
+Note that `grep` matches whole paths while tffm only matches names, so the
+match counts can differ when PATTERN also appears in directory names.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/findengine.hpp"
+
+// standard libraries
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Qt classes
+#include <QCoreApplication>
+#include <QFile>
+
+namespace {
+
+/*  runs `command` through the shell and returns the number it prints, or -1 */
+long runCounting(std::string const& command) {
+    auto pipe = popen(command.c_str(), "r");
+    if (!pipe) return -1;
+    long count = -1;
+    if (std::fscanf(pipe, "%ld", &count) != 1) count = -1;
+    pclose(pipe);
+    return count;
+}
+
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app{argc, argv};
+
+    int arg = 1;
+    if (argc > arg && std::string{argv[arg]} == "--populate") {
+        if (argc < arg + 5) {
+            std::fprintf(stderr, "usage: %s --populate FILES FILES_PER_DIRECTORY DIR PATTERN\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        const long files = std::atol(argv[arg + 1]);
+        const long filesPerDirectory = std::atol(argv[arg + 2]);
+        std::fprintf(stderr, "generating %ld files in %s...\n", files, argv[arg + 3]);
+        if (!tffm::bench::populateTree(argv[arg + 3], files, filesPerDirectory)) {
+            std::perror("failed to generate tree");
+            return EXIT_FAILURE;
+        }
+        arg += 3;
+    }
+    if (argc < arg + 2) {
+        std::fprintf(stderr, "usage: %s DIR PATTERN\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const std::string root = argv[arg];
+    const std::string pattern = argv[arg + 1];
+
+    runCounting("find '" + root + "' | wc -l");
+
+    auto start = tffm::bench::Clock::now();
+    const long findMatches = runCounting("find '" + root + "' | grep -c -F -- '" + pattern + "'");
+    const double findMs = tffm::bench::millisecondsSince(start);
+
+    tffm::FindEngine engine;
+    qint64 engineMatches = 0;
+    qint64 directoriesRead = 0;
+    QObject::connect(&engine, &tffm::FindEngine::finished, &app, [&](qint64 directories, qint64 matches, bool) {
+        directoriesRead = directories;
+        engineMatches = matches;
+        app.quit();
+    });
+    start = tffm::bench::Clock::now();
+    engine.start(QFile::decodeName(root.c_str()), QFile::decodeName(pattern.c_str()), Qt::CaseSensitive, true);
+    app.exec();
+    const double engineMs = tffm::bench::millisecondsSince(start);
+
+    std::printf("{\"directories\": %lld, \"find_grep_ms\": %.1f, \"find_grep_matches\": %ld, \"find_engine_ms\": %.1f, \"find_engine_matches\": %lld, \"speedup\": %.2f}\n",
+                directoriesRead, findMs, findMatches, engineMs, engineMatches, findMs / engineMs);
+    return EXIT_SUCCESS;
+}
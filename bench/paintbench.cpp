@@ -0,0 +1,175 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+/*
+Measures how long the file list takes to paint a frame while scrolling
+through a big directory, with the default delegate (what tffm used to draw
+with) or with `tffm::EntryDelegate` and uniform row heights. The view is
+scrolled from the top of the directory to its bottom in evenly spread jumps,
+painting each frame into an image, and the frame times are printed with
+their percentiles; the first frame includes laying out every row.
+
+    tffm_paint_bench default|tffm [--no-icons] [--frames N] DIR
+    tffm_paint_bench --populate N DIR    (creates N empty files in DIR, with a few extensions)
+
+Run it with QT_QPA_PLATFORM=offscreen to measure without a display.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/directorymodel.hpp"
+#include "../src/entrydelegate.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Qt classes
+#include <QApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QImage>
+#include <QListView>
+#include <QScrollBar>
+#include <QStyledItemDelegate>
+#include <QTimer>
+
+// system headers
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/*  the extensions `--populate` spreads over the files, so that icons are looked up */
+const char* const extensions[] = {".txt", ".cpp", ".png", ".pdf", ".tar.gz", ".mp3", ".html", ""};
+
+/*  returns the `p`th percentile of the sorted `samples` (nearest rank) */
+double percentile(std::vector<double> const& samples, double p) {
+    const auto rank = static_cast<std::size_t>(std::ceil(p / 100 * static_cast<double>(samples.size())));
+    return samples[std::max<std::size_t>(rank, 1) - 1];
+}
+
+/*  creates `count` empty files in `dir`, their extensions taken in turn from `extensions` */
+bool populate(std::string const& dir, long count) {
+    mkdir(dir.c_str(), 0755);
+    const int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) return false;
+    const auto kinds = static_cast<long>(sizeof extensions / sizeof extensions[0]);
+    bool ok = true;
+    for (long n = 0; n < count && ok; ++n) {
+        const auto name = "file_" + std::to_string(n) + extensions[n % kinds];
+        const int fd = openat(dirfd, name.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        ok = fd >= 0;
+        if (fd >= 0) close(fd);
+    }
+    close(dirfd);
+    return ok;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && std::strcmp(argv[1], "--populate") == 0) {
+        return populate(argv[3], std::atol(argv[2])) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    bool icons = true;
+    int frames = 200;
+    const char* mode = nullptr;
+    const char* dir = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--no-icons") == 0) icons = false;
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = std::max(1, std::atoi(argv[++i]));
+        else if (!mode) mode = argv[i];
+        else dir = argv[i];
+    }
+    if (!mode || !dir || (std::strcmp(mode, "default") != 0 && std::strcmp(mode, "tffm") != 0)) {
+        std::fprintf(stderr, "usage: %s default|tffm [--no-icons] [--frames N] DIR\n       %s --populate N DIR\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    QApplication app{argc, argv};
+    tffm::DirectoryModel model;
+    model.setShowIcons(icons);
+    {
+        QEventLoop loop;
+        QObject::connect(&model, &tffm::DirectoryModel::directoryLoaded, &loop, &QEventLoop::quit);
+        QTimer::singleShot(120000, &loop, &QEventLoop::quit);
+        model.setRootPath(QFile::decodeName(dir));
+        loop.exec();
+    }
+
+    QListView view;
+    QStyledItemDelegate defaultDelegate;
+    tffm::EntryDelegate entryDelegate;
+    if (std::strcmp(mode, "tffm") == 0) {
+        entryDelegate.setShowIcons(icons);
+        view.setItemDelegate(&entryDelegate);
+        view.setUniformItemSizes(true);
+    }
+    else {
+        view.setItemDelegate(&defaultDelegate);
+    }
+    view.resize(800, 600);
+    view.setModel(&model);
+    view.show();
+
+    auto image = QImage{view.viewport()->size(), QImage::Format_ARGB32_Premultiplied};
+    auto samples = std::vector<double>{};
+    double firstFrameMs = -1;
+    for (int frame = 0; frame <= frames; ++frame) {
+        // lets resolved icons (and anything else queued) in between frames, as the event loop would
+        app.processEvents();
+
+        const auto start = tffm::bench::Clock::now();
+        auto scrollBar = view.verticalScrollBar();
+        scrollBar->setValue(static_cast<int>(static_cast<long long>(scrollBar->maximum()) * frame / frames));
+        view.viewport()->render(&image);
+        const auto elapsed = tffm::bench::millisecondsSince(start);
+        if (frame == 0) firstFrameMs = elapsed;
+        else samples.push_back(elapsed);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    std::printf("delegate=%s icons=%d rows=%d first_frame_ms=%.2f frame_ms_p50=%.3f frame_ms_p90=%.3f frame_ms_p99=%.3f frame_ms_max=%.3f\n",
+                mode, icons ? 1 : 0, model.rowCount(), firstFrameMs,
+                percentile(samples, 50), percentile(samples, 90), percentile(samples, 99), samples.back());
+    return EXIT_SUCCESS;
+}
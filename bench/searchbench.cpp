@@ -0,0 +1,124 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+Times building the search index of a directory and matching names against it
+with each search mode (prefix, substring and fuzzy), the way a keystroke in
+`/` mode does:
+
+    tffm_search_bench DIR [PATTERN...]
+    tffm_search_bench --populate N DIR    (creates N log-like files in DIR)
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/directorylisting.hpp"
+#include "../src/searchindex.hpp"
+#include "../src/simdscan.hpp"
+
+// standard libraries
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// system headers
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/*  creates `count` files named like rotated service logs, e.g. `ingest-07_20261017_000123.log` */
+bool populateLogDirectory(std::string const& dir, long count) {
+    mkdir(dir.c_str(), 0755);
+    const int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) return false;
+    const char* services[] = {"ingest", "api", "worker", "scheduler", "Billing"};
+    char name[64];
+    bool ok = true;
+    for (long n = 0; n < count && ok; ++n) {
+        std::snprintf(name, sizeof name, "%s-%02ld_2026%02ld%02ld_%06ld.log", services[n % 5], n % 17, 1 + n / 1000 % 12, 1 + n % 28, n);
+        const int fd = openat(dirfd, name, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        ok = fd >= 0;
+        if (ok) close(fd);
+    }
+    close(dirfd);
+    return ok;
+}
+
+template <typename F>
+double bestOf(int runs, F&& f) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        const auto start = tffm::bench::Clock::now();
+        f();
+        best = std::min(best, tffm::bench::millisecondsSince(start));
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && std::strcmp(argv[1], "--populate") == 0) {
+        return populateLogDirectory(argv[3], std::atol(argv[2])) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s DIR [PATTERN...]\n       %s --populate N DIR\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto listing = std::make_shared<tffm::DirectoryListing>();
+    const double readMs = bestOf(1, [&]() { listing->read(argv[1]); });
+    std::unique_ptr<tffm::SearchIndex> index;
+    const double indexMs = bestOf(1, [&]() { index.reset(new tffm::SearchIndex{listing}); });
+    std::printf("{\"entries\": %u, \"kernels\": \"%s\", \"read_ms\": %.2f, \"index_ms\": %.2f}\n",
+                listing->size(), tffm::simd::implementation(), readMs, indexMs);
+
+    auto patterns = std::vector<std::string>{};
+    for (int i = 2; i < argc; ++i) patterns.emplace_back(argv[i]);
+    if (patterns.empty()) patterns = {"i", "ingest-0", "20261017", "_000123", "b1017log", "zzz"};
+
+    for (auto&& pattern : patterns) {
+        std::size_t prefixCount = 0, substringCount = 0, fuzzyCount = 0;
+        const double prefixMs = bestOf(5, [&]() { prefixCount = index->find(pattern, true).size(); });
+        const double substringMs = bestOf(5, [&]() { substringCount = index->substringMatches(pattern, true).size(); });
+        const double fuzzyMs = bestOf(5, [&]() { fuzzyCount = index->fuzzyMatches(pattern, true).size(); });
+        std::printf("{\"pattern\": \"%s\", \"prefix_ms\": %.3f, \"prefix_matches\": %zu, \"substring_ms\": %.3f, \"substring_matches\": %zu, "
+                    "\"fuzzy_ms\": %.3f, \"fuzzy_matches\": %zu}\n",
+                    pattern.c_str(), prefixMs, prefixCount, substringMs, substringCount, fuzzyMs, fuzzyCount);
+    }
+    return EXIT_SUCCESS;
+}
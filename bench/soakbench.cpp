@@ -0,0 +1,182 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+/*
+Walks a generated tree the way a user browsing it would, changing the directory
+of one `tffm::DirectoryModel` over and over, and reports whether memory stays
+flat once the listing cache has filled up to its budget:
+
+    tffm_soak_bench [--navigations N] [--budget MiB] DIR
+    tffm_soak_bench --populate WIDTH FILES DIR
+
+With `--populate`, DIR gets WIDTH directories, each with WIDTH sub-directories
+of FILES empty files. The walk (10000 navigations by default) mostly enters a
+sub-directory or goes up, and now and then jumps elsewhere, as `cd` would.
+The resident set size and the cache's use are printed every tenth of the walk;
+after the first tenth (the warm-up, which fills the cache), the resident size
+should grow by little more than the allocator's noise.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/directorymodel.hpp"
+
+// standard libraries
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Qt classes
+#include <QApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+
+namespace {
+
+/*  creates the tree described above under `root` */
+bool populate(std::string const& root, long width, long files) {
+    mkdir(root.c_str(), 0755);
+    for (long d = 0; d < width; ++d) {
+        if (!tffm::bench::populateTree(root + "/dir_" + std::to_string(d), width * files, files)) return false;
+    }
+    return true;
+}
+
+int usage(const char* program) {
+    std::fprintf(stderr, "usage: %s [--navigations N] [--budget MiB] DIR\n       %s --populate WIDTH FILES DIR\n", program, program);
+    return EXIT_FAILURE;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc == 5 && std::strcmp(argv[1], "--populate") == 0) {
+        return populate(argv[4], std::atol(argv[2]), std::atol(argv[3])) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    long navigations = 10000;
+    long budget = -1;
+    int arg = 1;
+    for (; arg + 1 < argc; arg += 2) {
+        if (std::strcmp(argv[arg], "--navigations") == 0) navigations = std::atol(argv[arg + 1]);
+        else if (std::strcmp(argv[arg], "--budget") == 0) budget = std::atol(argv[arg + 1]);
+        else break;
+    }
+    if (arg + 1 != argc || navigations < 10) return usage(argv[0]);
+
+    QApplication app{argc, argv};
+    const auto root = QDir{QFile::decodeName(argv[arg])}.absolutePath();
+
+    // the directories of the tree, and those right under each one
+    auto directories = QStringList{root};
+    QDirIterator iterator{root, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories};
+    while (iterator.hasNext()) {
+        directories << iterator.next();
+    }
+    auto children = std::unordered_map<std::string, QStringList>{};
+    for (auto&& directory : directories) {
+        if (directory != root) children[QFileInfo{directory}.absolutePath().toStdString()] << directory;
+    }
+    std::printf("directories=%d\n", directories.size());
+
+    auto store = std::make_shared<tffm::ListingStore>();
+    store->cache().setMaxIdle(std::chrono::seconds{0}); // only the budget evicts, however long the walk takes
+    if (budget >= 0) store->setMemoryBudget(static_cast<std::size_t>(budget) << 20);
+    tffm::DirectoryModel model{store};
+
+    bool loaded = false;
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    QObject::connect(&model, &tffm::DirectoryModel::directoryLoaded, [&](QString const&) {
+        loaded = true;
+        loop.quit();
+    });
+
+    auto state = 1u;
+    auto random = [&state](int n) {
+        state = state * 1103515245 + 12345; // any cheap deterministic generator does
+        return static_cast<int>((state >> 8) % static_cast<unsigned>(n));
+    };
+
+    auto current = root;
+    long rssAfterWarmUp = 0;
+    const auto start = tffm::bench::Clock::now();
+    for (long n = 1; n <= navigations; ++n) {
+        // the model only loads anything when its directory changes
+        const auto& below = children[current.toStdString()];
+        auto next = current;
+        while (next == current) {
+            const auto choice = random(10);
+            if (choice == 0) next = directories.at(random(directories.size()));
+            else if (choice < 6 && !below.isEmpty()) next = below.at(random(below.size()));
+            else if (current != root) next = QFileInfo{current}.absolutePath();
+        }
+        current = next;
+
+        loaded = false;
+        model.setRootPath(current);
+        // a cached directory can be loaded before `setRootPath` returns
+        if (!loaded) {
+            timeout.start(60000);
+            loop.exec();
+            if (!loaded) {
+                std::fprintf(stderr, "timed out loading %s\n", qPrintable(current));
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (n % (navigations / 10) == 0) {
+            const auto statistics = store->cache().statistics();
+            const auto rss = tffm::bench::residentKiB();
+            if (n == navigations / 10) rssAfterWarmUp = rss;
+            std::printf("navigations=%ld elapsed_ms=%.0f rss_kib=%ld cache_kib=%zu cached=%zu evictions=%lld\n",
+                        n, tffm::bench::millisecondsSince(start), rss, statistics.bytes / 1024, statistics.entries,
+                        static_cast<long long>(statistics.evictions));
+        }
+    }
+
+    std::printf("budget_kib=%zu rss_growth_after_warm_up_kib=%ld\n", store->memoryBudget() / 1024, tffm::bench::residentKiB() - rssAfterWarmUp);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+Times sorting a directory in each order `:sort` offers: the first time (which
+builds the keys and, for sizes and times, `stat`s every entry) and again, as
+when switching back to an order. The comparison sort the model used to do is
+timed as a baseline.
+
+    tffm_sort_bench DIR
+
+A large directory of log-like names can be made with `tffm_search_bench --populate`.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/directorylisting.hpp"
+#include "../src/sortkeys.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// system headers
+#include <strings.h>
+
+namespace {
+
+template <typename F>
+double bestOf(int runs, F&& f) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        const auto start = tffm::bench::Clock::now();
+        f();
+        best = std::min(best, tffm::bench::millisecondsSince(start));
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s DIR\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    using tffm::SortKeys;
+    auto listing = std::make_shared<tffm::DirectoryListing>();
+    if (!listing->read(argv[1])) {
+        std::perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    // directories first, then strcasecmp and strcmp: the order the model used to sort in
+    auto order = std::vector<SortKeys::EntryIndex>(listing->size());
+    const double baselineMs = bestOf(1, [&]() {
+        for (SortKeys::EntryIndex i = 0; i < listing->size(); ++i) order[i] = i;
+        auto const& l = *listing;
+        std::sort(order.begin(), order.end(), [&l](SortKeys::EntryIndex a, SortKeys::EntryIndex b) {
+            const bool aIsDir = l.isDirectory(a);
+            if (aIsDir != l.isDirectory(b)) return aIsDir;
+            const int c = strcasecmp(l.name(a), l.name(b));
+            return c != 0 ? c < 0 : std::strcmp(l.name(a), l.name(b)) < 0;
+        });
+    });
+    std::printf("{\"entries\": %u, \"comparison_sort_ms\": %.2f}\n", listing->size(), baselineMs);
+
+    const struct { const char* name; SortKeys::Key key; } keys[] = {
+        {"name", SortKeys::Key::Name},
+        {"natural", SortKeys::Key::Natural},
+        {"size", SortKeys::Key::Size},
+        {"mtime", SortKeys::Key::ModificationTime},
+        {"ext", SortKeys::Key::Extension}
+    };
+    auto sortKeys = SortKeys{std::make_shared<tffm::EntryMetadata>(listing)};
+    for (auto&& key : keys) {
+        bool same = true;
+        const double firstMs = bestOf(1, [&]() { order = sortKeys.sorted(SortKeys::Order{key.key, false}); });
+        const double againMs = bestOf(5, [&]() { same = sortKeys.sorted(SortKeys::Order{key.key, false}) == order; });
+        const double reversedMs = bestOf(5, [&]() { sortKeys.sorted(SortKeys::Order{key.key, true}); });
+        std::printf("{\"order\": \"%s\", \"first_ms\": %.2f, \"again_ms\": %.2f, \"reversed_ms\": %.2f, \"stable\": %s}\n",
+                    key.name, firstMs, againMs, reversedMs, same ? "true" : "false");
+    }
+    std::printf("{\"keys_bytes\": %zu}\n", sortKeys.memoryUsage());
+    return EXIT_SUCCESS;
+}
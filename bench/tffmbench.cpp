@@ -0,0 +1,337 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+Runs the real `tffm::FileManager` operations headlessly (on the offscreen Qt
+platform, unless QT_QPA_PLATFORM says otherwise) against synthetic directory
+trees, and prints their timings as JSON, with percentiles, so that releases
+can be compared:
+
+    tffm_bench [--runs N] [--large] [--dir DIR] [--keep]
+
+The trees are generated under DIR (a directory in /tmp by default) and reused
+by later runs if --keep leaves them there; otherwise they're removed at the
+end, and DIR with them if nothing else is left in it:
+
+    flat_10000, flat_100000     that many empty files (1% of them hidden) in one directory;
+                                --large adds flat_1000000
+    deep                        100 nested directories of 10 files each
+    mixed                       2000 files of 0 bytes to 16 MiB, and 4 sparse files of
+                                1 GiB with 4 MiB of data each
+    scratch                     where `mixed` is copied to and removed from
+
+Each operation is timed until the file manager is done with it: a `:cd` until
+the directory is loaded, a copy or removal until it's finished (the removal's
+confirmation is accepted right away), keystrokes and the rest until the call
+returns and the events it posted are processed. N (5 by default) sets how many
+times each operation is repeated.
+*/
+
+// project headers
+#include "benchutils.hpp"
+#include "../src/directorymodel.hpp"
+#include "../src/filemanager.hpp"
+#include "../src/yankregister.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Qt classes
+#include <QAbstractButton>
+#include <QApplication>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QMessageBox>
+#include <QStringList>
+#include <QTimer>
+
+namespace {
+
+/*  how long an operation may take before it's considered stuck */
+constexpr int timeout = 600000; // ms
+
+struct Result {
+    std::string operation;
+    std::string tree;
+    std::vector<double> samples; // ms
+    int timeouts = 0;
+};
+
+/*  returns the `p`th percentile of the sorted `samples` (nearest rank) */
+double percentile(std::vector<double> const& samples, double p) {
+    const auto rank = static_cast<std::size_t>(std::ceil(p / 100 * static_cast<double>(samples.size())));
+    return samples[std::max<std::size_t>(rank, 1) - 1];
+}
+
+/*  returns how long `action` takes, counting until `sender` emits `signal`; -1 if it never does */
+template <typename SENDER, typename SIGNAL, typename ACTION>
+double timeUntil(SENDER* sender, SIGNAL signal, ACTION action) {
+    QEventLoop loop;
+    bool emitted = false;
+    auto connection = QObject::connect(sender, signal, &loop, [&emitted, &loop]() {
+        emitted = true;
+        loop.quit();
+    });
+
+    const auto start = tffm::bench::Clock::now();
+    action();
+    if (!emitted) {
+        QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    const auto ms = tffm::bench::millisecondsSince(start);
+    QObject::disconnect(connection);
+    return emitted ? ms : -1;
+}
+
+/*  returns how long `action` takes, including the events it posts */
+template <typename ACTION>
+double timeCall(ACTION action) {
+    const auto start = tffm::bench::Clock::now();
+    action();
+    QCoreApplication::processEvents();
+    return tffm::bench::millisecondsSince(start);
+}
+
+void add(Result& result, double ms) {
+    if (ms < 0) ++result.timeouts;
+    else result.samples.push_back(ms);
+}
+
+/*  generates the tree `name` under `root` with `generate`, unless a previous run left it there */
+template <typename GENERATOR>
+bool prepare(std::string const& root, std::string const& name, GENERATOR generate) {
+    const auto marker = root + "/." + name + "_complete";
+    if (access(marker.c_str(), F_OK) == 0) return true;
+
+    std::fprintf(stderr, "generating %s...\n", name.c_str());
+    if (!generate(root + "/" + name)) {
+        std::perror(name.c_str());
+        return false;
+    }
+    close(open(marker.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644));
+    return true;
+}
+
+/*  removes the trees called `names` that were generated under `root`, then `root` if that leaves it empty */
+void removeGenerated(std::string const& root, std::vector<std::string> const& names) {
+    for (auto&& name : names) {
+        QDir{QFile::decodeName((root + "/" + name).c_str())}.removeRecursively();
+        unlink((root + "/." + name + "_complete").c_str());
+    }
+    rmdir(root.c_str());
+}
+
+void printResults(std::vector<Result>& results, int runs) {
+    std::printf("{\"platform\": \"%s\", \"runs\": %d, \"results\": [", qPrintable(QApplication::platformName()), runs);
+    bool first = true;
+    for (auto&& result : results) {
+        auto& samples = result.samples;
+        std::sort(samples.begin(), samples.end());
+        std::printf("%s\n  {\"operation\": \"%s\", \"tree\": \"%s\", \"samples\": %zu, \"timeouts\": %d",
+                    first ? "" : ",", result.operation.c_str(), result.tree.c_str(), samples.size(), result.timeouts);
+        if (!samples.empty()) {
+            const auto mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+            std::printf(", \"min_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, \"mean_ms\": %.3f",
+                        samples.front(), percentile(samples, 50), percentile(samples, 90), percentile(samples, 99), samples.back(), mean);
+        }
+        std::printf("}");
+        first = false;
+    }
+    std::printf("\n]}\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app{argc, argv};
+
+    int runs = 5;
+    bool large = false;
+    bool keep = false;
+    std::string root = "/tmp/tffm_bench";
+    const auto arguments = QCoreApplication::arguments();
+    for (int i = 1; i < arguments.size(); ++i) {
+        if (arguments[i] == "--runs" && i + 1 < arguments.size()) runs = std::max(arguments[++i].toInt(), 1);
+        else if (arguments[i] == "--large") large = true;
+        else if (arguments[i] == "--keep") keep = true;
+        else if (arguments[i] == "--dir" && i + 1 < arguments.size()) root = QFile::encodeName(arguments[++i]).toStdString();
+        else {
+            std::fprintf(stderr, "usage: tffm_bench [--runs N] [--large] [--dir DIR] [--keep]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // generate the trees
+    mkdir(root.c_str(), 0755);
+    auto flatSizes = std::vector<long>{10000, 100000};
+    if (large) flatSizes.push_back(1000000);
+    for (auto size : flatSizes) {
+        const bool ok = prepare(root, "flat_" + std::to_string(size), [size](std::string const& dir) {
+            return tffm::bench::populateDirectory(dir, size - size / 100) && tffm::bench::populateDirectory(dir, size / 100, ".hidden_");
+        });
+        if (!ok) return EXIT_FAILURE;
+    }
+    const bool ok = prepare(root, "deep", [](std::string const& dir) {
+        return tffm::bench::populateDeepTree(dir, 100, 10);
+    }) && prepare(root, "mixed", [](std::string const& dir) {
+        bool ok = tffm::bench::populateMixedSizes(dir, 2000, 16 << 20);
+        for (int i = 0; i < 4 && ok; ++i) {
+            ok = tffm::bench::createSparseFile(dir + "/sparse_" + std::to_string(i) + ".img", 1LL << 30, 4);
+        }
+        return ok;
+    });
+    if (!ok) return EXIT_FAILURE;
+    const auto scratch = root + "/scratch";
+    mkdir(scratch.c_str(), 0755);
+
+    tffm::FileManager fileManager;
+    fileManager.resize(800, 600);
+    fileManager.show();
+    auto model = qobject_cast<tffm::DirectoryModel*>(fileManager.model());
+    const auto cd = [&fileManager, model](std::string const& path) {
+        return timeUntil(model, &tffm::DirectoryModel::directoryLoaded, [&fileManager, &path]() {
+            fileManager.handleCommand(QStringLiteral(":cd ") + QFile::decodeName(path.c_str()));
+        });
+    };
+    auto results = std::vector<Result>{};
+
+    // flat directories: loading, searching as the pattern is typed, stepping through matches, hiding
+    for (auto size : flatSizes) {
+        const auto name = "flat_" + std::to_string(size);
+        const auto dir = root + "/" + name;
+        std::fprintf(stderr, "%s...\n", name.c_str());
+
+        auto firstLoad = Result{"cd_first", name};
+        add(firstLoad, cd(dir));
+        auto load = Result{"cd", name};
+        auto keystroke = Result{"search_keystroke", name};
+        auto next = Result{"search_next", name};
+        auto hidden = Result{"toggle_hidden", name};
+        const auto pattern = QStringLiteral("/file_") + QString::number(size * 3 / 4);
+        for (int run = 0; run < runs; ++run) {
+            cd(scratch);
+            add(load, cd(dir));
+
+            for (int length = 1; length <= pattern.size(); ++length) {
+                add(keystroke, timeCall([&fileManager, &pattern, length]() { fileManager.handleCommandUpdate(pattern.left(length)); }));
+            }
+            fileManager.handleCommandUpdate(QStringLiteral("/file_1"));
+            for (int i = 0; i < 20; ++i) {
+                add(next, timeCall([&fileManager]() { fileManager.searchNext(); }));
+            }
+            for (int i = 0; i < 2; ++i) {
+                add(hidden, timeCall([&fileManager]() { fileManager.toggleHidden(); }));
+            }
+        }
+        results.push_back(firstLoad);
+        results.push_back(load);
+        results.push_back(keystroke);
+        results.push_back(next);
+        results.push_back(hidden);
+    }
+
+    // a deep tree, one level at a time
+    {
+        std::fprintf(stderr, "deep...\n");
+        auto load = Result{"cd", "deep"};
+        for (int run = 0; run < runs; ++run) {
+            auto dir = root + "/deep";
+            for (int level = 0; level < 100; ++level) {
+                add(load, cd(dir));
+                dir += "/level_" + std::to_string(level);
+            }
+        }
+        results.push_back(load);
+    }
+
+    // copying and removing a tree of mixed and sparse files
+    {
+        std::fprintf(stderr, "mixed...\n");
+        auto copy = Result{"put_copy", "mixed"};
+        auto removal = Result{"remove_selected", "mixed"};
+
+        // removals ask for confirmation, which is given as soon as the dialog shows up
+        QTimer confirm;
+        confirm.setInterval(1);
+        QObject::connect(&confirm, &QTimer::timeout, []() {
+            if (auto box = qobject_cast<QMessageBox*>(QApplication::activeModalWidget())) box->button(QMessageBox::Yes)->click();
+        });
+
+        cd(scratch);
+        const auto copyPath = QFile::decodeName((scratch + "/mixed").c_str());
+        for (int run = 0; run < runs; ++run) {
+            tffm::YankRegister::instance().set(std::make_shared<tffm::YankRegister::Paths>(tffm::YankRegister::Paths{root + "/mixed"}));
+            add(copy, timeUntil(&fileManager, &tffm::FileManager::copyFinished, [&fileManager]() { fileManager.putCopy(); }));
+
+            // the directory watcher picks up the copied tree, after which it can be selected; the ticks
+            // bring the wait back to the deadline if that never happens
+            QTimer tick;
+            tick.start(100);
+            const auto copied = tffm::bench::Clock::now();
+            while (!model->index(copyPath).isValid()) {
+                if (tffm::bench::millisecondsSince(copied) > timeout) {
+                    std::fprintf(stderr, "the copy of mixed never showed up in %s\n", scratch.c_str());
+                    return EXIT_FAILURE;
+                }
+                QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+            }
+            fileManager.setCurrentIndex(model->index(copyPath));
+            confirm.start();
+            add(removal, timeUntil(&fileManager, &tffm::FileManager::removeFinished, [&fileManager]() { fileManager.removeSelected(); }));
+            confirm.stop();
+        }
+        results.push_back(copy);
+        results.push_back(removal);
+    }
+
+    printResults(results, runs);
+
+    if (!keep) {
+        // only what the bench generated, as DIR may hold other things
+        std::fprintf(stderr, "removing the trees in %s...\n", root.c_str());
+        auto generated = std::vector<std::string>{"deep", "mixed", "scratch"};
+        for (auto size : flatSizes) generated.push_back("flat_" + std::to_string(size));
+        removeGenerated(root, generated);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "commandpipe.hpp"
+#include "filemanager.hpp"
+
+// standard libraries
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+// Qt classes
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+// system headers
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+tffm::CommandPipe::CommandPipe(FileManager* fileManager, QObject* parent)
+    : QObject{parent}, _fileManager{fileManager}, _fd{-1}, _ownsFd{false}, _fdFlags{0}, _lineNumber{0},
+      _inputClosed{false}, _quitting{false}, _running{false}, _failed{false}, _current{0, QString{}},
+      _waitingFor{Wait::Nothing}, _ok{true} {
+    _fileManager->setConfirmRemovals(false);
+
+    connect(_fileManager, &FileManager::statusChanged, this, [this](QString const& message, int) {
+        if (!message.isEmpty()) _message = message;
+    });
+    connect(_fileManager, &FileManager::searchFinished, this, [this](bool found) {
+        _ok = found;
+        if (_waitingFor == Wait::FileManager) resume();
+    });
+    connect(_fileManager, &FileManager::directoryLoaded, this, [this]() {
+        if (_waitingFor == Wait::FileManager) resume();
+    });
+    connect(_fileManager, &FileManager::copyFinished, this, [this](qint64, QStringList const& errors, bool cancelled) {
+        if (_waitingFor != Wait::Copy) return;
+        _ok = errors.isEmpty() && !cancelled;
+        _waitingFor = Wait::Nothing;
+        resume();
+    });
+    connect(_fileManager, &FileManager::removeFinished, this, [this](qint64, QStringList const& errors) {
+        if (_waitingFor != Wait::Removal) return;
+        _ok = errors.isEmpty();
+        _waitingFor = Wait::Nothing;
+        resume();
+    });
+}
+
+tffm::CommandPipe::~CommandPipe() {
+    closeInput();
+}
+
+/*
+starts reading commands from `path`, or stdin if it's "-"
+*/
+bool tffm::CommandPipe::open(QString const& path) {
+    if (path == QLatin1String("-")) {
+        _fd = STDIN_FILENO;
+        _ownsFd = false;
+    }
+    else {
+        const auto nativePath = QFile::encodeName(path);
+        struct stat st;
+        const bool isFifo = stat(nativePath.constData(), &st) == 0 && S_ISFIFO(st.st_mode);
+
+        // a FIFO is opened for writing as well, so it doesn't end each time a writer closes it
+        _fd = ::open(nativePath.constData(), (isFifo ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+        if (_fd < 0) {
+            _error = tr("can't open %0: %1").arg(path).arg(QString::fromLocal8Bit(std::strerror(errno)));
+            return false;
+        }
+        _ownsFd = true;
+    }
+
+    _fdFlags = fcntl(_fd, F_GETFL);
+    fcntl(_fd, F_SETFL, _fdFlags | O_NONBLOCK);
+    _notifier = std::make_unique<QSocketNotifier>(_fd, QSocketNotifier::Read);
+    connect(_notifier.get(), &QSocketNotifier::activated, this, &CommandPipe::readInput);
+    return true;
+}
+
+/*
+reads what's available, queues the complete lines and runs them
+*/
+void tffm::CommandPipe::readInput() {
+    char buffer[64 * 1024];
+    for (;;) {
+        const auto n = read(_fd, buffer, sizeof buffer);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            _inputClosed = true;
+            break;
+        }
+        _input.append(buffer, static_cast<int>(n));
+    }
+    if (_inputClosed && !_input.isEmpty() && !_input.endsWith('\n')) _input.append('\n');
+
+    int start = 0;
+    for (int end; (end = _input.indexOf('\n', start)) >= 0; start = end + 1) {
+        ++_lineNumber;
+        auto text = QString::fromUtf8(_input.constData() + start, end - start);
+        if (text.endsWith(QChar('\r'))) text.chop(1);
+        if (text.trimmed().isEmpty() || text.startsWith(QChar('#'))) continue;
+        _commands.push_back(Command{_lineNumber, std::move(text)});
+    }
+    _input.remove(0, start);
+
+    if (_inputClosed) closeInput();
+    if (_waitingFor == Wait::Nothing && !_running) runCommands();
+}
+
+/*
+runs the queued commands until one has to wait, then writes out the results
+*/
+void tffm::CommandPipe::runCommands() {
+    _running = true;
+    while (!_commands.empty() && _waitingFor == Wait::Nothing && !_quitting) {
+        _current = std::move(_commands.front());
+        _commands.pop_front();
+        if (_current.text == QLatin1String(":q") || _current.text == QLatin1String(":quit")) {
+            _quitting = true;
+            break;
+        }
+        if (start(_current)) finishCommand();
+    }
+    _running = false;
+    std::fflush(stdout);
+
+    if (_waitingFor == Wait::Nothing && (_quitting || (_inputClosed && _commands.empty()))) {
+        closeInput();
+        _commands.clear();
+        emit finished(_failed ? 1 : 0);
+    }
+}
+
+/*
+runs `command`; returns false if it's left work running that has to be waited on
+*/
+bool tffm::CommandPipe::start(Command const& command) {
+    auto const& text = command.text;
+    _ok = true;
+    _message.clear();
+
+    if (text == QLatin1String("n") || text == QLatin1String("N")) {
+        _ok = false; // until a match is selected
+        if (text == QLatin1String("n")) _fileManager->searchNext();
+        else _fileManager->searchPrevious();
+    }
+    else if (text.startsWith(QChar('/')) || text.startsWith(QChar('?'))) {
+        _ok = false;
+        _fileManager->handleCommandUpdate(text);
+    }
+    else if (text == QLatin1String("yy")) {
+        _fileManager->copySelected();
+    }
+    else if (text == QLatin1String("p")) {
+        _waitingFor = Wait::Copy;
+        if (!_fileManager->putCopy()) {
+            _waitingFor = Wait::Nothing;
+            _ok = false;
+            _message = tr("nothing to put");
+        }
+    }
+    else if (text == QLatin1String("dd")) {
+        _waitingFor = Wait::Removal;
+        if (!_fileManager->removeSelected()) {
+            _waitingFor = Wait::Nothing;
+            _ok = false;
+            _message = tr("nothing to remove");
+        }
+    }
+    else if (text.startsWith(QChar(':'))) {
+        _ok = _fileManager->handleCommand(text);
+        if (!_ok && _message.isEmpty()) _message = tr("unknown command");
+    }
+    else {
+        _ok = false;
+        _message = tr("unknown command");
+    }
+    return isSettled();
+}
+
+/*
+picks up where `runCommands` left off once the work being waited on is done
+*/
+void tffm::CommandPipe::resume() {
+    if (_running || !isSettled()) return;
+    finishCommand();
+    runCommands();
+}
+
+/*
+returns whether the current command's work is done, updating `_waitingFor` if not
+*/
+bool tffm::CommandPipe::isSettled() {
+    if (_waitingFor == Wait::Copy || _waitingFor == Wait::Removal) return false;
+
+    // a copy re-reads the directory when it's done, and the next command should see the result
+    _waitingFor = _fileManager->isBusy() ? Wait::FileManager : Wait::Nothing;
+    return _waitingFor == Wait::Nothing;
+}
+
+/*
+writes the result of the current command
+*/
+void tffm::CommandPipe::finishCommand() {
+    auto result = QJsonObject{};
+    result.insert(QStringLiteral("line"), _current.line);
+    result.insert(QStringLiteral("command"), _current.text);
+    result.insert(QStringLiteral("ok"), _ok);
+    const auto current = _fileManager->currentPath();
+    if (!current.isEmpty()) result.insert(QStringLiteral("current"), current);
+    if (!_message.isEmpty()) result.insert(QStringLiteral("message"), _message);
+
+    auto line = QJsonDocument{result}.toJson(QJsonDocument::Compact);
+    line += '\n';
+    std::fwrite(line.constData(), 1, static_cast<std::size_t>(line.size()), stdout);
+    if (!_ok) _failed = true;
+}
+
+void tffm::CommandPipe::closeInput() {
+    _notifier.reset();
+    if (_fd < 0) return;
+
+    fcntl(_fd, F_SETFL, _fdFlags);
+    if (_ownsFd) ::close(_fd);
+    _fd = -1;
+}
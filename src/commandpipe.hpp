@@ -0,0 +1,131 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef COMMANDPIPE_HPP
+#define COMMANDPIPE_HPP
+
+// standard libraries
+#include <deque>
+#include <memory>
+
+// Qt classes
+#include <QByteArray>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+
+namespace tffm {
+    class FileManager;
+    class CommandPipe;
+}
+
+/*
+drives a `FileManager` with commands read from a pipe, a file or stdin, one per line, and
+writes a JSON result line to stdout for each
+
+Besides `:` commands, the lines can be searches (`/PATTERN` or `?PATTERN`) and the keys
+`n`, `N`, `yy`, `p` and `dd`; blank lines and lines starting with `#` are skipped, and `:q`
+stops. Every line that's available is read at once and run back to back without going
+back to the event loop, and the results are written out in one go. A command that leaves
+work running (reading a directory, waiting on a search index, copying or removing) holds
+the ones after it back until the work is done, so each command sees the effects of the
+previous one and the results come out in order; lines keep being read in the meantime.
+Removals aren't confirmed.
+*/
+class tffm::CommandPipe : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit CommandPipe(FileManager* fileManager, QObject* parent = nullptr);
+        ~CommandPipe() override;
+
+        bool open(QString const& path);
+        /*  starts reading commands from `path`, or stdin if it's "-"; a FIFO is kept open
+            (and waited on) until `:q`, anything else is read until its end */
+
+        QString errorString() const { return _error; }
+
+    signals:
+        void finished(int status);
+        /*  emitted once the last command is done; `status` is 1 if any of them failed, 0 otherwise */
+
+    private:
+        /*  what the command being run is waiting for */
+        enum class Wait { Nothing, Copy, Removal, FileManager };
+
+        struct Command {
+            qint64 line;
+            QString text;
+        };
+
+        FileManager* _fileManager;
+        int _fd;
+        bool _ownsFd;
+        int _fdFlags;                       // the flags of `_fd` before it was made non-blocking
+        std::unique_ptr<QSocketNotifier> _notifier;
+        QByteArray _input;                  // read but not yet split into lines
+        qint64 _lineNumber;
+        std::deque<Command> _commands;
+        bool _inputClosed;
+        bool _quitting;                     // true once `:q` is read
+        bool _running;                      // true while `runCommands` is running commands
+        bool _failed;                       // true once a command failed
+        QString _error;
+
+        Command _current;
+        Wait _waitingFor;
+        bool _ok;
+        QString _message;                   // the last status message of the current command
+
+        void readInput();
+        /*  reads what's available, queues the complete lines and runs them */
+
+        void runCommands();
+        /*  runs the queued commands until one has to wait, then writes out the results */
+
+        bool start(Command const& command);
+        /*  runs `command`; returns false if it's left work running that has to be waited on */
+
+        void resume();
+        /*  picks up where `runCommands` left off once the work being waited on is done */
+
+        bool isSettled();
+        /*  returns whether the current command's work is done, updating `_waitingFor` if not */
+
+        void finishCommand();
+        /*  writes the result of the current command */
+
+        void closeInput();
+};
+
+#endif // COMMANDPIPE_HPP
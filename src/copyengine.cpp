@@ -0,0 +1,1003 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "copyengine.hpp"
+#include "directorylisting.hpp"
+#include "functiontask.hpp"
+#include "iouring.hpp"
+#include "tracing.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <utility>
+
+// Qt classes
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+// system headers
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace {
+
+/*  size of the chunks in which file contents are streamed */
+constexpr std::size_t chunkSize = 1 << 20;
+
+/*  size of the chunks copied in the kernel, between which a cancelled copy stops */
+constexpr std::size_t rangeChunkSize = 64 << 20;
+
+/*  same, for copies driven by an io_uring, whose other requests wait while a chunk is copied */
+constexpr std::size_t ringRangeChunkSize = 8 << 20;
+
+/*  how often progress is reported while copies are running */
+constexpr int progressInterval = 250; // ms
+
+/*  how many requests a copy keeps in flight with io_uring, unless told otherwise */
+constexpr int defaultQueueDepth = 64;
+
+QString errorString(std::string const& path, int error = errno) {
+    return QFile::decodeName(path.c_str()) + QStringLiteral(": ") + QString::fromLocal8Bit(std::strerror(error));
+}
+
+/*  returns whether a file of `size` bytes taking up `blocks` 512-byte blocks has holes */
+bool isSparse(qint64 size, qint64 blocks) {
+    return blocks * 512 < size;
+}
+
+/*  returns whether `dest` is inside `src`, which can't be copied there */
+bool isInside(std::string const& dest, std::string const& src) {
+    return dest.compare(0, src.size() + 1, src + '/') == 0;
+}
+
+/*  returns the file mode creation mask, without changing it as `umask()` would */
+mode_t currentUmask() {
+    mode_t mask = 022;
+    if (auto f = std::fopen("/proc/self/status", "r")) {
+        char line[256];
+        while (std::fgets(line, sizeof line, f)) {
+            if (std::strncmp(line, "Umask:", 6) == 0) {
+                mask = static_cast<mode_t>(std::strtoul(line + 6, nullptr, 8));
+                break;
+            }
+        }
+        std::fclose(f);
+    }
+    return mask;
+}
+
+}
+
+/*
+state shared by all the tasks copying one batch of items
+*/
+struct tffm::CopyEngine::Job {
+    std::atomic<bool> cancelled{false};
+    std::atomic<qint64> bytesCopied{0};
+    std::atomic<qint64> filesLeft{0};
+    std::atomic<qint64> filesCopied{0};
+    std::atomic<int> pendingTasks{0};
+    std::atomic<bool> cannotClone{false};       // set once a reflink fails in a way that'll keep failing
+    std::atomic<bool> cannotCopyRange{false};   // same, for `copy_file_range`
+    const tracing::Clock::time_point started = tracing::Clock::now();
+    QMutex errorsMutex;
+    QStringList errors;
+
+    /*  a source file with several links, and the destinations waiting for its copy to link to it */
+    struct LinkedFile {
+        std::string copy;               // empty once copying it has failed
+        bool done = false;
+        std::vector<std::string> waiting;
+    };
+    QMutex linksMutex;
+    std::map<std::pair<std::uint64_t, std::uint64_t>, LinkedFile> linkedFiles; // by device and inode of the source
+
+    void addError(QString const& error) {
+        QMutexLocker lock{&errorsMutex};
+        errors << error;
+    }
+
+    bool linkToCopy(std::uint64_t device, std::uint64_t inode, std::string const& dest);
+    void finishLinkedCopy(std::uint64_t device, std::uint64_t inode, bool copied);
+    void link(std::string const& copy, std::string const& dest);
+};
+
+/*
+returns false the first time the source file identified by `device` and `inode` is seen, which should then be
+copied to `dest`; the other times, `dest` becomes (or will become, once that copy is done) a link to the copy
+
+If the copy fails, the next destination seen is copied in its place.
+*/
+bool tffm::CopyEngine::Job::linkToCopy(std::uint64_t device, std::uint64_t inode, std::string const& dest) {
+    QMutexLocker lock{&linksMutex};
+    auto inserted = linkedFiles.emplace(std::make_pair(device, inode), LinkedFile{});
+    auto& file = inserted.first->second;
+    if (inserted.second || file.copy.empty()) {
+        file.copy = dest;
+        file.done = false;
+        return false;
+    }
+
+    if (file.done) {
+        const auto copy = file.copy;
+        lock.unlock();
+        link(copy, dest);
+    }
+    else {
+        file.waiting.push_back(dest);
+    }
+    return true;
+}
+
+/*
+links the destinations waiting for the copy of the source file identified by `device` and `inode`
+*/
+void tffm::CopyEngine::Job::finishLinkedCopy(std::uint64_t device, std::uint64_t inode, bool copied) {
+    QMutexLocker lock{&linksMutex};
+    auto& file = linkedFiles[std::make_pair(device, inode)];
+    file.done = true;
+    if (!copied) file.copy.clear(); // nothing to link to
+    const auto copy = file.copy;
+    auto waiting = std::move(file.waiting);
+    lock.unlock();
+
+    for (auto&& dest : waiting) {
+        if (copied) link(copy, dest);
+        else addError(QFile::decodeName(dest.c_str()) + QStringLiteral(": not linked, as the file it's a link of wasn't copied"));
+    }
+}
+
+void tffm::CopyEngine::Job::link(std::string const& copy, std::string const& dest) {
+    if (::link(copy.c_str(), dest.c_str()) == 0) ++filesCopied;
+    else addError(errorString(dest));
+}
+
+tffm::CopyEngine::CopyEngine(QObject* parent) : QObject{parent}, _bytesAtLastProgress{0}, _queueDepth{defaultQueueDepth} {
+    // copying is mostly waiting on I/O, so use more threads than there are cores
+    _pool.setMaxThreadCount(std::max(4, QThread::idealThreadCount() * 2));
+
+    _progressTimer.setInterval(progressInterval);
+    connect(&_progressTimer, &QTimer::timeout, this, &CopyEngine::reportProgress);
+}
+
+tffm::CopyEngine::~CopyEngine() {
+    cancel();
+    _pool.waitForDone();
+}
+
+/*
+copies every (source, destination) pair in the background, recursively if needed
+*/
+void tffm::CopyEngine::start(CopyList const& items) {
+    auto nativeItems = NativeCopyList{};
+    for (auto&& item : items) {
+        nativeItems.emplace_back(QFile::encodeName(item.first).toStdString(), QFile::encodeName(item.second).toStdString());
+    }
+    startJob([nativeItems]() { return nativeItems; });
+}
+
+/*
+copies the items at the paths `sources` into `directory`, keeping their names, in the background
+*/
+void tffm::CopyEngine::start(std::shared_ptr<const std::vector<std::string>> sources, std::string const& directory) {
+    startJob([sources, directory]() {
+        auto items = NativeCopyList{};
+        items.reserve(sources->size());
+        for (auto&& source : *sources) {
+            const auto slash = source.find_last_of('/');
+            items.emplace_back(source, directory + '/' + (slash == std::string::npos ? source : source.substr(slash + 1)));
+        }
+        return items;
+    });
+}
+
+/*
+starts a job copying the (source, destination) pairs `plan` returns
+*/
+void tffm::CopyEngine::startJob(std::function<NativeCopyList()> plan) {
+    auto job = std::make_shared<Job>();
+    job->pendingTasks = 1; // held by the planning task below
+    _jobs.push_back(job);
+
+    if (!_progressTimer.isActive()) {
+        _bytesAtLastProgress = 0;
+        _sinceLastProgress.start();
+        _progressTimer.start();
+    }
+
+    const auto depth = usesIoUring() ? _queueDepth : 0;
+    _pool.start(new FunctionTask{[this, job, plan, depth]() {
+        auto items = NativeCopyList{};
+        for (auto&& item : plan()) {
+            if (isInside(item.second, item.first)) {
+                job->addError(QFile::decodeName(item.first.c_str()) + QStringLiteral(": cannot copy a directory into itself"));
+            }
+            else {
+                items.push_back(item);
+            }
+        }
+        // what the ring doesn't copy (all of it if it can't be set up) is copied on the pool
+        auto leftOver = NativeCopyList{};
+        if (depth == 0 || !copyWithRing(*job, items, depth, leftOver)) leftOver = std::move(items);
+        for (auto&& item : leftOver) {
+            if (job->cancelled) break;
+            copyRecursively(job, item.first, item.second);
+        }
+        release(job);
+    }});
+}
+
+/*
+stops all running copies; partially written files are removed
+*/
+void tffm::CopyEngine::cancel() {
+    for (auto&& job : _jobs) {
+        job->cancelled = true;
+    }
+}
+
+/*
+sets how many requests copies keep in flight with io_uring; 0 uses the thread pool instead
+*/
+void tffm::CopyEngine::setQueueDepth(int depth) {
+    _queueDepth = std::max(depth, 0);
+}
+
+/*
+returns whether the next copies will use io_uring
+*/
+bool tffm::CopyEngine::usesIoUring() const {
+    return _queueDepth > 0 && IoUring::isSupported();
+}
+
+/*
+copies a file system item from `src` to `dest`, recursively if needed (runs on the pool)
+
+Directories are created right away, in the order they're found, so that files
+can be handed to the pool as soon as their parent exists.
+*/
+void tffm::CopyEngine::copyRecursively(std::shared_ptr<Job> const& job, std::string const& src, std::string const& dest) {
+    tracing::Scope scope{tracing::Operation::CopyWalk};
+    auto copyops = std::vector<std::pair<std::string, std::string>>{};
+    copyops.emplace_back(src, dest);
+    auto listing = DirectoryListing{};
+    struct stat st;
+    while (!copyops.empty() && !job->cancelled) {
+        auto op = std::move(copyops.back());
+        copyops.pop_back();
+
+        if (lstat(op.first.c_str(), &st) != 0) {
+            job->addError(errorString(op.first));
+        }
+        else if (S_ISREG(st.st_mode)) {
+            const bool linked = st.st_nlink > 1;
+            if (linked && job->linkToCopy(st.st_dev, st.st_ino, op.second)) continue;
+            copyFileLater(job, std::move(op.first), std::move(op.second), st.st_dev, linked ? st.st_ino : 0);
+        }
+        else if (S_ISLNK(st.st_mode)) {
+            // links are recreated rather than followed, which also keeps cycles out of the walk
+            char target[PATH_MAX];
+            const auto n = readlink(op.first.c_str(), target, sizeof target - 1);
+            if (n < 0) {
+                job->addError(errorString(op.first));
+                continue;
+            }
+            target[n] = '\0';
+            if (symlink(target, op.second.c_str()) != 0) job->addError(errorString(op.second));
+        }
+        else if (S_ISDIR(st.st_mode)) {
+            if (mkdir(op.second.c_str(), (st.st_mode & 07777) | S_IRWXU) != 0) {
+                job->addError(errorString(op.second));
+                continue;
+            }
+            if (!listing.read(op.first)) {
+                job->addError(errorString(op.first));
+                continue;
+            }
+            for (DirectoryListing::size_type i = 0; i < listing.size(); ++i) {
+                copyops.emplace_back(op.first + '/' + listing.name(i), op.second + '/' + listing.name(i));
+            }
+        }
+        else {
+            job->addError(QFile::decodeName(op.first.c_str()) + QStringLiteral(": unsupported file type"));
+        }
+    }
+}
+
+/*
+copies the items of one job through an io_uring, keeping up to a fixed number of items in flight
+
+Every item goes through a chain of requests (statx, then mkdirat for a
+directory, or openat, openat, reads and writes until the end, and closes for a
+regular file) one request at a time, so an item in flight has a single request
+in the ring, apart from the close of its source that nothing waits on.
+
+The ring has no request for reflinks or `copy_file_range`, so a file that
+can't be reflinked is copied in the kernel on the ring's thread, a chunk at a
+time and taking turns with the other files being copied that way, in between
+handling completions. Sparse files are copied by `copyContents` right there
+too, all at once as their holes are found with lseek, which holds up every
+other request until they're done; they're rare enough for it not to matter.
+*/
+class tffm::CopyEngine::RingCopy {
+    public:
+        RingCopy(Job& job, IoUring& ring, int depth) : _job(job), _ring(ring), _depth{depth}, _inFlight{0}, _umask{currentUmask()} {}
+
+        void run(std::vector<std::pair<std::string, std::string>> const& items, std::vector<std::pair<std::string, std::string>>& leftOver);
+        /*  copies `items`; if the ring fails, what's left to copy is added to `leftOver` */
+
+    private:
+        enum class Step { Stat, MakeDirectory, OpenSource, OpenDestination, CopyRange, Read, Write, Close };
+
+        struct Item {
+            std::string src;
+            std::string dest;
+            Step step = Step::Stat;
+            struct statx stx;
+            int in = -1;
+            int out = -1;
+            bool isFile = false;        // counted in `filesLeft`
+            bool complete = false;      // all of the contents have been written
+            bool copied = false;        // and the copy has been closed
+            std::uint64_t device = 0;   // of the source, if it has other links
+            std::uint64_t inode = 0;    // same, 0 if it doesn't
+            std::unique_ptr<char[]> buffer;
+            off_t offset = 0;           // in the file, of the data in `buffer`
+            std::size_t buffered = 0;   // bytes in `buffer`
+            std::size_t written = 0;    // bytes of `buffer` written so far
+        };
+
+        Job& _job;
+        IoUring& _ring;
+        int _depth;
+        int _inFlight;                  // requests in the ring
+        mode_t _umask;
+        std::vector<std::pair<std::string, std::string>> _pending; // items not started yet, used as a stack
+        std::vector<std::unique_ptr<Item>> _items;                  // items in flight
+        std::vector<Item*> _inKernel;                               // those being copied with `copy_file_range`
+        std::size_t _nextInKernel = 0;                              // the one whose turn it is
+        std::vector<std::unique_ptr<char[]>> _freeBuffers;
+        DirectoryListing _listing;
+
+        io_uring_sqe* request(Item* item, Step step, unsigned char opcode, int fd);
+        /*  returns a ring entry for the next request of `item`, or for one nothing waits on if `item` is null */
+
+        void advance(Item* item, int result);
+        /*  moves `item` on, once its current request has returned `result` */
+
+        void copyInKernel();
+        /*  copies a chunk of the next item being copied with `copy_file_range` */
+
+        void startReading(Item* item);
+        void read(Item* item);
+        void write(Item* item);
+
+        void complete(Item* item);
+        /*  closes `item`, all of whose contents have been written */
+
+        void fail(Item* item, std::string const& path, int error);
+        /*  gives up on `item`, removing what was written of it */
+
+        void closeFiles(Item* item);
+        /*  closes the files of `item`, then forgets it */
+
+        void finish(Item* item);
+        /*  forgets `item` */
+
+        void abandon(std::vector<std::pair<std::string, std::string>>& leftOver);
+        /*  closes everything in flight without the ring, which has failed, adding what's left to copy to `leftOver` */
+};
+
+void tffm::CopyEngine::RingCopy::run(std::vector<std::pair<std::string, std::string>> const& items, std::vector<std::pair<std::string, std::string>>& leftOver) {
+    _pending.assign(items.rbegin(), items.rend());
+    while (true) {
+        while (!_job.cancelled && static_cast<int>(_items.size()) < _depth && !_pending.empty()) {
+            _items.emplace_back(new Item{});
+            auto item = _items.back().get();
+            item->src = std::move(_pending.back().first);
+            item->dest = std::move(_pending.back().second);
+            _pending.pop_back();
+
+            auto sqe = request(item, Step::Stat, IORING_OP_STATX, AT_FDCWD);
+            sqe->addr = reinterpret_cast<std::uint64_t>(item->src.c_str());
+            sqe->len = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_INO | STATX_SIZE | STATX_BLOCKS;
+            sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+            sqe->off = reinterpret_cast<std::uint64_t>(&item->stx);
+        }
+        if (_inFlight == 0 && _inKernel.empty()) break;
+
+        // while files are being copied in the kernel, completions are only picked up between chunks
+        const auto submitted = _ring.submit(_inKernel.empty() ? 1 : 0);
+        if (submitted < 0 && submitted != -EAGAIN && submitted != -EBUSY) {
+            abandon(leftOver);
+            return;
+        }
+
+        auto completion = IoUring::Completion{};
+        while (_ring.nextCompletion(completion)) {
+            --_inFlight;
+            if (completion.userData != 0) advance(reinterpret_cast<Item*>(completion.userData), completion.result);
+        }
+        if (!_inKernel.empty()) copyInKernel();
+    }
+}
+
+io_uring_sqe* tffm::CopyEngine::RingCopy::request(Item* item, Step step, unsigned char opcode, int fd) {
+    // the ring has room for two requests per item, so this only loops if the kernel is behind
+    auto sqe = _ring.nextRequest();
+    while (!sqe) {
+        _ring.submit();
+        sqe = _ring.nextRequest();
+    }
+    if (item) item->step = step;
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = reinterpret_cast<std::uint64_t>(item);
+    ++_inFlight;
+    return sqe;
+}
+
+void tffm::CopyEngine::RingCopy::advance(Item* item, int result) {
+    if (_job.cancelled && item->step != Step::Close) {
+        if (item->step == Step::OpenSource && result >= 0) item->in = result;
+        if (item->step == Step::OpenDestination && result >= 0) item->out = result;
+        if (item->out >= 0) unlink(item->dest.c_str());
+        closeFiles(item);
+        return;
+    }
+
+    switch (item->step) {
+    case Step::Stat:
+        if (result < 0) {
+            fail(item, item->src, -result);
+        }
+        else if (S_ISREG(item->stx.stx_mode)) {
+            if (item->stx.stx_nlink > 1) {
+                const auto device = static_cast<std::uint64_t>(makedev(item->stx.stx_dev_major, item->stx.stx_dev_minor));
+                if (_job.linkToCopy(device, item->stx.stx_ino, item->dest)) {
+                    finish(item);
+                    break;
+                }
+                item->device = device;
+                item->inode = item->stx.stx_ino;
+            }
+            item->isFile = true;
+            ++_job.filesLeft;
+            auto sqe = request(item, Step::OpenSource, IORING_OP_OPENAT, AT_FDCWD);
+            sqe->addr = reinterpret_cast<std::uint64_t>(item->src.c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        }
+        else if (S_ISDIR(item->stx.stx_mode)) {
+            auto sqe = request(item, Step::MakeDirectory, IORING_OP_MKDIRAT, AT_FDCWD);
+            sqe->addr = reinterpret_cast<std::uint64_t>(item->dest.c_str());
+            sqe->len = (item->stx.stx_mode & 07777) | S_IRWXU;
+        }
+        else if (S_ISLNK(item->stx.stx_mode)) {
+            // links are rare enough to be recreated right here
+            char target[PATH_MAX];
+            const auto n = readlink(item->src.c_str(), target, sizeof target - 1);
+            if (n < 0) {
+                _job.addError(errorString(item->src));
+            }
+            else {
+                target[n] = '\0';
+                if (symlink(target, item->dest.c_str()) != 0) _job.addError(errorString(item->dest));
+            }
+            finish(item);
+        }
+        else {
+            _job.addError(QFile::decodeName(item->src.c_str()) + QStringLiteral(": unsupported file type"));
+            finish(item);
+        }
+        break;
+    case Step::MakeDirectory:
+        // the children can only be started once their parent exists
+        if (result < 0) {
+            _job.addError(errorString(item->dest, -result));
+        }
+        else if (!_listing.read(item->src)) {
+            _job.addError(errorString(item->src));
+        }
+        else {
+            for (DirectoryListing::size_type i = 0; i < _listing.size(); ++i) {
+                _pending.emplace_back(item->src + '/' + _listing.name(i), item->dest + '/' + _listing.name(i));
+            }
+        }
+        finish(item);
+        break;
+    case Step::OpenSource: {
+        if (result < 0) {
+            fail(item, item->src, -result);
+            break;
+        }
+        item->in = result;
+        auto sqe = request(item, Step::OpenDestination, IORING_OP_OPENAT, AT_FDCWD);
+        sqe->addr = reinterpret_cast<std::uint64_t>(item->dest.c_str());
+        sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+        sqe->len = item->stx.stx_mode & 07777;
+        break;
+    }
+    case Step::OpenDestination:
+        if (result < 0) {
+            fail(item, item->dest, -result);
+            break;
+        }
+        item->out = result;
+
+        // reflinks, and the holes of sparse files, can't be had through reads and writes; sparse files
+        // are copied here and now (see above)
+        if (isSparse(static_cast<qint64>(item->stx.stx_size), static_cast<qint64>(item->stx.stx_blocks))) {
+            if (copyContents(_job, item->in, item->out, item->src, item->dest, static_cast<qint64>(item->stx.stx_size), true)) {
+                complete(item);
+            }
+            else {
+                unlink(item->dest.c_str());
+                closeFiles(item);
+            }
+            break;
+        }
+        if (cloneContents(_job, item->in, item->out)) {
+            _job.bytesCopied += static_cast<qint64>(item->stx.stx_size);
+            complete(item);
+            break;
+        }
+        if (!_job.cannotCopyRange) {
+            item->step = Step::CopyRange;
+            _inKernel.push_back(item);
+            break;
+        }
+        startReading(item);
+        break;
+    case Step::CopyRange:
+        break; // not a request
+    case Step::Read:
+        if (result < 0) {
+            fail(item, item->src, -result);
+        }
+        else if (result == 0) {
+            complete(item);
+        }
+        else {
+            item->buffered = static_cast<std::size_t>(result);
+            item->written = 0;
+            write(item);
+        }
+        break;
+    case Step::Write:
+        if (result < 0) {
+            fail(item, item->dest, -result);
+            break;
+        }
+        _job.bytesCopied += result;
+        item->written += static_cast<std::size_t>(result);
+        if (item->written < item->buffered) {
+            write(item);
+        }
+        else {
+            item->offset += static_cast<off_t>(item->buffered);
+            read(item);
+        }
+        break;
+    case Step::Close:
+        // only the destination's close is waited on, as it may be the one to report a failed write
+        if (result < 0 && item->complete) {
+            unlink(item->dest.c_str());
+            _job.addError(errorString(item->dest, -result));
+        }
+        else if (item->complete) {
+            item->copied = true;
+            ++_job.filesCopied;
+        }
+        finish(item);
+        break;
+    }
+}
+
+/*
+copies a chunk of the next item being copied with `copy_file_range`, moving it on once that's done or can't be
+*/
+void tffm::CopyEngine::RingCopy::copyInKernel() {
+    if (_nextInKernel >= _inKernel.size()) _nextInKernel = 0;
+    auto item = _inKernel[_nextInKernel];
+    const auto stop = [this]() {
+        _inKernel.erase(_inKernel.begin() + static_cast<std::ptrdiff_t>(_nextInKernel));
+    };
+    if (_job.cancelled) {
+        stop();
+        unlink(item->dest.c_str());
+        closeFiles(item);
+        return;
+    }
+
+    loff_t inOffset = item->offset;
+    loff_t outOffset = item->offset;
+    const auto n = copy_file_range(item->in, &inOffset, item->out, &outOffset, ringRangeChunkSize, 0);
+    if (n > 0) {
+        item->offset += static_cast<off_t>(n);
+        _job.bytesCopied += n;
+        ++_nextInKernel;
+    }
+    else if (n == 0) {
+        // some file systems (like procfs) claim to be empty, so the end is checked by reading
+        stop();
+        if (item->offset > 0) complete(item);
+        else startReading(item);
+    }
+    else if (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == ETXTBSY) {
+        _job.cannotCopyRange = true;
+        stop();
+        startReading(item);
+    }
+    else if (errno != EINTR) {
+        const int error = errno;
+        stop();
+        fail(item, item->dest, error);
+    }
+}
+
+/*
+streams the rest of `item`, from its offset, through a buffer
+*/
+void tffm::CopyEngine::RingCopy::startReading(Item* item) {
+    if (_freeBuffers.empty()) {
+        item->buffer.reset(new char[chunkSize]);
+    }
+    else {
+        item->buffer = std::move(_freeBuffers.back());
+        _freeBuffers.pop_back();
+    }
+    read(item);
+}
+
+void tffm::CopyEngine::RingCopy::read(Item* item) {
+    auto sqe = request(item, Step::Read, IORING_OP_READ, item->in);
+    sqe->addr = reinterpret_cast<std::uint64_t>(item->buffer.get());
+    sqe->len = static_cast<std::uint32_t>(chunkSize);
+    sqe->off = static_cast<std::uint64_t>(item->offset);
+}
+
+void tffm::CopyEngine::RingCopy::write(Item* item) {
+    auto sqe = request(item, Step::Write, IORING_OP_WRITE, item->out);
+    sqe->addr = reinterpret_cast<std::uint64_t>(item->buffer.get() + item->written);
+    sqe->len = static_cast<std::uint32_t>(item->buffered - item->written);
+    sqe->off = static_cast<std::uint64_t>(item->offset) + item->written;
+}
+
+/*
+closes `item`, all of whose contents have been written
+*/
+void tffm::CopyEngine::RingCopy::complete(Item* item) {
+    // `open` applied the umask, which most modes aren't affected by
+    if ((item->stx.stx_mode & _umask & 07777) != 0) fchmod(item->out, item->stx.stx_mode & 07777);
+    item->complete = true;
+    closeFiles(item);
+}
+
+/*
+gives up on `item`, removing what was written of it
+*/
+void tffm::CopyEngine::RingCopy::fail(Item* item, std::string const& path, int error) {
+    _job.addError(errorString(path, error));
+    if (item->out >= 0) unlink(item->dest.c_str());
+    closeFiles(item);
+}
+
+/*
+closes the files of `item`, then forgets it
+*/
+void tffm::CopyEngine::RingCopy::closeFiles(Item* item) {
+    if (item->in >= 0) {
+        request(nullptr, Step::Close, IORING_OP_CLOSE, item->in);
+        item->in = -1;
+    }
+    if (item->out >= 0) {
+        request(item, Step::Close, IORING_OP_CLOSE, item->out);
+        item->out = -1;
+    }
+    else {
+        finish(item);
+    }
+}
+
+/*
+forgets `item`
+*/
+void tffm::CopyEngine::RingCopy::finish(Item* item) {
+    if (item->isFile) --_job.filesLeft;
+    if (item->inode != 0) _job.finishLinkedCopy(item->device, item->inode, item->copied);
+    if (item->buffer) _freeBuffers.push_back(std::move(item->buffer));
+
+    auto i = std::find_if(_items.begin(), _items.end(), [item](std::unique_ptr<Item> const& p) { return p.get() == item; });
+    std::swap(*i, _items.back());
+    _items.pop_back();
+}
+
+/*
+closes everything in flight without the ring, which has failed, adding what's left to copy to `leftOver`
+
+The items in flight are started over, apart from those the ring may still be
+creating the destination of, which are reported as not copied rather than
+risking removing something else, and those that are only being closed.
+*/
+void tffm::CopyEngine::RingCopy::abandon(std::vector<std::pair<std::string, std::string>>& leftOver) {
+    for (auto&& item : _items) {
+        bool startOver = true;
+        if (item->step == Step::Close) {
+            // all written (or failed, and reported already)
+            if (item->complete) {
+                item->copied = true;
+                ++_job.filesCopied;
+            }
+            startOver = false;
+        }
+        else if (item->step == Step::OpenDestination || item->step == Step::MakeDirectory) {
+            _job.addError(QFile::decodeName(item->dest.c_str()) + QStringLiteral(": not copied, as io_uring failed"));
+            startOver = false;
+        }
+
+        if (item->isFile) --_job.filesLeft;
+        if (item->inode != 0) _job.finishLinkedCopy(item->device, item->inode, item->copied);
+        if (item->in >= 0) close(item->in);
+        if (item->out >= 0) {
+            close(item->out);
+            unlink(item->dest.c_str());
+        }
+        if (startOver) leftOver.emplace_back(std::move(item->src), std::move(item->dest));
+    }
+    leftOver.insert(leftOver.end(), _pending.rbegin(), _pending.rend());
+    _pending.clear();
+    _items.clear();
+    _inKernel.clear();
+}
+
+/*
+copies `items` recursively with io_uring (runs on the pool); returns false, without copying anything, if a ring can't be set up
+
+If the ring fails part of the way, what's left to copy is added to `leftOver`.
+*/
+bool tffm::CopyEngine::copyWithRing(Job& job, std::vector<std::pair<std::string, std::string>> const& items, int depth, std::vector<std::pair<std::string, std::string>>& leftOver) {
+    IoUring ring{static_cast<unsigned>(depth) * 2};
+    if (!ring.isValid()) return false;
+
+    RingCopy copy{job, ring, depth};
+    copy.run(items, leftOver);
+    return true;
+}
+
+/*
+queues a task that copies the regular file `src` to `dest`
+*/
+void tffm::CopyEngine::copyFileLater(std::shared_ptr<Job> const& job, std::string src, std::string dest, std::uint64_t device, std::uint64_t inode) {
+    ++job->pendingTasks;
+    ++job->filesLeft;
+    _pool.start(new FunctionTask{[this, job, src, dest, device, inode]() {
+        const bool copied = !job->cancelled && copyFile(*job, src, dest);
+        if (copied) ++job->filesCopied;
+        if (inode != 0) job->finishLinkedCopy(device, inode, copied);
+        --job->filesLeft;
+        release(job);
+    }});
+}
+
+/*
+marks one task of `job` as done, finishing the job when it was the last one
+*/
+void tffm::CopyEngine::release(std::shared_ptr<Job> const& job) {
+    if (--job->pendingTasks == 0) {
+        QMetaObject::invokeMethod(this, [this, job]() { finishJob(job); }, Qt::QueuedConnection);
+    }
+}
+
+void tffm::CopyEngine::finishJob(std::shared_ptr<Job> const& job) {
+    tracing::record(tracing::Operation::Copy, job->started, tracing::Clock::now());
+    _jobs.erase(std::remove(_jobs.begin(), _jobs.end(), job), _jobs.end());
+    if (_jobs.empty()) {
+        _progressTimer.stop();
+    }
+
+    // all of the job's tasks are done, so its errors can be read without locking
+    emit finished(job->filesCopied, job->errors, job->cancelled);
+}
+
+void tffm::CopyEngine::reportProgress() {
+    qint64 bytesCopied = 0;
+    qint64 filesLeft = 0;
+    for (auto&& job : _jobs) {
+        bytesCopied += job->bytesCopied;
+        filesLeft += job->filesLeft;
+    }
+
+    const auto elapsed = std::max<qint64>(_sinceLastProgress.restart(), 1);
+    const auto bytesPerSecond = (bytesCopied - _bytesAtLastProgress) * 1000 / elapsed;
+    _bytesAtLastProgress = bytesCopied;
+    emit progress(bytesPerSecond, filesLeft);
+}
+
+/*
+copies the contents and permissions of the regular file `src` to the new file `dest`
+*/
+bool tffm::CopyEngine::copyFile(Job& job, std::string const& src, std::string const& dest) {
+    const int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        job.addError(errorString(src));
+        return false;
+    }
+    struct stat st;
+    fstat(in, &st);
+    const int out = open(dest.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+    if (out < 0) {
+        job.addError(errorString(dest));
+        close(in);
+        return false;
+    }
+
+    bool ok = copyContents(job, in, out, src, dest, st.st_size, isSparse(st.st_size, st.st_blocks)) && !job.cancelled;
+    if (ok) fchmod(out, st.st_mode & 07777); // not subject to the umask, unlike `open`
+
+    close(in);
+    if (close(out) != 0 && ok) {
+        job.addError(errorString(dest));
+        ok = false;
+    }
+    if (!ok) unlink(dest.c_str());
+    return ok;
+}
+
+/*
+makes `out` share the extents of `in` (a reflink), if the file system can
+*/
+bool tffm::CopyEngine::cloneContents(Job& job, int in, int out) {
+    if (job.cannotClone) return false;
+    if (ioctl(out, FICLONE, in) == 0) return true;
+
+    // other errors (such as mismatched flags on btrfs) only concern this file
+    if (errno == EOPNOTSUPP || errno == ENOTTY || errno == EXDEV) job.cannotClone = true;
+    return false;
+}
+
+/*
+copies the contents of `in` (the file `src`, of `size` bytes) to the empty `out` (the file `dest`),
+keeping the holes of a `sparse` file
+
+A reflink is tried first, as it's instant whatever the size; the data of a
+sparse file is found with SEEK_DATA and SEEK_HOLE, so only what's allocated
+is copied and the holes are left by extending the copy at the end.
+*/
+bool tffm::CopyEngine::copyContents(Job& job, int in, int out, std::string const& src, std::string const& dest, qint64 size, bool sparse) {
+    if (cloneContents(job, in, out)) {
+        job.bytesCopied += size;
+        return true;
+    }
+
+    int error = 0;
+    bool readFailed = false;
+    if (sparse) {
+        off_t position = 0;
+        while (position < size && error == 0 && !job.cancelled) {
+            const auto data = lseek(in, position, SEEK_DATA);
+            if (data < 0) {
+                if (errno != ENXIO) error = copyRange(job, in, out, position, -1, readFailed); // no holes to be found
+                break; // ENXIO: the rest is a hole
+            }
+            auto hole = lseek(in, data, SEEK_HOLE);
+            if (hole < 0) hole = size;
+            error = copyRange(job, in, out, data, hole - data, readFailed);
+            position = hole;
+        }
+        if (error == 0 && !job.cancelled && ftruncate(out, size) != 0) error = errno;
+    }
+    else {
+        error = copyRange(job, in, out, 0, -1, readFailed);
+    }
+
+    if (error != 0) {
+        job.addError(errorString(readFailed ? src : dest, error));
+        return false;
+    }
+    return !job.cancelled;
+}
+
+/*
+copies `length` bytes (all of them up to the end if negative) at `offset` in `in` to the same place in `out`
+*/
+int tffm::CopyEngine::copyRange(Job& job, int in, int out, qint64 offset, qint64 length, bool& readFailed) {
+    const bool toEnd = length < 0;
+
+    // in the kernel first, which spares the copy through user space (and lets NFS copy on the server)
+    bool copiedAny = false;
+    while (!job.cannotCopyRange && !job.cancelled && (toEnd || length > 0)) {
+        loff_t inOffset = offset;
+        loff_t outOffset = offset;
+        const auto size = toEnd ? rangeChunkSize : std::min<std::size_t>(static_cast<std::size_t>(length), rangeChunkSize);
+        const auto n = copy_file_range(in, &inOffset, out, &outOffset, size, 0);
+        if (n > 0) {
+            offset += n;
+            if (!toEnd) length -= n;
+            job.bytesCopied += n;
+            copiedAny = true;
+        }
+        else if (n == 0) {
+            // some file systems (like procfs) claim to be empty, so the end is checked below
+            if (copiedAny || !toEnd) return 0;
+            break;
+        }
+        else if (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == ETXTBSY) {
+            job.cannotCopyRange = true;
+        }
+        else if (errno != EINTR) {
+            readFailed = false;
+            return errno;
+        }
+    }
+
+    // each pool thread reuses a single buffer for all the files it copies
+    thread_local auto buffer = std::unique_ptr<char[]>{new char[chunkSize]};
+    while (!job.cancelled && (toEnd || length > 0)) {
+        const auto size = toEnd ? chunkSize : std::min<std::size_t>(static_cast<std::size_t>(length), chunkSize);
+        const auto n = pread(in, buffer.get(), size, offset);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            readFailed = true;
+            return errno;
+        }
+        for (ssize_t written = 0; written < n; ) {
+            const auto w = pwrite(out, buffer.get() + written, static_cast<std::size_t>(n - written), offset + written);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                readFailed = false;
+                return errno;
+            }
+            written += w;
+        }
+        offset += n;
+        if (!toEnd) length -= n;
+        job.bytesCopied += n;
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef COPYENGINE_HPP
+#define COPYENGINE_HPP
+
+// standard libraries
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Qt classes
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace tffm { class CopyEngine; }
+
+/*
+copies file system items on a pool of worker threads
+
+Each call to `start()` creates a job. A planning task walks the source trees,
+creating the destination directories as it goes, and hands every file to the
+pool as a separate task, so many small files are copied concurrently while
+large ones are streamed in fixed-size chunks. Workers only update atomic
+counters; progress is sampled and reported from the thread the engine lives
+in, so the GUI never waits on a copy.
+
+Where the kernel supports io_uring, a job is instead driven by a single thread
+that keeps up to `queueDepth()` stats, opens, reads, writes, closes and mkdirs
+in flight at once, so that high-latency storage sees many requests at a time
+without a thread blocked on each one. Directories are still read with
+`getdents`, which io_uring doesn't offer.
+
+Either way, file contents are reflinked when the file system can share
+extents, copied in the kernel with `copy_file_range` otherwise, and only
+then streamed through a buffer; the holes of sparse files are kept, and files
+with several links in the copied tree are linked again rather than copied twice.
+*/
+class tffm::CopyEngine : public QObject {
+    Q_OBJECT
+
+    public:
+        using CopyList = QList<QPair<QString,QString>>;
+
+        explicit CopyEngine(QObject* parent = nullptr);
+        ~CopyEngine() override;
+
+        void start(CopyList const& items);
+        /*  copies every (source, destination) pair in the background, recursively if needed */
+
+        void start(std::shared_ptr<const std::vector<std::string>> sources, std::string const& directory);
+        /*  copies the items at the (native) paths `sources` into `directory`, keeping their names, in the
+            background; `sources` is only read by the copy, on a worker thread */
+
+        void cancel();
+        /*  stops all running copies; partially written files are removed */
+
+        bool isRunning() const { return !_jobs.empty(); }
+
+        void setQueueDepth(int depth);
+        /*  sets how many requests copies keep in flight with io_uring; 0 uses the thread pool instead
+            (this applies to the copies started afterwards) */
+
+        int queueDepth() const { return _queueDepth; }
+
+        bool usesIoUring() const;
+        /*  returns whether the next copies will use io_uring */
+
+    signals:
+        void progress(qint64 bytesPerSecond, qint64 filesLeft);
+        void finished(qint64 filesCopied, QStringList const& errors, bool cancelled);
+
+    private:
+        using NativeCopyList = std::vector<std::pair<std::string, std::string>>;
+
+        struct Job;
+        class RingCopy;
+
+        std::vector<std::shared_ptr<Job>> _jobs;
+        QTimer _progressTimer;
+        QElapsedTimer _sinceLastProgress;
+        qint64 _bytesAtLastProgress;
+        QThreadPool _pool;
+        int _queueDepth;
+
+        void startJob(std::function<NativeCopyList()> plan);
+        /*  starts a job copying the (source, destination) pairs `plan` returns; `plan` runs on the pool */
+
+        void copyRecursively(std::shared_ptr<Job> const& job, std::string const& src, std::string const& dest);
+        /*  copies a file system item from `src` to `dest`, recursively if needed (runs on the pool) */
+
+        static bool copyWithRing(Job& job, std::vector<std::pair<std::string, std::string>> const& items, int depth, std::vector<std::pair<std::string, std::string>>& leftOver);
+        /*  copies `items` recursively with io_uring (runs on the pool); returns false, without copying
+            anything, if a ring can't be set up; if the ring fails part of the way, what's left to copy
+            is added to `leftOver` */
+
+        void copyFileLater(std::shared_ptr<Job> const& job, std::string src, std::string dest, std::uint64_t device, std::uint64_t inode);
+        /*  queues a task that copies the regular file `src` to `dest`; `device` and `inode` identify `src`
+            if it has other links (`inode` is 0 otherwise) */
+
+        void release(std::shared_ptr<Job> const& job);
+        /*  marks one task of `job` as done, finishing the job when it was the last one */
+
+        void finishJob(std::shared_ptr<Job> const& job);
+
+        void reportProgress();
+
+        static bool copyFile(Job& job, std::string const& src, std::string const& dest);
+        /*  copies the contents and permissions of the regular file `src` to the new file `dest` */
+
+        static bool cloneContents(Job& job, int in, int out);
+        /*  makes `out` share the extents of `in` (a reflink), if the file system can */
+
+        static bool copyContents(Job& job, int in, int out, std::string const& src, std::string const& dest, qint64 size, bool sparse);
+        /*  copies the contents of `in` (the file `src`, of `size` bytes) to the empty `out` (the file `dest`),
+            keeping the holes of a `sparse` file */
+
+        static int copyRange(Job& job, int in, int out, qint64 offset, qint64 length, bool& readFailed);
+        /*  copies `length` bytes (all of them up to the end if negative) at `offset` in `in` to the same
+            place in `out`; returns 0, or the `errno` of the failure with `readFailed` saying which side failed */
+};
+
+#endif // COPYENGINE_HPP
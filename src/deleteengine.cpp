@@ -0,0 +1,348 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "deleteengine.hpp"
+#include "directorylisting.hpp"
+#include "functiontask.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// Qt classes
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+// system headers
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/*  upper bound on the directories held open at once by threads handing work to each other */
+constexpr int maxOpenDirectories = 512;
+
+/*  how often progress is reported while deletions are running */
+constexpr int progressInterval = 250; // ms
+
+}
+
+/*
+state shared by all the tasks removing one batch of items
+*/
+struct tffm::DeleteEngine::Job {
+    std::string directory;              // the directory containing the items
+    int fd = -1;                        // ... and a descriptor for it
+    std::atomic<qint64> entriesRemoved{0};
+    std::atomic<qint64> itemsRemoved{0};
+    std::atomic<int> pendingItems{0};
+    std::atomic<bool> cancelled{false};
+    QMutex errorsMutex;
+    QStringList errors;
+    QMutex removedMutex;
+    QStringList removed;                // items removed but not reported yet
+
+    void addError(std::string const& path) {
+        auto error = QFile::decodeName(path.c_str()) + QStringLiteral(": ") + QString::fromLocal8Bit(std::strerror(errno));
+        QMutexLocker lock{&errorsMutex};
+        errors << error;
+    }
+};
+
+/*
+a directory whose contents are being removed
+
+A directory is removed by whichever task finishes last among the one listing
+it and those removing its sub-directories. No descriptor is kept for it in
+the meantime; the task that removes it reaches its parent through its `..`.
+*/
+struct tffm::DeleteEngine::Directory {
+    std::shared_ptr<Directory> parent;  // null for the items passed to `start()`
+    std::string name;
+    std::atomic<int> pending{1};
+    std::atomic<bool> failed{false};
+
+    std::string path(Job const& job) const { return (parent ? parent->path(job) : job.directory) + '/' + name; }
+};
+
+/*
+a directory being removed in place by a thread, with the sub-directories it has left to remove
+*/
+struct tffm::DeleteEngine::Frame {
+    std::shared_ptr<Directory> dir;
+    std::vector<std::string> subdirectories;
+};
+
+tffm::DeleteEngine::DeleteEngine(QObject* parent) : QObject{parent}, _openDirectories{0} {
+    _pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    _progressTimer.setInterval(progressInterval);
+    connect(&_progressTimer, &QTimer::timeout, this, &DeleteEngine::reportProgress);
+}
+
+tffm::DeleteEngine::~DeleteEngine() {
+    // what's left of each tree is kept
+    for (auto&& job : _jobs) {
+        job->cancelled = true;
+    }
+    _pool.waitForDone();
+    for (auto&& job : _jobs) {
+        close(job->fd);
+    }
+}
+
+/*
+removes the items called `names` in `directory`, recursively, in the background
+*/
+void tffm::DeleteEngine::start(QString const& directory, QStringList const& names) {
+    auto job = std::make_shared<Job>();
+    job->directory = QFile::encodeName(directory).toStdString();
+    job->fd = open(job->directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (job->fd < 0) {
+        job->addError(job->directory);
+        emit finished(0, job->errors);
+        return;
+    }
+    if (names.isEmpty()) {
+        close(job->fd);
+        emit finished(0, QStringList{});
+        return;
+    }
+
+    job->pendingItems = names.size();
+    _jobs.push_back(job);
+    if (!_progressTimer.isActive()) _progressTimer.start();
+
+    for (auto&& name : names) {
+        auto nativeName = QFile::encodeName(name).toStdString();
+        _pool.start(new FunctionTask{[this, job, nativeName]() { removeItem(job, nativeName); }});
+    }
+}
+
+/*
+removes one of the items passed to `start()` (runs on the pool)
+*/
+void tffm::DeleteEngine::removeItem(std::shared_ptr<Job> const& job, std::string const& name) {
+    struct stat st;
+    if (job->cancelled) {
+        finishItem(job, name, false);
+    }
+    else if (fstatat(job->fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        job->addError(job->directory + '/' + name);
+        finishItem(job, name, false);
+    }
+    else if (!S_ISDIR(st.st_mode)) {
+        const bool removed = unlinkat(job->fd, name.c_str(), 0) == 0;
+        if (removed) ++job->entriesRemoved;
+        else job->addError(job->directory + '/' + name);
+        finishItem(job, name, removed);
+    }
+    else {
+        auto dir = std::make_shared<Directory>();
+        dir->name = name;
+        const int fd = openat(job->fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd >= 0) ++_openDirectories;
+        removeDirectory(job, dir, fd);
+    }
+}
+
+/*
+removes the contents of `dir`, whose descriptor is `fd` (-1 if it couldn't be opened), spreading its sub-directories across the pool
+
+Files are unlinked right away. A sub-directory is handed to another thread
+when one is idle and removed by this one otherwise, depth first from an
+explicit stack. Only the directory being worked on is kept open: going down
+closes the parent, and going back up reopens it through `..`, so a thread
+holds a single descriptor however deep the tree.
+*/
+void tffm::DeleteEngine::removeDirectory(std::shared_ptr<Job> const& job, std::shared_ptr<Directory> const& dir, int fd) {
+    auto stack = std::vector<Frame>{};
+    auto listing = DirectoryListing{};
+    const auto enter = [&job, &stack, &listing, &fd](std::shared_ptr<Directory> const& entered) {
+        stack.push_back(Frame{entered, {}});
+        if (fd < 0 || !listing.read(fd)) {
+            job->addError(entered->path(*job));
+            entered->failed = true;
+            return;
+        }
+        for (DirectoryListing::size_type i = 0; i < listing.size() && !job->cancelled; ++i) {
+            if (listing.type(i) == DT_DIR) {
+                stack.back().subdirectories.emplace_back(listing.name(i), listing.nameLength(i));
+            }
+            else if (unlinkat(fd, listing.name(i), 0) == 0) {
+                ++job->entriesRemoved;
+            }
+            else {
+                job->addError(entered->path(*job) + '/' + listing.name(i));
+                entered->failed = true;
+            }
+        }
+        if (job->cancelled) entered->failed = true;
+    };
+
+    enter(dir);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (job->cancelled || fd < 0) {
+            if (!top.subdirectories.empty()) top.dir->failed = true;
+            top.subdirectories.clear();
+        }
+        if (top.subdirectories.empty()) {
+            // the parent is kept (reopened) if it's still being worked on here
+            auto done = std::move(top.dir);
+            stack.pop_back();
+            fd = release(job, done, fd, !stack.empty());
+            if (fd < 0 && !stack.empty()) job->addError(stack.back().dir->path(*job));
+            continue;
+        }
+
+        auto child = std::make_shared<Directory>();
+        child->parent = top.dir;
+        child->name = std::move(top.subdirectories.back());
+        top.subdirectories.pop_back();
+        ++top.dir->pending;
+        const int childFd = openat(fd, child->name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (childFd >= 0) ++_openDirectories;
+        if (childFd >= 0 && _openDirectories < maxOpenDirectories && _pool.activeThreadCount() < _pool.maxThreadCount()) {
+            _pool.start(new FunctionTask{[this, job, child, childFd]() { removeDirectory(job, child, childFd); }});
+        }
+        else {
+            closeDirectory(fd);
+            fd = childFd;
+            enter(child);
+        }
+    }
+}
+
+/*
+marks the task listing `dir` (whose descriptor is `fd`, which is closed) as done; the last task working on a
+directory removes it and marks its parent as done in turn
+
+Returns a descriptor for the parent of `dir` if `keepParent` is set, or -1.
+*/
+int tffm::DeleteEngine::release(std::shared_ptr<Job> const& job, std::shared_ptr<Directory> dir, int fd, bool keepParent) {
+    while (true) {
+        const bool last = --dir->pending == 0;
+
+        // a directory that couldn't be emptied can't be removed either; its error has already been reported
+        const bool remove = last && !dir->failed;
+        const int parentFd = dir->parent && (remove || keepParent) ? reopenParent(*job, *dir, fd) : -1;
+        closeDirectory(fd);
+        if (!last) return parentFd;
+
+        bool removed = false;
+        if (remove) {
+            const int at = dir->parent ? parentFd : job->fd;
+            removed = at >= 0 && unlinkat(at, dir->name.c_str(), AT_REMOVEDIR) == 0;
+            if (removed) ++job->entriesRemoved;
+            else job->addError(dir->path(*job));
+        }
+
+        if (!dir->parent) {
+            finishItem(job, dir->name, removed);
+            return -1;
+        }
+        if (!removed) dir->parent->failed = true;
+        if (keepParent) {
+            // the parent is still being listed, so this isn't the last task working on it
+            --dir->parent->pending;
+            return parentFd;
+        }
+        dir = dir->parent;
+        fd = parentFd;
+    }
+}
+
+/*
+returns a descriptor for the parent of `dir`, opened through the `..` of its descriptor `fd` or by path if that fails
+*/
+int tffm::DeleteEngine::reopenParent(Job const& job, Directory const& dir, int fd) {
+    int parentFd = fd >= 0 ? openat(fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (parentFd < 0) parentFd = open(dir.parent->path(job).c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (parentFd >= 0) ++_openDirectories;
+    return parentFd;
+}
+
+void tffm::DeleteEngine::closeDirectory(int fd) {
+    if (fd < 0) return;
+    close(fd);
+    --_openDirectories;
+}
+
+void tffm::DeleteEngine::finishItem(std::shared_ptr<Job> const& job, std::string const& name, bool removed) {
+    if (removed) {
+        ++job->itemsRemoved;
+        auto decodedName = QFile::decodeName(name.c_str());
+        QMutexLocker lock{&job->removedMutex};
+        job->removed << decodedName;
+    }
+    if (--job->pendingItems == 0) {
+        QMetaObject::invokeMethod(this, [this, job]() { finishJob(job); }, Qt::QueuedConnection);
+    }
+}
+
+void tffm::DeleteEngine::finishJob(std::shared_ptr<Job> const& job) {
+    close(job->fd);
+    _jobs.erase(std::remove(_jobs.begin(), _jobs.end(), job), _jobs.end());
+    if (_jobs.empty()) {
+        _progressTimer.stop();
+    }
+
+    // all of the job's tasks are done, so its errors can be read without locking
+    reportRemovedItems(*job);
+    emit finished(job->itemsRemoved, job->errors);
+}
+
+void tffm::DeleteEngine::reportProgress() {
+    qint64 entriesRemoved = 0;
+    for (auto&& job : _jobs) {
+        entriesRemoved += job->entriesRemoved;
+        reportRemovedItems(*job);
+    }
+    emit progress(entriesRemoved);
+}
+
+void tffm::DeleteEngine::reportRemovedItems(Job& job) {
+    auto names = QStringList{};
+    {
+        QMutexLocker lock{&job.removedMutex};
+        names.swap(job.removed);
+    }
+    if (!names.isEmpty()) emit itemsRemoved(QFile::decodeName(job.directory.c_str()), names);
+}
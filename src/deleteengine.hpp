@@ -0,0 +1,120 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DELETEENGINE_HPP
+#define DELETEENGINE_HPP
+
+// standard libraries
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Qt classes
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace tffm { class DeleteEngine; }
+
+/*
+removes file system trees on a pool of worker threads
+
+Everything is done relative to directory file descriptors (`openat`,
+`unlinkat`), so paths are never resolved more than once. Sub-directories are
+handed to other threads while there are idle ones and removed in place
+otherwise, depth first from an explicit stack with only the directory being
+worked on kept open, which spreads independent subtrees across cores without
+keeping an unbounded number of directories open however deep the tree is.
+`itemsRemoved` reports the items passed to `start()` (not every file
+underneath them) a batch at a time, along with the progress, so removing a
+hundred thousand items doesn't flood the event loop. Destroying the engine
+stops the removals, leaving what's left of the trees in place.
+*/
+class tffm::DeleteEngine : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit DeleteEngine(QObject* parent = nullptr);
+        ~DeleteEngine() override;
+
+        void start(QString const& directory, QStringList const& names);
+        /*  removes the items called `names` in `directory`, recursively, in the background */
+
+        bool isRunning() const { return !_jobs.empty(); }
+
+    signals:
+        void progress(qint64 entriesRemoved);
+        void itemsRemoved(QString const& directory, QStringList const& names);
+        void finished(qint64 itemsRemoved, QStringList const& errors);
+
+    private:
+        struct Job;
+        struct Directory;
+        struct Frame;
+
+        std::vector<std::shared_ptr<Job>> _jobs;
+        std::atomic<int> _openDirectories;
+        QTimer _progressTimer;
+        QThreadPool _pool;
+
+        void removeItem(std::shared_ptr<Job> const& job, std::string const& name);
+        /*  removes one of the items passed to `start()` (runs on the pool) */
+
+        void removeDirectory(std::shared_ptr<Job> const& job, std::shared_ptr<Directory> const& dir, int fd);
+        /*  removes the contents of `dir`, whose descriptor is `fd` (-1 if it couldn't be opened), spreading
+            its sub-directories across the pool */
+
+        int release(std::shared_ptr<Job> const& job, std::shared_ptr<Directory> dir, int fd, bool keepParent);
+        /*  marks the task listing `dir` (whose descriptor is `fd`, which is closed) as done; the last task
+            working on a directory removes it and marks its parent as done in turn; returns a descriptor for
+            the parent of `dir` if `keepParent` is set, or -1 */
+
+        int reopenParent(Job const& job, Directory const& dir, int fd);
+        /*  returns a descriptor for the parent of `dir`, opened through the `..` of its descriptor `fd` */
+
+        void closeDirectory(int fd);
+
+        void finishItem(std::shared_ptr<Job> const& job, std::string const& name, bool removed);
+        void finishJob(std::shared_ptr<Job> const& job);
+
+        void reportRemovedItems(Job& job);
+        /*  emits `itemsRemoved` for the items of `job` removed since the last time, if any */
+
+        void reportProgress();
+};
+
+#endif // DELETEENGINE_HPP
@@ -0,0 +1,197 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "directorylisting.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+// system headers
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+/*  layout of the records returned by `getdents64` (glibc does not export it) */
+struct linux_dirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/*  size of the buffer handed to each `getdents64` call; large enough for several thousand entries */
+constexpr std::size_t readBufferSize = 1 << 20;
+
+/*  size of the first batch of a read in batches, about what a network file system returns at once;
+    each batch after it is twice as large, up to `readBufferSize` */
+constexpr std::size_t firstBatchSize = 32 << 10;
+
+/*
+fills in the type of an entry the file system didn't report, and whether a symbolic link
+points to a directory; only the type is asked for, and cached attributes are good enough
+*/
+std::uint8_t resolveType(int dirfd, const char* name, std::uint8_t type) {
+    struct statx st;
+    if (type == DT_UNKNOWN) {
+        if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_TYPE, &st) != 0) return DT_UNKNOWN;
+        type = IFTODT(st.stx_mode);
+    }
+    if (type == DT_LNK && statx(dirfd, name, AT_STATX_DONT_SYNC, STATX_TYPE, &st) == 0 && S_ISDIR(st.stx_mode)) {
+        type |= tffm::DirectoryListing::LinkToDirectory;
+    }
+    return type;
+}
+
+}
+
+bool tffm::DirectoryListing::read(std::string const& path) {
+    return read(path, BatchRead{});
+}
+
+bool tffm::DirectoryListing::read(std::string const& path, BatchRead const& batchRead) {
+    _path = path;
+    clear();
+    const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    const bool ok = readEntries(fd, batchRead);
+
+    const int savedErrno = errno;
+    close(fd);
+    errno = savedErrno;
+    return ok;
+}
+
+bool tffm::DirectoryListing::read(int dirfd) {
+    _path.clear();
+    clear();
+    return readEntries(dirfd, BatchRead{});
+}
+
+bool tffm::DirectoryListing::readEntries(int dirfd, BatchRead const& batchRead) {
+    // every thread reuses one buffer rather than allocating a fresh one per directory
+    thread_local auto buffer = std::unique_ptr<char[]>{new char[readBufferSize]};
+    auto batchSize = batchRead ? firstBatchSize : readBufferSize;
+    for (;;) {
+        const long n = syscall(SYS_getdents64, dirfd, buffer.get(), batchSize);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        for (long pos = 0; pos < n;) {
+            auto d = reinterpret_cast<linux_dirent64*>(buffer.get() + pos);
+            pos += d->d_reclen;
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            auto type = static_cast<std::uint8_t>(d->d_type);
+            if (type == DT_UNKNOWN || type == DT_LNK) type = resolveType(dirfd, name, type);
+            append(name, static_cast<std::uint16_t>(std::strlen(name)), type, d->d_ino);
+        }
+        if (batchRead && !batchRead(*this)) {
+            errno = ECANCELED;
+            return false;
+        }
+        batchSize = std::min(2 * batchSize, readBufferSize);
+    }
+    return true;
+}
+
+void tffm::DirectoryListing::assign(DirectoryListing const& base, std::vector<bool> const& removed, std::vector<Entry> const& added) {
+    clear();
+    _path = base._path;
+    _names.reserve(base._names.size());
+    _nameOffsets.reserve(base.size() + added.size());
+    _nameLengths.reserve(base.size() + added.size());
+    _types.reserve(base.size() + added.size());
+    _inodes.reserve(base.size() + added.size());
+
+    for (size_type i = 0; i < base.size(); ++i) {
+        if (!removed[i]) append(base.name(i), base._nameLengths[i], base._types[i], base._inodes[i]);
+    }
+    for (auto&& entry : added) {
+        append(entry.name.c_str(), static_cast<std::uint16_t>(entry.name.size()), entry.type, entry.inode);
+    }
+}
+
+bool tffm::DirectoryListing::lookup(int dirfd, std::string const& name, Entry& entry) {
+    struct statx st;
+    if (statx(dirfd, name.c_str(), AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_INO, &st) != 0) return false;
+
+    entry.name = name;
+    entry.type = resolveType(dirfd, name.c_str(), static_cast<std::uint8_t>(IFTODT(st.stx_mode)));
+    entry.inode = st.stx_ino;
+    return true;
+}
+
+bool tffm::DirectoryListing::isDirectory(size_type i) const {
+    return type(i) == DT_DIR || (_types[i] & LinkToDirectory);
+}
+
+auto tffm::DirectoryListing::entryAt(std::size_t offset) const -> size_type {
+    auto i = std::upper_bound(_nameOffsets.begin(), _nameOffsets.end(), offset);
+    return static_cast<size_type>(i - _nameOffsets.begin()) - 1;
+}
+
+std::size_t tffm::DirectoryListing::memoryUsage() const {
+    return _names.capacity()
+         + _nameOffsets.capacity() * sizeof(std::uint32_t)
+         + _nameLengths.capacity() * sizeof(std::uint16_t)
+         + _types.capacity() * sizeof(std::uint8_t)
+         + _inodes.capacity() * sizeof(std::uint64_t);
+}
+
+void tffm::DirectoryListing::clear() {
+    _names.clear();
+    _nameOffsets.clear();
+    _nameLengths.clear();
+    _types.clear();
+    _inodes.clear();
+}
+
+void tffm::DirectoryListing::append(const char* name, std::uint16_t length, std::uint8_t type, std::uint64_t inode) {
+    _nameOffsets.push_back(static_cast<std::uint32_t>(_names.size()));
+    _nameLengths.push_back(length);
+    _types.push_back(type);
+    _inodes.push_back(inode);
+    _names.insert(_names.end(), name, name + length + 1);
+}
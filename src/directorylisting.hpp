@@ -0,0 +1,135 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DIRECTORYLISTING_HPP
+#define DIRECTORYLISTING_HPP
+
+// standard libraries
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace tffm { class DirectoryListing; }
+
+/*
+a compact snapshot of the entries of a single directory
+
+The names of all entries are stored back to back (NUL terminated) in a single
+arena and the remaining per-entry attributes are kept in parallel arrays, so
+an entry costs a handful of bytes on top of its name. Entries are read with
+raw `getdents64` calls into a large buffer and are never `stat`ed, except for
+the few whose type the file system does not report.
+
+A slow directory (on a network file system, say) can be read in batches, the
+first ones small, with a callback that gets to see the entries read so far
+after each one, and to stop the read.
+*/
+class tffm::DirectoryListing {
+    public:
+        using size_type = std::uint32_t;
+
+        /*  flag or-ed into an entry's type when it is a symbolic link to a directory */
+        static constexpr std::uint8_t LinkToDirectory = 0x80;
+
+        /*  a single entry, outside of any listing */
+        struct Entry {
+            std::string name;
+            std::uint8_t type;      // including `LinkToDirectory`
+            std::uint64_t inode;
+        };
+
+        /*  called after each batch of entries is appended; returning false stops the read */
+        using BatchRead = std::function<bool(DirectoryListing const& listing)>;
+
+        bool read(std::string const& path);
+        /*  replaces the contents of the listing with the entries of the directory at `path`;
+            returns false (with `errno` set) if the directory could not be read */
+
+        bool read(std::string const& path, BatchRead const& batchRead);
+        /*  same as above but calls `batchRead` after each batch, the first ones a few hundred entries;
+            returns false with `errno` set to `ECANCELED` if `batchRead` stopped the read */
+
+        bool read(int dirfd);
+        /*  same as above but reads from the open directory `dirfd`, which is left open
+            (the offset of `dirfd` must be at the start of the directory) */
+
+        void assign(DirectoryListing const& base, std::vector<bool> const& removed, std::vector<Entry> const& added);
+        /*  replaces the contents of the listing with the entries of `base` not flagged in `removed`
+            (in the same order) followed by `added` */
+
+        static bool lookup(int dirfd, std::string const& name, Entry& entry);
+        /*  fills `entry` with the entry called `name` in the open directory `dirfd`, as `read` would;
+            returns false (with `errno` set) if there is no such entry */
+
+        std::string const& path() const { return _path; }
+
+        size_type size() const { return static_cast<size_type>(_nameOffsets.size()); }
+        bool empty() const { return _nameOffsets.empty(); }
+
+        const char* name(size_type i) const { return _names.data() + _nameOffsets[i]; }
+        std::uint16_t nameLength(size_type i) const { return _nameLengths[i]; }
+        std::uint8_t type(size_type i) const { return _types[i] & ~LinkToDirectory; }
+        std::uint8_t rawType(size_type i) const { return _types[i]; }
+        std::uint64_t inode(size_type i) const { return _inodes[i]; }
+
+        bool isDirectory(size_type i) const;
+        /*  returns true if the entry is a directory or a symbolic link to one */
+
+        bool isHidden(size_type i) const { return name(i)[0] == '.'; }
+
+        const char* nameData() const { return _names.data(); }
+        std::size_t nameDataSize() const { return _names.size(); }
+        /*  the arena holding all the names, each followed by a NUL */
+
+        size_type entryAt(std::size_t offset) const;
+        /*  returns the entry whose name covers `offset` in the name arena */
+
+        std::size_t memoryUsage() const;
+        /*  returns the number of bytes allocated to hold the listing */
+
+    private:
+        bool readEntries(int dirfd, BatchRead const& batchRead);
+
+        void clear();
+        void append(const char* name, std::uint16_t length, std::uint8_t type, std::uint64_t inode);
+
+        std::string _path;
+        std::vector<char> _names;
+        std::vector<std::uint32_t> _nameOffsets;
+        std::vector<std::uint16_t> _nameLengths;
+        std::vector<std::uint8_t> _types;
+        std::vector<std::uint64_t> _inodes;
+};
+
+#endif // DIRECTORYLISTING_HPP
@@ -0,0 +1,899 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "directorymodel.hpp"
+#include "functiontask.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+// Qt classes
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QLocale>
+#include <QPalette>
+
+// system headers
+#include <fnmatch.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+/*  FNV-1a, to find the entries a batch of changes refers to without building strings */
+std::uint64_t hashName(const char* name, std::size_t length) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(name[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/*  how many entries the background reader reads between checks for a newer listing */
+constexpr std::size_t metadataSlice = 1024;
+
+/*  returns permissions the way `ls -l` shows them */
+QString permissionString(std::uint16_t permissions) {
+    const char* letters = "rwxrwxrwx";
+    auto text = QString{9, QChar('-')};
+    for (int bit = 0; bit < 9; ++bit) {
+        if (permissions & (0400 >> bit)) text[bit] = QChar(letters[bit]);
+    }
+    return text;
+}
+
+}
+
+tffm::DirectoryModel::DirectoryModel(QObject* parent) : DirectoryModel{std::make_shared<ListingStore>(), parent} {}
+
+tffm::DirectoryModel::DirectoryModel(std::shared_ptr<ListingStore> store, QObject* parent)
+  : QAbstractListModel{parent}, _selectedCount{0}, _sortRequest{0}, _metadataGeneration{0}, _generation{0}, _showIcons{true}, _store{std::move(store)}, _generationAwaitingRead{0}, _loadPending{false}, _searchIndexRequested{false} {
+    _filters = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::AllDirs;
+    _loaderPool.setMaxThreadCount(2);
+    _metadataPool.setMaxThreadCount(2);
+    _backgroundMetadataPool.setMaxThreadCount(1);
+
+    connect(_store.get(), &ListingStore::loaded, this, &DirectoryModel::finishRead);
+    connect(_store.get(), &ListingStore::indexed, this, [this](std::string const& path, std::shared_ptr<const SearchIndex> const& index) {
+        if (path == _nativeRootPath) finishIndex(_generation, index);
+    });
+    connect(_store.get(), &ListingStore::changed, this, &DirectoryModel::adoptChange);
+    connect(_store.get(), &ListingStore::streamed, this, &DirectoryModel::adoptStreamed);
+    connect(_store.get(), &ListingStore::invalidated, this, [this](std::string const& path) {
+        if (path == _nativeRootPath) startLoad(false);
+    });
+    connect(&_icons, &IconCache::iconsResolved, this, [this]() {
+        if (rowCount() > 0) emit dataChanged(createIndex(0, 0), createIndex(rowCount() - 1, 0), {Qt::DecorationRole});
+    });
+}
+
+tffm::DirectoryModel::~DirectoryModel() {
+    ++_generation; // makes queued loads return early
+    ++_sortRequest;
+    ++_metadataGeneration;
+    _loaderPool.clear();
+    _metadataPool.clear();
+    _backgroundMetadataPool.clear();
+    _loaderPool.waitForDone();
+    _metadataPool.waitForDone();
+    _backgroundMetadataPool.waitForDone();
+    if (!_nativeRootPath.empty()) _store->release(_nativeRootPath);
+}
+
+int tffm::DirectoryModel::rowCount(QModelIndex const& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(_rows.size());
+}
+
+QVariant tffm::DirectoryModel::data(QModelIndex const& index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant{};
+
+    const auto i = entryAt(index);
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return QFile::decodeName(QByteArray::fromRawData(_listing->name(i), _listing->nameLength(i)));
+    case Qt::DecorationRole:
+        if (!_showIcons) return QVariant{};
+        return _listing->isDirectory(i) ? _icons.directoryIcon() : _icons.icon(_listing->name(i), _listing->nameLength(i));
+    case Qt::ToolTipRole: {
+        auto const& metadata = *_sortKeys->metadata();
+        if (!metadata.isRead(i)) return QVariant{};
+        const auto modified = QDateTime::fromMSecsSinceEpoch(metadata.modificationTime(i) / 1000000);
+        return tr("%0, modified %1, %2")
+            .arg(QLocale{}.formattedDataSize(static_cast<qint64>(metadata.size(i))))
+            .arg(QLocale{}.toString(modified, QLocale::ShortFormat))
+            .arg(permissionString(metadata.permissions(i)));
+    }
+    case SizeRole: {
+        if (_listing->isDirectory(i)) {
+            const auto size = _treeSizes.find(std::string{_listing->name(i), _listing->nameLength(i)});
+            return size != _treeSizes.end() ? QVariant{size->second} : QVariant{};
+        }
+        auto const& metadata = *_sortKeys->metadata();
+        return metadata.isRead(i) ? QVariant{static_cast<qint64>(metadata.size(i))} : QVariant{};
+    }
+    case Qt::BackgroundRole: {
+        // a tint of the highlight, so the current item still stands out among the selected ones
+        if (!_selected[i]) return QVariant{};
+        auto color = QGuiApplication::palette().color(QPalette::Highlight);
+        color.setAlpha(96);
+        return color;
+    }
+    default:
+        return QVariant{};
+    }
+}
+
+/*
+returns the MIME type of a file as far as its extension tells, once its icon has been resolved, or an empty string
+*/
+QString tffm::DirectoryModel::mimeType(QModelIndex const& index) const {
+    if (!index.isValid() || index.row() >= rowCount() || isDir(index)) return QString{};
+
+    const auto i = entryAt(index);
+    return _icons.mimeType(_listing->name(i), _listing->nameLength(i));
+}
+
+/*
+sets whether the rows have icons; without them, no icon or MIME type is ever looked up
+*/
+void tffm::DirectoryModel::setShowIcons(bool show) {
+    if (show == _showIcons) return;
+
+    _showIcons = show;
+    if (rowCount() > 0) emit dataChanged(createIndex(0, 0), createIndex(rowCount() - 1, 0), {Qt::DecorationRole});
+}
+
+QModelIndex tffm::DirectoryModel::index(QString const& path) const {
+    const auto info = QFileInfo{path};
+    if (!_listing || QDir::cleanPath(info.absolutePath()) != _rootPath) return QModelIndex{};
+
+    const auto name = QFile::encodeName(info.fileName());
+    for (std::size_t row = 0; row < _rows.size(); ++row) {
+        const auto i = _rows[row];
+        if (_listing->nameLength(i) == name.size() && std::memcmp(_listing->name(i), name.constData(), name.size()) == 0) {
+            return createIndex(static_cast<int>(row), 0);
+        }
+    }
+    return QModelIndex{};
+}
+
+QModelIndex tffm::DirectoryModel::setRootPath(QString const& path) {
+    const auto newPath = QDir::cleanPath(QDir{path}.absolutePath());
+    if (newPath == _rootPath) return QModelIndex{};
+
+    beginResetModel();
+    if (!_nativeRootPath.empty()) _store->release(_nativeRootPath);
+    _rootPath = newPath;
+    _nativeRootPath = QFile::encodeName(_rootPath).toStdString();
+    _listing.reset();
+    _order.clear();
+    _rows.clear();
+    _rowOfEntry.clear();
+    _selected.clear();
+    _selectedCount = 0;
+    _removed.clear();
+    _treeSizes.clear();
+    _sortKeys.reset();
+    ++_sortRequest;
+    ++_metadataGeneration;
+    _searchIndex.reset();
+    endResetModel();
+    emit rootPathChanged(_rootPath);
+
+    // watched before it's read, so no change can fall between the two
+    _store->acquire(_nativeRootPath);
+    startLoad(true);
+    return QModelIndex{};
+}
+
+/*
+re-reads the root directory; the current rows stay in place until the new listing is ready
+
+The other models showing it read it again along with this one (as the store
+drops its listing), so they keep sharing it.
+*/
+void tffm::DirectoryModel::refresh() {
+    if (!_nativeRootPath.empty()) _store->invalidate(_nativeRootPath);
+}
+
+/*
+loads the directory at `path` into the listing cache in the background, unless it's already there
+*/
+void tffm::DirectoryModel::prefetch(QString const& path) {
+    _store->prefetch(QFile::encodeName(QDir::cleanPath(path)).toStdString(), _sortOrder);
+}
+
+/*
+shows the listing of the root directory another model shows or the cache has, or has the store read it
+*/
+void tffm::DirectoryModel::startLoad(bool useCache) {
+    const auto generation = ++_generation;
+    _generationAwaitingRead = 0;
+
+    auto found = ListingCache::Listing{};
+    if (useCache && _store->lookup(_nativeRootPath, found)) {
+        if (found.order.size() == found.listing->size()) {
+            // shown right away, so `FileManager::updateCurrentIndex` doesn't have to wait for `directoryLoaded`
+            // sizes and times aren't watched while a listing is cached, so an order by them is redone
+            auto listing = found.listing;
+            auto index = found.searchIndex;
+            finishLoad(generation, found.sortKeys, std::move(found.order), found.sortOrder);
+            if (_orderSortedBy == _sortOrder && SortKeys::usesMetadata(_sortOrder.key)) startSort();
+            if (index) finishIndex(generation, index);
+            else startIndexing(generation, listing);
+            return;
+        }
+
+        // another model shows it, in an order of its own
+        _loadPending = true;
+        auto keys = found.sortKeys;
+        const auto sortOrder = _sortOrder;
+        _loaderPool.start(new FunctionTask{[this, generation, keys, sortOrder]() {
+            if (generation != _generation) return;
+            auto order = keys->sorted(sortOrder);
+            QMetaObject::invokeMethod(this, [this, generation, keys, order, sortOrder]() {
+                finishLoad(generation, keys, order, sortOrder);
+                if (_listing == keys->listing()) startIndexing(generation, _listing);
+            }, Qt::QueuedConnection);
+        }});
+        return;
+    }
+
+    _loadPending = true;
+    _generationAwaitingRead = generation;
+    _store->load(_nativeRootPath, _sortOrder);
+}
+
+/*
+shows a listing the store read, if it's of the root directory
+*/
+void tffm::DirectoryModel::finishRead(std::string const& path, ListingCache::Listing const& listing) {
+    if (path != _nativeRootPath) return;
+
+    if (_generationAwaitingRead != 0 && _generationAwaitingRead == _generation) {
+        _generationAwaitingRead = 0;
+        if (_sortKeys != listing.sortKeys) {
+            finishLoad(_generation, listing.sortKeys, listing.order, listing.sortOrder);
+            return;
+        }
+
+        // the rows were streamed in as it was read, and are all there
+        _indexedListing = _listing;
+        _loadPending = false;
+        if (_orderSortedBy != _sortOrder) startSort();
+        emit directoryLoaded(_rootPath);
+    }
+    else if (_sortKeys && _sortKeys != listing.sortKeys && !_loadPending) {
+        // another model read it again, and this one moves to the new listing too, so they keep sharing it
+        startLoad(true);
+    }
+}
+
+/*
+shows the entries of the root directory the store has read so far, if this model is waiting on the read
+
+Only a model with nothing to show takes the first entries (one that's reading
+its directory again keeps the rows it has until the new listing is whole);
+after that, each batch is merged into its rows as changes would be. The rows
+are in the order asked for, or by name if that needs sizes or times, and are
+sorted once the directory has been read.
+*/
+void tffm::DirectoryModel::adoptStreamed(std::string const& path, std::shared_ptr<const ListingStore::Change> const& change) {
+    if (path != _nativeRootPath || _generationAwaitingRead == 0 || _generationAwaitingRead != _generation) return;
+
+    if (_listing && _sortKeys == change->previous) {
+        mergeChange(*change);
+    }
+    else if (!_listing) {
+        const auto sortedBy = SortKeys::usesMetadata(_sortOrder.key) ? SortKeys::Order{} : _sortOrder;
+        showListing(change->keys, change->keys->sorted(sortedBy), sortedBy);
+    }
+    else {
+        return;
+    }
+    emit directoryLoading(_rootPath, static_cast<int>(_listing->size()));
+}
+
+/*
+builds the search index of `listing` on a loader thread
+*/
+void tffm::DirectoryModel::startIndexing(std::uint64_t generation, std::shared_ptr<const DirectoryListing> listing) {
+    _loaderPool.start(new FunctionTask{[this, generation, listing]() {
+        if (generation != _generation) return;
+        auto index = std::make_shared<SearchIndex>(listing);
+        QMetaObject::invokeMethod(this, [this, generation, index]() {
+            finishIndex(generation, index);
+        }, Qt::QueuedConnection);
+    }});
+}
+
+/*
+reads the sizes, modification times and permissions of the entries in rows `firstRow` to `lastRow` ahead of the rest
+*/
+void tffm::DirectoryModel::requestMetadata(int firstRow, int lastRow) {
+    if (!_sortKeys) return;
+    firstRow = std::max(firstRow, 0);
+    lastRow = std::min(lastRow, rowCount() - 1);
+
+    auto metadata = _sortKeys->metadata();
+    auto entries = std::vector<EntryIndex>{};
+    for (int row = firstRow; row <= lastRow; ++row) {
+        const auto i = _rows[static_cast<std::size_t>(row)];
+        if (!metadata->isRead(i)) entries.push_back(i);
+    }
+    if (entries.empty()) return;
+
+    _metadataPool.start(new FunctionTask{[this, metadata, entries]() {
+        metadata->read(entries.data(), entries.size());
+        QMetaObject::invokeMethod(this, [this, metadata, entries]() {
+            finishMetadata(metadata, entries);
+        }, Qt::QueuedConnection);
+    }});
+}
+
+/*
+reads the metadata of the whole listing in the background, once the visible rows are done
+*/
+void tffm::DirectoryModel::startReadingMetadata() {
+    const auto generation = ++_metadataGeneration;
+    if (!_sortKeys || _sortKeys->metadata()->missing() == 0) return;
+
+    auto metadata = _sortKeys->metadata();
+    _backgroundMetadataPool.start(new FunctionTask{[this, generation, metadata]() {
+        // Linux applies nice values per thread; the pool only ever runs this
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+
+        const auto size = metadata->listing()->size();
+        auto slice = std::vector<EntryIndex>{};
+        for (std::size_t first = 0; first < size && generation == _metadataGeneration; first += metadataSlice) {
+            slice.clear();
+            for (auto i = first; i < std::min<std::size_t>(first + metadataSlice, size); ++i) {
+                slice.push_back(static_cast<EntryIndex>(i));
+            }
+            metadata->read(slice.data(), slice.size());
+        }
+    }});
+}
+
+/*
+lets the view know the metadata of `entries` has been read, unless the listing changed since
+*/
+void tffm::DirectoryModel::finishMetadata(std::shared_ptr<const EntryMetadata> metadata, std::vector<EntryIndex> const& entries) {
+    if (!_sortKeys || _sortKeys->metadata() != metadata) return;
+
+    int firstRow = std::numeric_limits<int>::max();
+    int lastRow = -1;
+    for (auto i : entries) {
+        const auto row = _rowOfEntry[i];
+        if (row < 0) continue;
+        firstRow = std::min(firstRow, row);
+        lastRow = std::max(lastRow, row);
+    }
+    if (lastRow >= 0) emit dataChanged(createIndex(firstRow, 0), createIndex(lastRow, 0), {Qt::ToolTipRole, SizeRole});
+}
+
+/*
+sorts the rows by `order` on a loader thread; the listing isn't read again
+*/
+void tffm::DirectoryModel::setSortOrder(SortKeys::Order order) {
+    if (order == _sortOrder) {
+        if (order == _orderSortedBy) emit rowsSorted();
+        return;
+    }
+    _sortOrder = order;
+    startSort();
+}
+
+/*
+sorts the current listing by `_sortOrder` on a loader thread
+*/
+void tffm::DirectoryModel::startSort() {
+    if (!_sortKeys) return; // the listing being loaded is sorted as it's read
+    const auto request = ++_sortRequest;
+    auto keys = _sortKeys;
+    const auto sortOrder = _sortOrder;
+    _loaderPool.start(new FunctionTask{[this, request, keys, sortOrder]() {
+        if (request != _sortRequest) return;
+        auto order = keys->sorted(sortOrder);
+        QMetaObject::invokeMethod(this, [this, request, keys, order, sortOrder]() {
+            finishSort(request, keys, order, sortOrder);
+        }, Qt::QueuedConnection);
+    }});
+}
+
+QString tffm::DirectoryModel::filePath(QModelIndex const& index) const {
+    if (!index.isValid()) return _rootPath;
+    return childPath(_listing->name(entryAt(index)));
+}
+
+QString tffm::DirectoryModel::fileName(QModelIndex const& index) const {
+    return data(index, Qt::DisplayRole).toString();
+}
+
+bool tffm::DirectoryModel::isDir(QModelIndex const& index) const {
+    return index.isValid() && _listing->isDirectory(entryAt(index));
+}
+
+void tffm::DirectoryModel::setFilter(QDir::Filters filters) {
+    if (filters == _filters) return;
+
+    beginResetModel();
+    _filters = filters;
+    rebuildRows();
+    endResetModel();
+}
+
+/*
+returns, in ascending order, the visible rows of the entries in `range`
+*/
+std::vector<int> tffm::DirectoryModel::rowsMatching(SearchIndex::Range const& range) const {
+    auto rows = std::vector<int>{};
+    if (!_searchIndex) return rows;
+
+    rows.reserve(range.size());
+    for (EntryIndex i = 0; i < range.size(); ++i) {
+        const auto row = _rowOfEntry[_searchIndex->entry(range, i)];
+        if (row >= 0) rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+/*
+returns the visible rows of the entries in `matches`, best score first (and then in row order)
+*/
+std::vector<int> tffm::DirectoryModel::rowsMatching(std::vector<SearchIndex::Match> const& matches) const {
+    auto ranked = std::vector<std::pair<int, int>>{}; // (score, row)
+    ranked.reserve(matches.size());
+    for (auto&& match : matches) {
+        const auto row = _rowOfEntry[match.entry];
+        if (row >= 0) ranked.emplace_back(match.score, row);
+    }
+    std::sort(ranked.begin(), ranked.end(), [](std::pair<int, int> const& a, std::pair<int, int> const& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    auto rows = std::vector<int>{};
+    rows.reserve(ranked.size());
+    for (auto&& r : ranked) {
+        rows.push_back(r.second);
+    }
+    return rows;
+}
+
+/*
+returns the paths of the selected entries that are visible, as they are on the file system
+*/
+std::vector<std::string> tffm::DirectoryModel::selectedNativePaths() const {
+    auto paths = std::vector<std::string>{};
+    if (_selectedCount == 0) return paths;
+
+    auto directory = _listing->path();
+    if (directory.empty() || directory.back() != '/') directory += '/';
+    paths.reserve(_selectedCount);
+    for (auto i : _rows) {
+        if (_selected[i]) paths.push_back(directory + std::string{_listing->name(i), _listing->nameLength(i)});
+    }
+    return paths;
+}
+
+/*
+drops the rows of the items called `names` in `directory` once they've been removed, as one layout change
+
+The entries stay in the listing (which is shared with the cache and the search
+index) until the watcher reports them gone; until then they're hidden, as a
+filter would hide them, so that sorting the listing again doesn't bring them
+back.
+*/
+void tffm::DirectoryModel::removeEntries(QString const& directory, QStringList const& names) {
+    if (!_listing || names.isEmpty() || QDir::cleanPath(directory) != _rootPath) return;
+
+    auto namesByHash = std::unordered_multimap<std::uint64_t, std::string>{};
+    for (auto&& name : names) {
+        auto nativeName = QFile::encodeName(name).toStdString();
+        const auto hash = hashName(nativeName.data(), nativeName.size());
+        namesByHash.emplace(hash, std::move(nativeName));
+    }
+    auto removed = _removed.empty() ? std::vector<bool>(_listing->size(), false) : _removed;
+    bool anyRemoved = false;
+    for (auto i : _rows) {
+        const auto candidates = namesByHash.equal_range(hashName(_listing->name(i), _listing->nameLength(i)));
+        for (auto c = candidates.first; c != candidates.second; ++c) {
+            if (c->second == _listing->name(i)) removed[i] = anyRemoved = true;
+        }
+    }
+    if (!anyRemoved) return;
+
+    constexpr EntryIndex none = std::numeric_limits<EntryIndex>::max();
+    emit layoutAboutToBeChanged();
+    const auto from = persistentIndexList();
+    auto entries = std::vector<EntryIndex>{};
+    for (auto&& index : from) {
+        entries.push_back(index.isValid() && !removed[entryAt(index)] ? entryAt(index) : none);
+    }
+
+    for (EntryIndex i = 0; i < _listing->size(); ++i) {
+        if (removed[i] && _selected[i]) {
+            _selected[i] = false;
+            --_selectedCount;
+        }
+    }
+    _removed = std::move(removed);
+    rebuildRows();
+
+    auto to = QModelIndexList{};
+    for (auto i : entries) {
+        const auto row = i != none ? _rowOfEntry[i] : -1;
+        to << (row >= 0 ? createIndex(row, 0) : QModelIndex{});
+    }
+    changePersistentIndexList(from, to);
+    emit layoutChanged();
+}
+
+/*
+records the space taken by the trees of the sub-directories called `names` of `directory`, if it's the root directory
+*/
+void tffm::DirectoryModel::setTreeSizes(QString const& directory, QStringList const& names, QVector<qint64> const& bytes) {
+    if (QDir::cleanPath(directory) != _rootPath) return;
+
+    for (int n = 0; n < names.size() && n < bytes.size(); ++n) {
+        _treeSizes[QFile::encodeName(names[n]).toStdString()] = bytes[n];
+    }
+    if (rowCount() > 0) emit dataChanged(createIndex(0, 0), createIndex(rowCount() - 1, 0), {SizeRole});
+}
+
+bool tffm::DirectoryModel::isSelected(QModelIndex const& index) const {
+    return index.isValid() && index.row() < rowCount() && _selected[entryAt(index)];
+}
+
+/*
+selects (or deselects) the entries in rows `firstRow` to `lastRow`
+*/
+void tffm::DirectoryModel::setRowsSelected(int firstRow, int lastRow, bool selected) {
+    firstRow = std::max(firstRow, 0);
+    lastRow = std::min(lastRow, rowCount() - 1);
+    if (firstRow > lastRow) return;
+
+    for (int row = firstRow; row <= lastRow; ++row) {
+        const auto i = _rows[static_cast<std::size_t>(row)];
+        if (_selected[i] == selected) continue;
+        _selected[i] = selected;
+        if (selected) ++_selectedCount;
+        else --_selectedCount;
+    }
+    emit dataChanged(createIndex(firstRow, 0), createIndex(lastRow, 0), {Qt::BackgroundRole});
+}
+
+/*
+selects (or deselects) the visible entries whose names match the shell wildcard `pattern`
+*/
+std::size_t tffm::DirectoryModel::setMatchingSelected(QString const& pattern, bool selected) {
+    const auto nativePattern = QFile::encodeName(pattern);
+    std::size_t matches = 0;
+    for (auto i : _rows) {
+        if (fnmatch(nativePattern.constData(), _listing->name(i), 0) != 0) continue;
+        ++matches;
+        if (_selected[i] == selected) continue;
+        _selected[i] = selected;
+        if (selected) ++_selectedCount;
+        else --_selectedCount;
+    }
+    if (matches > 0) emit dataChanged(createIndex(0, 0), createIndex(rowCount() - 1, 0), {Qt::BackgroundRole});
+    return matches;
+}
+
+void tffm::DirectoryModel::clearSelection() {
+    if (_selectedCount == 0) return;
+
+    _selected.assign(_selected.size(), false);
+    _selectedCount = 0;
+    if (rowCount() > 0) emit dataChanged(createIndex(0, 0), createIndex(rowCount() - 1, 0), {Qt::BackgroundRole});
+}
+
+/*
+returns the names of the selected entries that are visible, in display order
+*/
+QStringList tffm::DirectoryModel::selectedNames() const {
+    auto names = QStringList{};
+    if (_selectedCount == 0) return names;
+
+    names.reserve(static_cast<int>(_selectedCount));
+    for (auto i : _rows) {
+        if (_selected[i]) names << QFile::decodeName(QByteArray::fromRawData(_listing->name(i), _listing->nameLength(i)));
+    }
+    return names;
+}
+
+/*
+installs a listing read by a loader thread, unless it's been superseded
+*/
+void tffm::DirectoryModel::finishLoad(std::uint64_t generation, std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortedBy) {
+    if (generation != _generation) return;
+    const auto current = _store->current(_nativeRootPath);
+    if (current && current != keys) {
+        // changes were applied to the directory (for another model) while it was being sorted
+        startLoad(true);
+        return;
+    }
+
+    showListing(std::move(keys), std::move(order), sortedBy);
+    _indexedListing = _listing;
+    _loadPending = false;
+    if (_orderSortedBy != _sortOrder) startSort();
+
+    emit directoryLoaded(_rootPath);
+}
+
+/*
+resets the rows to the entries of the listing of `keys`, in `order`, keeping the selected names
+*/
+void tffm::DirectoryModel::showListing(std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortedBy) {
+    beginResetModel();
+    // a directory that's read again keeps its selection
+    auto selected = std::vector<bool>(keys->listing()->size(), false);
+    std::size_t selectedCount = 0;
+    if (_selectedCount > 0 && _listing && _listing->path() == keys->listing()->path()) {
+        auto selectedNames = std::unordered_set<std::string>{};
+        for (EntryIndex i = 0; i < _listing->size(); ++i) {
+            if (_selected[i]) selectedNames.emplace(_listing->name(i), _listing->nameLength(i));
+        }
+        auto const& listing = *keys->listing();
+        for (EntryIndex i = 0; i < listing.size(); ++i) {
+            if (selectedNames.count(std::string{listing.name(i), listing.nameLength(i)})) {
+                selected[i] = true;
+                ++selectedCount;
+            }
+        }
+    }
+    _selected = std::move(selected);
+    _selectedCount = selectedCount;
+    _removed.clear(); // read after they were removed, or they're there again
+    _listing = keys->listing();
+    _sortKeys = std::move(keys);
+    ++_sortRequest; // sorts of the previous listing are of no use now
+    _order = std::move(order);
+    _orderSortedBy = sortedBy;
+    _searchIndex.reset(); // refers to the entries of the previous listing
+    rebuildRows();
+    endResetModel();
+    startReadingMetadata();
+}
+
+/*
+shows the rows in the order a loader thread sorted them in, as one layout change, unless it's been superseded
+*/
+void tffm::DirectoryModel::finishSort(std::uint64_t request, std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortedBy) {
+    _store->cache().setOrder(keys->listing()->path(), keys, order, sortedBy);
+    if (request != _sortRequest) return;
+    if (keys != _sortKeys) {
+        // changes were applied while it was being sorted
+        startSort();
+        return;
+    }
+
+    constexpr EntryIndex none = std::numeric_limits<EntryIndex>::max();
+    emit layoutAboutToBeChanged();
+    const auto from = persistentIndexList();
+    auto entries = std::vector<EntryIndex>{};
+    for (auto&& index : from) {
+        entries.push_back(index.isValid() ? entryAt(index) : none);
+    }
+
+    _order = std::move(order);
+    _orderSortedBy = sortedBy;
+    rebuildRows();
+
+    auto to = QModelIndexList{};
+    for (auto i : entries) {
+        const auto row = i != none ? _rowOfEntry[i] : -1;
+        to << (row >= 0 ? createIndex(row, 0) : QModelIndex{});
+    }
+    changePersistentIndexList(from, to);
+    emit layoutChanged();
+    emit rowsSorted();
+}
+
+/*
+installs the search index of the current listing, unless it's been superseded
+*/
+void tffm::DirectoryModel::finishIndex(std::uint64_t generation, std::shared_ptr<const SearchIndex> index) {
+    _store->cache().setSearchIndex(index->listing()->path(), index);
+    if (generation != _generation) return;
+    if (index->listing() != _listing) {
+        // changes were applied while it was being built
+        if (_indexedListing == index->listing()) _indexedListing.reset();
+        if (_searchIndexRequested) requestSearchIndex();
+        return;
+    }
+
+    _searchIndex = std::move(index);
+    _indexedListing.reset();
+    _searchIndexRequested = false;
+    emit searchIndexReady();
+}
+
+/*
+builds the search index if it's missing (it's dropped when changes are applied)
+*/
+void tffm::DirectoryModel::requestSearchIndex() {
+    if (_searchIndex || !_listing) return;
+
+    _searchIndexRequested = true;
+    if (_indexedListing != _listing) {
+        _indexedListing = _listing;
+        startIndexing(_generation, _listing);
+    }
+}
+
+/*
+moves the rows over to the listing the store made by applying changes to the root directory, as one layout change
+
+The store made the new listing once for all the models showing the directory
+(the listing itself is immutable, as the cache and the search index share
+it); what's left for each of them is its display order, which is updated by
+merging the (sorted) new entries into what's left of the old one, and its
+selection. The search index isn't rebuilt until a search asks for it, so a
+directory that keeps changing doesn't keep a core busy indexing it.
+*/
+void tffm::DirectoryModel::adoptChange(std::string const& path, std::shared_ptr<const ListingStore::Change> const& change) {
+    if (path != _nativeRootPath || !_listing) return;
+    if (_sortKeys != change->previous) {
+        // this model's listing isn't the one the changes were made to (it was read before them), so it catches up
+        if (!_loadPending) startLoad(true);
+        return;
+    }
+    mergeChange(*change);
+}
+
+/*
+moves the rows over to the listing of `change.keys`, made from the current one, as one layout change
+
+The new entries are merged into the order the rows are in, which is the one
+asked for unless a sort is still catching up.
+*/
+void tffm::DirectoryModel::mergeChange(ListingStore::Change const& change) {
+    // an entry that's still there may have changed size or time (which moves it in those orders)
+    constexpr EntryIndex none = ListingStore::none;
+    const bool byMetadata = SortKeys::usesMetadata(_orderSortedBy.key);
+    auto keys = change.keys;
+    auto listing = keys->listing();
+    auto const& newIndexOf = change.newIndexOf;
+
+    // modified entries are taken out of the order (if it's by size or time) and merged back in with the new ones
+    auto addedOrder = std::vector<EntryIndex>{};
+    auto moved = std::vector<bool>(listing->size(), false);
+    for (auto i : byMetadata ? change.modified : std::vector<EntryIndex>{}) {
+        if (!moved[i]) addedOrder.push_back(i);
+        moved[i] = true;
+    }
+    auto order = std::vector<EntryIndex>{};
+    order.reserve(listing->size());
+    for (auto i : _order) {
+        if (newIndexOf[i] != none && !moved[newIndexOf[i]]) order.push_back(newIndexOf[i]);
+    }
+    for (auto i = change.firstAdded; i < listing->size(); ++i) {
+        addedOrder.push_back(i);
+    }
+    const auto precedes = keys->comparator(_orderSortedBy);
+    std::sort(addedOrder.begin(), addedOrder.end(), precedes);
+    auto merged = std::vector<EntryIndex>{};
+    merged.reserve(order.size() + addedOrder.size());
+    std::merge(order.begin(), order.end(), addedOrder.begin(), addedOrder.end(), std::back_inserter(merged), precedes);
+
+    emit layoutAboutToBeChanged();
+    const auto from = persistentIndexList();
+    auto entries = std::vector<EntryIndex>{};
+    for (auto&& index : from) {
+        entries.push_back(index.isValid() ? newIndexOf[entryAt(index)] : none);
+    }
+
+    auto selected = std::vector<bool>(listing->size(), false);
+    _selectedCount = 0;
+    for (EntryIndex i = 0; i < _listing->size(); ++i) {
+        if (_selected[i] && newIndexOf[i] != none) {
+            selected[newIndexOf[i]] = true;
+            ++_selectedCount;
+        }
+    }
+
+    // entries removed by tffm that the store still has stay hidden
+    auto removed = std::vector<bool>{};
+    if (!_removed.empty()) {
+        removed.assign(listing->size(), false);
+        for (EntryIndex i = 0; i < _listing->size(); ++i) {
+            if (_removed[i] && newIndexOf[i] != none) removed[newIndexOf[i]] = true;
+        }
+        if (std::find(removed.begin(), removed.end(), true) == removed.end()) removed.clear();
+    }
+
+    _listing = std::move(listing);
+    _selected = std::move(selected);
+    _removed = std::move(removed);
+    _sortKeys = std::move(keys);
+    _order = std::move(merged);
+    _searchIndex.reset();
+    rebuildRows();
+
+    auto to = QModelIndexList{};
+    for (auto i : entries) {
+        const auto row = i != none ? _rowOfEntry[i] : -1;
+        to << (row >= 0 ? createIndex(row, 0) : QModelIndex{});
+    }
+    changePersistentIndexList(from, to);
+    emit layoutChanged();
+    startReadingMetadata();
+
+    // sizes and times that weren't read yet were taken as zero; the sort reads them on a loader thread,
+    // then moves the rows they belong to
+    if (byMetadata && _sortKeys->metadata()->missing() > 0) startSort();
+}
+
+/*
+recomputes which entries are visible according to `_filters`, and in which row
+*/
+void tffm::DirectoryModel::rebuildRows() {
+    _rows.clear();
+    _rows.reserve(_order.size());
+    _rowOfEntry.assign(_listing ? _listing->size() : 0, -1);
+    for (auto i : _order) {
+        if (isVisible(i)) {
+            _rowOfEntry[i] = static_cast<int>(_rows.size());
+            _rows.push_back(i);
+        }
+    }
+}
+
+bool tffm::DirectoryModel::isVisible(EntryIndex i) const {
+    if (!_removed.empty() && _removed[i]) return false;
+    if (_listing->isHidden(i) && !(_filters & QDir::Hidden)) return false;
+    if (_listing->isDirectory(i)) return _filters & (QDir::Dirs | QDir::AllDirs);
+    return _filters & (QDir::Files | QDir::System);
+}
+
+QString tffm::DirectoryModel::childPath(const char* name) const {
+    auto path = _rootPath;
+    if (!path.endsWith(QChar('/'))) path += QChar('/');
+    return path + QFile::decodeName(name);
+}
@@ -0,0 +1,314 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DIRECTORYMODEL_HPP
+#define DIRECTORYMODEL_HPP
+
+// project headers
+#include "directorylisting.hpp"
+#include "iconcache.hpp"
+#include "listingcache.hpp"
+#include "listingstore.hpp"
+#include "searchindex.hpp"
+#include "sortkeys.hpp"
+
+// standard libraries
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Qt classes
+#include <QAbstractListModel>
+#include <QDir>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+namespace tffm { class DirectoryModel; }
+
+/*
+a flat model of the entries of a single directory
+
+This is a light-weight replacement for `QFileSystemModel` for the way tffm
+uses it: only the children of the root path are ever shown. Directories are
+read on a background thread into a `DirectoryListing`, sorted once (directories
+first, then by name or whatever `setSortOrder()` asked for) with the
+listing's `SortKeys` and exposed as a list. Rows only hold an index into the
+listing, so a directory with a million entries costs a few tens of megabytes
+instead of a heavy-weight node per entry. Changing the order sorts the same
+listing again, it isn't read again.
+
+Nothing but the directory itself is read to show it: sizes, modification
+times and permissions (shown as tool tips) are read by `EntryMetadata` in
+the background, the rows the view asks for with `requestMetadata()` first and
+the rest of the directory at the lowest priority.
+
+Directories are read, cached and watched by a `ListingStore`, which can be
+shared by several models (the panes of a window): a directory shown in two
+panes is read and watched once, and both show the same listing. Going back
+to a directory shows its cached listing right away, and `prefetch()` loads
+a directory into the cache ahead of time.
+
+A directory that's slow to read is shown as it's read: the entries the store
+streams are merged into the rows the same way changes are, and
+`directoryLoading` tells how far the read is, until `directoryLoaded`.
+
+Changes to the root directory are applied by the store a batch at a time;
+the model carries its order and selection over to the new listing as a
+single layout change that keeps persistent indexes (and so the view's
+current item and selection) on their entries.
+
+Icons are looked up by an `IconCache`, which resolves them by extension in
+the background, and can be turned off altogether with `setShowIcons()`.
+
+Items are selected (for visual mode and `:select`) in a bitmap over the
+entries of the listing rather than as a list of indexes, so that selecting a
+hundred thousand items costs a few kilobytes and survives sorting, filtering
+and changes to the directory.
+*/
+class tffm::DirectoryModel : public QAbstractListModel {
+    Q_OBJECT
+
+    public:
+        enum Role { SizeRole = Qt::UserRole + 1 };
+        /*  the space taken by the tree of a directory `:du` has walked, or the size of a file whose
+            metadata has been read, in bytes */
+
+        explicit DirectoryModel(QObject* parent = nullptr);
+        /*  makes a model with a store of its own */
+
+        explicit DirectoryModel(std::shared_ptr<ListingStore> store, QObject* parent = nullptr);
+        /*  makes a model that reads its directories through `store`, along with the other models sharing it */
+
+        ~DirectoryModel() override;
+
+        int rowCount(QModelIndex const& parent = QModelIndex{}) const override;
+        QVariant data(QModelIndex const& index, int role = Qt::DisplayRole) const override;
+
+        using QAbstractListModel::index;
+
+        QModelIndex index(QString const& path) const;
+        /*  returns the index of the item at `path`, which must be the root path or one of its children */
+
+        QModelIndex setRootPath(QString const& path);
+        /*  starts loading the directory at `path`; `directoryLoaded` is emitted once it's available */
+
+        void refresh();
+        /*  re-reads the root directory; the current rows stay in place until the new listing is ready */
+
+        void prefetch(QString const& path);
+        /*  loads the directory at `path` into the listing cache in the background, unless it's already there */
+
+        ListingCache::Statistics cacheStatistics() const { return _store->cache().statistics(); }
+
+        std::vector<ListingStore::Footprint> memoryFootprints() const { return _store->footprints(); }
+        /*  returns the memory taken by the listing of each directory shown or cached, biggest first */
+
+        void setMemoryBudget(std::size_t bytes) { _store->setMemoryBudget(bytes); }
+        std::size_t memoryBudget() const { return _store->memoryBudget(); }
+        /*  bounds the memory of the listings cached for the directories no longer shown (for all the
+            models sharing the store) */
+
+        void requestMetadata(int firstRow, int lastRow);
+        /*  reads the sizes, modification times and permissions of the entries in rows `firstRow` to
+            `lastRow` (the visible ones) ahead of the rest of the directory */
+
+        void setSortOrder(SortKeys::Order order);
+        /*  sorts the rows by `order` on a loader thread; `rowsSorted` is emitted once they're in that order */
+
+        SortKeys::Order sortOrder() const { return _sortOrder; }
+
+        void setCoalescingWindow(int milliseconds) { _store->setCoalescingWindow(milliseconds); }
+        int coalescingWindow() const { return _store->coalescingWindow(); }
+        /*  how long changes to a directory are collected before being applied as one batch (for all the
+            models sharing the store) */
+
+        QString rootPath() const { return _rootPath; }
+        QDir rootDirectory() const { return QDir{_rootPath}; }
+
+        bool isLoading() const { return _loadPending; }
+        /*  returns whether the root directory is being (re-)read; `directoryLoaded` is emitted once it is */
+
+        QString filePath(QModelIndex const& index) const;
+        QString fileName(QModelIndex const& index) const;
+        bool isDir(QModelIndex const& index) const;
+
+        QString mimeType(QModelIndex const& index) const;
+        /*  returns the MIME type of a file as far as its extension tells, once its icon has been resolved,
+            or an empty string */
+
+        bool showsIcons() const { return _showIcons; }
+        void setShowIcons(bool show);
+        /*  sets whether the rows have icons; without them, no icon or MIME type is ever looked up */
+
+        QDir::Filters filter() const { return _filters; }
+        void setFilter(QDir::Filters filters);
+
+        SearchIndex const* searchIndex() const { return _searchIndex.get(); }
+        /*  returns the prefix index of the current listing, or null while it's being built */
+
+        void requestSearchIndex();
+        /*  builds the search index if it's missing (it's dropped when changes are applied);
+            `searchIndexReady` is emitted once it's available */
+
+        std::vector<int> rowsMatching(SearchIndex::Range const& range) const;
+        /*  returns, in ascending order, the visible rows of the entries in `range` */
+
+        std::vector<int> rowsMatching(std::vector<SearchIndex::Match> const& matches) const;
+        /*  returns the visible rows of the entries in `matches`, best score first */
+
+        void removeEntries(QString const& directory, QStringList const& names);
+        /*  drops the rows of the items called `names` in `directory` (if it's the root directory) once
+            they've been removed from the file system, as one layout change */
+
+        void setTreeSizes(QString const& directory, QStringList const& names, QVector<qint64> const& bytes);
+        /*  records the space taken by the trees of the sub-directories called `names` of `directory`, if it's
+            the root directory */
+
+        bool isSelected(QModelIndex const& index) const;
+
+        std::size_t selectedCount() const { return _selectedCount; }
+        /*  returns how many entries are selected, including those a filter hides */
+
+        void setRowsSelected(int firstRow, int lastRow, bool selected);
+        /*  selects (or deselects) the entries in rows `firstRow` to `lastRow` */
+
+        std::size_t setMatchingSelected(QString const& pattern, bool selected);
+        /*  selects (or deselects) the visible entries whose names match the shell wildcard `pattern`;
+            returns how many there are */
+
+        void clearSelection();
+
+        QStringList selectedNames() const;
+        /*  returns the names of the selected entries that are visible, in display order */
+
+        std::vector<std::string> selectedNativePaths() const;
+        /*  returns the paths of the same entries, as they are on the file system */
+
+    signals:
+        void rootPathChanged(QString const& newPath);
+        void directoryLoaded(QString const& path);
+        void directoryLoading(QString const& path, int entriesRead);
+        /*  emitted when the rows show more of the root directory while it's still being read */
+        void searchIndexReady();
+        void rowsSorted();
+
+    private:
+        using EntryIndex = DirectoryListing::size_type;
+
+        std::shared_ptr<const DirectoryListing> _listing;
+        std::vector<EntryIndex> _order;     // all entries in display order
+        std::vector<EntryIndex> _rows;      // entries of `_order` that pass `_filters`
+        std::vector<int> _rowOfEntry;       // inverse of `_rows`, -1 for hidden entries
+        std::vector<bool> _selected;        // by entry
+        std::vector<bool> _removed;         // by entry, those `removeEntries` dropped until the store drops them too; empty if none
+        std::size_t _selectedCount;
+        std::shared_ptr<const SortKeys> _sortKeys; // of `_listing`
+        SortKeys::Order _sortOrder;         // the order asked for
+        SortKeys::Order _orderSortedBy;     // the order `_order` is in, until a sort catches up
+        std::atomic<std::uint64_t> _sortRequest; // makes superseded sorts return early
+        std::atomic<std::uint64_t> _metadataGeneration; // makes background reads of old listings stop
+        std::shared_ptr<const SearchIndex> _searchIndex;
+        std::unordered_map<std::string, qint64> _treeSizes; // of the sub-directories `:du` has walked, by name
+        QString _rootPath;
+        std::string _nativeRootPath;        // `_rootPath` as it is on the file system
+        QDir::Filters _filters;
+        std::atomic<std::uint64_t> _generation;
+        mutable IconCache _icons;           // filled as `data()` asks for icons
+        bool _showIcons;
+        std::shared_ptr<ListingStore> _store;
+        std::uint64_t _generationAwaitingRead;          // the load waiting on the store to read the root, or 0
+        bool _loadPending;                              // true while the root directory is being (re-)read
+        std::shared_ptr<const DirectoryListing> _indexedListing; // the listing a search index is being built for
+        bool _searchIndexRequested;
+        QThreadPool _loaderPool;
+        QThreadPool _metadataPool;          // reads the metadata of visible rows
+        QThreadPool _backgroundMetadataPool; // reads the metadata of the other rows, at the lowest priority
+
+        void startLoad(bool useCache);
+        /*  shows the listing of the root directory another model shows or the cache has, or has the store read it */
+
+        void startIndexing(std::uint64_t generation, std::shared_ptr<const DirectoryListing> listing);
+        /*  builds the search index of `listing` on a loader thread */
+
+        void startSort();
+        /*  sorts the current listing by `_sortOrder` on a loader thread */
+
+        void startReadingMetadata();
+        /*  reads the metadata of the whole listing in the background, once the visible rows are done */
+
+        void finishMetadata(std::shared_ptr<const EntryMetadata> metadata, std::vector<EntryIndex> const& entries);
+        /*  lets the view know the metadata of `entries` has been read, unless the listing changed since */
+
+        void finishRead(std::string const& path, ListingCache::Listing const& listing);
+        /*  shows a listing the store read, if it's of the root directory */
+
+        void finishLoad(std::uint64_t generation, std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortedBy);
+        /*  installs a listing read by a loader thread (along with its keys and its order, sorted by `sortedBy`),
+            unless it's been superseded */
+
+        void showListing(std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortedBy);
+        /*  resets the rows to the entries of the listing of `keys`, in `order`, keeping the selected names */
+
+        void adoptStreamed(std::string const& path, std::shared_ptr<const ListingStore::Change> const& change);
+        /*  shows the entries of the root directory the store has read so far, if this model is waiting on
+            the read and has nothing better to show */
+
+        void finishSort(std::uint64_t request, std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortedBy);
+        /*  shows the rows in the order a loader thread sorted them in, as one layout change, unless it's been superseded */
+
+        void finishIndex(std::uint64_t generation, std::shared_ptr<const SearchIndex> index);
+        /*  installs the search index of the current listing, unless it's been superseded */
+
+        void adoptChange(std::string const& path, std::shared_ptr<const ListingStore::Change> const& change);
+        /*  moves the rows over to the listing the store made by applying changes to the root directory, as one
+            layout change */
+
+        void mergeChange(ListingStore::Change const& change);
+        /*  moves the rows over to the listing of `change.keys`, made from the current one, as one layout change */
+
+        void rebuildRows();
+        /*  recomputes which entries are visible according to `_filters`, and in which row */
+
+        bool isVisible(EntryIndex i) const;
+
+        EntryIndex entryAt(QModelIndex const& index) const { return _rows[static_cast<std::size_t>(index.row())]; }
+
+        QString childPath(const char* name) const;
+};
+
+#endif // DIRECTORYMODEL_HPP
@@ -0,0 +1,138 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "directorywatcher.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cerrno>
+
+// system headers
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+// IN_CLOSE_WRITE is there for the sizes and times shown, which a write changes without touching the directory
+constexpr std::uint32_t watchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE
+                                  | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+}
+
+constexpr int tffm::DirectoryWatcher::defaultCoalescingWindow;
+
+tffm::DirectoryWatcher::DirectoryWatcher(QObject* parent) : QObject{parent}, _wd{-1}, _overflowed{false} {
+    _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotifyFd >= 0) {
+        _notifier = std::make_unique<QSocketNotifier>(_inotifyFd, QSocketNotifier::Read);
+        connect(_notifier.get(), &QSocketNotifier::activated, this, &DirectoryWatcher::readEvents);
+    }
+
+    _batchTimer.setSingleShot(true);
+    _batchTimer.setInterval(defaultCoalescingWindow);
+    connect(&_batchTimer, &QTimer::timeout, this, &DirectoryWatcher::emitBatch);
+}
+
+tffm::DirectoryWatcher::~DirectoryWatcher() {
+    _notifier.reset();
+    if (_inotifyFd >= 0) close(_inotifyFd);
+}
+
+/*
+starts watching the directory at `path` instead of the current one, dropping pending changes
+*/
+void tffm::DirectoryWatcher::watch(std::string const& path) {
+    if (_inotifyFd < 0) return;
+
+    if (_wd >= 0) inotify_rm_watch(_inotifyFd, _wd);
+    _wd = -1;
+    readEvents(); // discards what was queued for the previous directory
+    _changedNames.clear();
+    _overflowed = false;
+    _batchTimer.stop();
+
+    _wd = inotify_add_watch(_inotifyFd, path.c_str(), watchMask);
+}
+
+void tffm::DirectoryWatcher::setCoalescingWindow(int milliseconds) {
+    _batchTimer.setInterval(std::max(0, milliseconds));
+}
+
+void tffm::DirectoryWatcher::readEvents() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    bool recorded = false;
+    for (;;) {
+        const auto n = read(_inotifyFd, buffer, sizeof buffer);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        for (ssize_t pos = 0; pos < n;) {
+            const auto event = reinterpret_cast<const inotify_event*>(buffer + pos);
+            pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                _overflowed = true;
+                recorded = true;
+            }
+            else if (event->wd != _wd) {
+                continue; // left over from a previous directory
+            }
+            else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                _overflowed = true;
+                recorded = true;
+            }
+            else if (event->len > 0) {
+                _changedNames.emplace(event->name);
+                recorded = true;
+            }
+        }
+    }
+
+    // the window is opened by the first change and not extended by later ones
+    if (recorded && _wd >= 0 && !_batchTimer.isActive()) _batchTimer.start();
+}
+
+void tffm::DirectoryWatcher::emitBatch() {
+    if (_overflowed) {
+        _overflowed = false;
+        _changedNames.clear();
+        emit overflowed();
+        return;
+    }
+    if (_changedNames.empty()) return;
+
+    auto names = std::vector<std::string>{_changedNames.begin(), _changedNames.end()};
+    _changedNames.clear();
+    emit changed(names);
+}
@@ -0,0 +1,99 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DIRECTORYWATCHER_HPP
+#define DIRECTORYWATCHER_HPP
+
+// standard libraries
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Qt classes
+#include <QObject>
+#include <QSocketNotifier>
+#include <QTimer>
+
+namespace tffm { class DirectoryWatcher; }
+
+/*
+collects the changes inotify reports in one directory into batches
+
+A directory that's written to constantly can produce thousands of events a
+second. Rather than passing each one on, the watcher only records the names
+of the entries they were about, and hands the (deduplicated) names over in
+one batch once the coalescing window that the first of them opened has
+elapsed. The window isn't extended by later events, so a directory that
+never stops changing still gets a batch per window.
+*/
+class tffm::DirectoryWatcher : public QObject {
+    Q_OBJECT
+
+    public:
+        /*  default length of the coalescing window; a few frames, so updates still look live */
+        static constexpr int defaultCoalescingWindow = 50; // ms
+
+        explicit DirectoryWatcher(QObject* parent = nullptr);
+        ~DirectoryWatcher() override;
+
+        void watch(std::string const& path);
+        /*  starts watching the directory at `path` instead of the current one, dropping pending changes */
+
+        void setCoalescingWindow(int milliseconds);
+        int coalescingWindow() const { return _batchTimer.interval(); }
+
+    signals:
+        void changed(std::vector<std::string> const& names);
+        /*  emitted with the names of the entries that changed (were created, removed, renamed or
+            had their attributes changed) during the last window; they can change again before the
+            batch is applied, so receivers should look the entries up rather than assume a change */
+
+        void overflowed();
+        /*  emitted instead of `changed` when changes were lost, or the directory itself was removed
+            or renamed, so it has to be read again */
+
+    private:
+        int _inotifyFd;
+        int _wd;
+        std::unique_ptr<QSocketNotifier> _notifier;
+        std::unordered_set<std::string> _changedNames;
+        bool _overflowed;
+        QTimer _batchTimer;
+
+        void readEvents();
+
+        void emitBatch();
+};
+
+#endif // DIRECTORYWATCHER_HPP
@@ -0,0 +1,152 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "entrydelegate.hpp"
+#include "directorymodel.hpp"
+
+// standard libraries
+#include <algorithm>
+
+// Qt classes
+#include <QBrush>
+#include <QIcon>
+#include <QLocale>
+#include <QPainter>
+#include <QPalette>
+#include <QStyle>
+
+namespace {
+
+/*  how many laid out names are kept; a few screens' worth is what matters when scrolling back and forth */
+constexpr int maxLayouts = 8192;
+
+/*  the space above and below each row, in pixels */
+constexpr int verticalMargin = 2;
+
+}
+
+tffm::EntryDelegate::EntryDelegate(QObject* parent)
+  : QStyledItemDelegate{parent}, _showSizes{false}, _showIcons{true}, _layouts{maxLayouts} {}
+
+void tffm::EntryDelegate::paint(QPainter* painter, QStyleOptionViewItem const& option, QModelIndex const& index) const {
+    const auto group = option.state & QStyle::State_Active ? QPalette::Active : QPalette::Inactive;
+    const bool selected = option.state & QStyle::State_Selected;
+    const int margin = option.fontMetrics.averageCharWidth();
+    auto rect = option.rect;
+
+    // the current item, or the tint of a selected one
+    if (selected) {
+        painter->fillRect(rect, option.palette.brush(group, QPalette::Highlight));
+    }
+    else {
+        const auto background = index.data(Qt::BackgroundRole);
+        if (background.isValid()) painter->fillRect(rect, qvariant_cast<QBrush>(background));
+    }
+    painter->save();
+    painter->setPen(option.palette.color(group, selected ? QPalette::HighlightedText : QPalette::Text));
+
+    // the name is cut short before the size rather than drawn under it
+    const auto size = _showSizes ? index.data(DirectoryModel::SizeRole) : QVariant{};
+    if (size.isValid()) {
+        const auto text = QLocale{}.formattedDataSize(size.toLongLong());
+        const int width = option.fontMetrics.boundingRect(text).width() + 2 * margin;
+        painter->drawText(QRect{rect.right() - width + 1, rect.top(), width, rect.height()}.adjusted(margin, 0, -margin, 0),
+                          Qt::AlignRight | Qt::AlignVCenter, text);
+        rect.setRight(rect.right() - width);
+    }
+
+    rect.setLeft(rect.left() + margin);
+    if (_showIcons) {
+        const auto icon = qvariant_cast<QIcon>(index.data(Qt::DecorationRole));
+        const auto iconSize = option.decorationSize;
+        if (!icon.isNull()) painter->drawPixmap(rect.left(), rect.top() + (rect.height() - iconSize.height()) / 2, pixmap(icon, iconSize));
+        rect.setLeft(rect.left() + iconSize.width() + margin);
+    }
+
+    const auto name = index.data(Qt::DisplayRole).toString();
+    const auto text = layout(name, std::max(rect.width() - margin, 0), option);
+    painter->drawStaticText(rect.left(), rect.top() + (rect.height() - option.fontMetrics.height()) / 2, text);
+    painter->restore();
+}
+
+/*
+every row is the same height, so that the view can lay a million of them out without asking each one
+*/
+QSize tffm::EntryDelegate::sizeHint(QStyleOptionViewItem const& option, QModelIndex const&) const {
+    const int iconHeight = _showIcons ? option.decorationSize.height() : 0;
+    return QSize{option.fontMetrics.averageCharWidth() * 40, std::max(option.fontMetrics.height(), iconHeight) + 2 * verticalMargin};
+}
+
+/*
+returns `name` laid out in the option's font, cut short if it's wider than `width`
+*/
+QStaticText tffm::EntryDelegate::layout(QString const& name, int width, QStyleOptionViewItem const& option) const {
+    if (option.font != _layoutFont) {
+        _layouts.clear();
+        _layoutFont = option.font;
+    }
+
+    auto cached = _layouts.object(name);
+    if (cached && (cached->width == width || (cached->width < 0 && cached->naturalWidth <= width))) return cached->text;
+
+    auto layout = new Layout{QStaticText{name}, -1, 0};
+    layout->text.setTextFormat(Qt::PlainText);
+    layout->text.prepare(QTransform{}, option.font);
+    layout->naturalWidth = static_cast<int>(layout->text.size().width());
+    if (layout->naturalWidth > width) {
+        layout->text.setText(option.fontMetrics.elidedText(name, Qt::ElideRight, width));
+        layout->text.prepare(QTransform{}, option.font);
+        layout->width = width;
+    }
+    const auto text = layout->text;
+    _layouts.insert(name, layout);
+    return text;
+}
+
+/*
+returns `icon` rendered at `size`
+*/
+QPixmap tffm::EntryDelegate::pixmap(QIcon const& icon, QSize const& size) const {
+    if (size != _pixmapSize) {
+        _pixmaps.clear();
+        _pixmapSize = size;
+    }
+
+    auto cached = _pixmaps.constFind(icon.cacheKey());
+    if (cached != _pixmaps.constEnd()) return *cached;
+    const auto rendered = icon.pixmap(size);
+    _pixmaps.insert(icon.cacheKey(), rendered);
+    return rendered;
+}
@@ -0,0 +1,97 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef ENTRYDELEGATE_HPP
+#define ENTRYDELEGATE_HPP
+
+// Qt classes
+#include <QCache>
+#include <QFont>
+#include <QHash>
+#include <QPixmap>
+#include <QSize>
+#include <QStaticText>
+#include <QStyledItemDelegate>
+
+namespace tffm { class EntryDelegate; }
+
+/*
+draws the rows of the file list: the icon, the name and, when sizes are shown,
+its `DirectoryModel::SizeRole` right-aligned in a column of its own
+
+Rows are drawn directly rather than through the style's item view element,
+which lays out the text and scales the icon again for every row of every
+frame. Names are laid out once into a `QStaticText` (cut short to fit if
+need be) and kept in a cache, icons are rendered once per icon, and every
+row is the same height, so the view (with uniform item sizes) never has to
+ask for the size of each of a million rows.
+*/
+class tffm::EntryDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+    public:
+        explicit EntryDelegate(QObject* parent = nullptr);
+
+        void paint(QPainter* painter, QStyleOptionViewItem const& option, QModelIndex const& index) const override;
+        QSize sizeHint(QStyleOptionViewItem const& option, QModelIndex const& index) const override;
+
+        bool showsSizes() const { return _showSizes; }
+        void setShowSizes(bool show) { _showSizes = show; }
+
+        bool showsIcons() const { return _showIcons; }
+        void setShowIcons(bool show) { _showIcons = show; }
+        /*  sets whether icons are drawn; rows are shorter without them, so the view must lay them out again */
+
+    private:
+        struct Layout {
+            QStaticText text;
+            int width;          // the width the text was cut short to fit, or -1 if it wasn't
+            int naturalWidth;   // the width of the whole text
+        };
+
+        bool _showSizes;
+        bool _showIcons;
+        mutable QCache<QString, Layout> _layouts;   // by name
+        mutable QFont _layoutFont;                  // the font of `_layouts`
+        mutable QHash<qint64, QPixmap> _pixmaps;    // by icon, at `_pixmapSize`
+        mutable QSize _pixmapSize;
+
+        QStaticText layout(QString const& name, int width, QStyleOptionViewItem const& option) const;
+        /*  returns `name` laid out in the option's font, cut short if it's wider than `width` */
+
+        QPixmap pixmap(QIcon const& icon, QSize const& size) const;
+        /*  returns `icon` rendered at `size` */
+};
+
+#endif // ENTRYDELEGATE_HPP
@@ -0,0 +1,136 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "entrymetadata.hpp"
+
+// standard libraries
+#include <limits>
+
+// system headers
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+tffm::EntryMetadata::EntryMetadata(std::shared_ptr<const DirectoryListing> listing)
+  : _listing{std::move(listing)},
+    _states{new std::atomic<std::uint8_t>[_listing->size()]},
+    _sizes(_listing->size(), 0),
+    _times(_listing->size(), 0),
+    _permissions(_listing->size(), 0),
+    _missing{_listing->size()},
+    _waiters{0} {
+    for (EntryIndex i = 0; i < _listing->size(); ++i) {
+        _states[i].store(Unread, std::memory_order_relaxed);
+    }
+}
+
+tffm::EntryMetadata::EntryMetadata(std::shared_ptr<const DirectoryListing> listing, EntryMetadata const& previous, std::vector<EntryIndex> const& newIndexOf, std::vector<EntryIndex> const& changed)
+  : EntryMetadata{std::move(listing)} {
+    for (std::size_t i = 0; i < newIndexOf.size(); ++i) {
+        const auto n = newIndexOf[i];
+        if (n == std::numeric_limits<EntryIndex>::max() || !previous.isRead(static_cast<EntryIndex>(i))) continue;
+        _sizes[n] = previous._sizes[i];
+        _times[n] = previous._times[i];
+        _permissions[n] = previous._permissions[i];
+        _states[n].store(Read, std::memory_order_relaxed);
+        _missing.fetch_sub(1, std::memory_order_relaxed);
+    }
+    for (auto i : changed) {
+        if (_states[i].load(std::memory_order_relaxed) != Read) continue;
+        _sizes[i] = 0;
+        _times[i] = 0;
+        _permissions[i] = 0;
+        _states[i].store(Unread, std::memory_order_relaxed);
+        _missing.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/*
+reads the metadata of the `count` entries at `entries` that haven't been read (or claimed by another thread)
+*/
+void tffm::EntryMetadata::read(EntryIndex const* entries, std::size_t count) {
+    int dirfd = -1;
+    for (std::size_t n = 0; n < count; ++n) {
+        if (!claim(entries[n])) continue;
+        if (dirfd < 0) dirfd = open(_listing->path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        readClaimed(dirfd, entries[n]);
+    }
+    if (dirfd >= 0) close(dirfd);
+}
+
+/*
+reads the metadata of every entry, and waits for the entries other threads are reading
+*/
+void tffm::EntryMetadata::readAll() {
+    if (missing() == 0) return;
+
+    const int dirfd = open(_listing->path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    for (EntryIndex i = 0; i < _listing->size(); ++i) {
+        if (claim(i)) readClaimed(dirfd, i);
+    }
+    if (dirfd >= 0) close(dirfd);
+
+    // the entries other threads claimed are waited for without spinning; `_missing` only reaches 0 once
+    // they've all been published
+    std::unique_lock<std::mutex> lock{_waitMutex};
+    ++_waiters;
+    _allRead.wait(lock, [this]() { return _missing == 0; });
+    --_waiters;
+}
+
+std::size_t tffm::EntryMetadata::memoryUsage() const {
+    return _listing->size() * sizeof(std::atomic<std::uint8_t>)
+         + _sizes.capacity() * sizeof(std::uint64_t)
+         + _times.capacity() * sizeof(std::int64_t)
+         + _permissions.capacity() * sizeof(std::uint16_t);
+}
+
+/*
+reads entry `i`, which this thread has claimed, and publishes it; an entry that
+can't be `stat`ed (it may be gone already) is left at zero
+*/
+void tffm::EntryMetadata::readClaimed(int dirfd, EntryIndex i) {
+    struct statx st;
+    if (dirfd >= 0 && statx(dirfd, _listing->name(i), AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_MODE | STATX_SIZE | STATX_MTIME, &st) == 0) {
+        _sizes[i] = st.stx_size;
+        _times[i] = static_cast<std::int64_t>(st.stx_mtime.tv_sec) * 1000000000 + st.stx_mtime.tv_nsec;
+        _permissions[i] = static_cast<std::uint16_t>(st.stx_mode & 07777);
+    }
+    _states[i].store(Read, std::memory_order_release);
+    if (--_missing == 0 && _waiters > 0) {
+        // the lock makes sure a thread about to wait sees the count
+        std::lock_guard<std::mutex> lock{_waitMutex};
+        _allRead.notify_all();
+    }
+}
@@ -0,0 +1,119 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef ENTRYMETADATA_HPP
+#define ENTRYMETADATA_HPP
+
+// project headers
+#include "directorylisting.hpp"
+
+// standard libraries
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tffm { class EntryMetadata; }
+
+/*
+the sizes, modification times and permissions of the entries of a
+`DirectoryListing`, read lazily
+
+A listing comes from the directory alone, so nothing here is known until it's
+asked for: entries are `statx`ed with only the fields kept here in the mask,
+and without forcing a network file system to revalidate them, so the rows on
+screen cost a handful of calls instead of one round trip per entry before
+anything is shown. Several threads can read entries at once (say, the visible
+rows and the rest of the directory in the background); each entry is claimed
+by the first thread to get to it.
+*/
+class tffm::EntryMetadata {
+    public:
+        using EntryIndex = DirectoryListing::size_type;
+
+        explicit EntryMetadata(std::shared_ptr<const DirectoryListing> listing);
+
+        EntryMetadata(std::shared_ptr<const DirectoryListing> listing, EntryMetadata const& previous, std::vector<EntryIndex> const& newIndexOf, std::vector<EntryIndex> const& changed);
+        /*  same as above, but keeps what `previous` has already read, where entry `i` of the listing of
+            `previous` is entry `newIndexOf[i]` of `listing` (see `DirectoryListing::assign`), except for
+            the entries of `listing` in `changed`, which are read again */
+
+        EntryMetadata(EntryMetadata const&) = delete;
+        EntryMetadata& operator=(EntryMetadata const&) = delete;
+
+        std::shared_ptr<const DirectoryListing> const& listing() const { return _listing; }
+
+        bool isRead(EntryIndex i) const { return _states[i].load(std::memory_order_acquire) == Read; }
+        /*  returns whether the metadata of entry `i` has been read; it's all zero until then (or if
+            the entry couldn't be `stat`ed) */
+
+        std::uint64_t size(EntryIndex i) const { return isRead(i) ? _sizes[i] : 0; }
+        std::int64_t modificationTime(EntryIndex i) const { return isRead(i) ? _times[i] : 0; }  // in ns since the epoch
+        std::uint16_t permissions(EntryIndex i) const { return isRead(i) ? _permissions[i] : 0; }
+
+        void read(EntryIndex const* entries, std::size_t count);
+        /*  reads the metadata of the `count` entries at `entries` that haven't been read (or claimed by another thread) */
+
+        void readAll();
+        /*  reads the metadata of every entry, and waits for the entries other threads are reading */
+
+        std::size_t missing() const { return _missing.load(std::memory_order_relaxed); }
+        /*  returns the number of entries whose metadata hasn't been read yet */
+
+        std::size_t memoryUsage() const;
+
+    private:
+        enum State : std::uint8_t { Unread, Reading, Read };
+
+        std::shared_ptr<const DirectoryListing> _listing;
+        std::unique_ptr<std::atomic<std::uint8_t>[]> _states;
+        std::vector<std::uint64_t> _sizes;
+        std::vector<std::int64_t> _times;
+        std::vector<std::uint16_t> _permissions;
+        std::atomic<std::size_t> _missing;
+        std::atomic<int> _waiters;              // threads in `readAll` waiting for others to finish
+        std::mutex _waitMutex;
+        std::condition_variable _allRead;
+
+        void readClaimed(int dirfd, EntryIndex i);
+        /*  reads entry `i`, which this thread has claimed, and publishes it */
+
+        bool claim(EntryIndex i) {
+            std::uint8_t expected = Unread;
+            return _states[i].compare_exchange_strong(expected, Reading, std::memory_order_relaxed);
+        }
+};
+
+#endif // ENTRYMETADATA_HPP
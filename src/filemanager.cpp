@@ -32,65 +32,197 @@ License:
 */
 
 #include "filemanager.hpp"
+#include "yankregister.hpp"
+
+#include <algorithm>
 
 #include <QKeyEvent>
+#include <QLocale>
 #include <QScrollBar>
 #include <QKeySequence>
-#include <QDesktopServices>
 #include <QRegularExpression>
 #include <QFileInfo>
 #include <QDir>
 #include <QString>
 #include <QStringList>
 #include <QApplication>
-#include <QClipboard>
-#include <QPair>
 #include <QMessageBox>
+#include <QStandardPaths>
 #include <QDebug>
 
-tffm::FileManager::FileManager(QWidget* parent) : QListView{parent}, _keyBindings{this} {
-    _fsModel = std::make_unique<QFileSystemModel>();
+#include <unistd.h>
+
+namespace {
+
+/*  how long the cursor has to rest on a directory before it's prefetched */
+constexpr int prefetchDelay = 150; // ms
+
+/*  how many of the items about to be removed are listed when asking for confirmation */
+constexpr int maxRemovalsListed = 20;
+
+/*  how many directories `:mem` lists */
+constexpr std::size_t maxFootprintsListed = 8;
+
+/*  the keys `:sort` takes */
+struct SortKeyName {
+    const char* name;
+    tffm::SortKeys::Key key;
+};
+constexpr SortKeyName sortKeyNames[] = {
+    {"name", tffm::SortKeys::Key::Name},
+    {"natural", tffm::SortKeys::Key::Natural},
+    {"size", tffm::SortKeys::Key::Size},
+    {"mtime", tffm::SortKeys::Key::ModificationTime},
+    {"ext", tffm::SortKeys::Key::Extension}
+};
+
+}
+
+tffm::FileManager::FileManager(QWidget* parent) : FileManager{std::make_shared<ListingStore>(), QDir::homePath(), parent} {}
+
+tffm::FileManager::FileManager(std::shared_ptr<ListingStore> store, QString const& path, QWidget* parent)
+  : QListView{parent}, _keyBindings{this} {
+    _fsModel = std::make_unique<DirectoryModel>(std::move(store));
+    _copyEngine = std::make_unique<CopyEngine>();
+    _deleteEngine = std::make_unique<DeleteEngine>();
+    _findEngine = std::make_unique<FindEngine>();
+    _grepEngine = std::make_unique<GrepEngine>();
+    _findResults = std::make_unique<FindResultsModel>();
+    _sizeEngine = std::make_unique<SizeEngine>();
+    _delegate = std::make_unique<EntryDelegate>();
+    _opener = std::make_unique<Opener>();
+    _showingFindResults = false;
+    _findResultsFromGrep = false;
+    _rowAcrossLayoutChange = -1;
+    _sortRequested = false;
+    _confirmRemovals = true;
+    _showingLoadProgress = false;
     _searchPattern = QString{};
+    _searchMode = SearchMode::Prefix;
+    _searchMatchPosition = 0;
     _searchInReverse = false;
+    _searchCaseSensitivity = Qt::CaseInsensitive;
+    _searchMatchesValid = false;
+    _searchWaitingForIndex = false;
 
     // configure widget
     setModel(_fsModel.get());
+    setItemDelegate(_delegate.get());
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setSelectionMode(QAbstractItemView::SingleSelection);
+    setUniformItemSizes(true);
+
+    // TFFM_NO_ICONS=1 starts without icons, as `:icons` leaves them, for slow (remote) displays
+    if (!qEnvironmentVariableIsEmpty("TFFM_NO_ICONS")) showIcons(false);
+
+    // the listing of a directory the cursor rests on is loaded ahead of time
+    _prefetchTimer.setSingleShot(true);
+    _prefetchTimer.setInterval(prefetchDelay);
+    connect(&_prefetchTimer, &QTimer::timeout, this, [this](){ _fsModel->prefetch(_pathToPrefetch); });
+
+    // sizes, times and permissions are read for the rows on screen before the others
+    _metadataTimer.setSingleShot(true);
+    _metadataTimer.setInterval(0);
+    connect(&_metadataTimer, &QTimer::timeout, this, &FileManager::requestVisibleMetadata);
+    const auto scheduleMetadata = [this](){ _metadataTimer.start(); };
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, scheduleMetadata);
+    connect(verticalScrollBar(), &QScrollBar::rangeChanged, this, scheduleMetadata);
+    connect(_fsModel.get(), &DirectoryModel::modelReset, this, scheduleMetadata);
+    connect(_fsModel.get(), &DirectoryModel::layoutChanged, this, scheduleMetadata);
+    connect(_fsModel.get(), &DirectoryModel::directoryLoaded, this, scheduleMetadata);
 
     // configure key bindings
+    _keyBindings.setCountsEnabled(true);
     _keyBindings.add(QKeySequence{Qt::Key_Right}, this, &FileManager::enterSelectedDirectory);
     _keyBindings.add(QKeySequence{Qt::Key_L}, this, &FileManager::enterSelectedDirectory);
 
-    _keyBindings.add(QKeySequence{Qt::Key_J}, this, &FileManager::moveSelectionDown);
-    _keyBindings.add(QKeySequence{Qt::Key_K}, this, &FileManager::moveSelectionUp);
+    _keyBindings.addMotion(QKeySequence{Qt::Key_J}, [this](int count){ moveSelectionDown(count); });
+    _keyBindings.addMotion(QKeySequence{Qt::Key_K}, [this](int count){ moveSelectionUp(count); });
+    _keyBindings.addMotion(QKeySequence{Qt::Key_Down}, [this](int count){ moveSelectionDown(count); });
+    _keyBindings.addMotion(QKeySequence{Qt::Key_Up}, [this](int count){ moveSelectionUp(count); });
 
     _keyBindings.add(QKeySequence{Qt::Key_Left}, this, &FileManager::cdUp);
     _keyBindings.add(QKeySequence{Qt::Key_H}, this, &FileManager::cdUp);
 
-    _keyBindings.add(QKeySequence{Qt::Key_G, Qt::Key_G}, this, &FileManager::moveSelectionTop);
-    _keyBindings.add(QKeySequence{Qt::SHIFT + Qt::Key_G}, this, &FileManager::moveSelectionBottom);
+    // with a count, `gg` and `G` go to that item, as they go to a line in vim
+    _keyBindings.addCounted(QKeySequence{Qt::Key_G, Qt::Key_G}, [this](int count){
+        if (count > 0) moveSelectionTo(count - 1);
+        else moveSelectionTop();
+    });
+    _keyBindings.addCounted(QKeySequence{Qt::SHIFT + Qt::Key_G}, [this](int count){
+        if (count > 0) moveSelectionTo(count - 1);
+        else moveSelectionBottom();
+    });
 
     _keyBindings.add(QKeySequence{Qt::Key_O}, this, &FileManager::openCurrent);
     _keyBindings.add(QKeySequence{Qt::Key_Space}, this, &FileManager::openCurrent);
     _keyBindings.addEnterKeyBinding( [this](){ openCurrent(); } );
 
-    _keyBindings.add(QKeySequence{Qt::Key_N}, this, &FileManager::searchNext);
-    _keyBindings.add(QKeySequence{Qt::SHIFT + Qt::Key_N}, this, &FileManager::searchPrevious);
+    _keyBindings.addMotion(QKeySequence{Qt::Key_N}, [this](int count){ searchNext(count); });
+    _keyBindings.addMotion(QKeySequence{Qt::SHIFT + Qt::Key_N}, [this](int count){ searchPrevious(count); });
 
     _keyBindings.add(QKeySequence{Qt::Key_Period, Qt::Key_Period}, this, &FileManager::toggleHidden);
 
-    _keyBindings.add(QKeySequence{Qt::Key_Y, Qt::Key_Y}, this, &FileManager::copySelected);
+    _keyBindings.addCounted(QKeySequence{Qt::Key_Y, Qt::Key_Y}, [this](int count){ copySelected(std::max(count, 1)); });
     _keyBindings.add(QKeySequence{Qt::Key_P}, this, &FileManager::putCopy);
 
-    _keyBindings.add(QKeySequence{Qt::Key_D, Qt::Key_D}, this, &FileManager::removeSelected);
+    _keyBindings.addCounted(QKeySequence{Qt::Key_D, Qt::Key_D}, [this](int count){ removeSelected(std::max(count, 1)); });
+
+    _keyBindings.add(QKeySequence{Qt::Key_V}, this, &FileManager::toggleVisualMode);
+    _keyBindings.add(QKeySequence{Qt::Key_Escape}, this, &FileManager::deselectAll);
 
     // connect signals to slots
-    connect(_fsModel.get(), &QFileSystemModel::directoryLoaded, this, &FileManager::selectFirstChildIfNeeded);
+    connect(_fsModel.get(), &DirectoryModel::directoryLoaded, this, &FileManager::selectFirstChildIfNeeded);
+    connect(_fsModel.get(), &DirectoryModel::directoryLoading, this, &FileManager::showPartialDirectory);
+    connect(_fsModel.get(), &DirectoryModel::modelAboutToBeReset, this, [this](){
+        _pathAcrossReset = _showingFindResults ? QString{} : _fsModel->filePath(currentIndex());
+    });
+    connect(_fsModel.get(), &DirectoryModel::modelReset, this, [this](){
+        // a directory that's read again keeps its current item
+        _searchMatchesValid = false;
+        auto i = _fsModel->index(_pathAcrossReset);
+        if (i.isValid() && !_showingFindResults) setCurrentIndex(i);
+    });
+    connect(_fsModel.get(), &DirectoryModel::layoutAboutToBeChanged, this, [this](){
+        _rowAcrossLayoutChange = _showingFindResults ? -1 : currentIndex().row();
+    });
+    connect(_fsModel.get(), &DirectoryModel::rowsRemoved, this, [this](){ _searchMatchesValid = false; });
+    connect(_fsModel.get(), &DirectoryModel::rowsInserted, this, [this](){ _searchMatchesValid = false; });
+    connect(_fsModel.get(), &DirectoryModel::layoutChanged, this, [this](){
+        // the current item follows its entry, unless the entry is gone; then its neighbour takes over
+        _searchMatchesValid = false;
+        if (_rowAcrossLayoutChange >= 0 && !currentIndex().isValid() && _fsModel->rowCount() > 0) {
+            setCurrentIndex(_fsModel->index(std::min(_rowAcrossLayoutChange, _fsModel->rowCount() - 1), 0));
+        }
+        _rowAcrossLayoutChange = -1;
+    });
+    connect(_fsModel.get(), &DirectoryModel::searchIndexReady, this, &FileManager::resumeSearch);
+    connect(_fsModel.get(), &DirectoryModel::rowsSorted, this, [this](){
+        _sortSpan.end();
+        if (!_showingFindResults) scrollTo(currentIndex());
+        if (_sortRequested) emit statusChanged(describeSortOrder(), 5000);
+        _sortRequested = false;
+    });
+    connect(_copyEngine.get(), &CopyEngine::progress, this, &FileManager::reportCopyProgress);
+    connect(_copyEngine.get(), &CopyEngine::finished, this, &FileManager::reportCopyFinished);
+    connect(_deleteEngine.get(), &DeleteEngine::itemsRemoved, _fsModel.get(), &DirectoryModel::removeEntries);
+    connect(_deleteEngine.get(), &DeleteEngine::progress, this, &FileManager::reportDeleteProgress);
+    connect(_deleteEngine.get(), &DeleteEngine::finished, this, &FileManager::reportDeleteFinished);
+    connect(_findEngine.get(), &FindEngine::matchesFound, this, &FileManager::addFindResults);
+    connect(_findEngine.get(), &FindEngine::progress, this, &FileManager::reportFindProgress);
+    connect(_findEngine.get(), &FindEngine::finished, this, &FileManager::reportFindFinished);
+    connect(_grepEngine.get(), &GrepEngine::matchesFound, this, &FileManager::addGrepResults);
+    connect(_grepEngine.get(), &GrepEngine::progress, this, &FileManager::reportGrepProgress);
+    connect(_grepEngine.get(), &GrepEngine::finished, this, &FileManager::reportGrepFinished);
+    connect(_sizeEngine.get(), &SizeEngine::sizesComputed, _fsModel.get(), &DirectoryModel::setTreeSizes);
+    connect(_sizeEngine.get(), &SizeEngine::progress, this, &FileManager::reportSizeProgress);
+    connect(_sizeEngine.get(), &SizeEngine::finished, this, &FileManager::reportSizesFinished);
 
-    // move to home directory
-    change_directory(QDir::homePath());
+    // what `:du` finds is kept between sessions
+    _sizeEngine->setCacheFile(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/du.cache"));
+
+    change_directory(path);
 }
 
 void tffm::FileManager::keyPressEvent(QKeyEvent* event) {
@@ -100,12 +232,39 @@ void tffm::FileManager::keyPressEvent(QKeyEvent* event) {
     }
 }
 
-void tffm::FileManager::moveSelectionUp() {
-    moveSelection(QAbstractItemView::MoveUp);
+void tffm::FileManager::paintEvent(QPaintEvent* event) {
+    tracing::Scope scope{tracing::Operation::Paint};
+    QListView::paintEvent(event);
 }
 
-void tffm::FileManager::moveSelectionDown() {
-    moveSelection(QAbstractItemView::MoveDown);
+/*
+schedules a prefetch of the directory under the cursor, once the cursor has rested on it for a moment
+*/
+void tffm::FileManager::currentChanged(QModelIndex const& current, QModelIndex const& previous) {
+    QListView::currentChanged(current, previous);
+
+    _prefetchTimer.stop();
+    if (!_showingFindResults && _fsModel->isDir(current)) {
+        _pathToPrefetch = _fsModel->filePath(current);
+        _prefetchTimer.start();
+    }
+
+    // in visual mode, the selection follows the cursor
+    if (_visualAnchor.isValid() && !_showingFindResults && current.isValid()) {
+        if (_visualCursor.isValid()) {
+            _fsModel->setRowsSelected(std::min(_visualAnchor.row(), _visualCursor.row()), std::max(_visualAnchor.row(), _visualCursor.row()), false);
+        }
+        _fsModel->setRowsSelected(std::min(_visualAnchor.row(), current.row()), std::max(_visualAnchor.row(), current.row()), true);
+        _visualCursor = current;
+    }
+}
+
+void tffm::FileManager::moveSelectionUp(int count) {
+    moveSelectionTo((currentIndex().isValid() ? currentIndex().row() : 0) - count);
+}
+
+void tffm::FileManager::moveSelectionDown(int count) {
+    moveSelectionTo((currentIndex().isValid() ? currentIndex().row() : -1) + count);
 }
 
 void tffm::FileManager::moveSelectionTop() {
@@ -116,7 +275,20 @@ void tffm::FileManager::moveSelectionBottom() {
     moveSelection(QAbstractItemView::MoveEnd);
 }
 
+/*
+makes the item in `row` current, or the first or last one if there's no such row
+*/
+void tffm::FileManager::moveSelectionTo(int row) {
+    const int rows = model()->rowCount(rootIndex());
+    if (rows == 0) return;
+    setCurrentIndex(model()->index(std::max(0, std::min(row, rows - 1)), 0, rootIndex()));
+}
+
 void tffm::FileManager::enterSelectedDirectory() {
+    if (_showingFindResults) {
+        openFindResult();
+        return;
+    }
     if (!_fsModel->isDir(currentIndex())) return;
 
     auto selectedPath = _fsModel->filePath(currentIndex());
@@ -126,46 +298,87 @@ void tffm::FileManager::enterSelectedDirectory() {
 }
 
 void tffm::FileManager::cdUp() {
-    auto i = rootIndex();
+    if (_showingFindResults) {
+        // back to the directory the search was run in
+        showFindResults(false);
+        return;
+    }
+
+    auto previousPath = _fsModel->rootPath();
     auto pwd = _fsModel->rootDirectory();
-    pwd.cdUp();
+    if (!pwd.cdUp()) return;
     change_directory(pwd.absolutePath());
-    setCurrentIndex(i);
+
+    // select the directory we just left once its parent is loaded
+    _pathToSelect = previousPath;
+    updateCurrentIndex(pwd.absolutePath());
 }
 
+/*
+enters the current directory, or opens the selected files (or the current one) with the applications associated
+with them
+
+Selected directories are skipped; the files are opened together, each application being started once for all
+of its files if it can take them.
+*/
 void tffm::FileManager::openCurrent() {
     auto ci = currentIndex();
-    if (_fsModel->isDir(ci)) {
+    if (_showingFindResults) {
+        if (_findResults->isDir(ci)) openFindResult();
+        else if (ci.isValid()) openFiles(QStringList{_findResults->filePath(ci)});
+    }
+    else if (_fsModel->selectedCount() > 0) {
+        auto directory = _fsModel->rootPath();
+        if (!directory.endsWith(QChar('/'))) directory += QChar('/');
+        auto paths = QStringList{};
+        for (auto const& name : _fsModel->selectedNames()) {
+            const auto path = directory + name;
+            if (!QFileInfo{path}.isDir()) paths << path;
+        }
+        deselectAll();
+        if (!paths.isEmpty()) openFiles(paths);
+    }
+    else if (_fsModel->isDir(ci)) {
         enterSelectedDirectory();
     }
-    else {
-        QDesktopServices::openUrl(QUrl{tr("file:///") + _fsModel->filePath(ci)});
+    else if (ci.isValid()) {
+        openFiles(QStringList{_fsModel->filePath(ci)});
     }
 }
 
 /*
-searches forward for the next occurrence of `_searchPattern`
+opens the files at `paths`, reporting what couldn't be
 */
-void tffm::FileManager::searchNext() {
-    auto next = _searchInReverse ? previousSibling : nextSibling;
+void tffm::FileManager::openFiles(QStringList const& paths) {
+    if (!_opener->open(paths)) emit statusChanged(_opener->errorString(), 5000);
+    else if (paths.size() > 1) emit statusChanged(tr("%n item(s) opened", "", paths.size()), 5000);
+}
 
-    // start search from the next node to ignore the current one in case it matches the search
-    auto match = cirularSearch( [this](auto&& i){ return this->indexMatchsSearchPattern(i); }, next(currentIndex()), next);
-    if (match.first) {
-        setCurrentIndex(match.second);
+/*
+searches forward for the next occurrence of `_searchPattern`
+*/
+void tffm::FileManager::searchNext(int count) {
+    for (int i = 0; i < count; ++i) {
+        if (_showingFindResults) {
+            stepFindResults(true);
+            continue;
+        }
+        if (!_searchMatchesValid) updateSearchMatches();
+        selectMatch(!_searchInReverse, false);
     }
 }
 
 /*
 searches backward for the next occurrence of `_searchPattern`
 */
-void tffm::FileManager::searchPrevious() {
-    auto next = _searchInReverse ? nextSibling : previousSibling;
-
-    // start search from the next node to ignore the current one in case it matches the search
-    auto match = cirularSearch( [this](auto&& i){ return this->indexMatchsSearchPattern(i); }, next(currentIndex()), next);
-    if (match.first) {
-        setCurrentIndex(match.second);
+void tffm::FileManager::searchPrevious(int count) {
+    for (int i = 0; i < count; ++i) {
+        if (_showingFindResults) {
+            stepFindResults(false);
+            continue;
+        }
+        if (!_searchMatchesValid) updateSearchMatches();
+        selectMatch(_searchInReverse, false);
     }
 }
 
@@ -173,51 +386,159 @@ void tffm::FileManager::searchPrevious() {
 toggle whether hidden files are shown
 */
 void tffm::FileManager::toggleHidden() {
+    if (_showingFindResults) return;
+
     auto f = QDir::AllEntries | QDir::NoDotAndDotDot | ( _fsModel->filter() & QDir::Hidden ? (QDir::Filter)0x0 : QDir::Hidden);
+    auto currentPath = _fsModel->filePath(currentIndex());
     _fsModel->setFilter(f);
+
+    // the model is reset when its filter changes, so restore the selection
+    auto i = _fsModel->index(currentPath);
+    setCurrentIndex(i.isValid() ? i : _fsModel->index(0, 0));
 }
 
 /*
-copies the path(s) of the currently selected item(s) to the clipboard
+starts (or ends) selecting the items between the current one and the one it was started on
 */
-void tffm::FileManager::copySelected() {
-    auto selection = QStringList{};
-    for (auto&& i : selectedIndexes()) {
-        selection << _fsModel->filePath(i);
+void tffm::FileManager::toggleVisualMode() {
+    if (_visualAnchor.isValid()) {
+        _visualAnchor = QPersistentModelIndex{};
+        _visualCursor = QPersistentModelIndex{};
+        emit statusChanged(tr("%n item(s) selected", "", static_cast<int>(_fsModel->selectedCount())), 5000);
+        return;
     }
+    if (_showingFindResults || !currentIndex().isValid()) return;
 
-    auto clipboard = QApplication::clipboard();
-    clipboard->setText(selection.join(':'));
+    _visualAnchor = currentIndex();
+    _visualCursor = currentIndex();
+    _fsModel->setRowsSelected(currentIndex().row(), currentIndex().row(), true);
+    emit statusChanged(tr("-- VISUAL --"), 0);
 }
 
 /*
-makes copys of the paths in the clipboard in the current directory
+leaves visual mode and deselects everything
 */
-void tffm::FileManager::putCopy() {
-    auto paths = QApplication::clipboard()->text().split(':');
-    auto info = QFileInfo{};
-    for (auto&& path : paths) {
-        info.setFile(path);
-        if (info.exists()) {
-            copyRecursively(info.absoluteFilePath(), _fsModel->rootPath() + QChar('/') + info.fileName());
-        }
+void tffm::FileManager::deselectAll() {
+    if (_visualAnchor.isValid()) emit statusChanged(QString{}, 0);
+    _visualAnchor = QPersistentModelIndex{};
+    _visualCursor = QPersistentModelIndex{};
+    _fsModel->clearSelection();
+}
+
+/*
+returns the names of the selected items or, if there are none, of the current item and the `count - 1` after it
+*/
+QStringList tffm::FileManager::selectedNames(int count) const {
+    if (_fsModel->selectedCount() > 0) return _fsModel->selectedNames();
+    if (!currentIndex().isValid()) return QStringList{};
+
+    auto names = QStringList{};
+    const int last = std::min(currentIndex().row() + count, _fsModel->rowCount()) - 1;
+    for (int row = currentIndex().row(); row <= last; ++row) {
+        names << _fsModel->fileName(_fsModel->index(row, 0));
     }
+    return names;
 }
 
-/*  removes the selected items from the file system */
-void tffm::FileManager::removeSelected() {
-    auto indexes = selectedIndexes();
-    auto paths = QStringList{};
-    for (auto&& i : indexes) {
-        paths << _fsModel->filePath(i);
+/*
+yanks the selected item(s), or the current one and the `count - 1` after it, into the yank register
+*/
+void tffm::FileManager::copySelected(int count) {
+    auto paths = std::make_shared<YankRegister::Paths>();
+    if (_showingFindResults) {
+        // the matches of a `:grep` list a file once per matching line, but it's yanked once
+        const int first = currentIndex().isValid() ? currentIndex().row() : _findResults->rowCount();
+        const int last = std::min(first + count, _findResults->rowCount()) - 1;
+        for (int row = first; row <= last; ++row) {
+            auto path = QFile::encodeName(_findResults->filePath(_findResults->index(row, 0))).toStdString();
+            if (std::find(paths->begin(), paths->end(), path) == paths->end()) paths->push_back(std::move(path));
+        }
+    }
+    else if (_fsModel->selectedCount() > 0) {
+        *paths = _fsModel->selectedNativePaths();
+        deselectAll();
+    }
+    else if (currentIndex().isValid()) {
+        const int last = std::min(currentIndex().row() + count, _fsModel->rowCount()) - 1;
+        for (int row = currentIndex().row(); row <= last; ++row) {
+            paths->push_back(QFile::encodeName(_fsModel->filePath(_fsModel->index(row, 0))).toStdString());
+        }
     }
-    auto message = tr("Are you sure you want to delete:\n  %0").arg(paths.join("\n  "));
-    auto answer = QMessageBox::question(this, "Delete these items?", message);
-    if (answer == QMessageBox::Yes) {
-        for (auto&& i : indexes) {
-            _fsModel->remove(i);
+    if (paths->empty()) return;
+
+    emit statusChanged(tr("%n item(s) yanked", "", static_cast<int>(paths->size())), 5000);
+    YankRegister::instance().set(std::move(paths));
+}
+
+/*
+makes copys of the items in the yank register in the current directory, in the background
+*/
+bool tffm::FileManager::putCopy() {
+    auto paths = YankRegister::instance().paths();
+    if (paths->empty()) return false;
+
+    _copyEngine->start(std::move(paths), QFile::encodeName(_fsModel->rootPath()).toStdString());
+    emit statusChanged(tr("copying..."), 0);
+    return true;
+}
+
+/*
+cancels all copies started by `putCopy` that are still running
+*/
+void tffm::FileManager::cancelCopies() {
+    _copyEngine->cancel();
+}
+
+/*
+stops the running `:find` or `:grep`, keeping the matches found so far
+*/
+void tffm::FileManager::cancelFind() {
+    _findEngine->cancel();
+    _grepEngine->cancel();
+}
+
+/*  removes the selected items from the file system, in the background */
+bool tffm::FileManager::removeSelected(int count) {
+    if (_showingFindResults) return false;
+
+    // however many items are selected, they're confirmed once and removed as a single job
+    auto names = selectedNames(count);
+    if (names.isEmpty()) return false;
+    if (_confirmRemovals) {
+        auto directory = _fsModel->rootPath();
+        if (!directory.endsWith(QChar('/'))) directory += QChar('/');
+        auto paths = QStringList{};
+        for (int i = 0; i < names.size() && i < maxRemovalsListed; ++i) {
+            paths << directory + names[i];
         }
+        auto message = tr("Are you sure you want to delete:\n  %0").arg(paths.join("\n  "));
+        if (names.size() > maxRemovalsListed) message += tr("\n  and %n more", "", names.size() - maxRemovalsListed);
+        auto answer = QMessageBox::question(this, "Delete these items?", message);
+        if (answer != QMessageBox::Yes) return false;
     }
+
+    _removeSpan.begin(tracing::Operation::Remove);
+    // rows are dropped by the model a batch at a time as the items are removed
+    _deleteEngine->start(_fsModel->rootPath(), names);
+    deselectAll();
+    emit statusChanged(tr("deleting..."), 0);
+    return true;
+}
+
+/*
+returns the path of the current item, or an empty string if there's none
+*/
+QString tffm::FileManager::currentPath() const {
+    const auto current = currentIndex();
+    if (!current.isValid()) return QString{};
+    return _showingFindResults ? _findResults->filePath(current) : _fsModel->filePath(current);
+}
+
+/*
+returns whether the current directory is being read or a search is waiting for its index
+*/
+bool tffm::FileManager::isBusy() const {
+    return _fsModel->isLoading() || _searchWaitingForIndex;
 }
 
 /*
@@ -225,28 +546,32 @@ handles a command entery as it's being typed by the user
 */
 void tffm::FileManager::handleCommandUpdate(QString const& command) {
     if (command.isEmpty()) return;
+    tracing::Scope scope{tracing::Operation::Keystroke};
 
     // process `command`
-    if (command[0] == '/' || command[0] == '?') { // if is search command
+    if ((command[0] == '/' || command[0] == '?') && !_showingFindResults) { // if is search command
         _searchPattern = command;
         _searchPattern.remove(0, 1); // remove first character (the '/' or '?')
         _searchInReverse = (command[0] == '?');
+
+        // a leading `~` makes a fuzzy search and a leading `*` a substring search
+        _searchMode = SearchMode::Prefix;
+        if (_searchPattern.startsWith('~')) _searchMode = SearchMode::Fuzzy;
+        else if (_searchPattern.startsWith('*')) _searchMode = SearchMode::Substring;
+        if (_searchMode != SearchMode::Prefix) _searchPattern.remove(0, 1);
         _searchCaseSensitivity = isAllLower(_searchPattern) ? Qt::CaseInsensitive : Qt::CaseSensitive;
 
-        // search for an occurrence of the pattern
-        auto next = _searchInReverse ? previousSibling : nextSibling;
-        auto match = cirularSearch( [this](auto&& i){ return this->indexMatchsSearchPattern(i); }, currentIndex(), next);
-        if (match.first) {
-            setCurrentIndex(match.second);
-        }
+        // search for an occurrence of the pattern, starting with the current item
+        updateSearchMatches();
+        selectMatch(!_searchInReverse, true);
     }
 }
 
 /*
 handles a command entered by the user
 */
-void tffm::FileManager::handleCommand(const QString& command) {
-    if (command.isEmpty()) return;
+bool tffm::FileManager::handleCommand(const QString& command) {
+    if (command.isEmpty()) return false;
 
     // process `command`
     if (command.startsWith(":cd")) {   // if is cd command
@@ -255,82 +580,624 @@ void tffm::FileManager::handleCommand(const QString& command) {
         QDir dir = _fsModel->rootDirectory();
         if (dir.cd(path)) {
             auto path = dir.absolutePath();
+            showFindResults(false);
             change_directory(path);
             updateCurrentIndex(path);
         }
         else {
-            qDebug() << "error:" << path << "does not exist";
+            emit statusChanged(tr("%0 does not exist").arg(path), 5000);
+            return false;
+        }
+    }
+    else if (command.startsWith(":find ")) {
+        find(command.mid(6).trimmed());
+    }
+    else if (command.startsWith(":grep ")) {
+        return grep(command.mid(6).trimmed());
+    }
+    else if (command.startsWith(":coalesce")) {
+        bool ok = false;
+        const auto milliseconds = command.mid(9).trimmed().toInt(&ok);
+        if (ok && milliseconds >= 0) _fsModel->setCoalescingWindow(milliseconds);
+        emit statusChanged(tr("changes are applied every %0 ms").arg(_fsModel->coalescingWindow()), 5000);
+    }
+    else if (command.startsWith(":iodepth")) {
+        bool ok = false;
+        const auto depth = command.mid(8).trimmed().toInt(&ok);
+        if (ok && depth >= 0) _copyEngine->setQueueDepth(depth);
+        if (_copyEngine->usesIoUring()) {
+            emit statusChanged(tr("copies keep up to %0 requests in flight with io_uring").arg(_copyEngine->queueDepth()), 5000);
+        }
+        else {
+            emit statusChanged(_copyEngine->queueDepth() > 0 ? tr("io_uring isn't available, copies use a thread pool") : tr("copies use a thread pool"), 5000);
         }
     }
+    else if (command.startsWith(":sort")) {
+        sort(command.mid(5));
+    }
+    else if (command.startsWith(":stats")) {
+        reportLatencies(command.mid(6));
+    }
+    else if (command.startsWith(":trace")) {
+        trace(command.mid(6));
+    }
+    else if (command.startsWith(":select")) {
+        return selectMatching(command.mid(7).trimmed(), true);
+    }
+    else if (command.startsWith(":deselect")) {
+        return selectMatching(command.mid(9).trimmed(), false);
+    }
+    else if (command.startsWith(":du")) {
+        const auto arguments = command.mid(3).trimmed();
+        if (_showingFindResults || !(arguments.isEmpty() || arguments == QLatin1String("!"))) return false;
+        du(arguments.isEmpty());
+    }
+    else if (command.simplified() == ":sizes") {
+        showSizes(!_delegate->showsSizes());
+    }
+    else if (command.simplified() == ":icons") {
+        showIcons(!_delegate->showsIcons());
+    }
+    else if (command.simplified() == ":export") {
+        YankRegister::instance().exportToClipboard();
+        emit statusChanged(tr("%n item(s) put in the clipboard", "", static_cast<int>(YankRegister::instance().paths()->size())), 5000);
+    }
+    else if (command.simplified() == ":import") {
+        if (!YankRegister::instance().importFromClipboard()) {
+            emit statusChanged(tr("the clipboard has no files"), 5000);
+            return false;
+        }
+        emit statusChanged(tr("%n item(s) yanked", "", static_cast<int>(YankRegister::instance().paths()->size())), 5000);
+    }
+    else if (command.simplified() == ":cache") {
+        reportCacheStatistics();
+    }
+    else if (command.startsWith(":mem")) {
+        const auto arguments = command.mid(4).trimmed();
+        bool ok = arguments.isEmpty();
+        const auto mebibytes = ok ? 0 : arguments.toLongLong(&ok);
+        if (!ok || mebibytes < 0) return false;
+        if (!arguments.isEmpty()) _fsModel->setMemoryBudget(static_cast<std::size_t>(mebibytes) << 20);
+        reportMemory();
+    }
+    else if (command.simplified() == ":cancel") {
+        cancelCopies();
+        cancelFind();
+        _sizeEngine->cancel();
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/*
+selects (or deselects) the items of the current directory whose names match the wildcard `pattern`
+*/
+bool tffm::FileManager::selectMatching(QString const& pattern, bool select) {
+    if (_showingFindResults) return false;
+    if (pattern.isEmpty() && !select) {
+        deselectAll();
+        return true;
+    }
+
+    const auto matches = _fsModel->setMatchingSelected(pattern.isEmpty() ? QStringLiteral("*") : pattern, select);
+    if (matches == 0) {
+        emit statusChanged(tr("nothing matches %0").arg(pattern), 5000);
+        return false;
+    }
+    emit statusChanged(tr("%n item(s) selected", "", static_cast<int>(_fsModel->selectedCount())), 5000);
+    return true;
 }
 
 void tffm::FileManager::moveSelection(QAbstractItemView::CursorAction action) {
     setCurrentIndex(moveCursor(action, Qt::NoModifier));
 }
 
+/*
+finds the rows matching `_searchPattern`, narrowing the previous matches when possible
+
+While a pattern is being typed, each keystroke usually appends a character to
+it, so its matches are a sub-range of those of the previous pattern.
+*/
+void tffm::FileManager::updateSearchMatches() {
+    auto index = _fsModel->searchIndex();
+    if (!index) {
+        // the index is still being built; `resumeSearch` picks up from here once it's ready
+        _fsModel->requestSearchIndex();
+        _searchMatches.clear();
+        _searchMatchesValid = false;
+        _searchWaitingForIndex = true;
+        return;
+    }
+    _searchWaitingForIndex = false;
+
+    const bool caseInsensitive = _searchCaseSensitivity == Qt::CaseInsensitive;
+    auto key = caseInsensitive ? SearchIndex::foldedKey(_searchPattern) : SearchIndex::exactKey(_searchPattern);
+    if (_searchMode != SearchMode::Prefix) {
+        // these scan every name, which the vectorized kernels make cheap enough to redo on each keystroke
+        if (key.empty()) _searchMatches.clear();
+        else if (_searchMode == SearchMode::Substring) _searchMatches = _fsModel->rowsMatching(index->substringMatches(key, caseInsensitive));
+        else _searchMatches = _fsModel->rowsMatching(index->fuzzyMatches(key, caseInsensitive));
+        _searchKey.clear(); // so the next prefix search doesn't try to narrow these matches
+        _searchMatchPosition = 0;
+        _searchMatchesValid = true;
+        return;
+    }
+
+    const bool extendsPreviousKey = _searchMatchesValid
+                                 && !_searchKey.empty()
+                                 && _searchRange.caseInsensitive == caseInsensitive
+                                 && key.compare(0, _searchKey.size(), _searchKey) == 0;
+    _searchRange = extendsPreviousKey ? index->narrow(_searchRange, key) : index->find(key, caseInsensitive);
+    _searchKey = std::move(key);
+    _searchMatches = _fsModel->rowsMatching(_searchRange);
+    _searchMatchesValid = true;
+}
+
+/*
+runs the search that was started before the search index was ready, if any
+*/
+void tffm::FileManager::resumeSearch() {
+    if (!_searchWaitingForIndex) return;
+
+    updateSearchMatches();
+    selectMatch(!_searchInReverse, true);
+}
+
+/*
+selects the closest match of `_searchPattern` after (or before) the current row, wrapping around
+*/
+void tffm::FileManager::selectMatch(bool forward, bool includeCurrent) {
+    if (_searchWaitingForIndex) return; // `resumeSearch` comes back here
+    if (_searchMatches.empty()) {
+        emit searchFinished(false);
+        return;
+    }
+    tracing::Scope scope{tracing::Operation::Search};
+
+    const auto row = currentIndex().row();
+    int match;
+    if (_searchMode != SearchMode::Prefix) {
+        // matches are ranked, so step through them in rank order starting from the best one
+        const auto count = _searchMatches.size();
+        if (includeCurrent) {
+            _searchMatchPosition = 0;
+        }
+        else {
+            if (_searchMatchPosition >= count || _searchMatches[_searchMatchPosition] != row) {
+                // the selection moved since the last match was picked
+                auto i = std::find(_searchMatches.begin(), _searchMatches.end(), row);
+                _searchMatchPosition = i != _searchMatches.end() ? static_cast<std::size_t>(i - _searchMatches.begin()) : (forward ? count - 1 : 0);
+            }
+            _searchMatchPosition = forward ? (_searchMatchPosition + 1) % count : (_searchMatchPosition + count - 1) % count;
+        }
+        match = _searchMatches[_searchMatchPosition];
+    }
+    else if (forward) {
+        auto i = includeCurrent ? std::lower_bound(_searchMatches.begin(), _searchMatches.end(), row)
+                                : std::upper_bound(_searchMatches.begin(), _searchMatches.end(), row);
+        match = i != _searchMatches.end() ? *i : _searchMatches.front();
+    }
+    else {
+        auto i = includeCurrent ? std::upper_bound(_searchMatches.begin(), _searchMatches.end(), row)
+                                : std::lower_bound(_searchMatches.begin(), _searchMatches.end(), row);
+        match = i != _searchMatches.begin() ? *(i - 1) : _searchMatches.back();
+    }
+    setCurrentIndex(_fsModel->index(match, 0));
+    emit searchFinished(true);
+}
+
 /*
 changes the directory being displayed to `path`
 */
 void tffm::FileManager::change_directory(QString const& path) {
+    // the read of the directory being left, if it's still going, is cancelled along with its progress
+    if (_showingLoadProgress) {
+        _showingLoadProgress = false;
+        emit statusChanged(QString{}, 0);
+    }
+    _loadSpan.begin(tracing::Operation::ChangeDirectory);
     auto rootIndex = _fsModel->setRootPath(path);
     setRootIndex(rootIndex);
 }
 
+void tffm::FileManager::reportCopyProgress(qint64 bytesPerSecond, qint64 filesLeft) {
+    auto message = tr("copying: %0 files left, %1/s").arg(filesLeft).arg(QLocale{}.formattedDataSize(bytesPerSecond));
+    emit statusChanged(message, 0);
+}
+
+void tffm::FileManager::reportCopyFinished(qint64 filesCopied, QStringList const& errors, bool cancelled) {
+    auto message = cancelled ? tr("copy cancelled after %0 files").arg(filesCopied) : tr("copied %0 files").arg(filesCopied);
+    if (!errors.isEmpty()) {
+        message += tr(" (%0 errors, first: %1)").arg(errors.size()).arg(errors.first());
+        for (auto&& error : errors) {
+            qDebug() << "error:" << error;
+        }
+    }
+    emit statusChanged(message, 5000);
+    emit copyFinished(filesCopied, errors, cancelled);
+}
+
+void tffm::FileManager::reportDeleteProgress(qint64 entriesRemoved) {
+    emit statusChanged(tr("deleting: %0 entries removed").arg(entriesRemoved), 0);
+}
+
+void tffm::FileManager::reportDeleteFinished(qint64 itemsRemoved, QStringList const& errors) {
+    auto message = tr("deleted %0 items").arg(itemsRemoved);
+    if (!errors.isEmpty()) {
+        message += tr(" (%0 errors, first: %1)").arg(errors.size()).arg(errors.first());
+        for (auto&& error : errors) {
+            qDebug() << "error:" << error;
+        }
+    }
+    emit statusChanged(message, 5000);
+    _removeSpan.end();
+    emit removeFinished(itemsRemoved, errors);
+}
+
 /*
-copies a file system item from `src` to `dest`, recursively if needed
+searches the tree under the current directory for `pattern` and shows the matches as they come
 */
-bool tffm::FileManager::copyRecursively(QString const& src, QString const& dest) {
-    QList<QPair<QString,QString>> copyops;
-    copyops.push_back(qMakePair(src, dest));
-    QFileInfo srcInfo;
-    while (!copyops.empty()) {
-        auto op = copyops.back();
-        copyops.pop_back();
-        srcInfo.setFile(op.first);
-        if (srcInfo.isFile()) {
-            if (!QFile::copy(op.first, op.second)) {
-                return false;
-            }
-        }
-        else if (srcInfo.isDir()) {
-            QDir targetDir{op.second};
-            targetDir.cdUp();
-            if (!targetDir.mkdir(QFileInfo(op.second).fileName())) {
-                return false;
-            }
-            QDir sourceDir{op.first};
-            auto fileNames = sourceDir.entryList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
-            for (auto&& fileName : fileNames) {
-                const QString newsrc = src + QChar('/') + fileName;
-                const QString newdest = dest + QChar('/') + fileName;
-                copyops.push_front(qMakePair(newsrc, newdest));
-            }
+void tffm::FileManager::find(QString const& pattern) {
+    if (pattern.isEmpty()) return;
+
+    const auto root = _showingFindResults ? _findResults->rootPath() : _fsModel->rootPath();
+    _grepEngine->cancel();
+    _findResults->reset(root);
+    _findResultsFromGrep = false;
+    showFindResults(true);
+    const auto caseSensitivity = isAllLower(pattern) ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    _findEngine->start(root, pattern, caseSensitivity, _fsModel->filter().testFlag(QDir::Hidden));
+    emit statusChanged(tr("finding..."), 0);
+}
+
+/*
+searches the contents of the files under the current directory for `pattern` and shows the matching
+lines as they come
+
+As with `:find`, the search is case-insensitive unless `pattern` has capital letters.
+*/
+bool tffm::FileManager::grep(QString const& pattern) {
+    if (pattern.isEmpty()) return false;
+
+    const auto root = _showingFindResults ? _findResults->rootPath() : _fsModel->rootPath();
+    const auto caseSensitivity = isAllLower(pattern) ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    if (!_grepEngine->start(root, pattern, caseSensitivity, _fsModel->filter().testFlag(QDir::Hidden))) {
+        emit statusChanged(tr("%0 is not a valid regular expression").arg(pattern), 5000);
+        return false;
+    }
+    _findEngine->cancel();
+    _findResults->reset(root);
+    _findResultsFromGrep = true;
+    showFindResults(true);
+    emit statusChanged(tr("searching..."), 0);
+    return true;
+}
+
+/*
+moves to the next (or previous) match of a `:find` or `:grep`, wrapping around
+*/
+void tffm::FileManager::stepFindResults(bool forward) {
+    const int rows = _findResults->rowCount();
+    if (rows == 0) {
+        emit searchFinished(false);
+        return;
+    }
+
+    const int row = currentIndex().isValid() ? currentIndex().row() : (forward ? -1 : 0);
+    setCurrentIndex(_findResults->index((row + (forward ? 1 : rows - 1)) % rows, 0));
+    emit searchFinished(true);
+}
+
+/*
+switches the view between the find results and the current directory
+*/
+void tffm::FileManager::showFindResults(bool show) {
+    if (show == _showingFindResults) return;
+
+    if (show) _pathBeforeFind = _fsModel->filePath(currentIndex());
+    _showingFindResults = show;
+
+    // `setModel` replaces the selection model without deleting the old one
+    auto oldSelectionModel = selectionModel();
+    if (show) {
+        setModel(_findResults.get());
+        setCurrentIndex(_findResults->index(0, 0));
+    }
+    else {
+        setModel(_fsModel.get());
+        auto i = _fsModel->index(_pathBeforeFind);
+        setCurrentIndex(i.isValid() ? i : _fsModel->index(0, 0));
+    }
+    delete oldSelectionModel;
+}
+
+/*
+leaves the find results for the directory of the current match, selecting it
+*/
+void tffm::FileManager::openFindResult() {
+    const auto ci = currentIndex();
+    if (!ci.isValid()) return;
+
+    const auto path = _findResults->filePath(ci);
+    const bool isDir = _findResults->isDir(ci);
+    showFindResults(false);
+    if (isDir) {
+        change_directory(path);
+        updateCurrentIndex(path);
+    }
+    else {
+        const auto directory = QFileInfo{path}.absolutePath();
+        change_directory(directory);
+        _pathToSelect = path;
+        updateCurrentIndex(directory);
+    }
+}
+
+void tffm::FileManager::addFindResults(QStringList const& paths) {
+    if (_findResultsFromGrep) return; // the last matches of a cancelled `:find`
+    const bool wasEmpty = _findResults->rowCount() == 0;
+    _findResults->append(paths);
+    if (wasEmpty && _showingFindResults) setCurrentIndex(_findResults->index(0, 0));
+}
+
+void tffm::FileManager::addGrepResults(QStringList const& paths, QVector<qint64> const& lines, QStringList const& texts) {
+    if (!_findResultsFromGrep) return; // the last matches of a cancelled `:grep`
+    const bool wasEmpty = _findResults->rowCount() == 0;
+    _findResults->append(paths, lines, texts);
+    if (wasEmpty && _showingFindResults) setCurrentIndex(_findResults->index(0, 0));
+}
+
+void tffm::FileManager::reportFindProgress(qint64 directoriesRead, qint64 matches) {
+    emit statusChanged(tr("finding: %0 matches in %1 directories").arg(matches).arg(directoriesRead), 0);
+}
+
+void tffm::FileManager::reportFindFinished(qint64 directoriesRead, qint64 matches, bool cancelled) {
+    auto message = cancelled ? tr("find cancelled: %0 matches in %1 directories") : tr("found %0 matches in %1 directories");
+    emit statusChanged(message.arg(matches).arg(directoriesRead), 5000);
+}
+
+void tffm::FileManager::reportGrepProgress(qint64 filesScanned, qint64 matches) {
+    emit statusChanged(tr("searching: %0 matching lines in %1 files").arg(matches).arg(filesScanned), 0);
+}
+
+void tffm::FileManager::reportGrepFinished(qint64 filesScanned, qint64 matches, bool cancelled) {
+    auto message = cancelled ? tr("search cancelled: %0 matching lines in %1 files") : tr("found %0 matching lines in %1 files");
+    emit statusChanged(message.arg(matches).arg(filesScanned), 5000);
+}
+
+/*
+computes the space taken by the current directory and each of its sub-directories, and shows sizes
+*/
+void tffm::FileManager::du(bool useCache) {
+    showSizes(true);
+    _sizeEngine->start(_fsModel->rootPath(), useCache);
+    emit statusChanged(tr("computing sizes..."), 0);
+}
+
+void tffm::FileManager::reportSizeProgress(qint64 directoriesRead, qint64 bytes) {
+    emit statusChanged(tr("computing sizes: %0 in %1 directories").arg(QLocale{}.formattedDataSize(bytes)).arg(directoriesRead), 0);
+}
+
+void tffm::FileManager::reportSizesFinished(QString const& root, qint64 bytes, qint64 directoriesRead, bool cancelled) {
+    if (cancelled) {
+        emit statusChanged(tr("size computation cancelled"), 5000);
+        return;
+    }
+    emit statusChanged(tr("%0: %1 in %2 directories").arg(root).arg(QLocale{}.formattedDataSize(bytes)).arg(directoriesRead), 10000);
+}
+
+void tffm::FileManager::showSizes(bool show) {
+    _delegate->setShowSizes(show);
+    viewport()->update();
+}
+
+/*
+shows or hides the icons; without them, rows are shorter and no icon or MIME type is ever looked up
+*/
+void tffm::FileManager::showIcons(bool show) {
+    _fsModel->setShowIcons(show);
+    _delegate->setShowIcons(show);
+    doItemsLayout();
+}
+
+void tffm::FileManager::reportCacheStatistics() {
+    const auto statistics = _fsModel->cacheStatistics();
+    auto message = tr("listing cache: %0 hits, %1 misses (%2 prefetched, %3 of them used), %4 directories in %5 of %6")
+        .arg(statistics.hits).arg(statistics.misses).arg(statistics.prefetches).arg(statistics.prefetchHits)
+        .arg(static_cast<qint64>(statistics.entries))
+        .arg(QLocale{}.formattedDataSize(static_cast<qint64>(statistics.bytes)))
+        .arg(QLocale{}.formattedDataSize(static_cast<qint64>(statistics.memoryBudget)));
+    emit statusChanged(message, 10000);
+}
+
+/*
+shows what the listings of the shown and cached directories take, biggest first
+
+The resident size of the whole process comes first, for comparison: listings
+are most of it in a big tree, but not all of it.
+*/
+void tffm::FileManager::reportMemory() {
+    const auto size = [](std::size_t bytes) { return QLocale{}.formattedDataSize(static_cast<qint64>(bytes)); };
+    auto parts = QStringList{};
+
+    auto statm = QFile{QStringLiteral("/proc/self/statm")};
+    if (statm.open(QIODevice::ReadOnly)) {
+        const auto pages = statm.readAll().split(' ').value(1).toLongLong();
+        parts << tr("resident %0").arg(size(static_cast<std::size_t>(pages) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE))));
+    }
+
+    const auto footprints = _fsModel->memoryFootprints();
+    std::size_t shownBytes = 0, cachedBytes = 0;
+    int shown = 0;
+    for (auto&& footprint : footprints) {
+        if (footprint.views > 0) {
+            shownBytes += footprint.bytes;
+            ++shown;
         }
         else {
-            return false;
+            cachedBytes += footprint.bytes;
         }
     }
-    return true;
+    const auto statistics = _fsModel->cacheStatistics();
+    parts << tr("%n directories shown in %0", "", shown).arg(size(shownBytes))
+          << tr("%n cached in %0 of %1", "", static_cast<int>(footprints.size()) - shown).arg(size(cachedBytes)).arg(size(_fsModel->memoryBudget()))
+          << tr("%0 evicted, %1 expired").arg(statistics.evictions).arg(statistics.expirations);
+
+    for (std::size_t i = 0; i < footprints.size() && i < maxFootprintsListed; ++i) {
+        auto const& footprint = footprints[i];
+        const auto use = footprint.views > 0 ? tr("shown in %n pane(s)", "", footprint.views)
+                                             : tr("idle %n min", "", static_cast<int>(footprint.idle.count() / 60));
+        parts << tr("%0 %1 (%2)").arg(QFile::decodeName(footprint.path.c_str())).arg(size(footprint.bytes)).arg(use);
+    }
+    emit statusChanged(parts.join(QStringLiteral(" | ")), 20000);
+}
+
+/*
+shows the latency statistics of the traced operations, or resets them if `arguments` is "reset"
+*/
+void tffm::FileManager::reportLatencies(QString const& arguments) {
+    if (arguments.trimmed() == QLatin1String("reset")) {
+        tracing::reset();
+        emit statusChanged(tr("latency statistics reset"), 5000);
+        return;
+    }
+
+    const auto milliseconds = [](double ms) { return QString::number(ms, 'g', 3); };
+    auto parts = QStringList{};
+    for (auto&& summary : tracing::summaries()) {
+        parts << tr("%0 %1x: p50 %2, p90 %3, p99 %4, max %5 ms")
+            .arg(QString::fromLatin1(tracing::name(summary.operation))).arg(summary.count)
+            .arg(milliseconds(summary.p50)).arg(milliseconds(summary.p90)).arg(milliseconds(summary.p99)).arg(milliseconds(summary.max));
+    }
+    emit statusChanged(parts.isEmpty() ? tr("nothing has been measured yet") : parts.join(QStringLiteral(" | ")), 20000);
+}
+
+/*
+starts writing a trace to the file `arguments` or, if it's "off", stops
+*/
+void tffm::FileManager::trace(QString const& arguments) {
+    const auto path = arguments.trimmed();
+    if (path.isEmpty()) {
+        emit statusChanged(tracing::isTracing() ? tr("tracing is on") : tr("tracing is off"), 5000);
+    }
+    else if (path == QLatin1String("off")) {
+        tracing::stopTrace();
+        emit statusChanged(tr("tracing is off"), 5000);
+    }
+    else if (tracing::startTrace(QFile::encodeName(QDir{}.absoluteFilePath(path)).toStdString())) {
+        emit statusChanged(tr("tracing to %0").arg(QDir{}.absoluteFilePath(path)), 5000);
+    }
+    else {
+        emit statusChanged(tr("can't write a trace to %0").arg(path), 5000);
+    }
+}
+
+/*
+sorts the current directory as `arguments` (a key, optionally followed by "reverse") says
+*/
+void tffm::FileManager::sort(QString const& arguments) {
+    if (arguments.simplified().isEmpty()) {
+        emit statusChanged(describeSortOrder(), 5000);
+        return;
+    }
+
+    auto order = _fsModel->sortOrder();
+    const auto words = arguments.simplified().split(QChar(' '));
+
+    bool known = false;
+    for (auto&& name : sortKeyNames) {
+        if (words[0] == QLatin1String(name.name)) {
+            order.key = name.key;
+            known = true;
+        }
+    }
+    if (!known || words.size() > 2 || (words.size() == 2 && words[1] != QLatin1String("reverse"))) {
+        emit statusChanged(tr("usage: sort name|natural|size|mtime|ext [reverse]"), 5000);
+        return;
+    }
+    order.reversed = words.size() == 2;
+
+    _sortRequested = true;
+    _sortSpan.begin(tracing::Operation::Sort);
+    if (SortKeys::usesMetadata(order.key)) emit statusChanged(tr("sorting..."), 0);
+    _fsModel->setSortOrder(order);
+}
+
+QString tffm::FileManager::describeSortOrder() const {
+    const auto order = _fsModel->sortOrder();
+    auto keyName = QString{};
+    for (auto&& name : sortKeyNames) {
+        if (name.key == order.key) keyName = QString::fromLatin1(name.name);
+    }
+    return order.reversed ? tr("sorted by %0, reversed").arg(keyName) : tr("sorted by %0").arg(keyName);
+}
+
+void tffm::FileManager::requestVisibleMetadata() {
+    if (_showingFindResults || _fsModel->rowCount() == 0) return;
+
+    const auto first = indexAt(viewport()->rect().topLeft());
+    const auto last = indexAt(viewport()->rect().bottomLeft());
+    _fsModel->requestMetadata(first.isValid() ? first.row() : 0, last.isValid() ? last.row() : _fsModel->rowCount() - 1);
 }
 
 void tffm::FileManager::updateCurrentIndex(QString const& currentPath) {
     // row count is only 0 if current directory hasn't
     // been loaded yet or if it's empty; assume the first
-    if (_fsModel->rowCount(rootIndex()) == 0) {
-        _pathWaitingToBeLoaded = currentPath;
+    if (_fsModel->rowCount() == 0) {
+        _pathWaitingToBeLoaded = QDir::cleanPath(currentPath);
     }
     else {
-        setCurrentIndex(rootIndex().child(0,0));
+        auto i = _fsModel->index(_pathToSelect);
+        setCurrentIndex(i.isValid() ? i : _fsModel->index(0, 0));
+        _pathToSelect = QString{};
     }
 }
 
 void tffm::FileManager::selectFirstChildIfNeeded(const QString& path) {
+    if (path == _fsModel->rootPath()) _loadSpan.end();
+    tracing::Scope scope{tracing::Operation::SelectFirst};
+
     if (path == _pathWaitingToBeLoaded) {
-        auto pathIndex = _fsModel->index(path);
-        if (_fsModel->rowCount(pathIndex) > 0) { // not strictly required but doesn't hurt
-            _fsModel->sort(0);
-            setCurrentIndex(pathIndex.child(0,0));
-            _pathWaitingToBeLoaded = QString{};
+        // the model keeps its rows sorted, so there's no need to sort here; an item picked while the
+        // directory was being read stays current, unless the one to select has only come now
+        if (_fsModel->rowCount() > 0 && !_showingFindResults) {
+            auto i = _fsModel->index(_pathToSelect);
+            if (i.isValid() || !currentIndex().isValid()) setCurrentIndex(i.isValid() ? i : _fsModel->index(0, 0));
+        }
+        _pathWaitingToBeLoaded = QString{};
+        _pathToSelect = QString{};
+    }
+    if (path == _fsModel->rootPath() && !_fsModel->isLoading()) {
+        if (_showingLoadProgress) {
+            _showingLoadProgress = false;
+            emit statusChanged(tr("%0: %n item(s)", "", _fsModel->rowCount()).arg(path), 3000);
+        }
+        emit directoryLoaded(path);
+    }
+}
+
+/*
+selects an item among the rows of a directory that's still being read, and says how far the read is
+
+The item to select (the directory `h` came from, say) is selected as soon as
+it shows up; until then, the first row is, so that there's something to move
+from. `selectFirstChildIfNeeded` finishes the job once the directory is read.
+*/
+void tffm::FileManager::showPartialDirectory(QString const& path, int entriesRead) {
+    if (path != _fsModel->rootPath()) return;
+
+    if (path == _pathWaitingToBeLoaded && _fsModel->rowCount() > 0 && !_showingFindResults) {
+        auto i = _fsModel->index(_pathToSelect);
+        if (i.isValid()) {
+            setCurrentIndex(i);
+            _pathToSelect = QString{};
+        }
+        else if (!currentIndex().isValid()) {
+            setCurrentIndex(_fsModel->index(0, 0));
         }
     }
+    _showingLoadProgress = true;
+    emit statusChanged(tr("reading %0: %n item(s) so far", "", entriesRead).arg(path), 0);
 }
@@ -35,16 +35,30 @@ License:
 #define FILEMANAGER_HPP
 
 // project headers
+#include "copyengine.hpp"
+#include "deleteengine.hpp"
+#include "directorymodel.hpp"
+#include "entrydelegate.hpp"
+#include "findengine.hpp"
+#include "findresultsmodel.hpp"
+#include "grepengine.hpp"
 #include "keybindingtable.hpp"
+#include "opener.hpp"
+#include "sizeengine.hpp"
+#include "tracing.hpp"
 
 // standard libraries
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 // Qt classes
 #include <QListView>
-#include <QFileSystemModel>
+#include <QPersistentModelIndex>
 #include <QString>
+#include <QStringList>
+#include <QTimer>
 
 namespace tffm { class FileManager; }
 
@@ -53,84 +67,240 @@ class tffm::FileManager : public QListView {
 
     public:
         explicit FileManager(QWidget* parent = nullptr);
+        /*  makes a file manager showing the home directory, with a listing store of its own */
 
-        void moveSelectionUp();
-        void moveSelectionDown();
+        FileManager(std::shared_ptr<ListingStore> store, QString const& path, QWidget* parent = nullptr);
+        /*  makes a file manager showing the directory at `path`, whose directories are read through `store`
+            (which the other panes of the window share) */
+
+        void moveSelectionUp(int count = 1);
+        void moveSelectionDown(int count = 1);
         void moveSelectionTop();
         void moveSelectionBottom();
 
+        void moveSelectionTo(int row);
+        /*  makes the item in `row` current, or the first or last one if there's no such row */
+
         void enterSelectedDirectory();
         void cdUp();
 
         void openCurrent();
+        /*  enters the current directory, or opens the selected files (or the current one) with the
+            applications associated with them */
 
-        void searchNext();
-        /*  searches for the next occurrence of `_searchPattern` */
+        void searchNext(int count = 1);
+        /*  searches for the `count`th next occurrence of `_searchPattern`, or moves to the `count`th next match
+            of a `:find` or `:grep` while they're shown */
 
-        void searchPrevious();
-        /*  searches for the previous occurrence of `_searchPattern` */
+        void searchPrevious(int count = 1);
+        /*  searches for the `count`th previous occurrence of `_searchPattern`, or moves to the previous match */
 
         void toggleHidden();
         /*  toggle whether hidden files are shown */
 
-        void copySelected();
-        /*  copies the path(s) of the currently selected item(s) to the clipboard */
+        void toggleVisualMode();
+        /*  starts selecting the items between the current one and the one it was started on, as the
+            cursor moves, or stops (keeping the selection) */
+
+        void deselectAll();
+        /*  leaves visual mode and deselects everything */
+
+        void copySelected(int count = 1);
+        /*  yanks the selected item(s), or the current one and the `count - 1` after it, into the yank register */
+
+        bool putCopy();
+        /*  makes copys of the items in the yank register in the current directory, in the background;
+            returns whether there was anything to copy */
+
+        void cancelCopies();
+        /*  cancels all copies started by `putCopy` that are still running */
+
+        void cancelFind();
+        /*  stops the running `:find` or `:grep`, keeping the matches found so far */
 
-        void putCopy();
-        /*  makes copys of the paths in the clipboard in the current directory */
+        bool removeSelected(int count = 1);
+        /*  removes the selected items (or the current one and the `count - 1` after it) from the file system,
+            in the background; returns whether anything is being removed */
 
-        void removeSelected();
-        /*  removes the selected items from the file system */
+        void setConfirmRemovals(bool confirm) { _confirmRemovals = confirm; }
+        /*  sets whether `removeSelected` asks before removing anything (it does by default) */
+
+        QString currentPath() const;
+        /*  returns the path of the current item, or an empty string if there's none */
+
+        QString directoryPath() const { return _fsModel->rootPath(); }
+        /*  returns the path of the current directory */
+
+        bool isBusy() const;
+        /*  returns whether the current directory is being read or a search is waiting for its index;
+            `directoryLoaded` or `searchFinished` is emitted once it's done */
 
         void handleCommandUpdate(const QString& command);
         /*  handles a command entery as it's being typed by the user */
 
-        void handleCommand(const QString& command);
-        /*  handles a command entered by the user */
+        bool handleCommand(const QString& command);
+        /*  handles a command entered by the user; returns false if it's unknown or couldn't be run */
+
+    signals:
+        void statusChanged(QString const& message, int timeout);
+        /*  emitted to show `message` to the user for `timeout` milliseconds (0 means until replaced) */
+
+        void copyFinished(qint64 filesCopied, QStringList const& errors, bool cancelled);
+        /*  emitted when a copy started by `putCopy` is done, or cancelled */
+
+        void removeFinished(qint64 itemsRemoved, QStringList const& errors);
+        /*  emitted when the items of a `removeSelected` have been removed */
+
+        void directoryLoaded(QString const& path);
+        /*  emitted once the current directory, `path`, has been read and its first item selected */
+
+        void searchFinished(bool found);
+        /*  emitted when a search (or `searchNext`/`searchPrevious`) has selected a match, or found none */
 
     protected:
         void keyPressEvent(QKeyEvent* event) override;
+        void paintEvent(QPaintEvent* event) override;
+        void currentChanged(QModelIndex const& current, QModelIndex const& previous) override;
         void moveSelection(QAbstractItemView::CursorAction action);
 
     private:
-        std::unique_ptr<QFileSystemModel> _fsModel;
+        std::unique_ptr<DirectoryModel> _fsModel;
+        std::unique_ptr<CopyEngine> _copyEngine;
+        std::unique_ptr<DeleteEngine> _deleteEngine;
+        std::unique_ptr<FindEngine> _findEngine;
+        std::unique_ptr<GrepEngine> _grepEngine;
+        std::unique_ptr<FindResultsModel> _findResults;
+        std::unique_ptr<SizeEngine> _sizeEngine;
+        std::unique_ptr<EntryDelegate> _delegate;
+        std::unique_ptr<Opener> _opener;
+        bool _showingFindResults;               // true while the view shows `_findResults` instead of `_fsModel`
+        bool _findResultsFromGrep;              // true when `_findResults` holds the lines of a `:grep`
+        QString _pathBeforeFind;                // the item that was current when the find results were shown
+        QString _pathToPrefetch;                // the directory the cursor is resting on
+        QString _pathAcrossReset;               // the current item while the model is being reset
+        int _rowAcrossLayoutChange;             // the current row while changes are being applied
+        bool _sortRequested;                    // true from a `:sort` until the rows are in that order
+        bool _confirmRemovals;
+        bool _showingLoadProgress;              // true while the status bar says how far a slow read of the directory is
+        QPersistentModelIndex _visualAnchor;    // the item visual mode was started on, invalid outside of it
+        QPersistentModelIndex _visualCursor;    // the other end of the items selected in visual mode
+        QTimer _prefetchTimer;
+        QTimer _metadataTimer;                  // coalesces the requests for the metadata of the visible rows
+        tracing::Span _loadSpan;                // from a change of directory until it's loaded
+        tracing::Span _sortSpan;                // from a `:sort` until the rows are sorted
+        tracing::Span _removeSpan;              // from a confirmed removal until it's done
         KeyBindingTable _keyBindings;
         QString _pathWaitingToBeLoaded;
+        QString _pathToSelect;
+        enum class SearchMode { Prefix, Substring, Fuzzy };
+
         QString _searchPattern;
+        SearchMode _searchMode;
         bool _searchInReverse;
         Qt::CaseSensitivity _searchCaseSensitivity;
+        std::string _searchKey;                 // `_searchPattern` as looked up in the search index
+        SearchIndex::Range _searchRange;        // entries of the search index matching `_searchKey`
+        std::vector<int> _searchMatches;        // matching rows, ascending for prefix searches and best first otherwise
+        std::size_t _searchMatchPosition;       // position in `_searchMatches` of the last match selected
+        bool _searchMatchesValid;               // false when `_searchMatches` needs to be recomputed
+        bool _searchWaitingForIndex;            // true when a search is waiting on the search index
+
+        QStringList selectedNames(int count = 1) const;
+        /*  returns the names of the selected items or, if there are none, of the current item and the
+            `count - 1` after it */
+
+        bool selectMatching(QString const& pattern, bool select);
+        /*  selects (or deselects) the items whose names match the wildcard `pattern` (all of them if it's empty) */
 
         void updateCurrentIndex(const QString& currentPath);
 
         void selectFirstChildIfNeeded(const QString& path);
 
+        void showPartialDirectory(QString const& path, int entriesRead);
+        /*  selects an item among the rows of a directory that's still being read, and says how far the read is */
+
         void change_directory(QString const& path);
         /*  changes the directory being displayed to `path` */
 
-        static bool copyRecursively(QString const& src, QString const& dest);
-        /*  copies a file system item from `src` to `dest`, recursively if needed */
-
-        /*
-        searches for the next occurrence of `_searchPattern`
-        */
-        template <typename Predicate, typename CircularIterator, typename NextSiblingFunction>
-        static auto cirularSearch(Predicate&& pred, CircularIterator&& startPoint, NextSiblingFunction&& next) -> std::pair<bool, CircularIterator>{
-            auto i = startPoint;
-            while (i.isValid()) {
-                if (pred(i)) {
-                    return std::make_pair(true, i);
-                }
-                i = next(i);
-                if (i == startPoint) { // if we're back to the start,
-                    break;             // then we've found nothing and wrapped around
-                }
-            }
-            return std::make_pair(false, i);
-        }
+        void reportCopyProgress(qint64 bytesPerSecond, qint64 filesLeft);
 
-        bool indexMatchsSearchPattern(const QModelIndex& i) {
-            return i.data(Qt::DisplayRole).toString().startsWith(_searchPattern, _searchCaseSensitivity);
-        }
+        void reportCopyFinished(qint64 filesCopied, QStringList const& errors, bool cancelled);
+
+        void reportDeleteProgress(qint64 entriesRemoved);
+
+        void reportDeleteFinished(qint64 itemsRemoved, QStringList const& errors);
+
+        void find(QString const& pattern);
+        /*  searches the tree under the current directory for `pattern` and shows the matches as they come */
+
+        bool grep(QString const& pattern);
+        /*  searches the contents of the files under the current directory for `pattern` and shows the
+            matching lines as they come; returns false if `pattern` isn't a valid regular expression */
+
+        void stepFindResults(bool forward);
+        /*  moves to the next (or previous) match of a `:find` or `:grep`, wrapping around */
+
+        void showFindResults(bool show);
+        /*  switches the view between the find results and the current directory */
+
+        void openFiles(QStringList const& paths);
+        /*  opens the files at `paths`, reporting what couldn't be */
+
+        void openFindResult();
+        /*  leaves the find results for the directory of the current match, selecting it */
+
+        void addFindResults(QStringList const& paths);
+
+        void reportFindProgress(qint64 directoriesRead, qint64 matches);
+
+        void reportFindFinished(qint64 directoriesRead, qint64 matches, bool cancelled);
+
+        void addGrepResults(QStringList const& paths, QVector<qint64> const& lines, QStringList const& texts);
+
+        void reportGrepProgress(qint64 filesScanned, qint64 matches);
+
+        void reportGrepFinished(qint64 filesScanned, qint64 matches, bool cancelled);
+
+        void du(bool useCache);
+        /*  computes the space taken by the current directory and each of its sub-directories, and shows sizes */
+
+        void reportSizeProgress(qint64 directoriesRead, qint64 bytes);
+
+        void reportSizesFinished(QString const& root, qint64 bytes, qint64 directoriesRead, bool cancelled);
+
+        void showSizes(bool show);
+
+        void showIcons(bool show);
+        /*  shows or hides the icons; without them, rows are shorter and no icon or MIME type is ever looked up */
+
+        void reportCacheStatistics();
+
+        void reportMemory();
+        /*  shows what the listings of the shown and cached directories take */
+
+        void reportLatencies(QString const& arguments);
+        /*  shows the latency statistics of the traced operations, or resets them if `arguments` is "reset" */
+
+        void trace(QString const& arguments);
+        /*  starts writing a trace to the file `arguments` or, if it's "off", stops */
+
+        void sort(QString const& arguments);
+        /*  sorts the current directory as `arguments` (a key, optionally followed by "reverse") says */
+
+        QString describeSortOrder() const;
+
+        void requestVisibleMetadata();
+        /*  asks the model for the metadata of the rows on screen first */
+
+        void updateSearchMatches();
+        /*  finds the rows matching `_searchPattern`, narrowing the previous matches when possible */
+
+        void resumeSearch();
+        /*  runs the search that was started before the search index was ready, if any */
+
+        void selectMatch(bool forward, bool includeCurrent);
+        /*  selects the closest match of `_searchPattern` after (or before) the current row, wrapping around;
+            substring and fuzzy matches are stepped through by rank instead */
 
         template <typename QSTRING>
         static bool isAllLower(QSTRING&& s){
@@ -139,14 +309,6 @@ class tffm::FileManager : public QListView {
                     return false;
             return true;
         }
-
-        static QModelIndex nextSibling(QModelIndex const& i) {
-            return i.sibling((i.row() + 1) % i.model()->rowCount(i.parent()), i.column());
-        }
-
-        static QModelIndex previousSibling(QModelIndex const& i) {
-            return i.sibling(i.row() > 0 ? (i.row() - 1) : i.model()->rowCount(i.parent()) - 1, i.column());
-        }
 };
 
 #endif // FILEMANAGER
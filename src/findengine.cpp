@@ -0,0 +1,240 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "findengine.hpp"
+#include "directorylisting.hpp"
+#include "functiontask.hpp"
+#include "simdscan.hpp"
+#include "workstealingqueues.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// Qt classes
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+// system headers
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/*  how often matches are handed over while a search is running */
+constexpr int deliveryInterval = 100; // ms
+
+/*  returns `s` with ASCII letters lowered; other bytes are left alone, so UTF-8 stays valid */
+void foldAscii(const char* s, std::size_t size, std::vector<char>& folded) {
+    folded.resize(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        const char c = s[i];
+        folded[i] = c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+}
+
+}
+
+/*
+state shared by the walkers of one search
+*/
+struct tffm::FindEngine::Walk {
+    WorkStealingQueues queues;          // of directories (relative to the root, ending with a '/') to read
+    QString root;
+    int rootFd = -1;
+    std::string key;                    // the pattern, ASCII-folded for case-insensitive searches
+    bool caseInsensitive = true;
+    bool includeHidden = false;
+    std::atomic<qint64> directoriesRead{0};
+    std::atomic<qint64> matches{0};
+    std::atomic<int> runningWalkers{0};
+    QMutex matchesMutex;
+    QStringList newMatches;             // found since the last delivery
+
+    explicit Walk(std::size_t walkers) : queues{walkers} {}
+
+    ~Walk() {
+        if (rootFd >= 0) close(rootFd);
+    }
+};
+
+tffm::FindEngine::FindEngine(QObject* parent) : QObject{parent} {
+    _pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+
+    _deliveryTimer.setInterval(deliveryInterval);
+    connect(&_deliveryTimer, &QTimer::timeout, this, &FindEngine::deliverMatches);
+}
+
+tffm::FindEngine::~FindEngine() {
+    if (_walk) _walk->queues.cancel();
+    _pool.waitForDone();
+}
+
+/*
+starts looking under `root` for items whose names contain `pattern`, cancelling any search that's still running
+*/
+void tffm::FindEngine::start(QString const& root, QString const& pattern, Qt::CaseSensitivity caseSensitivity, bool includeHidden) {
+    if (_walk) {
+        // its walkers stop after the directory they're reading, without being waited for (which could take
+        // long on a slow file system), and what they found is dropped as `finishWalk` sees it's superseded;
+        // the new walkers start as they leave the pool
+        auto previous = std::move(_walk);
+        previous->queues.cancel();
+        emit finished(previous->directoriesRead, previous->matches, true);
+    }
+
+    const auto walkers = static_cast<std::size_t>(_pool.maxThreadCount());
+    auto walk = std::make_shared<Walk>(walkers);
+    walk->root = root;
+    walk->caseInsensitive = caseSensitivity == Qt::CaseInsensitive;
+    walk->includeHidden = includeHidden;
+    walk->key = QFile::encodeName(pattern).toStdString();
+    if (walk->caseInsensitive) {
+        std::vector<char> folded;
+        foldAscii(walk->key.data(), walk->key.size(), folded);
+        walk->key.assign(folded.begin(), folded.end());
+    }
+    walk->rootFd = open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (walk->rootFd < 0 || walk->key.empty()) {
+        emit finished(0, 0, false);
+        return;
+    }
+
+    auto rootDirectory = std::vector<std::string>{std::string{}};
+    walk->queues.push(0, rootDirectory);
+    walk->runningWalkers = static_cast<int>(walkers);
+
+    _walk = walk;
+    _deliveryTimer.start();
+    for (std::size_t i = 0; i < walkers; ++i) {
+        _pool.start(new FunctionTask{[this, walk, i]() { runWalker(walk, i); }});
+    }
+}
+
+/*
+stops the running search, if any; `finished` is still emitted
+*/
+void tffm::FindEngine::cancel() {
+    if (_walk) _walk->queues.cancel();
+}
+
+/*
+reads directories from the walker's own queue, or stolen from others, until none are left
+*/
+void tffm::FindEngine::runWalker(std::shared_ptr<Walk> const& walk, std::size_t self) {
+    walk->queues.run(self, [this, &walk, self](std::string const& directory) { readDirectory(*walk, self, directory); });
+
+    if (--walk->runningWalkers == 0) {
+        QMetaObject::invokeMethod(this, [this, walk]() { finishWalk(walk); }, Qt::QueuedConnection);
+    }
+}
+
+/*
+matches the entries of `directory` (relative to the root) and queues its sub-directories
+
+The names of a listing are stored back to back, so the whole directory is
+searched with a single scan; a match can't straddle two names as the
+pattern holds no NUL.
+*/
+void tffm::FindEngine::readDirectory(Walk& walk, std::size_t self, std::string const& directory) {
+    const int fd = openat(walk.rootFd, directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return;
+    auto listing = DirectoryListing{};
+    const bool ok = listing.read(fd);
+    close(fd);
+    if (!ok) return;
+    ++walk.directoriesRead;
+
+    thread_local std::vector<char> folded;
+    const char* names = listing.nameData();
+    if (walk.caseInsensitive) {
+        foldAscii(listing.nameData(), listing.nameDataSize(), folded);
+        names = folded.data();
+    }
+
+    auto matches = QStringList{};
+    const auto size = listing.nameDataSize();
+    std::size_t position = 0;
+    while (const char* hit = simd::find(names + position, size - position, walk.key.data(), walk.key.size())) {
+        const auto i = listing.entryAt(static_cast<std::size_t>(hit - names));
+        position = static_cast<std::size_t>(listing.name(i) - listing.nameData()) + listing.nameLength(i) + 1;
+        if (!walk.includeHidden && listing.isHidden(i)) continue;
+
+        auto path = directory + listing.name(i);
+        if (listing.isDirectory(i)) path += '/';
+        matches << QFile::decodeName(path.c_str());
+    }
+
+    auto subdirectories = std::vector<std::string>{};
+    for (DirectoryListing::size_type i = 0; i < listing.size(); ++i) {
+        // symbolic links aren't followed, as with find(1)
+        if (listing.type(i) != DT_DIR || (!walk.includeHidden && listing.isHidden(i))) continue;
+        subdirectories.push_back(directory + listing.name(i) + '/');
+    }
+    walk.queues.push(self, subdirectories);
+
+    if (!matches.isEmpty()) {
+        walk.matches += matches.size();
+        QMutexLocker lock{&walk.matchesMutex};
+        walk.newMatches << matches;
+    }
+}
+
+void tffm::FindEngine::finishWalk(std::shared_ptr<Walk> const& walk) {
+    if (walk != _walk) return; // superseded; `start()` has already reported it
+
+    deliverMatches();
+    _deliveryTimer.stop();
+    _walk.reset();
+    emit finished(walk->directoriesRead, walk->matches, walk->queues.isCancelled());
+}
+
+/*
+emits the matches found since the last delivery, and the progress of the walk
+*/
+void tffm::FindEngine::deliverMatches() {
+    if (!_walk) return;
+
+    auto matches = QStringList{};
+    {
+        QMutexLocker lock{&_walk->matchesMutex};
+        matches.swap(_walk->newMatches);
+    }
+    if (!matches.isEmpty()) emit matchesFound(matches);
+    emit progress(_walk->directoriesRead, _walk->matches);
+}
@@ -0,0 +1,103 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef FINDENGINE_HPP
+#define FINDENGINE_HPP
+
+// standard libraries
+#include <memory>
+#include <string>
+
+// Qt classes
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace tffm { class FindEngine; }
+
+/*
+finds the items under a directory whose names contain a pattern
+
+The tree is walked by one thread per core, each with its own queue of
+directories still to be read, stealing from the others when it runs dry (see
+`WorkStealingQueues`). Directories are read with
+`DirectoryListing` and names are matched with the vectorized substring
+search over the whole listing at once. Matches are handed over in batches
+from the thread the engine lives in, while the walk is still going.
+*/
+class tffm::FindEngine : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit FindEngine(QObject* parent = nullptr);
+        ~FindEngine() override;
+
+        void start(QString const& root, QString const& pattern, Qt::CaseSensitivity caseSensitivity, bool includeHidden);
+        /*  starts looking under `root` for items whose names contain `pattern`, cancelling any
+            search that's still running; hidden items (and what's under them) are skipped unless
+            `includeHidden` is set */
+
+        void cancel();
+        /*  stops the running search, if any; `finished` is still emitted */
+
+        bool isRunning() const { return static_cast<bool>(_walk); }
+
+    signals:
+        void matchesFound(QStringList const& paths);
+        /*  emitted with the paths (relative to the root) of a batch of matches; directories end with a '/' */
+
+        void progress(qint64 directoriesRead, qint64 matches);
+        void finished(qint64 directoriesRead, qint64 matches, bool cancelled);
+
+    private:
+        struct Walk;
+
+        std::shared_ptr<Walk> _walk;
+        QTimer _deliveryTimer;
+        QThreadPool _pool;
+
+        void runWalker(std::shared_ptr<Walk> const& walk, std::size_t self);
+        /*  reads directories from the walker's own queue, or stolen from others, until none are left */
+
+        void readDirectory(Walk& walk, std::size_t self, std::string const& directory);
+        /*  matches the entries of `directory` (relative to the root) and queues its sub-directories */
+
+        void finishWalk(std::shared_ptr<Walk> const& walk);
+
+        void deliverMatches();
+        /*  emits the matches found since the last delivery, and the progress of the walk */
+};
+
+#endif // FINDENGINE_HPP
@@ -0,0 +1,122 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "findresultsmodel.hpp"
+
+// Qt classes
+#include <QFileIconProvider>
+
+tffm::FindResultsModel::FindResultsModel(QObject* parent) : QAbstractListModel{parent} {
+    QFileIconProvider iconProvider;
+    _directoryIcon = iconProvider.icon(QFileIconProvider::Folder);
+    _fileIcon = iconProvider.icon(QFileIconProvider::File);
+}
+
+int tffm::FindResultsModel::rowCount(QModelIndex const& parent) const {
+    return parent.isValid() ? 0 : _paths.size();
+}
+
+QVariant tffm::FindResultsModel::data(QModelIndex const& index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant{};
+
+    switch (role) {
+    case Qt::DisplayRole:
+        if (_lines.at(index.row()) > 0) {
+            return QStringLiteral("%1:%2: %3").arg(_paths.at(index.row())).arg(_lines.at(index.row())).arg(_texts.at(index.row()));
+        }
+        return _paths.at(index.row());
+    case Qt::EditRole:
+        return _paths.at(index.row());
+    case Qt::DecorationRole:
+        return isDir(index) ? _directoryIcon : _fileIcon;
+    default:
+        return QVariant{};
+    }
+}
+
+/*
+drops all matches; the following ones are relative to `root`
+*/
+void tffm::FindResultsModel::reset(QString const& root) {
+    beginResetModel();
+    _rootPath = root;
+    _paths.clear();
+    _lines.clear();
+    _texts.clear();
+    endResetModel();
+}
+
+/*
+adds a batch of matches, as reported by `FindEngine::matchesFound`
+*/
+void tffm::FindResultsModel::append(QStringList const& paths) {
+    if (paths.isEmpty()) return;
+
+    beginInsertRows(QModelIndex{}, _paths.size(), _paths.size() + paths.size() - 1);
+    _paths << paths;
+    _lines.insert(_lines.size(), paths.size(), 0);
+    for (int i = 0; i < paths.size(); ++i) {
+        _texts << QString{};
+    }
+    endInsertRows();
+}
+
+/*
+adds a batch of matching lines, as reported by `GrepEngine::matchesFound`
+*/
+void tffm::FindResultsModel::append(QStringList const& paths, QVector<qint64> const& lines, QStringList const& texts) {
+    if (paths.isEmpty()) return;
+
+    beginInsertRows(QModelIndex{}, _paths.size(), _paths.size() + paths.size() - 1);
+    _paths << paths;
+    _lines << lines;
+    _texts << texts;
+    endInsertRows();
+}
+
+QString tffm::FindResultsModel::filePath(QModelIndex const& index) const {
+    if (!index.isValid()) return _rootPath;
+
+    auto path = _paths.at(index.row());
+    if (path.endsWith(QChar('/'))) path.chop(1);
+    return _rootPath.endsWith(QChar('/')) ? _rootPath + path : _rootPath + QChar('/') + path;
+}
+
+bool tffm::FindResultsModel::isDir(QModelIndex const& index) const {
+    return index.isValid() && _paths.at(index.row()).endsWith(QChar('/'));
+}
+
+qint64 tffm::FindResultsModel::line(QModelIndex const& index) const {
+    return index.isValid() ? _lines.at(index.row()) : 0;
+}
@@ -0,0 +1,88 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef FINDRESULTSMODEL_HPP
+#define FINDRESULTSMODEL_HPP
+
+// Qt classes
+#include <QAbstractListModel>
+#include <QIcon>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace tffm { class FindResultsModel; }
+
+/*
+the matches of a `:find` or a `:grep`, as paths relative to the directory it was run in
+
+Matches are appended in the (unsorted) order the walkers find them, so the
+list can be browsed while the search is still running. Matches of a `:grep`
+are lines, shown as `path:line: text`.
+*/
+class tffm::FindResultsModel : public QAbstractListModel {
+    Q_OBJECT
+
+    public:
+        explicit FindResultsModel(QObject* parent = nullptr);
+
+        int rowCount(QModelIndex const& parent = QModelIndex{}) const override;
+        QVariant data(QModelIndex const& index, int role = Qt::DisplayRole) const override;
+
+        void reset(QString const& root);
+        /*  drops all matches; the following ones are relative to `root` */
+
+        void append(QStringList const& paths);
+        /*  adds a batch of matches, as reported by `FindEngine::matchesFound` */
+
+        void append(QStringList const& paths, QVector<qint64> const& lines, QStringList const& texts);
+        /*  adds a batch of matching lines, as reported by `GrepEngine::matchesFound` */
+
+        QString rootPath() const { return _rootPath; }
+
+        QString filePath(QModelIndex const& index) const;
+        bool isDir(QModelIndex const& index) const;
+
+        qint64 line(QModelIndex const& index) const;
+        /*  returns the number of the matching line, or 0 if the match is a whole item */
+
+    private:
+        QString _rootPath;
+        QStringList _paths;     // directories end with a '/'
+        QVector<qint64> _lines; // of `:grep` matches, 0 for `:find` ones
+        QStringList _texts;     // of the matching lines
+        QIcon _directoryIcon;
+        QIcon _fileIcon;
+};
+
+#endif // FINDRESULTSMODEL_HPP
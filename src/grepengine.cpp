@@ -0,0 +1,494 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "grepengine.hpp"
+#include "directorylisting.hpp"
+#include "functiontask.hpp"
+#include "simdscan.hpp"
+#include "workstealingqueues.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Qt classes
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QThread>
+
+// system headers
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/*  how often matches are handed over while a search is running */
+constexpr int deliveryInterval = 100; // ms
+
+/*  how much of the start of a file is checked for a NUL byte, which makes it binary */
+constexpr std::size_t binaryProbe = 8192;
+
+/*  files that aren't mapped are read this much at a time */
+constexpr std::size_t readBlock = 1024 * 1024;
+
+/*  a regular expression is matched against this much of a mapped file at a time, cut at a line end */
+constexpr std::size_t regexBlock = 16 * 1024 * 1024;
+
+/*  matching lines are cut to this many characters */
+constexpr int maxLineShown = 200;
+
+/*  the characters that make a pattern a regular expression */
+const char regexSyntax[] = ".^$*+?()[]{}|\\";
+
+/*  returns the text of a matching line, cut short if it's long */
+QString lineText(const char* begin, const char* end) {
+    const auto length = std::min<std::ptrdiff_t>(end - begin, maxLineShown * 4);
+    auto text = QString::fromUtf8(begin, static_cast<int>(length));
+    if (text.endsWith(QChar('\r'))) text.chop(1);
+    if (text.size() > maxLineShown) text.truncate(maxLineShown);
+    return text.trimmed();
+}
+
+/*  returns where the block of at most `size` bytes starting at `begin` ends: after its last whole
+    line, or at `size` bytes if a line is longer than that */
+const char* blockEnd(const char* begin, const char* end, std::size_t size) {
+    if (static_cast<std::size_t>(end - begin) <= size) return end;
+    const auto lastLineEnd = static_cast<const char*>(memrchr(begin, '\n', size));
+    return lastLineEnd ? lastLineEnd + 1 : begin + size;
+}
+
+/*  returns whether `text` has characters outside of ASCII */
+bool hasNonAscii(QString const& text) {
+    return std::any_of(text.constBegin(), text.constEnd(), [](QChar c) { return c.unicode() >= 128; });
+}
+
+/*  the mapped file the current thread is scanning, if any; its pages past the end of the file, should
+    it be truncated meanwhile, are replaced with zeros rather than raising SIGBUS */
+struct GuardedMapping {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    volatile sig_atomic_t truncated = 0;
+};
+
+thread_local GuardedMapping guardedMapping;
+
+struct sigaction previousBusAction;
+std::uintptr_t pageSize = 4096;
+
+/*  maps zeros over the rest of the guarded mapping from the faulting page, or hands the fault to the
+    handler installed before, if it didn't happen there */
+void onBusError(int number, siginfo_t* info, void* context) {
+    const auto address = static_cast<const char*>(info->si_addr);
+    auto& guarded = guardedMapping;
+    if (address >= guarded.begin && address < guarded.end) {
+        const auto start = reinterpret_cast<std::uintptr_t>(address) & ~(pageSize - 1);
+        const auto length = reinterpret_cast<std::uintptr_t>(guarded.end) - start;
+        void* zeros = mmap(reinterpret_cast<void*>(start), length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        if (zeros != MAP_FAILED) {
+            guarded.truncated = 1;
+            return;
+        }
+    }
+    if ((previousBusAction.sa_flags & SA_SIGINFO) && previousBusAction.sa_sigaction) {
+        previousBusAction.sa_sigaction(number, info, context);
+    }
+    else if (previousBusAction.sa_handler != SIG_DFL && previousBusAction.sa_handler != SIG_IGN) {
+        previousBusAction.sa_handler(number);
+    }
+    else {
+        // the faulting access is retried on return, and then kills as it would have
+        struct sigaction fallback {};
+        fallback.sa_handler = SIG_DFL;
+        sigemptyset(&fallback.sa_mask);
+        sigaction(SIGBUS, &fallback, nullptr);
+    }
+}
+
+/*  installs `onBusError`, once */
+void guardMappings() {
+    static const bool installed = []() {
+        pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+        struct sigaction action {};
+        action.sa_sigaction = onBusError;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        return sigaction(SIGBUS, &action, &previousBusAction) == 0;
+    }();
+    Q_UNUSED(installed);
+}
+
+}
+
+/*
+state shared by the walkers of one search
+*/
+struct tffm::GrepEngine::Walk {
+    WorkStealingQueues queues;          // of items (relative to the root) to read; directories end with a '/'
+    QString root;
+    int rootFd = -1;
+    std::string key;                    // an ASCII or case-sensitive literal pattern, lowered for case-insensitive searches
+    QString regex;                      // the pattern otherwise
+    bool caseInsensitive = true;
+    bool includeHidden = false;
+    std::atomic<qint64> filesScanned{0};
+    std::atomic<qint64> matches{0};
+    std::atomic<int> runningWalkers{0};
+    QMutex matchesMutex;
+    QStringList newPaths;               // found since the last delivery
+    QVector<qint64> newLines;
+    QStringList newTexts;
+
+    explicit Walk(std::size_t walkers) : queues{walkers} {}
+
+    ~Walk() {
+        if (rootFd >= 0) close(rootFd);
+    }
+};
+
+/*
+what a walker keeps from one file to the next
+*/
+struct tffm::GrepEngine::Scanner {
+    QRegularExpression regex;           // a copy of its own, so walkers don't share its matching state
+    std::vector<char> buffer;           // blocks of the files that aren't mapped
+    QString path;                       // of the file being scanned
+    QStringList paths;                  // its matches
+    QVector<qint64> lines;
+    QStringList texts;
+};
+
+constexpr qint64 tffm::GrepEngine::mmapThreshold;
+
+tffm::GrepEngine::GrepEngine(QObject* parent) : QObject{parent} {
+    guardMappings();
+    _pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+
+    _deliveryTimer.setInterval(deliveryInterval);
+    connect(&_deliveryTimer, &QTimer::timeout, this, &GrepEngine::deliverMatches);
+}
+
+tffm::GrepEngine::~GrepEngine() {
+    if (_walk) _walk->queues.cancel();
+    _pool.waitForDone();
+}
+
+/*
+returns whether `pattern` has no regular expression syntax
+*/
+bool tffm::GrepEngine::isLiteral(QString const& pattern) {
+    for (auto c : pattern) {
+        if (c.unicode() < 128 && std::strchr(regexSyntax, c.toLatin1())) return false;
+    }
+    return true;
+}
+
+/*
+starts looking for `pattern` in the files under `root`, cancelling any search that's still running
+*/
+bool tffm::GrepEngine::start(QString const& root, QString const& pattern, Qt::CaseSensitivity caseSensitivity, bool includeHidden) {
+    if (_walk) {
+        // its walkers stop after the item they're on, without being waited for, and what they found is
+        // dropped as `finishWalk` sees it's superseded; the new walkers start as they leave the pool
+        auto previous = std::move(_walk);
+        previous->queues.cancel();
+        emit finished(previous->filesScanned, previous->matches, true);
+    }
+
+    const auto walkers = static_cast<std::size_t>(_pool.maxThreadCount());
+    auto walk = std::make_shared<Walk>(walkers);
+    walk->root = root;
+    walk->caseInsensitive = caseSensitivity == Qt::CaseInsensitive;
+    walk->includeHidden = includeHidden;
+    if (isLiteral(pattern) && !(walk->caseInsensitive && hasNonAscii(pattern))) {
+        walk->key = (walk->caseInsensitive ? pattern.toLower() : pattern).toUtf8().toStdString();
+    }
+    else if (isLiteral(pattern)) {
+        // the caseless search only folds ASCII letters
+        walk->regex = QRegularExpression::escape(pattern);
+    }
+    else {
+        auto options = walk->caseInsensitive ? QRegularExpression::CaseInsensitiveOption : QRegularExpression::NoPatternOption;
+        if (!QRegularExpression{pattern, options}.isValid()) return false;
+        walk->regex = pattern;
+    }
+    walk->rootFd = open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (walk->rootFd < 0 || pattern.isEmpty()) {
+        emit finished(0, 0, false);
+        return true;
+    }
+
+    auto rootDirectory = std::vector<std::string>{std::string{}};
+    walk->queues.push(0, rootDirectory);
+    walk->runningWalkers = static_cast<int>(walkers);
+
+    _walk = walk;
+    _deliveryTimer.start();
+    for (std::size_t i = 0; i < walkers; ++i) {
+        _pool.start(new FunctionTask{[this, walk, i]() { runWalker(walk, i); }});
+    }
+    return true;
+}
+
+/*
+stops the running search, if any; `finished` is still emitted
+*/
+void tffm::GrepEngine::cancel() {
+    if (_walk) _walk->queues.cancel();
+}
+
+/*
+reads directories and scans files from the walker's own queue, or stolen from others, until none are left
+*/
+void tffm::GrepEngine::runWalker(std::shared_ptr<Walk> const& walk, std::size_t self) {
+    auto scanner = Scanner{};
+    if (!walk->regex.isEmpty()) {
+        auto options = QRegularExpression::MultilineOption;
+        if (walk->caseInsensitive) options |= QRegularExpression::CaseInsensitiveOption;
+        scanner.regex = QRegularExpression{walk->regex, options};
+        scanner.regex.optimize();
+    }
+
+    walk->queues.run(self, [this, &walk, &scanner, self](std::string const& item) {
+        if (item.empty() || item.back() == '/') readDirectory(*walk, self, item);
+        else scanFile(*walk, scanner, item);
+    });
+
+    if (--walk->runningWalkers == 0) {
+        QMetaObject::invokeMethod(this, [this, walk]() { finishWalk(walk); }, Qt::QueuedConnection);
+    }
+}
+
+/*
+queues the files and sub-directories of `directory` (relative to the root)
+*/
+void tffm::GrepEngine::readDirectory(Walk& walk, std::size_t self, std::string const& directory) {
+    const int fd = openat(walk.rootFd, directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return;
+    auto listing = DirectoryListing{};
+    const bool ok = listing.read(fd);
+    close(fd);
+    if (!ok) return;
+
+    // symbolic links aren't followed, as with grep -r
+    auto items = std::vector<std::string>{};
+    for (DirectoryListing::size_type i = 0; i < listing.size(); ++i) {
+        if (!walk.includeHidden && listing.isHidden(i)) continue;
+        if (listing.type(i) == DT_DIR) items.push_back(directory + listing.name(i) + '/');
+        else if (listing.type(i) == DT_REG) items.push_back(directory + listing.name(i));
+    }
+    walk.queues.push(self, items);
+}
+
+/*
+hands over the lines of the file at `path` (relative to the root) that match
+
+A mapped file is searched for a literal all at once, and matched against a
+regular expression a block of lines at a time, since a `QString` can't hold
+more than 2 GiB. Other files are read a block at a time, the start of the
+last line of a block being kept for the next one. A mapped file that is
+truncated while it's scanned (`onBusError` reads zeros past its new end) is
+scanned again that way, from what's left of it.
+*/
+void tffm::GrepEngine::scanFile(Walk& walk, Scanner& scanner, std::string const& path) {
+    const int fd = openat(walk.rootFd, path.c_str(), O_RDONLY | O_NOFOLLOW | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    ++walk.filesScanned;
+    scanner.path = QFile::decodeName(path.c_str());
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void* mapping = st.st_size >= mmapThreshold ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    bool scanned = false;
+    if (mapping != MAP_FAILED) {
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        const auto data = static_cast<const char*>(mapping);
+        const char* end = data + size;
+        guardedMapping.truncated = 0;
+        guardedMapping.begin = data;
+        guardedMapping.end = end;
+        if (!std::memchr(data, 0, std::min(size, binaryProbe))) {
+            const auto block = walk.key.empty() ? regexBlock : size;
+            qint64 line = 1;
+            for (const char* begin = data; begin < end && !walk.queues.isCancelled() && !guardedMapping.truncated;) {
+                const char* next = blockEnd(begin, end, block);
+                line = scanText(walk, scanner, begin, static_cast<std::size_t>(next - begin), line);
+                begin = next;
+            }
+        }
+        guardedMapping.begin = guardedMapping.end = nullptr;
+        munmap(mapping, size);
+        scanned = !guardedMapping.truncated;
+        if (!scanned) {
+            scanner.paths.clear();
+            scanner.lines.clear();
+            scanner.texts.clear();
+        }
+    }
+    if (!scanned) {
+        auto& buffer = scanner.buffer;
+        buffer.resize(std::min(size, readBlock));
+        std::size_t filled = 0;
+        std::size_t offset = 0;
+        qint64 line = 1;
+        while (!walk.queues.isCancelled()) {
+            auto n = pread(fd, buffer.data() + filled, buffer.size() - filled, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) n = 0;
+            filled += static_cast<std::size_t>(n);
+            const bool atEnd = n == 0 || (offset += static_cast<std::size_t>(n)) >= size;
+            if (offset == filled && std::memchr(buffer.data(), 0, std::min(filled, binaryProbe))) break; // binary
+
+            const char* data = buffer.data();
+            const char* complete = data + filled;
+            if (!atEnd) {
+                if (filled < buffer.size()) continue; // a short read
+                // a line longer than the buffer is cut
+                const auto lastLineEnd = static_cast<const char*>(memrchr(data, '\n', filled));
+                if (lastLineEnd) complete = lastLineEnd + 1;
+            }
+            line = scanText(walk, scanner, data, static_cast<std::size_t>(complete - data), line);
+            if (atEnd) break;
+            filled -= static_cast<std::size_t>(complete - data);
+            std::memmove(buffer.data(), complete, filled);
+        }
+    }
+    close(fd);
+
+    if (!scanner.paths.isEmpty()) {
+        walk.matches += scanner.paths.size();
+        QMutexLocker lock{&walk.matchesMutex};
+        walk.newPaths << scanner.paths;
+        walk.newLines << scanner.lines;
+        walk.newTexts << scanner.texts;
+        lock.unlock();
+        scanner.paths.clear();
+        scanner.lines.clear();
+        scanner.texts.clear();
+    }
+}
+
+/*
+adds the matching lines of `data`, whole lines of the file being scanned starting with line number `line`, to the matches of `scanner`; returns the number of the line after them
+
+Only one match is reported per line; the search for the next one starts on
+the following line.
+*/
+qint64 tffm::GrepEngine::scanText(Walk& walk, Scanner& scanner, const char* data, std::size_t length, qint64 line) {
+    const char* end = data + length;
+    const auto addMatch = [&scanner](qint64 line, QString text) {
+        scanner.paths << scanner.path;
+        scanner.lines << line;
+        scanner.texts << std::move(text);
+    };
+    if (!walk.key.empty()) {
+        const char* counted = data; // lines are counted up to here
+        const char* position = data;
+        while (position < end) {
+            const char* hit = walk.caseInsensitive ? simd::findCaseless(position, static_cast<std::size_t>(end - position), walk.key.data(), walk.key.size())
+                                                   : simd::find(position, static_cast<std::size_t>(end - position), walk.key.data(), walk.key.size());
+            if (!hit) break;
+            auto lineStart = static_cast<const char*>(memrchr(counted, '\n', static_cast<std::size_t>(hit - counted)));
+            lineStart = lineStart ? lineStart + 1 : counted;
+            auto lineEnd = static_cast<const char*>(std::memchr(hit, '\n', static_cast<std::size_t>(end - hit)));
+            if (!lineEnd) lineEnd = end;
+
+            line += static_cast<qint64>(simd::count(counted, static_cast<std::size_t>(lineStart - counted), '\n'));
+            counted = lineStart;
+            addMatch(line, lineText(lineStart, lineEnd));
+            position = lineEnd + 1;
+        }
+        return line + static_cast<qint64>(simd::count(counted, static_cast<std::size_t>(end - counted), '\n'));
+    }
+
+    // the whole block is matched at once, with `^` and `$` matching at line boundaries
+    const auto text = QString::fromUtf8(data, static_cast<int>(length));
+    int counted = 0;
+    int position = 0;
+    while (position < text.size() && !walk.queues.isCancelled()) {
+        const auto match = scanner.regex.match(text, position);
+        if (!match.hasMatch()) break;
+        const int lineStart = match.capturedStart() > 0 ? text.lastIndexOf(QChar('\n'), match.capturedStart() - 1) + 1 : 0;
+        int lineEnd = text.indexOf(QChar('\n'), match.capturedStart());
+        if (lineEnd < 0) lineEnd = text.size();
+
+        line += std::count(text.constBegin() + counted, text.constBegin() + std::max(lineStart, counted), QChar('\n'));
+        counted = std::max(lineStart, counted);
+        addMatch(line, text.mid(lineStart, std::min(lineEnd - lineStart, maxLineShown)).trimmed());
+        position = lineEnd + 1;
+    }
+    return line + std::count(text.constBegin() + counted, text.constEnd(), QChar('\n'));
+}
+
+void tffm::GrepEngine::finishWalk(std::shared_ptr<Walk> const& walk) {
+    if (walk != _walk) return; // superseded; `start()` has already reported it
+
+    deliverMatches();
+    _deliveryTimer.stop();
+    _walk.reset();
+    emit finished(walk->filesScanned, walk->matches, walk->queues.isCancelled());
+}
+
+/*
+emits the matches found since the last delivery, and the progress of the walk
+*/
+void tffm::GrepEngine::deliverMatches() {
+    if (!_walk) return;
+
+    auto paths = QStringList{};
+    auto lines = QVector<qint64>{};
+    auto texts = QStringList{};
+    {
+        QMutexLocker lock{&_walk->matchesMutex};
+        paths.swap(_walk->newPaths);
+        lines.swap(_walk->newLines);
+        texts.swap(_walk->newTexts);
+    }
+    if (!paths.isEmpty()) emit matchesFound(paths, lines, texts);
+    emit progress(_walk->filesScanned, _walk->matches);
+}
@@ -0,0 +1,125 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef GREPENGINE_HPP
+#define GREPENGINE_HPP
+
+// standard libraries
+#include <memory>
+#include <string>
+
+// Qt classes
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+
+namespace tffm { class GrepEngine; }
+
+/*
+finds the lines of the files under a directory that match a pattern, for `:grep`
+
+The tree is walked as `FindEngine` walks it, one thread per core with its own
+queue and stealing from the others (see `WorkStealingQueues`), except that files are queued as well as
+directories, so a directory full of big files is spread across cores too.
+Files of `mmapThreshold` bytes or more are mapped, smaller ones (and those
+that can't be mapped, or are truncated while mapped) are read a block at a
+time into a buffer the thread reuses; files with a NUL byte near the start are taken as binary and
+skipped. A pattern without regular expression syntax is looked for with the
+vectorized substring search, and lines are only delimited (and counted)
+around the hits; other patterns, and case-insensitive ones with non-ASCII
+characters, are matched with `QRegularExpression`. Matches are handed over
+in batches while the walk is still going.
+*/
+class tffm::GrepEngine : public QObject {
+    Q_OBJECT
+
+    public:
+        /*  files at least this big are mapped rather than read */
+        static constexpr qint64 mmapThreshold = 256 * 1024;
+
+        explicit GrepEngine(QObject* parent = nullptr);
+        ~GrepEngine() override;
+
+        bool start(QString const& root, QString const& pattern, Qt::CaseSensitivity caseSensitivity, bool includeHidden);
+        /*  starts looking for `pattern` in the files under `root`, cancelling any search that's still
+            running; hidden items (and what's under them) are skipped unless `includeHidden` is set;
+            returns false if `pattern` is neither a literal nor a valid regular expression */
+
+        void cancel();
+        /*  stops the running search, if any; `finished` is still emitted */
+
+        bool isRunning() const { return static_cast<bool>(_walk); }
+
+        static bool isLiteral(QString const& pattern);
+        /*  returns whether `pattern` has no regular expression syntax, and so is looked for as it is */
+
+    signals:
+        void matchesFound(QStringList const& paths, QVector<qint64> const& lines, QStringList const& texts);
+        /*  emitted with a batch of matching lines: the paths of their files (relative to the root), their
+            numbers (from 1) and their text */
+
+        void progress(qint64 filesScanned, qint64 matches);
+        void finished(qint64 filesScanned, qint64 matches, bool cancelled);
+
+    private:
+        struct Walk;
+        struct Scanner;
+
+        std::shared_ptr<Walk> _walk;
+        QTimer _deliveryTimer;
+        QThreadPool _pool;
+
+        void runWalker(std::shared_ptr<Walk> const& walk, std::size_t self);
+        /*  reads directories and scans files from the walker's own queue, or stolen from others, until none are left */
+
+        void readDirectory(Walk& walk, std::size_t self, std::string const& directory);
+        /*  queues the files and sub-directories of `directory` (relative to the root) */
+
+        void scanFile(Walk& walk, Scanner& scanner, std::string const& path);
+        /*  hands over the lines of the file at `path` (relative to the root) that match */
+
+        qint64 scanText(Walk& walk, Scanner& scanner, const char* data, std::size_t length, qint64 line);
+        /*  adds the matching lines of `data`, whole lines of the file being scanned starting with line
+            number `line`, to the matches of `scanner`; returns the number of the line after them */
+
+        void finishWalk(std::shared_ptr<Walk> const& walk);
+
+        void deliverMatches();
+        /*  emits the matches found since the last delivery, and the progress of the walk */
+};
+
+#endif // GREPENGINE_HPP
@@ -0,0 +1,148 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "iconcache.hpp"
+#include "functiontask.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cstring>
+
+// Qt classes
+#include <QFileIconProvider>
+#include <QMimeDatabase>
+#include <QMimeType>
+
+namespace {
+
+/*  longer extensions aren't looked up (they're most likely not extensions at all) */
+constexpr std::size_t maxExtensionLength = 16;
+
+/*  returns the extension of `name` in lower case, or an empty string if it has none (or a long one) */
+std::string extensionOf(const char* name, std::size_t length) {
+    auto dot = static_cast<const char*>(memrchr(name, '.', length));
+    if (!dot || dot == name) return std::string{}; // hidden files without an extension too
+    const auto size = static_cast<std::size_t>(name + length - dot - 1);
+    if (size == 0 || size > maxExtensionLength) return std::string{};
+
+    auto extension = std::string{dot + 1, size};
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+    return extension;
+}
+
+}
+
+tffm::IconCache::IconCache(QObject* parent) : QObject{parent} {
+    _pool.setMaxThreadCount(1);
+
+    QFileIconProvider iconProvider;
+    _directoryIcon = iconProvider.icon(QFileIconProvider::Folder);
+    _fileIcon = iconProvider.icon(QFileIconProvider::File);
+
+    // the extensions of all the rows painted at once go in the same batch
+    _batchTimer.setSingleShot(true);
+    _batchTimer.setInterval(0);
+    connect(&_batchTimer, &QTimer::timeout, this, &IconCache::startBatch);
+}
+
+tffm::IconCache::~IconCache() {
+    _pool.clear();
+    _pool.waitForDone();
+}
+
+/*
+returns the icon of the file called `name` (as it is on the file system), or the generic file icon until it's
+been resolved
+*/
+QIcon tffm::IconCache::icon(const char* name, std::size_t length) {
+    auto extension = extensionOf(name, length);
+    if (extension.empty()) return _fileIcon;
+
+    const auto resolved = _extensions.find(extension);
+    if (resolved != _extensions.end()) return resolved->second.icon;
+    if (_pending.insert(extension).second) {
+        _queued.push_back(std::move(extension));
+        if (!_batchTimer.isActive()) _batchTimer.start();
+    }
+    return _fileIcon;
+}
+
+/*
+returns the MIME type of the file called `name`, as far as its extension tells, or an empty string if it hasn't
+been resolved (or there's no extension)
+*/
+QString tffm::IconCache::mimeType(const char* name, std::size_t length) const {
+    const auto resolved = _extensions.find(extensionOf(name, length));
+    return resolved != _extensions.end() ? resolved->second.mimeType : QString{};
+}
+
+/*
+resolves the MIME types of the queued extensions on the pool
+*/
+void tffm::IconCache::startBatch() {
+    if (_queued.empty()) return;
+
+    auto extensions = std::move(_queued);
+    _queued.clear();
+    _pool.start(new FunctionTask{[this, extensions]() {
+        // `QMimeDatabase` is thread-safe; it only matches the globs, the files aren't read
+        QMimeDatabase database;
+        auto resolved = std::vector<std::pair<std::string, Resolved>>{};
+        resolved.reserve(extensions.size());
+        for (auto const& extension : extensions) {
+            const auto type = database.mimeTypeForFile(QStringLiteral("file.") + QString::fromUtf8(extension.c_str()), QMimeDatabase::MatchExtension);
+            resolved.emplace_back(extension, Resolved{type.name(), type.iconName(), type.genericIconName()});
+        }
+        QMetaObject::invokeMethod(this, [this, resolved]() { finishBatch(resolved); }, Qt::QueuedConnection);
+    }});
+}
+
+/*
+looks up the icons of a resolved batch and records them
+*/
+void tffm::IconCache::finishBatch(std::vector<std::pair<std::string, Resolved>> const& resolved) {
+    for (auto const& r : resolved) {
+        auto icon = _iconsByMimeType.value(r.second.mimeType);
+        if (icon.isNull()) {
+            icon = QIcon::fromTheme(r.second.iconName, QIcon::fromTheme(r.second.genericIconName, _fileIcon));
+            _iconsByMimeType.insert(r.second.mimeType, icon);
+        }
+        _extensions[r.first] = Extension{icon, r.second.mimeType};
+        _pending.erase(r.first);
+    }
+    emit iconsResolved();
+}
@@ -0,0 +1,122 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef ICONCACHE_HPP
+#define ICONCACHE_HPP
+
+// standard libraries
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Qt classes
+#include <QHash>
+#include <QIcon>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace tffm { class IconCache; }
+
+/*
+the icons of files, by extension, resolved in the background
+
+Working out the MIME type of a name means matching it against the globs of
+the shared MIME database, and finding the icon of a type means searching the
+icon theme; doing either for every row painted makes scrolling crawl. Here,
+`icon()` answers from a table keyed by (lower-case) extension and, the first
+time an extension comes up, returns the generic file icon and queues the
+extension. The queued extensions are matched against the MIME database on a
+thread of their own, a batch at a time; back on the GUI thread (the icon
+theme isn't thread-safe) each MIME type's icon is looked up once and shared
+by all its extensions, and `iconsResolved` is emitted so the rows can be
+painted again.
+
+Names without an extension, or with a long one, get the generic file icon
+without any lookup.
+*/
+class tffm::IconCache : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit IconCache(QObject* parent = nullptr);
+        ~IconCache() override;
+
+        QIcon icon(const char* name, std::size_t length);
+        /*  returns the icon of the file called `name` (as it is on the file system), or the generic file
+            icon until it's been resolved */
+
+        QString mimeType(const char* name, std::size_t length) const;
+        /*  returns the MIME type of the file called `name`, as far as its extension tells, or an empty
+            string if it hasn't been resolved (or there's no extension) */
+
+        QIcon directoryIcon() const { return _directoryIcon; }
+        QIcon fileIcon() const { return _fileIcon; }
+
+    signals:
+        void iconsResolved();
+        /*  emitted when a batch of extensions has been resolved, changing the icons `icon()` returns */
+
+    private:
+        struct Resolved {
+            QString mimeType;
+            QString iconName;
+            QString genericIconName;
+        };
+
+        struct Extension {
+            QIcon icon;
+            QString mimeType;
+        };
+
+        std::unordered_map<std::string, Extension> _extensions; // resolved ones, by lower-case extension
+        std::unordered_set<std::string> _pending;   // asked for and not resolved yet
+        std::vector<std::string> _queued;           // asked for since the last batch was started
+        QHash<QString, QIcon> _iconsByMimeType;
+        QIcon _directoryIcon;
+        QIcon _fileIcon;
+        QTimer _batchTimer;
+        QThreadPool _pool;
+
+        void startBatch();
+        /*  resolves the MIME types of the queued extensions on the pool */
+
+        void finishBatch(std::vector<std::pair<std::string, Resolved>> const& resolved);
+        /*  looks up the icons of a resolved batch and records them */
+};
+
+#endif // ICONCACHE_HPP
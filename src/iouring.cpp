@@ -0,0 +1,178 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "iouring.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+// system headers
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+sets up a ring of at least `entries` submission queue entries; check `isValid()`
+*/
+tffm::IoUring::IoUring(unsigned entries)
+: _fd{-1}, _error{0}, _sqEntries{0}, _sqTail{0}, _unsubmitted{0},
+  _sqRing{MAP_FAILED}, _sqRingSize{0}, _cqRing{MAP_FAILED}, _cqRingSize{0}, _sqes{nullptr}, _sqesSize{0},
+  _sqHead{nullptr}, _sqTailShared{nullptr}, _sqMask{0}, _sqArray{nullptr}, _cqHead{nullptr}, _cqTail{nullptr}, _cqMask{0}, _cqes{nullptr} {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof params);
+    _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (_fd < 0) {
+        _error = errno;
+        return;
+    }
+
+    // recent kernels map both rings at once
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+    _sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+    if (_sqRing != MAP_FAILED) {
+        _cqRing = singleMap ? _sqRing : mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+    }
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    auto sqes = _cqRing == MAP_FAILED ? MAP_FAILED : mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        _error = errno;
+        unmap();
+        close(_fd);
+        _fd = -1;
+        return;
+    }
+    _sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto sq = static_cast<char*>(_sqRing);
+    _sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sqTailShared = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    _sqEntries = params.sq_entries;
+    _sqTail = *_sqTailShared;
+
+    auto cq = static_cast<char*>(_cqRing);
+    _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+tffm::IoUring::~IoUring() {
+    if (_fd < 0) return;
+    unmap();
+    close(_fd);
+}
+
+/*
+returns a zeroed entry to describe a request with, or null if the queue is full until `submit()`
+*/
+io_uring_sqe* tffm::IoUring::nextRequest() {
+    if (_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries) return nullptr;
+
+    const auto index = _sqTail & _sqMask;
+    auto request = &_sqes[index];
+    std::memset(request, 0, sizeof *request);
+    _sqArray[index] = index;
+    ++_sqTail;
+    ++_unsubmitted;
+    return request;
+}
+
+/*
+sends the queued requests to the kernel and waits for `waitFor` of them to complete
+*/
+int tffm::IoUring::submit(unsigned waitFor) {
+    __atomic_store_n(_sqTailShared, _sqTail, __ATOMIC_RELEASE);
+
+    const unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+    long submitted;
+    do {
+        submitted = syscall(__NR_io_uring_enter, _fd, _unsubmitted, waitFor, flags, nullptr, 0);
+    } while (submitted < 0 && errno == EINTR);
+    if (submitted < 0) return -errno;
+
+    _unsubmitted -= static_cast<unsigned>(submitted);
+    return static_cast<int>(submitted);
+}
+
+/*
+takes the oldest completion, if any
+*/
+bool tffm::IoUring::nextCompletion(Completion& completion) {
+    const auto head = *_cqHead; // only ever written on this side
+    if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) return false;
+
+    auto const& entry = _cqes[head & _cqMask];
+    completion.userData = entry.user_data;
+    completion.result = entry.res;
+    __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+returns whether the kernel sets up rings and has the operations used here; checked once
+*/
+bool tffm::IoUring::isSupported() {
+    static const bool supported = []() {
+        IoUring ring{4};
+        if (!ring.isValid()) return false;
+
+        // `io_uring_probe` is followed by one `io_uring_probe_op` per operation; both are 8-byte aligned
+        static_assert(sizeof(io_uring_probe) % sizeof(std::uint64_t) == 0, "unexpected io_uring_probe layout");
+        static_assert(sizeof(io_uring_probe_op) == sizeof(std::uint64_t), "unexpected io_uring_probe_op layout");
+        auto buffer = std::vector<std::uint64_t>(sizeof(io_uring_probe) / sizeof(std::uint64_t) + IORING_OP_LAST, 0);
+        auto probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (syscall(__NR_io_uring_register, ring._fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) return false;
+
+        for (int op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_MKDIRAT}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }();
+    return supported;
+}
+
+void tffm::IoUring::unmap() {
+    if (_sqes) munmap(_sqes, _sqesSize);
+    if (_cqRing != MAP_FAILED && _cqRing != _sqRing) munmap(_cqRing, _cqRingSize);
+    if (_sqRing != MAP_FAILED) munmap(_sqRing, _sqRingSize);
+}
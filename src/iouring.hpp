@@ -0,0 +1,118 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef IOURING_HPP
+#define IOURING_HPP
+
+// standard libraries
+#include <cstddef>
+#include <cstdint>
+
+// system headers
+#include <linux/io_uring.h>
+
+namespace tffm { class IoUring; }
+
+/*
+a minimal io_uring instance, driven through the raw system calls
+
+Requests are queued with `nextRequest()`, which hands out a zeroed submission
+queue entry for the caller to fill in, and sent to the kernel together by
+`submit()`. Completions are then taken one at a time with `nextCompletion()`.
+An instance is meant to be used by a single thread.
+
+Whether io_uring can be used at all depends on the kernel (and on whether it's
+been disabled, say by a seccomp filter), so `isSupported()` should be checked
+before relying on it; every user keeps a fallback.
+*/
+class tffm::IoUring {
+    public:
+        struct Completion {
+            std::uint64_t userData;
+            std::int32_t result;    // what the system call returns, or a negated `errno`
+        };
+
+        explicit IoUring(unsigned entries);
+        /*  sets up a ring of at least `entries` submission queue entries; check `isValid()` */
+
+        ~IoUring();
+
+        IoUring(IoUring const&) = delete;
+        IoUring& operator=(IoUring const&) = delete;
+
+        bool isValid() const { return _fd >= 0; }
+        int error() const { return _error; }    // the `errno` of a failed setup
+
+        unsigned capacity() const { return _sqEntries; }
+
+        io_uring_sqe* nextRequest();
+        /*  returns a zeroed entry to describe a request with, or null if the queue is full until `submit()` */
+
+        int submit(unsigned waitFor = 0);
+        /*  sends the queued requests to the kernel and waits for `waitFor` of them to complete; returns
+            the number of requests sent, or a negated `errno` */
+
+        bool nextCompletion(Completion& completion);
+        /*  takes the oldest completion, if any */
+
+        static bool isSupported();
+        /*  returns whether the kernel sets up rings and has the operations used here (open, statx, read,
+            write, close, mkdirat); checked once */
+
+    private:
+        int _fd;
+        int _error;
+        unsigned _sqEntries;
+        unsigned _sqTail;       // tail of the submission queue, as far as this side knows
+        unsigned _unsubmitted;  // entries queued since the last `submit()`
+
+        void* _sqRing;
+        std::size_t _sqRingSize;
+        void* _cqRing;
+        std::size_t _cqRingSize;
+        io_uring_sqe* _sqes;
+        std::size_t _sqesSize;
+
+        unsigned* _sqHead;
+        unsigned* _sqTailShared;
+        unsigned _sqMask;
+        unsigned* _sqArray;
+        unsigned* _cqHead;
+        unsigned* _cqTail;
+        unsigned _cqMask;
+        io_uring_cqe* _cqes;
+
+        void unmap();
+};
+
+#endif // IOURING_HPP
@@ -31,9 +31,39 @@ License:
     SOFTWARE.
 */
 
+
 // project headers
 #include "keybindingtable.hpp"
 
+// standard libraries
+#include <algorithm>
+
+// Qt classes
+#include <QApplication>
+
+namespace {
+
+/*  counts stop growing past this */
+constexpr int maxCount = 999999;
+
+/*  returns whether `key` only ever modifies other keys */
+bool isModifier(int key) {
+    switch (key) {
+    case Qt::Key_Shift:
+    case Qt::Key_Control:
+    case Qt::Key_Meta:
+    case Qt::Key_Alt:
+    case Qt::Key_AltGr:
+    case Qt::Key_CapsLock:
+    case Qt::Key_NumLock:
+        return true;
+    default:
+        return false;
+    }
+}
+
+}
+
 tffm::EnterKeyReceiver::EnterKeyReceiver(Callable f) : _f{f} {}
 
 bool tffm::EnterKeyReceiver::eventFilter(QObject* obj, QEvent* event) {
@@ -51,13 +81,151 @@ bool tffm::EnterKeyReceiver::eventFilter(QObject* obj, QEvent* event) {
     return false;
 }
 
-void tffm::KeyBindingTable::add(QKeySequence const& keys, const char* handler) {
-    add(keys, static_cast<QObject*>(_listener), handler);
+tffm::KeyBindingTable::KeyBindingTable(QWidget* listener) : _listener{listener} {
+    _nodes.emplace_back();
+    _state = 0;
+    _count = 0;
+    _countsEnabled = false;
+    _repeatBinding = -1;
+    _repeatCount = 0;
+
+    // a zero timer fires once every event waiting in the queue has been processed
+    _repeatTimer.setSingleShot(true);
+    _repeatTimer.setInterval(0);
+    connect(&_repeatTimer, &QTimer::timeout, this, &KeyBindingTable::flushRepeats);
+
+    QCoreApplication::instance()->installEventFilter(this);
+}
+
+tffm::KeyBindingTable::~KeyBindingTable() {
+    if (QCoreApplication::instance()) QCoreApplication::instance()->removeEventFilter(this);
+}
+
+/*
+looks at the key presses sent to the keyboard grabber or the focus widget, taking those that are bound if it's the listener or inside it
+*/
+bool tffm::KeyBindingTable::eventFilter(QObject* watched, QEvent* event) {
+    if (event->type() != QEvent::KeyPress || !watched->isWidgetType()) return false;
+
+    // only look at the key when it's sent to the widget that gets keys (one grabbing the keyboard, such as
+    // the input line, or else the focus widget), not again as it propagates to its parents
+    auto widget = static_cast<QWidget*>(watched);
+    auto target = QWidget::keyboardGrabber() ? QWidget::keyboardGrabber() : QApplication::focusWidget();
+    if (target ? widget != target : widget != widget->window()) return false;
+
+    auto keyEvent = static_cast<QKeyEvent*>(event);
+    if (widget != _listener) {
+        if (!_listener->isAncestorOf(widget)) return false;
+
+        // as with shortcuts, the widget gets to keep the keys it wants for itself
+        QKeyEvent shortcutOverride{QEvent::ShortcutOverride, keyEvent->key(), keyEvent->modifiers(), keyEvent->text(),
+                                   keyEvent->isAutoRepeat(), static_cast<ushort>(keyEvent->count())};
+        shortcutOverride.ignore();
+        QCoreApplication::sendEvent(widget, &shortcutOverride);
+        if (shortcutOverride.isAccepted()) return false;
+    }
+    return dispatch(keyEvent);
+}
+
+/*
+adds `keys` to the trie, bound to `handler`
+
+A sequence that's the start of another one is run as soon as it's typed.
+*/
+void tffm::KeyBindingTable::insert(QKeySequence const& keys, Handler handler, Kind kind) {
+    std::size_t node = 0;
+    for (int i = 0; i < keys.count(); ++i) {
+        auto& children = _nodes[node].children;
+        auto c = std::find_if(children.begin(), children.end(), [&](std::pair<int, std::size_t> const& child) {
+            return child.first == keys[static_cast<uint>(i)];
+        });
+        if (c != children.end()) {
+            node = c->second;
+        }
+        else {
+            children.emplace_back(keys[static_cast<uint>(i)], _nodes.size());
+            node = _nodes.size();
+            _nodes.emplace_back();
+        }
+    }
+    _nodes[node].binding = static_cast<int>(_bindings.size());
+    _bindings.push_back(Binding{std::move(handler), kind});
+}
+
+/*
+returns the node reached from `node` by the key of `event`, or 0 (the root) if there's none
+
+Keys typed with shift are also looked up without it, so that `?` and `:` match whatever the keyboard
+layout needs to type them.
+*/
+std::size_t tffm::KeyBindingTable::child(std::size_t node, QKeyEvent const* event) const {
+    const auto modifiers = event->modifiers() & ~Qt::KeypadModifier;
+    const int key = event->key() | static_cast<int>(modifiers);
+    const int unshifted = event->key() | static_cast<int>(modifiers & ~Qt::ShiftModifier);
+
+    std::size_t fallback = 0;
+    for (auto&& c : _nodes[node].children) {
+        if (c.first == key) return c.second;
+        if (c.first == unshifted) fallback = c.second;
+    }
+    return fallback;
 }
 
-void tffm::KeyBindingTable::add(QKeySequence const& keys, QObject* handler, const char* f) {
-    auto s = std::make_unique<QShortcut>(keys, _listener);
-    QObject::connect(s.get(), SIGNAL(activated), handler, f);
-    //connect(s.get(), SIGNAL(activatedAmbiguously()), std::forward<Handler>(handler), std::forward<Callable>(f));
-    _keyBindings.push_back(std::move(s));
+/*
+feeds a key press to the trie (or the count), running the binding it completes; returns whether the key was taken
+*/
+bool tffm::KeyBindingTable::dispatch(QKeyEvent const* event) {
+    const int key = event->key();
+    if (isModifier(key)) return false;
+    if (!event->isAutoRepeat()) flushRepeats();
+
+    const bool plain = (event->modifiers() & ~Qt::KeypadModifier) == Qt::NoModifier;
+    if (_countsEnabled && _state == 0 && plain && key >= Qt::Key_0 && key <= Qt::Key_9 && (key != Qt::Key_0 || _count > 0)) {
+        _count = std::min(_count * 10 + (key - Qt::Key_0), maxCount);
+        return true;
+    }
+
+    auto next = child(_state, event);
+    if (next == 0 && _state != 0) {
+        // as in vim, a sequence that isn't bound is dropped and the key starts a new one
+        _state = 0;
+        next = child(0, event);
+    }
+    if (next == 0) {
+        _count = 0;
+        return false;
+    }
+    const int binding = _nodes[next].binding;
+    if (binding < 0) {
+        _state = next; // wait for the rest of the sequence
+        return true;
+    }
+    _state = 0;
+    const int count = _count;
+    _count = 0;
+
+    auto const& b = _bindings[static_cast<std::size_t>(binding)];
+    if (b.kind == Kind::Motion && event->isAutoRepeat()) {
+        if (_repeatBinding != binding) flushRepeats();
+        _repeatBinding = binding;
+        _repeatCount = std::min(_repeatCount + std::max(count, 1), maxCount);
+        if (!_repeatTimer.isActive()) _repeatTimer.start();
+        return true;
+    }
+    b.handler(b.kind == Kind::Motion ? std::max(count, 1) : count);
+    return true;
+}
+
+/*
+runs the motion whose auto-repeats have been coalesced, if any
+*/
+void tffm::KeyBindingTable::flushRepeats() {
+    if (_repeatBinding < 0) return;
+
+    const auto binding = static_cast<std::size_t>(_repeatBinding);
+    const int count = _repeatCount;
+    _repeatBinding = -1;
+    _repeatCount = 0;
+    _repeatTimer.stop();
+    _bindings[binding].handler(count);
 }
@@ -31,6 +31,7 @@ License:
     SOFTWARE.
 */
 
+
 #ifndef KEYBINDINGTABLE_HPP
 #define KEYBINDINGTABLE_HPP
 
@@ -44,8 +45,9 @@ License:
 #include <QObject>
 #include <QEvent>
 #include <QKeyEvent>
+#include <QKeySequence>
+#include <QTimer>
 #include <QWidget>
-#include <QShortcut>
 
 namespace tffm {
     class EnterKeyReceiver;
@@ -68,19 +70,50 @@ class tffm::EnterKeyReceiver : public QObject {
         Callable _f;
 };
 
-class tffm::KeyBindingTable {
+/*
+dispatches the key presses meant for a widget (or the widgets inside it) to the handlers bound to them
+
+Bindings are kept in a trie of key sequences (`gg`, `dd`, `yy`, `..` share
+their first level with the single keys), walked one key press at a time from
+an application-wide event filter, so there's no `QShortcut` per binding and
+no shortcut map to search. As with shortcuts, keys the focus widget wants for
+itself (such as text typed into a line edit) are left to it.
+
+With `setCountsEnabled()`, digits typed before a binding are a count, as in
+vim (`250j`, `5dd`), passed to the handlers bound with `addCounted()` or
+`addMotion()`. Auto-repeats of a motion are coalesced: those waiting in the
+event queue when it's processed make a single call with the sum of their
+counts, so holding a key down never builds up a backlog that keeps the
+cursor moving after it's released.
+*/
+class tffm::KeyBindingTable : public QObject {
+    Q_OBJECT
+
     public:
-        explicit KeyBindingTable(QWidget* listener) : _listener{listener} {}
+        using Handler = std::function<void(int)>;
+
+        explicit KeyBindingTable(QWidget* listener);
+        ~KeyBindingTable() override;
 
         template <typename CallableHandler>
         void add(QKeySequence const& keys, CallableHandler&& handler);
+        /*  binds `keys` to `handler()`; a count typed before them is dropped */
 
-        template <typename Handler, typename Callable>
-        void add(QKeySequence const& keys, Handler&& handler, Callable&& f);
+        template <typename Receiver, typename Callable>
+        void add(QKeySequence const& keys, Receiver* receiver, Callable f);
+        /*  binds `keys` to the member function `f` of `receiver` */
 
-        void add(QKeySequence const& keys, const char* handler);
+        template <typename CallableHandler>
+        void addCounted(QKeySequence const& keys, CallableHandler&& handler);
+        /*  binds `keys` to `handler(count)`, where `count` is the number typed before them or 0 if there's none */
+
+        template <typename CallableHandler>
+        void addMotion(QKeySequence const& keys, CallableHandler&& handler);
+        /*  binds `keys` to `handler(count)`, where `count` is at least 1 and includes the auto-repeats of `keys`
+            that were waiting to be processed */
 
-        void add(QKeySequence const& keys, QObject* handler, const char* f);
+        void setCountsEnabled(bool enabled) { _countsEnabled = enabled; }
+        /*  sets whether digits are taken as a count for the binding that follows them (they're not by default) */
 
         /*  a special function is needed to handle the `Enter` key, which need an event filter to be handled */
         void addEnterKeyBinding(EnterKeyReceiver::Callable f) {
@@ -89,27 +122,66 @@ class tffm::KeyBindingTable {
             _enterKeyReceivers.push_back(std::move(r));
         }
 
+    protected:
+        bool eventFilter(QObject* watched, QEvent* event) override;
+
     private:
+        enum class Kind { Plain, Counted, Motion };
+
+        struct Binding {
+            Handler handler;
+            Kind kind;
+        };
+
+        struct Node {
+            std::vector<std::pair<int, std::size_t>> children; // by key and modifiers
+            int binding = -1;                   // bound to the sequence ending here, or -1
+        };
 
         QWidget* _listener;
-        std::vector<std::unique_ptr<QShortcut>> _keyBindings;
+        std::vector<Node> _nodes;               // the trie of bound sequences, rooted at the first node
+        std::vector<Binding> _bindings;
+        std::size_t _state;                     // the node of the keys of a sequence typed so far
+        int _count;                             // the count typed so far, 0 if there's none
+        bool _countsEnabled;
+        int _repeatBinding;                     // the motion whose auto-repeats are waiting, or -1
+        int _repeatCount;                       // the sum of their counts
+        QTimer _repeatTimer;                    // fires once the event queue has been processed
         std::vector<std::unique_ptr<EnterKeyReceiver>> _enterKeyReceivers;
+
+        void insert(QKeySequence const& keys, Handler handler, Kind kind);
+        /*  adds `keys` to the trie, bound to `handler` */
+
+        std::size_t child(std::size_t node, QKeyEvent const* event) const;
+        /*  returns the node reached from `node` by the key of `event`, or 0 (the root) if there's none */
+
+        bool dispatch(QKeyEvent const* event);
+        /*  feeds a key press to the trie (or the count), running the binding it completes; returns whether
+            the key was taken */
+
+        void flushRepeats();
+        /*  runs the motion whose auto-repeats have been coalesced, if any */
 };
 
 template <typename CallableHandler>
 void tffm::KeyBindingTable::add(QKeySequence const& keys, CallableHandler&& handler) {
-    auto s = std::make_unique<QShortcut>(keys, _listener);
-    QObject::connect(s.get(), &QShortcut::activated, std::forward<CallableHandler>(handler));
-    //QObject::connect(s.get(), &QShortcut::activatedAmbiguously, std::forward<CallableHandler>(handler));
-    _keyBindings.push_back(std::move(s));
+    auto f = std::forward<CallableHandler>(handler);
+    insert(keys, [f](int) { f(); }, Kind::Plain);
 }
 
-template <typename Handler, typename Callable>
-void tffm::KeyBindingTable::add(QKeySequence const& keys, Handler&& handler, Callable&& f) {
-    auto s = std::make_unique<QShortcut>(keys, _listener);
-    QObject::connect(s.get(), &QShortcut::activated, std::forward<Handler>(handler), std::forward<Callable>(f));
-    //QObject::connect(s.get(), &QShortcut::activatedAmbiguously, std::forward<Handler>(handler), std::forward<Callable>(f));
-    _keyBindings.push_back(std::move(s));
+template <typename Receiver, typename Callable>
+void tffm::KeyBindingTable::add(QKeySequence const& keys, Receiver* receiver, Callable f) {
+    insert(keys, [receiver, f](int) { (receiver->*f)(); }, Kind::Plain);
+}
+
+template <typename CallableHandler>
+void tffm::KeyBindingTable::addCounted(QKeySequence const& keys, CallableHandler&& handler) {
+    insert(keys, Handler{std::forward<CallableHandler>(handler)}, Kind::Counted);
+}
+
+template <typename CallableHandler>
+void tffm::KeyBindingTable::addMotion(QKeySequence const& keys, CallableHandler&& handler) {
+    insert(keys, Handler{std::forward<CallableHandler>(handler)}, Kind::Motion);
 }
 
 #endif // KEYBINDINGTABLE_HPP
@@ -0,0 +1,409 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "listingcache.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+// Qt classes
+#include <QFile>
+
+// system headers
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+/*  the changes that make a listing stale; attributes and contents of entries aren't part of it */
+constexpr std::uint32_t watchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                  | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+/*  returns whether `path` is under the directory `root` (and not `root` itself) */
+bool isUnder(std::string const& path, std::string const& root) {
+    if (root == "/") return path.size() > 1 && path[0] == '/';
+    return path.size() > root.size() + 1 && path[root.size()] == '/' && path.compare(0, root.size(), root) == 0;
+}
+
+}
+
+constexpr std::size_t tffm::ListingCache::defaultMemoryBudget;
+constexpr std::chrono::seconds tffm::ListingCache::defaultMaxIdle;
+
+tffm::ListingCache::ListingCache(QObject* parent)
+  : QObject{parent}, _epoch{0}, _bytes{0}, _memoryBudget{defaultMemoryBudget}, _maxIdle{0} {
+    // without inotify nothing can be kept correct, so nothing is cached
+    _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotifyFd >= 0) {
+        _notifier = std::make_unique<QSocketNotifier>(_inotifyFd, QSocketNotifier::Read);
+        connect(_notifier.get(), &QSocketNotifier::activated, this, &ListingCache::readEvents);
+    }
+    connect(&_sweepTimer, &QTimer::timeout, this, &ListingCache::sweep);
+    setMaxIdle(defaultMaxIdle);
+}
+
+tffm::ListingCache::~ListingCache() {
+    _notifier.reset();
+    if (_inotifyFd >= 0) close(_inotifyFd); // also removes all watches
+}
+
+/*
+copies the cached listing of `path` into `listing` if there is one, counting a hit or a miss
+*/
+bool tffm::ListingCache::lookup(std::string const& path, Listing& listing) {
+    // changes made before the lookup must not be missed, even if their events haven't been handled yet
+    readEvents();
+
+    auto i = _entries.find(path);
+    if (i == _entries.end()) {
+        ++_counters.misses;
+        return false;
+    }
+
+    auto& entry = i->second;
+    ++_counters.hits;
+    if (entry.prefetched) {
+        ++_counters.prefetchHits;
+        entry.prefetched = false;
+    }
+    entry.lastUsed = Clock::now();
+    listing = entry.listing;
+
+    // the sort keys fill in the metadata of their entries as it's asked for, after they've been cached
+    const auto bytes = memoryUsage(entry.listing);
+    if (bytes != entry.bytes) {
+        _bytes = _bytes - entry.bytes + bytes;
+        entry.bytes = bytes;
+        evictToBudget();
+    }
+    return true;
+}
+
+/*
+starts watching `path`, which is about to be read; the ticket must be passed to `finishLoad`
+*/
+std::uint64_t tffm::ListingCache::prepareLoad(std::string const& path) {
+    auto& watch = _watches[path];
+    if (watch.wd < 0 && _inotifyFd >= 0) {
+        watch.wd = inotify_add_watch(_inotifyFd, path.c_str(), watchMask);
+        if (watch.wd >= 0) {
+            auto& paths = _pathsOfWatch[watch.wd]; // several paths can lead to the same directory
+            if (std::find(paths.begin(), paths.end(), path) == paths.end()) paths.push_back(path);
+        }
+    }
+    ++watch.pendingLoads;
+    return _epoch;
+}
+
+/*
+caches the listing read for `path` unless the directory changed since `prepareLoad`
+
+Changes reported while the directory was being read may or may not show in
+the listing, so it's only kept if no change was reported at all.
+*/
+void tffm::ListingCache::finishLoad(std::string const& path, std::uint64_t ticket, Listing listing, bool prefetched) {
+    readEvents();
+    auto w = _watches.find(path);
+    if (w == _watches.end()) return;
+
+    auto& watch = w->second;
+    --watch.pendingLoads;
+    if (listing.listing && watch.wd >= 0 && watch.invalidatedAt <= ticket) {
+        erase(path);
+        auto& entry = _entries[path];
+        entry.bytes = memoryUsage(listing);
+        entry.listing = std::move(listing);
+        entry.prefetched = prefetched;
+        entry.lastUsed = Clock::now();
+        _bytes += entry.bytes;
+        if (prefetched) ++_counters.prefetches;
+        evictToBudget();
+    }
+    releaseWatch(path);
+}
+
+/*
+attaches the search index built for the cached listing of `path`, if it's still cached
+*/
+void tffm::ListingCache::setSearchIndex(std::string const& path, std::shared_ptr<const SearchIndex> index) {
+    auto i = _entries.find(path);
+    if (i == _entries.end() || !index || index->listing() != i->second.listing.listing) return;
+
+    auto& entry = i->second;
+    _bytes -= entry.bytes;
+    entry.listing.searchIndex = std::move(index);
+    entry.bytes = memoryUsage(entry.listing);
+    _bytes += entry.bytes;
+    evictToBudget();
+}
+
+void tffm::ListingCache::setOrder(std::string const& path, std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortOrder) {
+    auto i = _entries.find(path);
+    if (i == _entries.end() || !keys || keys->listing() != i->second.listing.listing) return;
+
+    auto& entry = i->second;
+    _bytes -= entry.bytes;
+    entry.listing.order = std::move(order);
+    entry.listing.sortKeys = std::move(keys);
+    entry.listing.sortOrder = sortOrder;
+    entry.bytes = memoryUsage(entry.listing);
+    _bytes += entry.bytes;
+    evictToBudget();
+}
+
+void tffm::ListingCache::setMemoryBudget(std::size_t bytes) {
+    _memoryBudget = bytes;
+    evictToBudget();
+}
+
+/*
+sets how long a subtree is kept without being used, checking every quarter of
+that (but at least every minute, so that lowering it takes effect soon)
+*/
+void tffm::ListingCache::setMaxIdle(std::chrono::seconds idle) {
+    _maxIdle = std::max(idle, std::chrono::seconds{0});
+    if (_maxIdle.count() == 0) {
+        _sweepTimer.stop();
+        return;
+    }
+    const auto interval = std::max(std::min(_maxIdle / 4, std::chrono::seconds{60}), std::chrono::seconds{1});
+    _sweepTimer.start(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(interval).count()));
+    sweep();
+}
+
+auto tffm::ListingCache::statistics() const -> Statistics {
+    auto statistics = _counters;
+    statistics.entries = _entries.size();
+    statistics.bytes = _bytes;
+    statistics.memoryBudget = _memoryBudget;
+    return statistics;
+}
+
+/*
+returns the memory taken by each cached listing, biggest first
+*/
+auto tffm::ListingCache::footprints() const -> std::vector<Footprint> {
+    const auto now = Clock::now();
+    const auto uses = subtreeUses();
+    auto footprints = std::vector<Footprint>{};
+    footprints.reserve(_entries.size());
+    for (auto&& entry : _entries) {
+        auto footprint = Footprint{};
+        footprint.path = entry.first;
+        footprint.bytes = entry.second.bytes;
+        footprint.idle = std::chrono::duration_cast<std::chrono::seconds>(now - uses.at(entry.first));
+        footprints.push_back(std::move(footprint));
+    }
+    std::sort(footprints.begin(), footprints.end(), [](Footprint const& a, Footprint const& b){
+        return a.bytes != b.bytes ? a.bytes > b.bytes : a.path < b.path;
+    });
+    return footprints;
+}
+
+/*
+drops the listings of the directories inotify reports changes in
+*/
+void tffm::ListingCache::readEvents() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        const auto n = read(_inotifyFd, buffer, sizeof buffer);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        for (ssize_t pos = 0; pos < n;) {
+            const auto event = reinterpret_cast<const inotify_event*>(buffer + pos);
+            pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // events were lost, so any listing could be stale
+                auto paths = std::vector<std::string>{};
+                for (auto&& watch : _watches) {
+                    paths.push_back(watch.first);
+                }
+                for (auto&& path : paths) {
+                    invalidate(path);
+                }
+                continue;
+            }
+
+            auto watched = _pathsOfWatch.find(event->wd);
+            if (watched == _pathsOfWatch.end()) continue;
+            const auto paths = watched->second;
+            if (event->mask & IN_IGNORED) {
+                // the watch is gone (the directory was removed or unmounted)
+                _pathsOfWatch.erase(watched);
+                for (auto&& path : paths) {
+                    _watches[path].wd = -1;
+                }
+            }
+            // a directory that's gone from its path takes the paths under it along, and the
+            // directories there see no change of their own
+            const bool gone = event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED);
+            for (auto&& path : paths) {
+                if (gone) invalidateSubtree(path);
+                else invalidate(path);
+            }
+        }
+    }
+}
+
+void tffm::ListingCache::invalidate(std::string const& path) {
+    auto w = _watches.find(path);
+    if (w == _watches.end()) return;
+
+    w->second.invalidatedAt = ++_epoch;
+    if (_entries.count(path)) {
+        ++_counters.invalidations;
+        erase(path);
+    }
+    releaseWatch(path);
+    emit invalidated(QFile::decodeName(path.c_str()));
+}
+
+void tffm::ListingCache::invalidateSubtree(std::string const& path) {
+    auto paths = std::vector<std::string>{path};
+    for (auto&& watch : _watches) {
+        if (isUnder(watch.first, path)) paths.push_back(watch.first);
+    }
+    for (auto&& p : paths) {
+        invalidate(p);
+    }
+}
+
+void tffm::ListingCache::erase(std::string const& path) {
+    auto i = _entries.find(path);
+    if (i == _entries.end()) return;
+
+    _bytes -= i->second.bytes;
+    _entries.erase(i);
+}
+
+/*
+stops watching `path` if nothing is cached or being loaded for it
+*/
+void tffm::ListingCache::releaseWatch(std::string const& path) {
+    auto w = _watches.find(path);
+    if (w == _watches.end() || w->second.pendingLoads > 0 || _entries.count(path)) return;
+
+    const int wd = w->second.wd;
+    _watches.erase(w);
+    if (wd < 0) return;
+
+    auto& paths = _pathsOfWatch[wd];
+    paths.erase(std::remove(paths.begin(), paths.end(), path), paths.end());
+    if (paths.empty()) {
+        _pathsOfWatch.erase(wd);
+        inotify_rm_watch(_inotifyFd, wd);
+    }
+}
+
+/*
+evicts the subtrees used the longest ago until the cached listings fit in the budget
+
+Within a subtree, which shares its time of last use, the directories that were
+themselves used the longest ago go first, so a subtree shrinks from the
+branches that were left behind.
+*/
+void tffm::ListingCache::evictToBudget() {
+    if (_bytes <= _memoryBudget) return;
+
+    const auto uses = subtreeUses();
+    auto candidates = std::vector<std::pair<std::pair<Clock::time_point, Clock::time_point>, std::string>>{};
+    candidates.reserve(_entries.size());
+    for (auto&& entry : _entries) {
+        candidates.emplace_back(std::make_pair(uses.at(entry.first), entry.second.lastUsed), entry.first);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (auto&& candidate : candidates) {
+        if (_bytes <= _memoryBudget) break;
+        evict(candidate.second);
+        ++_counters.evictions;
+    }
+}
+
+/*
+evicts the subtrees that haven't been used for `_maxIdle`
+*/
+void tffm::ListingCache::sweep() {
+    if (_maxIdle.count() == 0 || _entries.empty()) return;
+
+    const auto oldest = Clock::now() - _maxIdle;
+    auto expired = std::vector<std::string>{};
+    for (auto&& use : subtreeUses()) {
+        if (use.second < oldest) expired.push_back(use.first);
+    }
+    for (auto&& path : expired) {
+        evict(path);
+        ++_counters.expirations;
+    }
+}
+
+void tffm::ListingCache::evict(std::string const& path) {
+    erase(path);
+    releaseWatch(path);
+}
+
+/*
+returns when each cached directory, or one cached under it, was last used
+
+Each listing's time of use is carried up to every cached directory above it.
+*/
+auto tffm::ListingCache::subtreeUses() const -> std::unordered_map<std::string, Clock::time_point> {
+    auto uses = std::unordered_map<std::string, Clock::time_point>{};
+    uses.reserve(_entries.size());
+    for (auto&& entry : _entries) {
+        auto& use = uses[entry.first];
+        use = std::max(use, entry.second.lastUsed);
+    }
+    for (auto&& entry : _entries) {
+        const auto& path = entry.first;
+        for (auto end = path.size(); path != "/" && end > 0;) {
+            end = path.rfind('/', end - 1);
+            if (end == std::string::npos) break;
+            auto use = uses.find(end == 0 ? std::string{"/"} : path.substr(0, end));
+            if (use != uses.end()) use->second = std::max(use->second, entry.second.lastUsed);
+        }
+    }
+    return uses;
+}
+
+std::size_t tffm::ListingCache::memoryUsage(Listing const& listing) {
+    auto bytes = listing.order.capacity() * sizeof(EntryIndex);
+    if (listing.listing) bytes += listing.listing->memoryUsage();
+    if (listing.searchIndex) bytes += listing.searchIndex->memoryUsage();
+    if (listing.sortKeys) bytes += listing.sortKeys->memoryUsage();
+    return bytes;
+}
@@ -0,0 +1,215 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LISTINGCACHE_HPP
+#define LISTINGCACHE_HPP
+
+// project headers
+#include "directorylisting.hpp"
+#include "searchindex.hpp"
+#include "sortkeys.hpp"
+
+// standard libraries
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Qt classes
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+#include <QTimer>
+
+namespace tffm { class ListingCache; }
+
+/*
+a cache of directory listings, bounded by memory usage
+
+Each cached directory is watched with inotify and dropped as soon as one of
+its entries is created, removed or renamed, so a listing that's handed out
+is never older than the last change the kernel reported. A load has to be
+announced with `prepareLoad()` before the directory is read: that puts the
+watch in place first, and the ticket it returns lets `finishLoad()` tell
+whether the directory changed while it was being read, in which case the
+result is not cached.
+
+Memory is bounded by a budget, and what's evicted first is the subtree (a
+cached directory and the cached directories under it) that was used the
+longest ago: a directory counts as used when it, or any directory under it,
+was. So the way back up from a directory that's still in use (its parents,
+for `h`) is kept over a tree that was walked and left, and a tree that
+hasn't been used for `maxIdle()` is dropped whole even under budget, along
+with its watches. A directory that's removed or renamed takes the listings
+cached under it along, as their paths no longer lead to them.
+
+The cache lives in (and must only be used from) the GUI thread; the loads
+themselves can run anywhere.
+*/
+class tffm::ListingCache : public QObject {
+    Q_OBJECT
+
+    public:
+        using EntryIndex = DirectoryListing::size_type;
+
+        /*  what's kept for each directory */
+        struct Listing {
+            std::shared_ptr<const DirectoryListing> listing;
+            std::vector<EntryIndex> order;                  // display order
+            std::shared_ptr<const SearchIndex> searchIndex; // null until it's been built
+            std::shared_ptr<const SortKeys> sortKeys;       // of `listing`
+            SortKeys::Order sortOrder;                      // what `order` is sorted by
+        };
+
+        struct Statistics {
+            qint64 hits = 0;
+            qint64 misses = 0;
+            qint64 prefetches = 0;      // listings cached ahead of being asked for
+            qint64 prefetchHits = 0;    // hits on those listings
+            qint64 evictions = 0;
+            qint64 expirations = 0;     // listings dropped for not having been used for `maxIdle`
+            qint64 invalidations = 0;
+            std::size_t entries = 0;
+            std::size_t bytes = 0;
+            std::size_t memoryBudget = 0;
+        };
+
+        /*  the memory taken by a cached listing */
+        struct Footprint {
+            std::string path;
+            std::size_t bytes = 0;
+            std::chrono::seconds idle{0};   // since it, or a directory under it, was last used
+        };
+
+        /*  default bound on the memory used by cached listings */
+        static constexpr std::size_t defaultMemoryBudget = std::size_t{256} << 20;
+
+        /*  default time after which a subtree that hasn't been used is dropped */
+        static constexpr std::chrono::seconds defaultMaxIdle = std::chrono::minutes{15};
+
+        explicit ListingCache(QObject* parent = nullptr);
+        ~ListingCache() override;
+
+        bool lookup(std::string const& path, Listing& listing);
+        /*  copies the cached listing of `path` into `listing` if there is one, counting a hit or a miss */
+
+        bool contains(std::string const& path) const { return _entries.count(path) != 0; }
+
+        std::uint64_t prepareLoad(std::string const& path);
+        /*  starts watching `path`, which is about to be read; the ticket must be passed to `finishLoad` */
+
+        void finishLoad(std::string const& path, std::uint64_t ticket, Listing listing, bool prefetched);
+        /*  caches the listing read for `path` unless the directory changed since `prepareLoad`;
+            must be called once per `prepareLoad`, with a null listing if the read failed */
+
+        void setSearchIndex(std::string const& path, std::shared_ptr<const SearchIndex> index);
+        /*  attaches the search index built for the cached listing of `path`, if it's still cached */
+
+        void setOrder(std::string const& path, std::shared_ptr<const SortKeys> keys, std::vector<EntryIndex> order, SortKeys::Order sortOrder);
+        /*  replaces the display order of the cached listing of `path` with `order`, sorted by `sortOrder`
+            (and `keys`), if that listing is still cached */
+
+        void setMemoryBudget(std::size_t bytes);
+        std::size_t memoryBudget() const { return _memoryBudget; }
+
+        void setMaxIdle(std::chrono::seconds idle);
+        std::chrono::seconds maxIdle() const { return _maxIdle; }
+        /*  how long a subtree is kept without being used; 0 keeps it until the budget runs out */
+
+        Statistics statistics() const;
+
+        std::vector<Footprint> footprints() const;
+        /*  returns the memory taken by each cached listing, biggest first */
+
+    signals:
+        void invalidated(QString const& path);
+        /*  emitted when a change is reported in the directory at `path` */
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Watch {
+            int wd = -1;
+            int pendingLoads = 0;
+            std::uint64_t invalidatedAt = 0;
+        };
+
+        struct Entry {
+            Listing listing;
+            std::size_t bytes = 0;
+            bool prefetched = false;
+            Clock::time_point lastUsed;
+        };
+
+        int _inotifyFd;
+        std::unique_ptr<QSocketNotifier> _notifier;
+        std::unordered_map<std::string, Watch> _watches;
+        std::unordered_map<int, std::vector<std::string>> _pathsOfWatch;
+        std::unordered_map<std::string, Entry> _entries;
+        std::uint64_t _epoch;
+        std::size_t _bytes;
+        std::size_t _memoryBudget;
+        std::chrono::seconds _maxIdle;
+        QTimer _sweepTimer;
+        Statistics _counters;
+
+        void readEvents();
+        /*  drops the listings of the directories inotify reports changes in */
+
+        void invalidate(std::string const& path);
+
+        void invalidateSubtree(std::string const& path);
+        /*  drops the listings of `path` and of the directories cached under it */
+
+        void erase(std::string const& path);
+
+        void releaseWatch(std::string const& path);
+        /*  stops watching `path` if nothing is cached or being loaded for it */
+
+        void evictToBudget();
+        /*  evicts the subtrees used the longest ago until the cached listings fit in the budget */
+
+        void sweep();
+        /*  evicts the subtrees that haven't been used for `_maxIdle` */
+
+        void evict(std::string const& path);
+
+        std::unordered_map<std::string, Clock::time_point> subtreeUses() const;
+        /*  returns when each cached directory, or one cached under it, was last used */
+
+        static std::size_t memoryUsage(Listing const& listing);
+};
+
+#endif // LISTINGCACHE_HPP
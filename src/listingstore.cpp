@@ -0,0 +1,469 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "listingstore.hpp"
+#include "entrymetadata.hpp"
+#include "functiontask.hpp"
+#include "searchindex.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <bitset>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+// system headers
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/*  batches bigger than this (and than an eighth of the listing) are applied by reading the directory again */
+constexpr std::size_t maxIncrementalChanges = 4096;
+
+/*  how long a read goes before the entries it has read are shown, about a frame */
+constexpr std::chrono::milliseconds firstStreamDelay{16};
+
+/*  the longest a read that's being streamed goes without showing the entries it has read since */
+constexpr std::chrono::milliseconds maxStreamInterval{500};
+
+/*  FNV-1a, to find the entries a batch of changes refers to without building strings */
+std::uint64_t hashName(const char* name, std::size_t length) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(name[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+
+constexpr tffm::ListingStore::EntryIndex tffm::ListingStore::none;
+
+tffm::ListingStore::ListingStore(QObject* parent)
+  : QObject{parent}, _epoch{0}, _coalescingWindow{DirectoryWatcher::defaultCoalescingWindow} {
+    _loaderPool.setMaxThreadCount(2);
+
+    // in MiB, as `:mem` takes it
+    bool ok = false;
+    const auto budget = qEnvironmentVariableIntValue("TFFM_MEMORY_BUDGET", &ok);
+    if (ok && budget >= 0) _cache.setMemoryBudget(static_cast<std::size_t>(budget) << 20);
+}
+
+tffm::ListingStore::~ListingStore() {
+    _loaderPool.clear();
+    _loaderPool.waitForDone();
+}
+
+/*
+records that a view shows the directory at `path`; the first one starts watching it
+*/
+void tffm::ListingStore::acquire(std::string const& path) {
+    auto& directory = _directories[path];
+    if (directory.views++ > 0) return;
+
+    // watched before it's read, so no change can fall between the two
+    directory.watcher = std::make_unique<DirectoryWatcher>();
+    directory.watcher->setCoalescingWindow(_coalescingWindow);
+    connect(directory.watcher.get(), &DirectoryWatcher::changed, this, [this, path](std::vector<std::string> const& names) {
+        applyChanges(path, names);
+    });
+    connect(directory.watcher.get(), &DirectoryWatcher::overflowed, this, [this, path]() { invalidate(path); });
+    directory.watcher->watch(path);
+    directory.validSince = ++_epoch;
+}
+
+/*
+records that a view no longer shows `path`; once none does, it's no longer watched
+*/
+void tffm::ListingStore::release(std::string const& path) {
+    auto directory = _directories.find(path);
+    if (directory == _directories.end() || --directory->second.views > 0) return;
+
+    _directories.erase(directory);
+
+    // it stops at its next batch; `finishRead` still hands its ticket back to the cache
+    auto read = _reads.find(path);
+    if (read != _reads.end()) {
+        read->second.job->cancelled = true;
+        _reads.erase(read);
+    }
+}
+
+std::shared_ptr<const tffm::SortKeys> tffm::ListingStore::current(std::string const& path) const {
+    const auto directory = _directories.find(path);
+    return directory != _directories.end() ? directory->second.keys : nullptr;
+}
+
+/*
+copies the current listing of `path` or its cached one into `listing`, if there is one
+
+A directory another view shows is taken as that view has it, metadata and
+all, so it isn't `stat`ed twice; the cache only contributes its order, if it
+has one for the same listing. A cached listing becomes the current one, with
+its sizes and times read again, as they aren't watched while it's cached.
+*/
+bool tffm::ListingStore::lookup(std::string const& path, ListingCache::Listing& listing) {
+    auto directory = _directories.find(path);
+    if (directory != _directories.end() && directory->second.keys) {
+        auto const& keys = directory->second.keys;
+        auto cached = ListingCache::Listing{};
+        if (_cache.contains(path) && _cache.lookup(path, cached) && cached.listing == keys->listing()) {
+            listing = std::move(cached);
+        }
+        else {
+            listing = ListingCache::Listing{};
+            listing.listing = keys->listing();
+        }
+        listing.sortKeys = keys;
+        return true;
+    }
+
+    if (!_cache.lookup(path, listing)) return false;
+    listing.sortKeys = std::make_shared<SortKeys>(*listing.sortKeys, std::make_shared<EntryMetadata>(listing.listing));
+    if (directory != _directories.end()) directory->second.keys = listing.sortKeys;
+    return true;
+}
+
+/*
+reads `path`, unless it's already being read; `loaded` is emitted once it's the current listing
+
+A read that was already under way is waited for even if it started before
+the directory was watched (a prefetch, typically): `finishRead` only takes it
+if the cache vouches for it, and reads the directory again otherwise.
+*/
+void tffm::ListingStore::load(std::string const& path, SortKeys::Order sortOrder) {
+    auto read = _reads.find(path);
+    if (read == _reads.end()) startRead(path, sortOrder, false);
+    else read->second.job->streamed = true;
+}
+
+/*
+reads `path` into the cache in the background, unless it's already there, shown or being read
+*/
+void tffm::ListingStore::prefetch(std::string const& path, SortKeys::Order sortOrder) {
+    if (_cache.contains(path) || _reads.count(path) || current(path)) return;
+    startRead(path, sortOrder, true);
+}
+
+/*
+drops the current listing of `path`, as the directory has to be read again
+*/
+void tffm::ListingStore::invalidate(std::string const& path) {
+    auto directory = _directories.find(path);
+    if (directory != _directories.end()) {
+        directory->second.keys.reset();
+        directory->second.pendingNames.clear();
+        directory->second.validSince = ++_epoch;
+    }
+    emit invalidated(path);
+}
+
+void tffm::ListingStore::setCoalescingWindow(int milliseconds) {
+    _coalescingWindow = std::max(0, milliseconds);
+    for (auto&& directory : _directories) {
+        directory.second.watcher->setCoalescingWindow(_coalescingWindow);
+    }
+}
+
+/*
+returns the memory taken by each shown or cached listing, biggest first
+
+A shown directory that's also cached shares its names with the cached
+listing, so only its own sort keys and metadata are added to it.
+*/
+auto tffm::ListingStore::footprints() const -> std::vector<Footprint> {
+    auto footprints = std::vector<Footprint>{};
+    auto indexOf = std::unordered_map<std::string, std::size_t>{};
+    for (auto&& cached : _cache.footprints()) {
+        indexOf.emplace(cached.path, footprints.size());
+        auto footprint = Footprint{};
+        footprint.path = cached.path;
+        footprint.bytes = cached.bytes;
+        footprint.idle = cached.idle;
+        footprints.push_back(std::move(footprint));
+    }
+
+    for (auto&& directory : _directories) {
+        auto const& keys = directory.second.keys;
+        const auto shown = keys ? keys->memoryUsage() : std::size_t{0};
+        auto i = indexOf.find(directory.first);
+        if (i == indexOf.end()) {
+            auto footprint = Footprint{};
+            footprint.path = directory.first;
+            footprint.bytes = shown + (keys ? keys->listing()->memoryUsage() : 0);
+            footprints.push_back(std::move(footprint));
+            i = indexOf.emplace(directory.first, footprints.size() - 1).first;
+        }
+        else {
+            footprints[i->second].bytes += shown;
+        }
+        footprints[i->second].views = directory.second.views;
+        footprints[i->second].idle = std::chrono::seconds{0};
+    }
+
+    std::sort(footprints.begin(), footprints.end(), [](Footprint const& a, Footprint const& b){
+        return a.bytes != b.bytes ? a.bytes > b.bytes : a.path < b.path;
+    });
+    return footprints;
+}
+
+/*
+reads `path` on a loader thread
+*/
+void tffm::ListingStore::startRead(std::string const& path, SortKeys::Order sortOrder, bool prefetch) {
+    auto read = Read{};
+    read.ticket = _cache.prepareLoad(path);
+    read.startedAt = ++_epoch;
+    read.prefetch = prefetch;
+    read.job = std::make_shared<Job>();
+    read.job->streamed = !prefetch;
+    _reads[path] = read;
+    _loaderPool.start(new FunctionTask{[this, path, read, sortOrder]() {
+        // the entries read so far are passed on a frame after the read started, and then less and less often,
+        // as each copy of them costs more
+        auto job = read.job;
+        auto interval = firstStreamDelay;
+        auto lastStreamed = std::chrono::steady_clock::now();
+        const auto batchRead = [this, path, read, job, &interval, &lastStreamed](DirectoryListing const& entries) {
+            if (job->cancelled) return false;
+            const auto now = std::chrono::steady_clock::now();
+            if (!job->streamed || now - lastStreamed < interval) return true;
+
+            auto copy = std::make_shared<const DirectoryListing>(entries);
+            QMetaObject::invokeMethod(this, [this, path, read, copy]() {
+                streamRead(path, read, copy);
+            }, Qt::QueuedConnection);
+            lastStreamed = now;
+            interval = std::min(2 * interval, maxStreamInterval);
+            return true;
+        };
+
+        bool ok = false;
+        auto listing = job->cancelled ? ListingCache::Listing{} : readListing(path, sortOrder, batchRead, ok);
+        QMetaObject::invokeMethod(this, [this, path, read, listing, ok]() {
+            finishRead(path, read, listing, ok);
+        }, Qt::QueuedConnection);
+    }});
+}
+
+/*
+passes the entries a loader thread has read so far on to the views, unless the read is over
+*/
+void tffm::ListingStore::streamRead(std::string const& path, Read const& read, std::shared_ptr<const DirectoryListing> entries) {
+    auto latest = _reads.find(path);
+    if (latest == _reads.end() || latest->second.job != read.job || !_directories.count(path)) return;
+
+    emit streamed(path, extendPartial(*read.job, std::move(entries)));
+}
+
+/*
+returns the change from the entries streamed so far to `entries`, and makes `entries` the ones streamed so far
+
+The reader only ever appends, so the entries streamed so far are the first
+ones of `entries`, in the same order, and keep the metadata read for them.
+*/
+auto tffm::ListingStore::extendPartial(Job& job, std::shared_ptr<const DirectoryListing> entries) -> std::shared_ptr<const Change> {
+    auto change = std::make_shared<Change>();
+    const auto kept = job.partial ? job.partial->listing()->size() : EntryIndex{0};
+    change->newIndexOf.resize(kept);
+    std::iota(change->newIndexOf.begin(), change->newIndexOf.end(), EntryIndex{0});
+    change->firstAdded = kept;
+    change->previous = job.partial;
+    change->keys = std::make_shared<SortKeys>(job.partial ? std::make_shared<EntryMetadata>(entries, *job.partial->metadata(), change->newIndexOf, change->modified)
+                                                          : std::make_shared<EntryMetadata>(entries));
+    job.partial = change->keys;
+    return change;
+}
+
+/*
+caches a listing a loader thread read, and makes it the current one of its views, if it's recent enough
+*/
+void tffm::ListingStore::finishRead(std::string const& path, Read read, ListingCache::Listing listing, bool ok) {
+    auto latest = _reads.find(path);
+    const bool superseded = latest == _reads.end() || latest->second.ticket != read.ticket;
+    if (!superseded) _reads.erase(latest);
+    auto cached = listing;
+    if (!ok) cached.listing.reset();
+    _cache.finishLoad(path, read.ticket, std::move(cached), read.prefetch);
+
+    auto directory = _directories.find(path);
+    if (superseded || directory == _directories.end()) return;
+    if (read.startedAt < directory->second.validSince) {
+        // it may have missed changes, so it's only used if the cache could vouch for it
+        auto vouched = ListingCache::Listing{};
+        if (!ok || !_cache.contains(path) || !_cache.lookup(path, vouched) || vouched.listing != listing.listing) {
+            startRead(path, listing.sortOrder, false);
+            return;
+        }
+    }
+
+    // the views that were shown the entries as they were read are given the rest the same way
+    if (ok && read.job->partial) {
+        auto change = extendPartial(*read.job, listing.listing);
+        listing.sortKeys = change->keys;
+        emit streamed(path, change);
+    }
+
+    directory->second.keys = listing.sortKeys;
+    auto pending = std::move(directory->second.pendingNames);
+    directory->second.pendingNames.clear();
+    emit loaded(path, listing);
+
+    // the directory may have changed while it was being read
+    if (!pending.empty()) {
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+        applyChanges(path, pending);
+    }
+
+    // the listing is shown before the search index is built, as only searching needs it
+    auto entries = listing.listing;
+    _loaderPool.start(new FunctionTask{[this, path, entries]() {
+        auto index = std::make_shared<SearchIndex>(entries);
+        QMetaObject::invokeMethod(this, [this, path, index]() {
+            _cache.setSearchIndex(path, index);
+            emit indexed(path, index);
+        }, Qt::QueuedConnection);
+    }});
+}
+
+/*
+updates the entries of the current listing of `path` called `names` to match the file system
+
+Each name is looked up again rather than trusting the events about it, as it
+may have changed several times since. The listing itself is immutable (the
+views, the cache and the search indexes share it), so a new one is made from
+the entries that are kept and the new ones, once for all the views of the
+directory; each of them then merges the new entries into its own order.
+*/
+void tffm::ListingStore::applyChanges(std::string const& path, std::vector<std::string> const& names) {
+    auto directory = _directories.find(path);
+    if (directory == _directories.end() || names.empty()) return;
+    if (_reads.count(path)) {
+        // applied again to what's being read, once it's read
+        auto& pending = directory->second.pendingNames;
+        pending.insert(pending.end(), names.begin(), names.end());
+    }
+    if (!directory->second.keys) return;
+
+    const auto previousKeys = directory->second.keys;
+    auto const& previous = *previousKeys->listing();
+    if (names.size() > maxIncrementalChanges && names.size() > previous.size() / 8) {
+        invalidate(path);
+        return;
+    }
+
+    // find the entries the names refer to, in a single pass over the listing
+    auto entryOfName = std::vector<EntryIndex>(names.size(), none);
+    auto namesByHash = std::unordered_multimap<std::uint64_t, std::size_t>{};
+    auto hashFilter = std::bitset<4096>{};
+    for (std::size_t n = 0; n < names.size(); ++n) {
+        const auto hash = hashName(names[n].data(), names[n].size());
+        namesByHash.emplace(hash, n);
+        hashFilter.set(hash % hashFilter.size());
+    }
+    for (EntryIndex i = 0; i < previous.size(); ++i) {
+        const auto hash = hashName(previous.name(i), previous.nameLength(i));
+        if (!hashFilter.test(hash % hashFilter.size())) continue;
+        const auto candidates = namesByHash.equal_range(hash);
+        for (auto c = candidates.first; c != candidates.second; ++c) {
+            if (names[c->second] == previous.name(i)) entryOfName[c->second] = i;
+        }
+    }
+
+    const int dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        invalidate(path);
+        return;
+    }
+    // an entry that's still there may have changed size or time (which moves it in those orders)
+    auto removed = std::vector<bool>(previous.size(), false);
+    auto added = std::vector<DirectoryListing::Entry>{};
+    auto modified = std::vector<EntryIndex>{};
+    for (std::size_t n = 0; n < names.size(); ++n) {
+        auto entry = DirectoryListing::Entry{};
+        const bool exists = DirectoryListing::lookup(dirfd, names[n], entry);
+        const auto i = entryOfName[n];
+        if (i != none && exists && entry.type == previous.rawType(i) && entry.inode == previous.inode(i)) {
+            modified.push_back(i);
+            continue;
+        }
+        if (i != none) removed[i] = true;
+        if (exists) added.push_back(std::move(entry));
+    }
+    close(dirfd);
+    if (added.empty() && modified.empty() && std::find(removed.begin(), removed.end(), true) == removed.end()) return;
+
+    auto listing = std::make_shared<DirectoryListing>();
+    listing->assign(previous, removed, added);
+
+    // kept entries move down by the number of entries removed before them; new ones go at the end
+    auto change = std::make_shared<Change>();
+    change->newIndexOf.assign(previous.size(), none);
+    EntryIndex kept = 0;
+    for (EntryIndex i = 0; i < previous.size(); ++i) {
+        if (!removed[i]) change->newIndexOf[i] = kept++;
+    }
+    change->firstAdded = kept;
+
+    // the metadata already read is kept, so only the new and modified entries are `stat`ed again
+    for (auto i : modified) {
+        change->modified.push_back(change->newIndexOf[i]);
+    }
+    auto metadata = std::make_shared<EntryMetadata>(listing, *previousKeys->metadata(), change->newIndexOf, change->modified);
+    change->previous = previousKeys;
+    change->keys = std::make_shared<SortKeys>(metadata);
+
+    directory->second.keys = change->keys;
+    emit changed(path, change);
+}
+
+/*
+reads the directory at `path` and sorts it by `sortOrder`, or by name if that would need every entry `stat`ed
+*/
+auto tffm::ListingStore::readListing(std::string const& path, SortKeys::Order sortOrder, DirectoryListing::BatchRead const& batchRead, bool& ok) -> ListingCache::Listing {
+    auto listing = std::make_shared<DirectoryListing>();
+    ok = listing->read(path, batchRead);
+
+    auto loaded = ListingCache::Listing{};
+    auto keys = std::make_shared<SortKeys>(std::make_shared<EntryMetadata>(listing));
+    loaded.sortOrder = SortKeys::usesMetadata(sortOrder.key) ? SortKeys::Order{} : sortOrder;
+    loaded.order = keys->sorted(loaded.sortOrder);
+    loaded.listing = std::move(listing);
+    loaded.sortKeys = std::move(keys);
+    return loaded;
+}
@@ -0,0 +1,229 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef LISTINGSTORE_HPP
+#define LISTINGSTORE_HPP
+
+// project headers
+#include "directorylisting.hpp"
+#include "directorywatcher.hpp"
+#include "listingcache.hpp"
+#include "sortkeys.hpp"
+
+// standard libraries
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Qt classes
+#include <QObject>
+#include <QThreadPool>
+
+namespace tffm { class ListingStore; }
+
+/*
+the directory listings shared by all the views of a window
+
+Every `DirectoryModel` of a window (one per pane) reads its directory through
+the same store, which keeps one `ListingCache`, one read at a time per
+directory and, for each directory that's being shown, a single
+`DirectoryWatcher` and a single up-to-date listing, however many panes show
+it. Views `acquire()` the directory they show and `release()` it when they
+move on; the first one starts watching it and the last one stops, so the
+store's memory (and its inotify watches) follow the number of distinct
+directories shown rather than the number of panes.
+
+Changes reported by a watcher are applied once, by the store, which makes a
+new listing and emits `changed` with what each entry became; the views of the
+directory then only have to carry their own order and selection over to it.
+A view that missed a change (because it was still loading, say) catches up
+by taking the store's current listing again.
+
+Each read is a job that can be cancelled: once no view shows a directory, its
+read stops at the next batch of entries rather than competing with the one
+the views moved on to. A read that takes more than a frame streams what it
+has read so far to the views, as `streamed` changes that only add entries,
+each listing extending the one before it, until the whole directory is
+`loaded`.
+
+The store lives in (and must only be used from) the GUI thread; it reads
+directories on a pool of its own.
+*/
+class tffm::ListingStore : public QObject {
+    Q_OBJECT
+
+    public:
+        using EntryIndex = DirectoryListing::size_type;
+
+        /*  marks the entries of `Change::newIndexOf` that were removed */
+        static constexpr EntryIndex none = std::numeric_limits<EntryIndex>::max();
+
+        /*  a batch of changes applied to the listing of a directory */
+        struct Change {
+            std::shared_ptr<const SortKeys> previous;   // of the listing the changes were applied to
+            std::shared_ptr<const SortKeys> keys;       // of the new listing
+            std::vector<EntryIndex> newIndexOf;         // the index of each previous entry in the new listing, or `none`
+            std::vector<EntryIndex> modified;           // entries (of the new listing) that were kept but may have new sizes or times
+            EntryIndex firstAdded = 0;                  // the new entries go from here to the end of the new listing
+        };
+
+        /*  the memory taken by the listing of a directory, shown or cached */
+        struct Footprint {
+            std::string path;
+            std::size_t bytes = 0;
+            int views = 0;                              // that show it; 0 if it's only cached
+            std::chrono::seconds idle{0};               // since it, or a cached directory under it, was last used
+        };
+
+        explicit ListingStore(QObject* parent = nullptr);
+        ~ListingStore() override;
+
+        ListingCache& cache() { return _cache; }
+        ListingCache const& cache() const { return _cache; }
+
+        void acquire(std::string const& path);
+        /*  records that a view shows the directory at `path`; the first one starts watching it */
+
+        void release(std::string const& path);
+        /*  records that a view no longer shows `path`; once none does, it's no longer watched, a read of it
+            that's under way is cancelled and its listing is only kept by the cache */
+
+        std::shared_ptr<const SortKeys> current(std::string const& path) const;
+        /*  returns the up-to-date listing of `path` (as its keys), or null if none of its views has one yet */
+
+        bool lookup(std::string const& path, ListingCache::Listing& listing);
+        /*  copies the current listing of `path`, which must be acquired, or its cached one into `listing`, if
+            there is one; its order is left empty unless the cache has one for that very listing */
+
+        void load(std::string const& path, SortKeys::Order sortOrder);
+        /*  reads `path`, which must be acquired, sorted by `sortOrder` if that doesn't need every entry
+            `stat`ed, unless it's already being read; `streamed` is emitted as entries are read, if it takes
+            a while, and `loaded` once it's the current listing */
+
+        void prefetch(std::string const& path, SortKeys::Order sortOrder);
+        /*  reads `path` into the cache in the background, unless it's already there or being read */
+
+        void invalidate(std::string const& path);
+        /*  drops the current listing of `path`, as the directory has to be read again; emits `invalidated` */
+
+        void setCoalescingWindow(int milliseconds);
+        int coalescingWindow() const { return _coalescingWindow; }
+        /*  how long the changes to a directory are collected before being applied as one batch */
+
+        void setMemoryBudget(std::size_t bytes) { _cache.setMemoryBudget(bytes); }
+        std::size_t memoryBudget() const { return _cache.memoryBudget(); }
+        /*  bounds the memory of the listings that are cached but not shown; the shown ones are always kept */
+
+        std::vector<Footprint> footprints() const;
+        /*  returns the memory taken by each shown or cached listing, biggest first */
+
+    signals:
+        void loaded(std::string const& path, ListingCache::Listing const& listing);
+        /*  emitted once a read of `path` is its current listing; `listing.searchIndex` is null, the index is
+            built afterwards and passed on with `indexed` */
+
+        void streamed(std::string const& path, std::shared_ptr<const Change> const& change);
+        /*  emitted while `path` is being read, with the entries read since the last time (`change->previous`
+            is null the first time); the listing read so far is `change->keys`, and it's not current */
+
+        void indexed(std::string const& path, std::shared_ptr<const SearchIndex> const& index);
+        /*  emitted when the search index of a listing `load` read has been built */
+
+        void changed(std::string const& path, std::shared_ptr<const Change> const& change);
+        /*  emitted when a batch of changes has been applied to the current listing of `path` */
+
+        void invalidated(std::string const& path);
+        /*  emitted when `path` has to be read again (it changed too much, or changes were lost); its views
+            should `load` it again */
+
+    private:
+        /*  a directory shown by at least one view */
+        struct Directory {
+            int views = 0;
+            std::unique_ptr<DirectoryWatcher> watcher;
+            std::shared_ptr<const SortKeys> keys;       // the current listing, null until it's been read
+            std::vector<std::string> pendingNames;      // changes reported before it was read
+            std::uint64_t validSince = 0;               // reads started before this missed changes
+        };
+
+        /*  what a loader thread and the GUI thread share about a read */
+        struct Job {
+            std::atomic<bool> cancelled{false};
+            std::atomic<bool> streamed{false};          // whether the entries are passed on as they're read
+            std::shared_ptr<const SortKeys> partial;    // the entries streamed so far (GUI thread only)
+        };
+
+        /*  a read that's under way */
+        struct Read {
+            std::uint64_t ticket = 0;                   // from `ListingCache::prepareLoad`
+            std::uint64_t startedAt = 0;
+            bool prefetch = false;                      // started by `prefetch`, ahead of any view
+            std::shared_ptr<Job> job;
+        };
+
+        ListingCache _cache;
+        std::unordered_map<std::string, Directory> _directories;
+        std::unordered_map<std::string, Read> _reads;
+        std::uint64_t _epoch;
+        int _coalescingWindow;
+        QThreadPool _loaderPool;
+
+        void startRead(std::string const& path, SortKeys::Order sortOrder, bool prefetch);
+        /*  reads `path` on a loader thread */
+
+        void streamRead(std::string const& path, Read const& read, std::shared_ptr<const DirectoryListing> entries);
+        /*  passes the entries a loader thread has read so far on to the views, unless the read is over */
+
+        std::shared_ptr<const Change> extendPartial(Job& job, std::shared_ptr<const DirectoryListing> entries);
+        /*  returns the change from the entries streamed so far to `entries`, which extends them, and makes
+            `entries` the ones streamed so far */
+
+        void finishRead(std::string const& path, Read read, ListingCache::Listing listing, bool ok);
+        /*  caches a listing a loader thread read, and makes it the current one of its views, if it's recent enough */
+
+        void applyChanges(std::string const& path, std::vector<std::string> const& names);
+        /*  updates the entries of the current listing of `path` called `names` to match the file system */
+
+        static ListingCache::Listing readListing(std::string const& path, SortKeys::Order sortOrder, DirectoryListing::BatchRead const& batchRead, bool& ok);
+        /*  reads the directory at `path` (calling `batchRead` after each batch of entries) and sorts it by
+            `sortOrder`, or by name if that would need every entry `stat`ed (which is left to the views);
+            meant to run on a loader thread */
+};
+
+#endif // LISTINGSTORE_HPP
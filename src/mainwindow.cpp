@@ -33,28 +33,300 @@ License:
 
 #include "mainwindow.hpp"
 
+#include <QApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QList>
+#include <QSplitter>
+#include <QStatusBar>
+#include <QTabBar>
+
+namespace {
+
+/*  returns the first pane under `widget` (a pane or a splitter), in layout order */
+tffm::FileManager* firstPane(QWidget* widget) {
+    if (auto pane = qobject_cast<tffm::FileManager*>(widget)) return pane;
+    auto splitter = qobject_cast<QSplitter*>(widget);
+    for (int i = 0; splitter && i < splitter->count(); ++i) {
+        if (auto pane = firstPane(splitter->widget(i))) return pane;
+    }
+    return nullptr;
+}
+
+/*  appends the panes under `widget` to `panes`, in layout order */
+void collectPanes(QWidget* widget, QList<tffm::FileManager*>& panes) {
+    if (auto pane = qobject_cast<tffm::FileManager*>(widget)) {
+        panes << pane;
+        return;
+    }
+    auto splitter = qobject_cast<QSplitter*>(widget);
+    for (int i = 0; splitter && i < splitter->count(); ++i) {
+        collectPanes(splitter->widget(i), panes);
+    }
+}
+
+/*  gives the widgets of `splitter` the same share of its space */
+void equalize(QSplitter* splitter) {
+    auto sizes = QList<int>{};
+    for (int i = 0; i < splitter->count(); ++i) {
+        sizes << 1000;
+    }
+    splitter->setSizes(sizes);
+}
+
+}
+
 tffm::MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), _keyBindings{this} {
     // allocate members
+    _store = std::make_shared<ListingStore>();
     _centralWidget = std::make_unique<QWidget>();
     _mainLayout = std::make_unique<QVBoxLayout>();
-    _fileManager = std::make_unique<FileManager>(this);
+    _tabs = std::make_unique<QTabWidget>(this);
     _inputLine = std::make_unique<InputLine>(this);
 
     // configure layout
     _mainLayout->setMargin(0);
+    _tabs->setDocumentMode(true);
+    _tabs->setTabBarAutoHide(true);
+    _tabs->setFocusPolicy(Qt::NoFocus);
+    _tabs->tabBar()->setFocusPolicy(Qt::NoFocus);
 
     // connect signals to slots
-    connect(_inputLine.get(), &InputLine::textChanged, _fileManager.get(), &FileManager::handleCommandUpdate);
-    connect(_inputLine.get(), &InputLine::commandEntered, _fileManager.get(), &FileManager::handleCommand);
+    connect(_inputLine.get(), &InputLine::textChanged, this, &MainWindow::handleCommandUpdate);
+    connect(_inputLine.get(), &InputLine::commandEntered, this, &MainWindow::handleCommand);
+    connect(statusBar(), &QStatusBar::messageChanged, this, &MainWindow::hideEmptyStatus);
+    connect(qApp, &QApplication::focusChanged, this, [this](QWidget*, QWidget* now){ setActivePane(now); });
+    connect(_tabs.get(), &QTabWidget::currentChanged, this, [this](int index){
+        // the pane that had the focus in that tab gets it back
+        auto page = _tabs->widget(index);
+        if (!page) return;
+        auto pane = qobject_cast<FileManager*>(page->focusWidget());
+        if (!pane) pane = firstPane(page);
+        if (pane) {
+            _activePane = pane;
+            pane->setFocus();
+        }
+    });
 
     // set key bindings
     _keyBindings.add(QKeySequence{Qt::Key_Slash}, _inputLine.get(), &InputLine::enterSearchMode);
     _keyBindings.add(QKeySequence{Qt::Key_Question}, _inputLine.get(), &InputLine::enterReverseSearchMode);
     _keyBindings.add(QKeySequence{Qt::Key_Colon}, _inputLine.get(), &InputLine::enterCommandMode);
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_W, Qt::Key_W}, [this](){ focusNextPane(true); });
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_W, Qt::CTRL + Qt::Key_W}, [this](){ focusNextPane(true); });
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_W, Qt::SHIFT + Qt::Key_W}, [this](){ focusNextPane(false); });
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_W, Qt::Key_S}, [this](){ split(Qt::Vertical); });
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_W, Qt::CTRL + Qt::Key_S}, [this](){ split(Qt::Vertical); });
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_W, Qt::CTRL + Qt::Key_V}, [this](){ split(Qt::Horizontal); });
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_W, Qt::Key_C}, this, &MainWindow::closePane);
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_PageDown}, [this](){ stepTab(true); });
+    _keyBindings.add(QKeySequence{Qt::CTRL + Qt::Key_PageUp}, [this](){ stepTab(false); });
 
     // set widgets
-    _mainLayout->addWidget(_fileManager.get());
+    _mainLayout->addWidget(_tabs.get());
     _mainLayout->addWidget(_inputLine.get());
     _centralWidget->setLayout(_mainLayout.get());
     this->setCentralWidget(_centralWidget.get());
+    statusBar()->hide();
+
+    newTab(QDir::homePath());
+}
+
+/*
+makes a pane showing the directory at `path`, reading through `_store`
+*/
+tffm::FileManager* tffm::MainWindow::newPane(QString const& path) {
+    auto pane = new FileManager{_store, path};
+    connect(pane, &FileManager::statusChanged, this, &MainWindow::showStatus);
+    connect(pane, &FileManager::directoryLoaded, this, [this, pane](){
+        if (pane == _activePane) updateTabTitle(pane);
+    });
+    return pane;
+}
+
+/*
+opens a tab with a single pane showing the directory at `path`
+*/
+void tffm::MainWindow::newTab(QString const& path) {
+    auto page = new QSplitter{};
+    auto pane = newPane(path);
+    page->addWidget(pane);
+    _activePane = pane;
+    _tabs->setCurrentIndex(_tabs->addTab(page, QString{}));
+    pane->setFocus();
+    updateTabTitle(pane);
+}
+
+/*
+splits the active pane in two, side by side (`Qt::Horizontal`) or one above the other, both showing its directory
+
+Splitting in the direction the pane's splitter already goes adds a pane next
+to it; splitting across puts the pane and the new one in a splitter of
+their own, in its place.
+*/
+void tffm::MainWindow::split(Qt::Orientation orientation) {
+    if (!_activePane) return;
+
+    auto pane = _activePane.data();
+    auto splitter = qobject_cast<QSplitter*>(pane->parentWidget());
+    if (!splitter) return;
+    auto newPane = this->newPane(pane->directoryPath());
+    if (splitter->count() == 1 || splitter->orientation() == orientation) {
+        splitter->setOrientation(orientation);
+        splitter->insertWidget(splitter->indexOf(pane) + 1, newPane);
+    }
+    else {
+        auto inner = new QSplitter{orientation};
+        splitter->replaceWidget(splitter->indexOf(pane), inner);
+        inner->addWidget(pane);
+        inner->addWidget(newPane);
+        pane->show();
+        splitter = inner;
+    }
+    equalize(splitter);
+    _activePane = newPane;
+    newPane->setFocus();
+}
+
+/*
+closes the active pane, its tab if it was the last one in it, and the window if it was the last tab
+*/
+void tffm::MainWindow::closePane() {
+    if (!_activePane) return;
+
+    // the pane may be handling the key that closes it, so it's only taken out of its splitter for now
+    auto pane = _activePane.data();
+    auto splitter = qobject_cast<QSplitter*>(pane->parentWidget());
+    pane->hide();
+    pane->setParent(nullptr);
+    pane->deleteLater();
+
+    // splitters left empty go too, up to the tab
+    while (splitter && splitter->count() == 0) {
+        auto parent = qobject_cast<QSplitter*>(splitter->parentWidget());
+        if (!parent) {
+            _tabs->removeTab(_tabs->indexOf(splitter));
+            delete splitter;
+            if (_tabs->count() == 0) {
+                close();
+                return;
+            }
+        }
+        else {
+            delete splitter;
+        }
+        splitter = parent;
+    }
+
+    auto next = firstPane(splitter ? static_cast<QWidget*>(splitter) : _tabs->currentWidget());
+    if (!next) next = firstPane(_tabs->currentWidget());
+    if (next) {
+        _activePane = next;
+        next->setFocus();
+        updateTabTitle(next);
+    }
+}
+
+/*
+moves the focus to the next (or previous) pane of the current tab, wrapping around
+*/
+void tffm::MainWindow::focusNextPane(bool forward) {
+    auto panes = QList<FileManager*>{};
+    collectPanes(_tabs->currentWidget(), panes);
+    if (panes.isEmpty()) return;
+
+    const int position = panes.indexOf(_activePane.data());
+    const int next = position < 0 ? 0 : (position + (forward ? 1 : panes.size() - 1)) % panes.size();
+    panes[next]->setFocus();
+}
+
+/*
+shows the next (or previous) tab, wrapping around
+*/
+void tffm::MainWindow::stepTab(bool forward) {
+    const int count = _tabs->count();
+    if (count > 1) _tabs->setCurrentIndex((_tabs->currentIndex() + (forward ? 1 : count - 1)) % count);
+}
+
+/*
+makes `focused` the active pane, if it's one
+*/
+void tffm::MainWindow::setActivePane(QWidget* focused) {
+    auto pane = qobject_cast<FileManager*>(focused);
+    if (!pane || !isAncestorOf(pane)) return;
+
+    _activePane = pane;
+    updateTabTitle(pane);
+}
+
+/*
+names the tab of `pane` after its directory
+*/
+void tffm::MainWindow::updateTabTitle(FileManager* pane) {
+    QWidget* page = pane;
+    while (page && _tabs->indexOf(page) < 0) {
+        page = page->parentWidget();
+    }
+    if (!page) return;
+
+    const auto path = pane->directoryPath();
+    const auto name = QFileInfo{path}.fileName();
+    _tabs->setTabText(_tabs->indexOf(page), name.isEmpty() ? path : name);
+}
+
+/*
+passes a command being typed on to the active pane
+*/
+void tffm::MainWindow::handleCommandUpdate(QString const& command) {
+    if (_activePane) _activePane->handleCommandUpdate(command);
+}
+
+/*
+runs a command about panes and tabs, or passes it on to the active pane
+*/
+void tffm::MainWindow::handleCommand(QString const& command) {
+    const auto simplified = command.simplified();
+    if (simplified == ":split") {
+        split(Qt::Vertical);
+    }
+    else if (simplified == ":vsplit") {
+        split(Qt::Horizontal);
+    }
+    else if (simplified == ":close") {
+        closePane();
+    }
+    else if (simplified == ":tabnext") {
+        stepTab(true);
+    }
+    else if (simplified == ":tabprevious") {
+        stepTab(false);
+    }
+    else if (simplified == ":tabnew" || simplified.startsWith(":tabnew ")) {
+        // a relative path is taken from the directory of the active pane, as `:cd` would
+        const auto path = command.trimmed().mid(7).trimmed();
+        auto dir = _activePane ? QDir{_activePane->directoryPath()} : QDir::home();
+        if (!path.isEmpty() && !dir.cd(path)) {
+            showStatus(tr("%0 does not exist").arg(path), 5000);
+            return;
+        }
+        newTab(dir.absolutePath());
+    }
+    else if (_activePane) {
+        _activePane->handleCommand(command);
+    }
+}
+
+/*
+shows `message` in the status bar for `timeout` milliseconds (0 means until replaced)
+*/
+void tffm::MainWindow::showStatus(QString const& message, int timeout) {
+    statusBar()->show();
+    statusBar()->showMessage(message, timeout);
+}
+
+/*
+hides the status bar once there's nothing left to show in it
+*/
+void tffm::MainWindow::hideEmptyStatus(QString const& message) {
+    if (message.isEmpty()) statusBar()->hide();
 }
@@ -37,6 +37,8 @@ License:
 #include <memory>
 
 #include <QMainWindow>
+#include <QPointer>
+#include <QTabWidget>
 #include <QVBoxLayout>
 #include <QListView>
 #include <QString>
@@ -44,9 +46,19 @@ License:
 #include "filemanager.hpp"
 #include "inputline.hpp"
 #include "keybindingtable.hpp"
+#include "listingstore.hpp"
 
 namespace tffm { class MainWindow; }
 
+/*
+a window of tabs, each split into panes (file managers)
+
+Each tab is a tree of `QSplitter`s with a `FileManager` at each leaf. All the
+panes of the window read their directories through one `ListingStore`, so a
+directory shown in several of them is read, watched and held in memory once.
+Searches and commands go to the pane that has the focus, except for the ones
+about panes and tabs, which the window handles.
+*/
 class tffm::MainWindow : public QMainWindow {
         Q_OBJECT
 
@@ -57,10 +69,49 @@ class tffm::MainWindow : public QMainWindow {
 
     private:
         tffm::KeyBindingTable _keyBindings;
+        std::shared_ptr<ListingStore> _store;
         std::unique_ptr<QWidget> _centralWidget;
         std::unique_ptr<QVBoxLayout> _mainLayout;
-        std::unique_ptr<FileManager> _fileManager;
+        std::unique_ptr<QTabWidget> _tabs;
         std::unique_ptr<InputLine> _inputLine;
+        QPointer<FileManager> _activePane;      // the pane searches and commands go to
+
+        FileManager* newPane(QString const& path);
+        /*  makes a pane showing the directory at `path`, reading through `_store` */
+
+        void newTab(QString const& path);
+        /*  opens a tab with a single pane showing the directory at `path` */
+
+        void split(Qt::Orientation orientation);
+        /*  splits the active pane in two, side by side (`Qt::Horizontal`) or one above the other, both
+            showing its directory */
+
+        void closePane();
+        /*  closes the active pane, its tab if it was the last one in it, and the window if it was the last tab */
+
+        void focusNextPane(bool forward);
+        /*  moves the focus to the next (or previous) pane of the current tab, wrapping around */
+
+        void stepTab(bool forward);
+        /*  shows the next (or previous) tab, wrapping around */
+
+        void setActivePane(QWidget* focused);
+        /*  makes `focused` the active pane, if it's one */
+
+        void updateTabTitle(FileManager* pane);
+        /*  names the tab of `pane` after its directory */
+
+        void handleCommandUpdate(QString const& command);
+        /*  passes a command being typed on to the active pane */
+
+        void handleCommand(QString const& command);
+        /*  runs a command about panes and tabs, or passes it on to the active pane */
+
+        void showStatus(QString const& message, int timeout);
+        /*  shows `message` in the status bar for `timeout` milliseconds (0 means until replaced) */
+
+        void hideEmptyStatus(QString const& message);
+        /*  hides the status bar once there's nothing left to show in it */
 };
 
 #endif // MAINWINDOW_HPP
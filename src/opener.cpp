@@ -0,0 +1,507 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "opener.hpp"
+#include "functiontask.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cstring>
+
+// Qt classes
+#include <QByteArray>
+#include <QDesktopServices>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QMimeDatabase>
+#include <QMimeType>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStandardPaths>
+#include <QUrl>
+
+// system headers
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+/*  how often the applications that were started are checked for having exited */
+constexpr int reapInterval = 1000; // ms
+
+/*  returns the directories `.desktop` files are looked for in, the one that takes precedence first */
+QStringList applicationDirectories() {
+    return QStandardPaths::standardLocations(QStandardPaths::ApplicationsLocation);
+}
+
+/*  returns the `mimeapps.list` files, the one that takes precedence first, as the MIME applications spec lists them */
+QStringList mimeappsFiles() {
+    auto names = QStringList{};
+    for (auto const& desktop : qEnvironmentVariable("XDG_CURRENT_DESKTOP").split(QChar(':'), QString::SkipEmptyParts)) {
+        names << desktop.toLower() + QStringLiteral("-mimeapps.list");
+    }
+    names << QStringLiteral("mimeapps.list");
+
+    auto files = QStringList{};
+    auto directories = QStandardPaths::standardLocations(QStandardPaths::GenericConfigLocation);
+    directories << applicationDirectories();
+    for (auto const& directory : directories) {
+        for (auto const& name : names) {
+            files << directory + QChar('/') + name;
+        }
+    }
+    return files;
+}
+
+/*  replaces the escape sequences of a value of a desktop entry (`\s`, `\n`, `\t`, `\r`, `\\`) */
+QString unescape(QString const& value) {
+    if (!value.contains(QChar('\\'))) return value;
+
+    auto result = QString{};
+    result.reserve(value.size());
+    for (int i = 0; i < value.size(); ++i) {
+        if (value[i] != QChar('\\') || i + 1 == value.size()) {
+            result += value[i];
+            continue;
+        }
+        switch (value[++i].unicode()) {
+        case 's': result += QChar(' '); break;
+        case 'n': result += QChar('\n'); break;
+        case 't': result += QChar('\t'); break;
+        case 'r': result += QChar('\r'); break;
+        default: result += value[i]; break;
+        }
+    }
+    return result;
+}
+
+/*  splits an `Exec` key into arguments, as the desktop entry spec quotes them; field codes are left as they are */
+QStringList splitExec(QString const& exec) {
+    auto arguments = QStringList{};
+    auto argument = QString{};
+    bool quoted = false;
+    bool started = false;
+    for (int i = 0; i < exec.size(); ++i) {
+        const auto c = exec[i];
+        if (quoted) {
+            if (c == QChar('\\') && i + 1 < exec.size()) argument += exec[++i];
+            else if (c == QChar('"')) quoted = false;
+            else argument += c;
+        }
+        else if (c.isSpace()) {
+            if (started) arguments << argument;
+            argument.clear();
+            started = false;
+        }
+        else if (c == QChar('"')) {
+            quoted = true;
+            started = true;
+        }
+        else {
+            argument += c;
+            started = true;
+        }
+    }
+    if (started) arguments << argument;
+    return arguments;
+}
+
+/*  calls `f(group, key, value)` for each entry of the desktop-entry-style file at `path` */
+template <typename F>
+void readKeyFile(QString const& path, F&& f) {
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    auto group = QString{};
+    for (auto const& rawLine : file.readAll().split('\n')) {
+        const auto line = QString::fromUtf8(rawLine).trimmed();
+        if (line.isEmpty() || line.startsWith(QChar('#'))) continue;
+        if (line.startsWith(QChar('[')) && line.endsWith(QChar(']'))) {
+            group = line.mid(1, line.size() - 2);
+            continue;
+        }
+        const int equals = line.indexOf(QChar('='));
+        if (equals > 0) f(group, line.left(equals).trimmed(), line.mid(equals + 1).trimmed());
+    }
+}
+
+/*  appends the items of `items` that aren't in `list` already */
+void appendNew(QStringList& list, QStringList const& items) {
+    for (auto const& item : items) {
+        if (!list.contains(item)) list << item;
+    }
+}
+
+}
+
+/*
+an application a `.desktop` file describes
+*/
+struct tffm::Opener::Application {
+    QString id;                 // the name of the desktop file, with the directories under `applications/`
+    QString name;
+    QString icon;
+    QString desktopFile;
+    QStringList exec;           // the arguments of `Exec`, field codes included
+    bool terminal = false;
+    bool takesMany = false;     // `%F` or `%U` take all the files at once
+    bool takesFile = false;     // any field code takes files
+};
+
+/*
+what the desktop associates with what, as read from the XDG directories
+*/
+struct tffm::Opener::Associations {
+    QHash<QString, Application> applications;   // by desktop id
+    QHash<QString, QStringList> defaults;       // desktop ids by MIME type, the preferred one first
+    QHash<QString, QStringList> added;          // from `mimeapps.list`, then from the `.desktop` files
+    QHash<QString, QStringList> removed;
+};
+
+tffm::Opener::Opener(QObject* parent) : QObject{parent}, _loadsRunning{0} {
+    _pool.setMaxThreadCount(1);
+
+    _reapTimer.setInterval(reapInterval);
+    connect(&_reapTimer, &QTimer::timeout, this, &Opener::reapChildren);
+
+    // the associations are read again when any of the files they come from changes
+    const auto configDirectories = QStandardPaths::standardLocations(QStandardPaths::GenericConfigLocation);
+    auto directories = configDirectories;
+    directories << applicationDirectories();
+    for (auto const& directory : directories) {
+        const bool isConfig = configDirectories.contains(directory);
+        auto watcher = std::make_unique<DirectoryWatcher>();
+        watcher->watch(QFile::encodeName(directory).toStdString());
+        connect(watcher.get(), &DirectoryWatcher::changed, this, [this, isConfig](std::vector<std::string> const& names) {
+            // a configuration directory has the files of every other program too
+            const bool relevant = !isConfig || std::any_of(names.begin(), names.end(), [](std::string const& name) {
+                return name.size() >= std::strlen("mimeapps.list") && name.compare(name.size() - std::strlen("mimeapps.list"), std::string::npos, "mimeapps.list") == 0;
+            });
+            if (relevant) startLoad();
+        });
+        connect(watcher.get(), &DirectoryWatcher::overflowed, this, &Opener::startLoad);
+        _watchers.push_back(std::move(watcher));
+    }
+
+    startLoad();
+}
+
+tffm::Opener::~Opener() {
+    _pool.waitForDone();
+}
+
+/*
+opens the files at `paths`, starting each application they need once if it can take them all
+*/
+bool tffm::Opener::open(QStringList const& paths) {
+    _errorString.clear();
+    const auto current = associations();
+
+    // files are grouped by application, in the order the applications first come up
+    QMimeDatabase database;
+    auto filesByApplication = QHash<QString, QStringList>{};
+    auto applications = QStringList{};
+    auto unhandled = QStringList{};
+    for (auto const& path : paths) {
+        auto application = applicationForMimeType(*current, database.mimeTypeForFile(path).name());
+        if (!application || application->terminal) {
+            unhandled << path;
+            continue;
+        }
+        if (!filesByApplication.contains(application->id)) applications << application->id;
+        filesByApplication[application->id] << path;
+    }
+
+    bool ok = true;
+    for (auto const& id : applications) {
+        auto const& application = *current->applications.find(id);
+        auto const& files = filesByApplication[id];
+        if (application.takesMany || !application.takesFile) {
+            // one that takes no files (without a field code) is only started once
+            ok = launch(application, files) && ok;
+            continue;
+        }
+        for (auto const& file : files) {
+            ok = launch(application, QStringList{file}) && ok;
+        }
+    }
+    for (auto const& path : unhandled) {
+        if (QDesktopServices::openUrl(QUrl::fromLocalFile(path))) continue;
+        _errorString = tr("couldn't open %0").arg(path);
+        ok = false;
+    }
+    return ok;
+}
+
+/*
+returns the name of the application that would open the file at `path`, or an empty string
+*/
+QString tffm::Opener::applicationFor(QString const& path) {
+    const auto current = associations();
+    auto application = applicationForMimeType(*current, QMimeDatabase{}.mimeTypeForFile(path).name());
+    return application ? application->name : QString{};
+}
+
+/*
+reads the associations on the pool
+*/
+void tffm::Opener::startLoad() {
+    ++_loadsRunning;
+    _pool.start(new FunctionTask{[this]() {
+        auto associations = readAssociations();
+        {
+            QMutexLocker lock{&_loadedMutex};
+            _loaded = std::move(associations);
+        }
+        --_loadsRunning;
+        QMetaObject::invokeMethod(this, [this]() { adoptLoaded(); }, Qt::QueuedConnection);
+    }});
+}
+
+/*
+replaces the associations by the ones the pool read last, if any
+*/
+void tffm::Opener::adoptLoaded() {
+    QMutexLocker lock{&_loadedMutex};
+    if (!_loaded) return;
+
+    _associations = std::move(_loaded);
+    _loaded.reset();
+    _applicationByMimeType.clear();
+}
+
+/*
+returns the current associations, waiting for them to be read if need be
+
+Only the first open after tffm starts, or after the associations changed,
+can have to wait.
+*/
+std::shared_ptr<const tffm::Opener::Associations> tffm::Opener::associations() {
+    if (_loadsRunning > 0) _pool.waitForDone();
+    adoptLoaded();
+    return _associations ? _associations : std::make_shared<const Associations>();
+}
+
+/*
+returns the application `associations` choose for files of `mimeType` (or of a type it's a kind of), or null if
+there's none
+
+As the MIME applications spec says, each type is looked up in the default applications and then in the added
+associations, before the types it's a kind of.
+*/
+tffm::Opener::Application const* tffm::Opener::applicationForMimeType(Associations const& associations, QString const& mimeType) {
+    auto cached = _applicationByMimeType.constFind(mimeType);
+    if (cached == _applicationByMimeType.constEnd()) {
+        auto types = QStringList{mimeType};
+        types << QMimeDatabase{}.mimeTypeForName(mimeType).allAncestors();
+        auto chosen = QString{};
+        for (auto const& type : types) {
+            for (auto const& id : associations.defaults.value(type)) {
+                if (associations.applications.contains(id)) {
+                    chosen = id;
+                    break;
+                }
+            }
+            if (!chosen.isEmpty()) break;
+            const auto removed = associations.removed.value(type);
+            for (auto const& id : associations.added.value(type)) {
+                if (associations.applications.contains(id) && !removed.contains(id)) {
+                    chosen = id;
+                    break;
+                }
+            }
+            if (!chosen.isEmpty()) break;
+        }
+        cached = _applicationByMimeType.insert(mimeType, chosen);
+    }
+    if (cached->isEmpty()) return nullptr;
+    auto application = associations.applications.find(*cached);
+    return application != associations.applications.end() ? &*application : nullptr;
+}
+
+/*
+starts `application` with the files at `paths`, which it must take all at once if there are several
+
+An application whose `Exec` has no field code for files takes none, as the
+desktop entry spec says, so it's started without them.
+*/
+bool tffm::Opener::launch(Application const& application, QStringList const& paths) {
+    // the field codes are expanded as the desktop entry spec says; deprecated ones are dropped
+    auto arguments = std::vector<QByteArray>{};
+    for (auto const& token : application.exec) {
+        if (token == QLatin1String("%F")) {
+            for (auto const& path : paths) arguments.push_back(QFile::encodeName(path));
+            continue;
+        }
+        if (token == QLatin1String("%U")) {
+            for (auto const& path : paths) arguments.push_back(QUrl::fromLocalFile(path).toEncoded());
+            continue;
+        }
+        if (token == QLatin1String("%i")) {
+            if (!application.icon.isEmpty()) {
+                arguments.push_back(QByteArrayLiteral("--icon"));
+                arguments.push_back(QFile::encodeName(application.icon));
+            }
+            continue;
+        }
+        auto argument = QString{};
+        for (int i = 0; i < token.size(); ++i) {
+            if (token[i] != QChar('%') || i + 1 == token.size()) {
+                argument += token[i];
+                continue;
+            }
+            switch (token[++i].unicode()) {
+            case 'f': argument += paths.value(0); break;
+            case 'u': argument += QString::fromUtf8(QUrl::fromLocalFile(paths.value(0)).toEncoded()); break;
+            case 'c': argument += application.name; break;
+            case 'k': argument += application.desktopFile; break;
+            case '%': argument += QChar('%'); break;
+            default: break;
+            }
+        }
+        arguments.push_back(QFile::encodeName(argument));
+    }
+    if (arguments.empty()) {
+        _errorString = tr("%0 has no command to run").arg(application.desktopFile);
+        return false;
+    }
+
+    auto argv = std::vector<char*>{};
+    for (auto& argument : arguments) argv.push_back(argument.data());
+    argv.push_back(nullptr);
+
+    // the application gets a session of its own (so it outlives tffm) and none of the signals Qt blocks
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t noSignals;
+    sigemptyset(&noSignals);
+    posix_spawnattr_setsigmask(&attributes, &noSignals);
+    short flags = POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_SETSID
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attributes, flags);
+    pid_t pid = 0;
+    const int error = posix_spawnp(&pid, argv.front(), nullptr, &attributes, argv.data(), environ);
+    posix_spawnattr_destroy(&attributes);
+    if (error != 0) {
+        _errorString = tr("couldn't start %0: %1").arg(application.name, QString::fromLocal8Bit(std::strerror(error)));
+        return false;
+    }
+
+    _children.push_back(pid);
+    if (!_reapTimer.isActive()) _reapTimer.start();
+    return true;
+}
+
+/*
+collects the exit status of the applications that have exited, so they don't linger as zombies
+*/
+void tffm::Opener::reapChildren() {
+    _children.erase(std::remove_if(_children.begin(), _children.end(), [](pid_t pid) {
+        return waitpid(pid, nullptr, WNOHANG) != 0;
+    }), _children.end());
+    if (_children.empty()) _reapTimer.stop();
+}
+
+/*
+reads the `.desktop` files and the `mimeapps.list` files, in the order they take precedence
+*/
+std::shared_ptr<const tffm::Opener::Associations> tffm::Opener::readAssociations() {
+    auto associations = std::make_shared<Associations>();
+    QMimeDatabase database;
+    const auto canonical = [&database](QString const& type) {
+        const auto mimeType = database.mimeTypeForName(type);
+        return mimeType.isValid() ? mimeType.name() : type; // aliases are looked up under their proper name
+    };
+
+    // a desktop id found in a directory that takes precedence hides the others, even if it's hidden
+    auto seen = QSet<QString>{};
+    auto typesOfApplications = QHash<QString, QStringList>{};
+    for (auto const& directory : applicationDirectories()) {
+        const QDir root{directory};
+        QDirIterator files{directory, QStringList{QStringLiteral("*.desktop")}, QDir::Files, QDirIterator::Subdirectories};
+        while (files.hasNext()) {
+            const auto path = files.next();
+            auto id = root.relativeFilePath(path);
+            id.replace(QChar('/'), QChar('-'));
+            if (seen.contains(id)) continue;
+            seen.insert(id);
+
+            auto application = Application{};
+            application.id = id;
+            application.desktopFile = path;
+            bool valid = true;
+            auto types = QStringList{};
+            readKeyFile(path, [&](QString const& group, QString const& key, QString const& value) {
+                if (group != QLatin1String("Desktop Entry")) return;
+                if (key == QLatin1String("Exec")) application.exec = splitExec(unescape(value));
+                else if (key == QLatin1String("Name")) application.name = unescape(value);
+                else if (key == QLatin1String("Icon")) application.icon = unescape(value);
+                else if (key == QLatin1String("Terminal")) application.terminal = value == QLatin1String("true");
+                else if (key == QLatin1String("MimeType")) types = value.split(QChar(';'), QString::SkipEmptyParts);
+                else if (key == QLatin1String("Hidden") && value == QLatin1String("true")) valid = false;
+                else if (key == QLatin1String("Type") && value != QLatin1String("Application")) valid = false;
+            });
+            if (!valid || application.exec.isEmpty()) continue;
+
+            for (auto const& argument : application.exec) {
+                if (argument == QLatin1String("%F") || argument == QLatin1String("%U")) application.takesMany = true;
+                if (argument.contains(QLatin1String("%f")) || argument.contains(QLatin1String("%u")) || application.takesMany) application.takesFile = true;
+            }
+            if (application.name.isEmpty()) application.name = id;
+            for (auto const& type : types) {
+                typesOfApplications[canonical(type)] << id;
+            }
+            associations->applications.insert(id, std::move(application));
+        }
+    }
+
+    for (auto const& file : mimeappsFiles()) {
+        readKeyFile(file, [&](QString const& group, QString const& key, QString const& value) {
+            const auto ids = value.split(QChar(';'), QString::SkipEmptyParts);
+            if (group == QLatin1String("Default Applications")) appendNew(associations->defaults[canonical(key)], ids);
+            else if (group == QLatin1String("Added Associations")) appendNew(associations->added[canonical(key)], ids);
+            else if (group == QLatin1String("Removed Associations")) appendNew(associations->removed[canonical(key)], ids);
+        });
+    }
+    for (auto i = typesOfApplications.constBegin(); i != typesOfApplications.constEnd(); ++i) {
+        appendNew(associations->added[i.key()], i.value());
+    }
+    return associations;
+}
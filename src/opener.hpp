@@ -0,0 +1,132 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef OPENER_HPP
+#define OPENER_HPP
+
+// project headers
+#include "directorywatcher.hpp"
+
+// standard libraries
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Qt classes
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+// system headers
+#include <sys/types.h>
+
+namespace tffm { class Opener; }
+
+/*
+opens files with the applications the desktop associates with their MIME types, without `xdg-open`
+
+`QDesktopServices::openUrl` runs `xdg-open`, a shell script that reads the
+desktop database again and sniffs the file for every open. Here, the
+associations (the `mimeapps.list` files and the `MimeType` keys of the
+`.desktop` files, found as the XDG MIME applications spec says) are read
+once, in the background, and kept until inotify reports a change to one of
+the directories they come from. A file's MIME type comes from
+`QMimeDatabase`; the application chosen for each type is remembered; the
+application is started directly with `posix_spawnp`, in a session of its own.
+
+Files are grouped by application, and an application that takes several
+files at once (`%F` or `%U` in its `Exec` key) is started once for all of
+them. Files without an application, or whose application has to run in a
+terminal, are left to `QDesktopServices`.
+*/
+class tffm::Opener : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit Opener(QObject* parent = nullptr);
+        ~Opener() override;
+
+        bool open(QStringList const& paths);
+        /*  opens the files at `paths`, starting each application they need once if it can take them all;
+            returns false if anything couldn't be opened (see `errorString()`) */
+
+        QString errorString() const { return _errorString; }
+
+        QString applicationFor(QString const& path);
+        /*  returns the name of the application that would open the file at `path`, or an empty string */
+
+    private:
+        struct Application;
+        struct Associations;
+
+        std::shared_ptr<const Associations> _associations;
+        std::shared_ptr<const Associations> _loaded;        // read by the pool, waiting to be adopted
+        QMutex _loadedMutex;
+        std::atomic<int> _loadsRunning;                     // queued or running on the pool
+        QHash<QString, QString> _applicationByMimeType;     // desktop ids, or empty strings for none
+        std::vector<std::unique_ptr<DirectoryWatcher>> _watchers;
+        std::vector<pid_t> _children;                       // started and not reaped yet
+        QTimer _reapTimer;
+        QString _errorString;
+        QThreadPool _pool;
+
+        void startLoad();
+        /*  reads the associations on the pool */
+
+        void adoptLoaded();
+        /*  replaces the associations by the ones the pool read last, if any */
+
+        std::shared_ptr<const Associations> associations();
+        /*  returns the current associations, waiting for them to be read if need be */
+
+        Application const* applicationForMimeType(Associations const& associations, QString const& mimeType);
+        /*  returns the application `associations` choose for files of `mimeType` (or of a type it's a kind of),
+            or null if there's none */
+
+        static std::shared_ptr<const Associations> readAssociations();
+        /*  reads the `.desktop` files and the `mimeapps.list` files, in the order they take precedence */
+
+        bool launch(Application const& application, QStringList const& paths);
+        /*  starts `application` with the files at `paths`, which it must take all at once if there are several */
+
+        void reapChildren();
+        /*  collects the exit status of the applications that have exited, so they don't linger as zombies */
+};
+
+#endif // OPENER_HPP
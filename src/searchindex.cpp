@@ -0,0 +1,311 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "searchindex.hpp"
+#include "simdscan.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// Qt classes
+#include <QByteArray>
+#include <QFile>
+
+namespace {
+
+// fuzzy and substring scoring, loosely modelled on fzf
+constexpr int scoreMatch = 16;
+constexpr int bonusBoundary = 8;
+constexpr int bonusConsecutive = 4;
+constexpr int penaltyGapStart = 3;
+constexpr int penaltyGapExtension = 1;
+
+bool isSeparator(char c) {
+    return c == '/' || c == '-' || c == '_' || c == '.' || c == ' ';
+}
+
+/*  returns whether position `i` of `text` starts a "word" */
+bool isBoundary(const char* text, std::size_t i) {
+    if (i == 0 || isSeparator(text[i - 1])) return true;
+    return text[i - 1] >= 'a' && text[i - 1] <= 'z' && text[i] >= 'A' && text[i] <= 'Z'; // camelCase
+}
+
+int substringScore(const char* text, std::size_t length, std::size_t position, std::size_t keyLength) {
+    auto score = static_cast<int>(keyLength) * scoreMatch;
+    if (isBoundary(text, position)) score += 2 * bonusBoundary;
+    score -= static_cast<int>(std::min<std::size_t>(position, 20));
+    score -= static_cast<int>(std::min<std::size_t>(length - keyLength, 40) / 4);
+    return score;
+}
+
+/*
+scores the best (shortest) window of `text` containing the characters of
+`key` in order; returns -1 if there's no such window
+*/
+int fuzzyScore(const char* text, std::size_t length, const char* key, std::size_t keyLength) {
+    if (keyLength == 0) return 0;
+
+    // find where the first complete match ends...
+    std::size_t k = 0;
+    std::size_t end = 0;
+    while (end < length && k < keyLength) {
+        if (text[end++] == key[k]) ++k;
+    }
+    if (k < keyLength) return -1;
+
+    // ...and walk back from there to the latest possible start
+    std::size_t start = end;
+    while (k > 0) {
+        if (text[--start] == key[k - 1]) --k;
+    }
+
+    int score = 0;
+    int consecutive = 0;
+    bool inGap = false;
+    for (std::size_t i = start; i < end; ++i) {
+        if (k < keyLength && text[i] == key[k]) {
+            auto s = scoreMatch;
+            if (isBoundary(text, i)) s += k == 0 ? 2 * bonusBoundary : bonusBoundary;
+            if (consecutive > 0) s += bonusConsecutive * consecutive;
+            score += s;
+            ++consecutive;
+            ++k;
+            inGap = false;
+        }
+        else {
+            score -= inGap ? penaltyGapExtension : penaltyGapStart;
+            consecutive = 0;
+            inGap = true;
+        }
+    }
+    return score - static_cast<int>(std::min<std::size_t>(start, 20));
+}
+
+bool isAscii(const char* s, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i) {
+        if (static_cast<unsigned char>(s[i]) >= 0x80) return false;
+    }
+    return true;
+}
+
+}
+
+/*
+builds the index; this sorts every entry twice, so it's meant to run off the GUI thread
+*/
+tffm::SearchIndex::SearchIndex(std::shared_ptr<const DirectoryListing> listing) : _listing{std::move(listing)} {
+    const auto size = _listing->size();
+
+    // fold the names, with a fast path for the (common) pure ASCII ones
+    _foldedOffsets.reserve(size);
+    for (EntryIndex i = 0; i < size; ++i) {
+        _foldedOffsets.push_back(static_cast<std::uint32_t>(_foldedNames.size()));
+        const char* name = _listing->name(i);
+        const auto length = _listing->nameLength(i);
+        if (isAscii(name, length)) {
+            for (std::size_t c = 0; c < length; ++c) {
+                const char ch = name[c];
+                _foldedNames.push_back(ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch);
+            }
+        }
+        else {
+            const auto folded = foldedKey(QFile::decodeName(QByteArray::fromRawData(name, length)));
+            _foldedNames.insert(_foldedNames.end(), folded.begin(), folded.end());
+        }
+        _foldedNames.push_back('\0');
+    }
+    _foldedOffsets.push_back(static_cast<std::uint32_t>(_foldedNames.size())); // so the last name's length is known
+
+    _characterSets.reserve(size);
+    for (EntryIndex i = 0; i < size; ++i) {
+        _characterSets.push_back(characterSet(key(i, true), keyLength(i, true)));
+    }
+
+    _exactOrder.resize(size);
+    for (EntryIndex i = 0; i < size; ++i) {
+        _exactOrder[i] = i;
+    }
+    _foldedOrder = _exactOrder;
+
+    std::sort(_exactOrder.begin(), _exactOrder.end(), [this](EntryIndex a, EntryIndex b) {
+        return std::strcmp(key(a, false), key(b, false)) < 0;
+    });
+    std::sort(_foldedOrder.begin(), _foldedOrder.end(), [this](EntryIndex a, EntryIndex b) {
+        return std::strcmp(key(a, true), key(b, true)) < 0;
+    });
+}
+
+/*
+returns the range of entries whose (case-folded) names start with `key`
+*/
+auto tffm::SearchIndex::find(std::string const& key, bool caseInsensitive) const -> Range {
+    return search(0, _listing->size(), key, caseInsensitive);
+}
+
+/*
+same as `find` but only looks in `within`, the range found for a prefix of `key`
+*/
+auto tffm::SearchIndex::narrow(Range const& within, std::string const& key) const -> Range {
+    return search(within.begin, within.end, key, within.caseInsensitive);
+}
+
+/*
+returns the entries whose (case-folded) names contain `key`, favouring early, word-aligned occurrences
+*/
+auto tffm::SearchIndex::substringMatches(std::string const& key, bool caseInsensitive) const -> std::vector<Match> {
+    auto matches = std::vector<Match>{};
+    const auto size = _listing->size();
+    if (size == 0) return matches;
+
+    if (key.empty()) {
+        matches.reserve(size);
+        for (EntryIndex i = 0; i < size; ++i) matches.push_back(Match{i, 0});
+        return matches;
+    }
+
+    // scan the whole arena at once; names are NUL terminated so a match never spans two of them
+    const char* data = this->key(0, caseInsensitive);
+    const auto dataSize = keyOffset(size - 1, caseInsensitive) + keyLength(size - 1, caseInsensitive);
+    EntryIndex entry = 0;
+    std::size_t position = 0;
+    while (position < dataSize) {
+        auto found = simd::find(data + position, dataSize - position, key.data(), key.size());
+        if (!found) break;
+
+        // names are laid out in entry order, so the entry containing `found` is never behind `entry`
+        const auto offset = static_cast<std::size_t>(found - data);
+        while (keyOffset(entry, caseInsensitive) + keyLength(entry, caseInsensitive) < offset) ++entry;
+
+        const auto start = keyOffset(entry, caseInsensitive);
+        const auto length = keyLength(entry, caseInsensitive);
+        matches.push_back(Match{entry, substringScore(data + start, length, offset - start, key.size())});
+
+        // only the first occurrence in a name counts
+        position = start + length + 1;
+        ++entry;
+        if (entry == size) break;
+    }
+    return matches;
+}
+
+/*
+returns the entries whose (case-folded) names contain the characters of `key` in order,
+favouring consecutive and word-aligned characters
+*/
+auto tffm::SearchIndex::fuzzyMatches(std::string const& key, bool caseInsensitive) const -> std::vector<Match> {
+    // the names are only looked at folded below, so a case-sensitive key is folded as they are
+    auto foldedKey = key;
+    bool isAscii = true;
+    for (auto&& c : foldedKey) {
+        if (static_cast<unsigned char>(c) >= 0x80) isAscii = false;
+        else if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    if (!caseInsensitive && !isAscii) foldedKey = SearchIndex::foldedKey(QFile::decodeName(QByteArray::fromStdString(key)));
+
+    // the character sets (of the folded names) rule out most names without looking at them
+    auto candidates = std::vector<EntryIndex>{};
+    simd::selectSupersets(_characterSets.data(), _characterSets.size(), characterSet(foldedKey.data(), foldedKey.size()), candidates);
+
+    // and a vectorized subsequence test over the folded names, most of the others
+    if (caseInsensitive || isAscii) {
+        simd::filterSubsequences(_foldedNames.data(), _foldedNames.size(), _foldedOffsets.data(), candidates, foldedKey.data(), foldedKey.size());
+    }
+
+    auto matches = std::vector<Match>{};
+    for (auto entry : candidates) {
+        const auto score = fuzzyScore(this->key(entry, caseInsensitive), keyLength(entry, caseInsensitive), key.data(), key.size());
+        if (score >= 0) matches.push_back(Match{entry, score});
+    }
+    return matches;
+}
+
+std::size_t tffm::SearchIndex::memoryUsage() const {
+    return _foldedNames.capacity()
+         + _foldedOffsets.capacity() * sizeof(std::uint32_t)
+         + (_exactOrder.capacity() + _foldedOrder.capacity()) * sizeof(EntryIndex)
+         + _characterSets.capacity() * sizeof(std::uint64_t);
+}
+
+/*
+returns a bit set of the (ASCII case-folded) characters in `s`; unrelated characters may share a bit
+*/
+std::uint64_t tffm::SearchIndex::characterSet(const char* s, std::size_t length) {
+    std::uint64_t set = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+        auto c = static_cast<unsigned char>(s[i]);
+        if (c >= 'A' && c <= 'Z') c = static_cast<unsigned char>(c - 'A' + 'a');
+
+        unsigned bit;
+        if (c >= 'a' && c <= 'z') bit = c - 'a';
+        else if (c >= '0' && c <= '9') bit = 26 + (c - '0');
+        else bit = 36 + c % 28;
+        set |= std::uint64_t{1} << bit;
+    }
+    return set;
+}
+
+auto tffm::SearchIndex::search(EntryIndex begin, EntryIndex end, std::string const& key, bool caseInsensitive) const -> Range {
+    auto const& order = caseInsensitive ? _foldedOrder : _exactOrder;
+    const char* k = key.c_str();
+    const auto n = key.size();
+
+    auto first = std::lower_bound(order.begin() + begin, order.begin() + end, k, [this, caseInsensitive](EntryIndex e, const char* k) {
+        return std::strcmp(this->key(e, caseInsensitive), k) < 0;
+    });
+    auto last = std::upper_bound(first, order.begin() + end, k, [this, caseInsensitive, n](const char* k, EntryIndex e) {
+        return std::strncmp(k, this->key(e, caseInsensitive), n) < 0;
+    });
+
+    auto range = Range{};
+    range.begin = static_cast<EntryIndex>(first - order.begin());
+    range.end = static_cast<EntryIndex>(last - order.begin());
+    range.caseInsensitive = caseInsensitive;
+    return range;
+}
+
+/*
+returns the key to look `pattern` up with, case-sensitively
+*/
+std::string tffm::SearchIndex::exactKey(QString const& pattern) {
+    return QFile::encodeName(pattern).toStdString();
+}
+
+/*
+returns the key to look `pattern` up with, case-insensitively
+*/
+std::string tffm::SearchIndex::foldedKey(QString const& pattern) {
+    return pattern.toCaseFolded().toUtf8().toStdString();
+}
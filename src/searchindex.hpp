@@ -0,0 +1,145 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef SEARCHINDEX_HPP
+#define SEARCHINDEX_HPP
+
+// project headers
+#include "directorylisting.hpp"
+
+// standard libraries
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Qt classes
+#include <QString>
+
+namespace tffm { class SearchIndex; }
+
+/*
+a sorted prefix index over the names of a `DirectoryListing`
+
+The entries are sorted twice: once by their exact names and once by their
+case-folded names (kept in an arena of their own). All the names starting with
+a given prefix are then a contiguous range of one of the two orders, which is
+found with two binary searches. When a prefix is extended by one more
+character, its matches are a sub-range of the previous ones, so the search can
+be narrowed instead of started over.
+
+Substring and fuzzy matches can't use the orders, so they scan the name arenas
+with the vectorized kernels of `simdscan.hpp` instead: substrings are searched
+for across a whole arena in one pass, and fuzzy patterns first discard every
+name that lacks one of their characters, using a 64-bit character set kept for
+each entry, before the remaining candidates are scored.
+*/
+class tffm::SearchIndex {
+    public:
+        using EntryIndex = DirectoryListing::size_type;
+
+        /*  a range of positions in one of the two orders of the index */
+        struct Range {
+            EntryIndex begin = 0;
+            EntryIndex end = 0;
+            bool caseInsensitive = false;
+
+            EntryIndex size() const { return end - begin; }
+            bool empty() const { return begin == end; }
+        };
+
+        /*  an entry matching a substring or fuzzy pattern; higher scores are better matches */
+        struct Match {
+            EntryIndex entry;
+            int score;
+        };
+
+        explicit SearchIndex(std::shared_ptr<const DirectoryListing> listing);
+        /*  builds the index; this sorts every entry twice, so it's meant to run off the GUI thread */
+
+        Range find(std::string const& key, bool caseInsensitive) const;
+        /*  returns the range of entries whose (case-folded) names start with `key` */
+
+        Range narrow(Range const& within, std::string const& key) const;
+        /*  same as `find` but only looks in `within`, the range found for a prefix of `key` */
+
+        std::vector<Match> substringMatches(std::string const& key, bool caseInsensitive) const;
+        /*  returns the entries whose (case-folded) names contain `key`, favouring early, word-aligned occurrences */
+
+        std::vector<Match> fuzzyMatches(std::string const& key, bool caseInsensitive) const;
+        /*  returns the entries whose (case-folded) names contain the characters of `key` in order,
+            favouring consecutive and word-aligned characters */
+
+        EntryIndex entry(Range const& range, EntryIndex i) const {
+            return (range.caseInsensitive ? _foldedOrder : _exactOrder)[range.begin + i];
+        }
+        /*  returns the index in the listing of the `i`th entry of `range` */
+
+        std::shared_ptr<const DirectoryListing> const& listing() const { return _listing; }
+
+        std::size_t memoryUsage() const;
+        /*  returns the number of bytes allocated by the index, not counting the listing it refers to */
+
+        static std::string exactKey(QString const& pattern);
+        /*  returns the key to look `pattern` up with, case-sensitively */
+
+        static std::string foldedKey(QString const& pattern);
+        /*  returns the key to look `pattern` up with, case-insensitively */
+
+    private:
+        std::shared_ptr<const DirectoryListing> _listing;
+        std::vector<char> _foldedNames;
+        std::vector<std::uint32_t> _foldedOffsets;
+        std::vector<EntryIndex> _exactOrder;
+        std::vector<EntryIndex> _foldedOrder;
+        std::vector<std::uint64_t> _characterSets;
+
+        std::size_t keyOffset(EntryIndex entry, bool caseInsensitive) const {
+            return caseInsensitive ? _foldedOffsets[entry] : static_cast<std::size_t>(_listing->name(entry) - _listing->nameData());
+        }
+
+        std::size_t keyLength(EntryIndex entry, bool caseInsensitive) const {
+            return caseInsensitive ? _foldedOffsets[entry + 1] - _foldedOffsets[entry] - 1 : _listing->nameLength(entry);
+        }
+
+        const char* key(EntryIndex entry, bool caseInsensitive) const {
+            return caseInsensitive ? _foldedNames.data() + _foldedOffsets[entry] : _listing->name(entry);
+        }
+
+        static std::uint64_t characterSet(const char* s, std::size_t length);
+        /*  returns a bit set of the (ASCII case-folded) characters in `s`; unrelated characters may share a bit */
+
+        Range search(EntryIndex begin, EntryIndex end, std::string const& key, bool caseInsensitive) const;
+};
+
+#endif // SEARCHINDEX_HPP
@@ -0,0 +1,415 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "simdscan.hpp"
+
+// standard libraries
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TFFM_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/*
+portable implementations
+*/
+
+const char* findScalar(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    return static_cast<const char*>(memmem(haystack, size, needle, length));
+}
+
+char foldAscii(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/*  compares `length` bytes of `text` with the lower-case `key`, ignoring the case of `text` */
+bool equalsCaseless(const char* text, const char* key, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i) {
+        if (foldAscii(text[i]) != key[i]) return false;
+    }
+    return true;
+}
+
+const char* findCaselessScalar(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    if (length > size) return nullptr;
+    for (std::size_t i = 0; i + length <= size; ++i) {
+        if (foldAscii(haystack[i]) == needle[0] && equalsCaseless(haystack + i, needle, length)) return haystack + i;
+    }
+    return nullptr;
+}
+
+std::size_t countScalar(const char* data, std::size_t size, char c) {
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        n += data[i] == c;
+    }
+    return n;
+}
+
+void selectSupersetsScalar(const std::uint64_t* masks, std::size_t count, std::uint64_t required, std::vector<std::uint32_t>& indices) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if ((masks[i] & required) == required) indices.push_back(static_cast<std::uint32_t>(i));
+    }
+}
+
+bool isSubsequence(const char* text, std::size_t size, const char* key, std::size_t length) {
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < size && k < length; ++i) {
+        if (text[i] == key[k]) ++k;
+    }
+    return k == length;
+}
+
+void filterSubsequencesScalar(const char* names, std::size_t, const std::uint32_t* offsets, std::vector<std::uint32_t>& candidates, const char* key, std::size_t length) {
+    auto out = candidates.begin();
+    for (auto i : candidates) {
+        if (isSubsequence(names + offsets[i], offsets[i + 1] - offsets[i] - 1, key, length)) *out++ = i;
+    }
+    candidates.erase(out, candidates.end());
+}
+
+#ifdef TFFM_SIMD_X86
+
+/*
+Substring search compares the first and the last byte of the needle against
+a whole block of candidate positions at once, and only checks the bytes in
+between for the positions where both match (see Wojciech Muła, "SIMD-friendly
+algorithms for substring searching"). The tail of the haystack that's
+shorter than a block is handled by the portable implementation.
+*/
+
+const char* findSse2(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    if (length > size) return nullptr;
+    const auto first = _mm_set1_epi8(needle[0]);
+    const auto last = _mm_set1_epi8(needle[length - 1]);
+
+    std::size_t i = 0;
+    for (; i + length - 1 + 16 <= size; i += 16) {
+        const auto blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        const auto blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + length - 1));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+        while (mask != 0) {
+            const auto bit = static_cast<std::size_t>(__builtin_ctz(mask));
+            if (length <= 2 || std::memcmp(haystack + i + bit + 1, needle + 1, length - 2) == 0) return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(haystack + i, size - i, needle, length);
+}
+
+__attribute__((target("avx2")))
+const char* findAvx2(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    if (length > size) return nullptr;
+    const auto first = _mm256_set1_epi8(needle[0]);
+    const auto last = _mm256_set1_epi8(needle[length - 1]);
+
+    std::size_t i = 0;
+    for (; i + length - 1 + 32 <= size; i += 32) {
+        const auto blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        const auto blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + length - 1));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+        while (mask != 0) {
+            const auto bit = static_cast<std::size_t>(__builtin_ctz(mask));
+            if (length <= 2 || std::memcmp(haystack + i + bit + 1, needle + 1, length - 2) == 0) return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findSse2(haystack + i, size - i, needle, length);
+}
+
+/*
+The caseless search is the same, except that the first and last bytes of
+the needle are compared in both cases, and the candidates are checked with a
+caseless compare.
+*/
+
+char otherCase(char c) {
+    if (c >= 'a' && c <= 'z') return static_cast<char>(c - 'a' + 'A');
+    return c;
+}
+
+const char* findCaselessSse2(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    if (length > size) return nullptr;
+    const auto first = _mm_set1_epi8(needle[0]);
+    const auto firstOther = _mm_set1_epi8(otherCase(needle[0]));
+    const auto last = _mm_set1_epi8(needle[length - 1]);
+    const auto lastOther = _mm_set1_epi8(otherCase(needle[length - 1]));
+
+    std::size_t i = 0;
+    for (; i + length - 1 + 16 <= size; i += 16) {
+        const auto blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        const auto blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + length - 1));
+        const auto matchFirst = _mm_or_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockFirst, firstOther));
+        const auto matchLast = _mm_or_si128(_mm_cmpeq_epi8(blockLast, last), _mm_cmpeq_epi8(blockLast, lastOther));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(matchFirst, matchLast)));
+        while (mask != 0) {
+            const auto bit = static_cast<std::size_t>(__builtin_ctz(mask));
+            if (equalsCaseless(haystack + i + bit, needle, length)) return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findCaselessScalar(haystack + i, size - i, needle, length);
+}
+
+__attribute__((target("avx2")))
+const char* findCaselessAvx2(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    if (length > size) return nullptr;
+    const auto first = _mm256_set1_epi8(needle[0]);
+    const auto firstOther = _mm256_set1_epi8(otherCase(needle[0]));
+    const auto last = _mm256_set1_epi8(needle[length - 1]);
+    const auto lastOther = _mm256_set1_epi8(otherCase(needle[length - 1]));
+
+    std::size_t i = 0;
+    for (; i + length - 1 + 32 <= size; i += 32) {
+        const auto blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        const auto blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + length - 1));
+        const auto matchFirst = _mm256_or_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockFirst, firstOther));
+        const auto matchLast = _mm256_or_si256(_mm256_cmpeq_epi8(blockLast, last), _mm256_cmpeq_epi8(blockLast, lastOther));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(matchFirst, matchLast)));
+        while (mask != 0) {
+            const auto bit = static_cast<std::size_t>(__builtin_ctz(mask));
+            if (equalsCaseless(haystack + i + bit, needle, length)) return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findCaselessSse2(haystack + i, size - i, needle, length);
+}
+
+/*
+Counting compares a block at a time and adds up the bits of the mask.
+*/
+
+std::size_t countSse2(const char* data, std::size_t size, char c) {
+    const auto needle = _mm_set1_epi8(c);
+    std::size_t n = 0;
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        n += static_cast<std::size_t>(__builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)))));
+    }
+    return n + countScalar(data + i, size - i, c);
+}
+
+__attribute__((target("avx2,popcnt")))
+std::size_t countAvx2(const char* data, std::size_t size, char c) {
+    const auto needle = _mm256_set1_epi8(c);
+    std::size_t n = 0;
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        n += static_cast<std::size_t>(__builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)))));
+    }
+    return n + countSse2(data + i, size - i, c);
+}
+
+/*
+Superset selection tests two (SSE2) or four (AVX2) masks per instruction:
+`(mask & required) == required` becomes a compare of `mask & required`
+against `required`, lane by lane.
+*/
+
+void selectSupersetsSse2(const std::uint64_t* masks, std::size_t count, std::uint64_t required, std::vector<std::uint32_t>& indices) {
+    const auto r = _mm_set1_epi64x(static_cast<long long>(required));
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const auto m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i));
+        // SSE2 has no 64-bit compare, so compare 32-bit halves and require both to match
+        const auto eq = _mm_cmpeq_epi32(_mm_and_si128(m, r), r);
+        const auto bits = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if ((bits & 0x3) == 0x3) indices.push_back(static_cast<std::uint32_t>(i));
+        if ((bits & 0xc) == 0xc) indices.push_back(static_cast<std::uint32_t>(i + 1));
+    }
+    for (; i < count; ++i) {
+        if ((masks[i] & required) == required) indices.push_back(static_cast<std::uint32_t>(i));
+    }
+}
+
+__attribute__((target("avx2")))
+void selectSupersetsAvx2(const std::uint64_t* masks, std::size_t count, std::uint64_t required, std::vector<std::uint32_t>& indices) {
+    const auto r = _mm256_set1_epi64x(static_cast<long long>(required));
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const auto m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i));
+        auto bits = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(m, r), r))));
+        while (bits != 0) {
+            indices.push_back(static_cast<std::uint32_t>(i + static_cast<std::size_t>(__builtin_ctz(bits))));
+            bits &= bits - 1;
+        }
+    }
+    for (; i < count; ++i) {
+        if ((masks[i] & required) == required) indices.push_back(static_cast<std::uint32_t>(i));
+    }
+}
+
+/*
+Subsequence filtering loads (up to) the first 64 bytes of a name and turns
+each character of the key into a 64-bit mask of the positions where it
+occurs. The key is then a subsequence if, for each of its characters in
+turn, there's an occurrence after the one picked for the previous character,
+which only takes a mask and a count of trailing zeros. Longer names, and names
+too close to the end of the arena to load 64 bytes, are handled by the
+portable implementation.
+*/
+
+std::uint64_t positionsOf(__m128i const* blocks, char c) {
+    const auto needle = _mm_set1_epi8(c);
+    std::uint64_t mask = 0;
+    for (int b = 0; b < 4; ++b) {
+        mask |= static_cast<std::uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(blocks[b], needle)))) << (16 * b);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+std::uint64_t positionsOf(__m256i const* blocks, char c) {
+    const auto needle = _mm256_set1_epi8(c);
+    const auto low = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(blocks[0], needle)));
+    const auto high = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(blocks[1], needle)));
+    return static_cast<std::uint64_t>(low) | (static_cast<std::uint64_t>(high) << 32);
+}
+
+/*  returns whether the characters of `key` occur in order among the (masked) positions */
+template <typename Block>
+__attribute__((always_inline)) inline bool isSubsequence(Block const* blocks, std::uint64_t valid, const char* key, std::size_t length) {
+    std::uint64_t allowed = valid;
+    for (std::size_t k = 0; k < length; ++k) {
+        const auto positions = positionsOf(blocks, key[k]) & allowed;
+        if (positions == 0) return false;
+        const auto position = __builtin_ctzll(positions);
+        allowed = position == 63 ? 0 : allowed & (~std::uint64_t{0} << (position + 1));
+    }
+    return true;
+}
+
+/*  applies `test` to the names that fit in a 64-byte window, and the portable test to the rest */
+template <typename Test>
+__attribute__((always_inline)) inline void filterSubsequencesWith(Test test, const char* names, std::size_t size, const std::uint32_t* offsets, std::vector<std::uint32_t>& candidates, const char* key, std::size_t length) {
+    auto out = candidates.begin();
+    for (auto i : candidates) {
+        const auto nameLength = offsets[i + 1] - offsets[i] - 1;
+        const char* name = names + offsets[i];
+        const bool matches = nameLength < 64 && offsets[i] + 64 <= size
+                           ? test(name, (std::uint64_t{1} << nameLength) - 1)
+                           : isSubsequence(name, nameLength, key, length);
+        if (matches) *out++ = i;
+    }
+    candidates.erase(out, candidates.end());
+}
+
+void filterSubsequencesSse2(const char* names, std::size_t size, const std::uint32_t* offsets, std::vector<std::uint32_t>& candidates, const char* key, std::size_t length) {
+    filterSubsequencesWith([key, length](const char* name, std::uint64_t valid) {
+        __m128i blocks[4];
+        for (int b = 0; b < 4; ++b) blocks[b] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(name + 16 * b));
+        return isSubsequence(blocks, valid, key, length);
+    }, names, size, offsets, candidates, key, length);
+}
+
+__attribute__((target("avx2")))
+void filterSubsequencesAvx2(const char* names, std::size_t size, const std::uint32_t* offsets, std::vector<std::uint32_t>& candidates, const char* key, std::size_t length) {
+    filterSubsequencesWith([key, length](const char* name, std::uint64_t valid) __attribute__((target("avx2"))) {
+        __m256i blocks[2];
+        for (int b = 0; b < 2; ++b) blocks[b] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(name + 32 * b));
+        return isSubsequence(blocks, valid, key, length);
+    }, names, size, offsets, candidates, key, length);
+}
+
+#endif // TFFM_SIMD_X86
+
+/*
+the implementations picked for this CPU
+*/
+struct Kernels {
+    decltype(&findScalar) find;
+    decltype(&findCaselessScalar) findCaseless;
+    decltype(&countScalar) count;
+    decltype(&selectSupersetsScalar) selectSupersets;
+    decltype(&filterSubsequencesScalar) filterSubsequences;
+    const char* name;
+
+    Kernels() : find{findScalar}, findCaseless{findCaselessScalar}, count{countScalar}, selectSupersets{selectSupersetsScalar}, filterSubsequences{filterSubsequencesScalar}, name{"scalar"} {
+#ifdef TFFM_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            find = findAvx2;
+            findCaseless = findCaselessAvx2;
+            count = countAvx2;
+            selectSupersets = selectSupersetsAvx2;
+            filterSubsequences = filterSubsequencesAvx2;
+            name = "avx2";
+        }
+        else if (__builtin_cpu_supports("sse2")) {
+            find = findSse2;
+            findCaseless = findCaselessSse2;
+            count = countSse2;
+            selectSupersets = selectSupersetsSse2;
+            filterSubsequences = filterSubsequencesSse2;
+            name = "sse2";
+        }
+#endif
+    }
+};
+
+Kernels const& kernels() {
+    static const Kernels k;
+    return k;
+}
+
+}
+
+const char* tffm::simd::find(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    return kernels().find(haystack, size, needle, length);
+}
+
+const char* tffm::simd::findCaseless(const char* haystack, std::size_t size, const char* needle, std::size_t length) {
+    return kernels().findCaseless(haystack, size, needle, length);
+}
+
+std::size_t tffm::simd::count(const char* data, std::size_t size, char c) {
+    return kernels().count(data, size, c);
+}
+
+void tffm::simd::selectSupersets(const std::uint64_t* masks, std::size_t count, std::uint64_t required, std::vector<std::uint32_t>& indices) {
+    kernels().selectSupersets(masks, count, required, indices);
+}
+
+void tffm::simd::filterSubsequences(const char* names, std::size_t size, const std::uint32_t* offsets, std::vector<std::uint32_t>& candidates, const char* key, std::size_t length) {
+    kernels().filterSubsequences(names, size, offsets, candidates, key, length);
+}
+
+const char* tffm::simd::implementation() {
+    return kernels().name;
+}
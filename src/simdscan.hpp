@@ -0,0 +1,71 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef SIMDSCAN_HPP
+#define SIMDSCAN_HPP
+
+// standard libraries
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+vectorized scanning kernels used to match file names and contents
+
+Each kernel has an AVX2, an SSE2 and a portable implementation; the best one
+the CPU supports is picked the first time the kernel is called.
+*/
+namespace tffm { namespace simd {
+
+const char* find(const char* haystack, std::size_t size, const char* needle, std::size_t length);
+/*  returns the first occurrence of `needle` (which must not be empty) in `haystack`, or null */
+
+const char* findCaseless(const char* haystack, std::size_t size, const char* needle, std::size_t length);
+/*  same as `find`, but ignoring the case of ASCII letters; `needle` must be in lower case */
+
+std::size_t count(const char* data, std::size_t size, char c);
+/*  returns the number of occurrences of `c` in `data` (to count lines) */
+
+void selectSupersets(const std::uint64_t* masks, std::size_t count, std::uint64_t required, std::vector<std::uint32_t>& indices);
+/*  appends to `indices` every `i` for which `masks[i]` has all the bits of `required` set */
+
+void filterSubsequences(const char* names, std::size_t size, const std::uint32_t* offsets, std::vector<std::uint32_t>& candidates, const char* key, std::size_t length);
+/*  removes from `candidates` every `i` whose name in the arena `names` of `size` bytes, from
+    `offsets[i]` up to the NUL at `offsets[i + 1] - 1`, doesn't contain the characters of `key` in order */
+
+const char* implementation();
+/*  returns the name of the instruction set the kernels use on this CPU */
+
+}}
+
+#endif // SIMDSCAN_HPP
@@ -0,0 +1,152 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "sizecache.hpp"
+
+// standard libraries
+#include <utility>
+
+// Qt classes
+#include <QByteArray>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+namespace {
+
+/*  identifies the cache files (and the version of their format) */
+constexpr quint32 fileMagic = 0x74666475; // "tfdu"
+constexpr quint32 fileVersion = 2;
+
+}
+
+/*
+copies the record of the directory into `record` if there is one for that modification time
+*/
+bool tffm::SizeCache::lookup(std::uint64_t device, std::uint64_t inode, std::int64_t modificationTime, Record& record) const {
+    QMutexLocker lock{&_mutex};
+    const auto i = _records.find(Key{device, inode});
+    if (i == _records.end() || i->second.modificationTime != modificationTime) return false;
+    record = i->second;
+    return true;
+}
+
+void tffm::SizeCache::insert(std::uint64_t device, std::uint64_t inode, Record record) {
+    QMutexLocker lock{&_mutex};
+    _records[Key{device, inode}] = std::move(record);
+}
+
+void tffm::SizeCache::clear() {
+    QMutexLocker lock{&_mutex};
+    _records.clear();
+}
+
+std::size_t tffm::SizeCache::size() const {
+    QMutexLocker lock{&_mutex};
+    return _records.size();
+}
+
+/*
+replaces the records with the ones saved in the file at `path`
+*/
+bool tffm::SizeCache::load(QString const& path) {
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in{&file};
+
+    quint32 magic = 0, version = 0;
+    quint64 count = 0;
+    in >> magic >> version >> count;
+    if (magic != fileMagic || version != fileVersion) return false;
+
+    auto records = std::unordered_map<Key, Record, KeyHash>{};
+    for (quint64 n = 0; n < count && in.status() == QDataStream::Ok; ++n) {
+        quint64 device = 0, inode = 0, ownBytes = 0;
+        qint64 modificationTime = 0;
+        quint32 subdirectories = 0, linkedFiles = 0;
+        in >> device >> inode >> modificationTime >> ownBytes >> subdirectories;
+
+        auto record = Record{};
+        record.modificationTime = modificationTime;
+        record.ownBytes = ownBytes;
+        for (quint32 s = 0; s < subdirectories && in.status() == QDataStream::Ok; ++s) {
+            QByteArray name;
+            in >> name;
+            record.subdirectories.emplace_back(name.constData(), static_cast<std::size_t>(name.size()));
+        }
+        in >> linkedFiles;
+        for (quint32 l = 0; l < linkedFiles && in.status() == QDataStream::Ok; ++l) {
+            quint64 linkDevice = 0, linkInode = 0, bytes = 0;
+            in >> linkDevice >> linkInode >> bytes;
+            record.linkedFiles.push_back(LinkedFile{linkDevice, linkInode, bytes});
+        }
+        records[Key{device, inode}] = std::move(record);
+    }
+    if (in.status() != QDataStream::Ok) return false;
+
+    QMutexLocker lock{&_mutex};
+    _records = std::move(records);
+    return true;
+}
+
+/*
+writes the records to the file at `path`, replacing it
+*/
+bool tffm::SizeCache::save(QString const& path) const {
+    QDir{}.mkpath(QFileInfo{path}.absolutePath());
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out{&file};
+
+    QMutexLocker lock{&_mutex};
+    out << fileMagic << fileVersion << static_cast<quint64>(_records.size());
+    for (auto&& record : _records) {
+        out << static_cast<quint64>(record.first.device) << static_cast<quint64>(record.first.inode)
+            << static_cast<qint64>(record.second.modificationTime) << static_cast<quint64>(record.second.ownBytes)
+            << static_cast<quint32>(record.second.subdirectories.size());
+        for (auto&& name : record.second.subdirectories) {
+            out << QByteArray::fromRawData(name.data(), static_cast<int>(name.size()));
+        }
+        out << static_cast<quint32>(record.second.linkedFiles.size());
+        for (auto&& file : record.second.linkedFiles) {
+            out << static_cast<quint64>(file.device) << static_cast<quint64>(file.inode) << static_cast<quint64>(file.bytes);
+        }
+    }
+    lock.unlock();
+    return file.commit();
+}
@@ -0,0 +1,117 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef SIZECACHE_HPP
+#define SIZECACHE_HPP
+
+// standard libraries
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Qt classes
+#include <QMutex>
+#include <QString>
+
+namespace tffm { class SizeCache; }
+
+/*
+what `:du` found in each directory it walked, kept between sessions
+
+A directory is identified by its device and inode and its record holds the
+modification time it had when it was read, the space taken by its other
+entries (and itself) and the names of its sub-directories. As long as that
+time hasn't changed no entry was added, removed or renamed in it, so a walk
+only needs to check the sub-directories again, not read the directory and
+`stat` every file in it. A file that grows in place doesn't change its
+directory's time, so its size is only picked up by a walk that ignores the
+cache.
+
+Files with several links are kept apart from the other entries, with their
+device and inode, as they're only counted once per walk, by whichever of
+their directories the walk gets to first; what a directory holds of its own
+can't depend on that.
+
+It can be used from any thread.
+*/
+class tffm::SizeCache {
+    public:
+        /*  a file with several links */
+        struct LinkedFile {
+            std::uint64_t device;
+            std::uint64_t inode;
+            std::uint64_t bytes;
+        };
+
+        struct Record {
+            std::int64_t modificationTime = 0;  // in ns since the epoch
+            std::uint64_t ownBytes = 0;         // the directory itself and its entries, other than sub-directories and linked files
+            std::vector<std::string> subdirectories;
+            std::vector<LinkedFile> linkedFiles;
+        };
+
+        bool lookup(std::uint64_t device, std::uint64_t inode, std::int64_t modificationTime, Record& record) const;
+        /*  copies the record of the directory into `record` if there is one for that modification time */
+
+        void insert(std::uint64_t device, std::uint64_t inode, Record record);
+
+        void clear();
+
+        std::size_t size() const;
+
+        bool load(QString const& path);
+        /*  replaces the records with the ones saved in the file at `path`; returns false if it can't be read */
+
+        bool save(QString const& path) const;
+        /*  writes the records to the file at `path`, replacing it; returns false if it can't be written */
+
+    private:
+        struct Key {
+            std::uint64_t device;
+            std::uint64_t inode;
+
+            bool operator==(Key const& other) const { return device == other.device && inode == other.inode; }
+        };
+
+        struct KeyHash {
+            std::size_t operator()(Key const& key) const { return std::hash<std::uint64_t>{}(key.inode * 31 + key.device); }
+        };
+
+        mutable QMutex _mutex;
+        std::unordered_map<Key, Record, KeyHash> _records;
+};
+
+#endif // SIZECACHE_HPP
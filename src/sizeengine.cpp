@@ -0,0 +1,298 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "sizeengine.hpp"
+#include "directorylisting.hpp"
+#include "functiontask.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Qt classes
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+// system headers
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/*  how often sizes are handed over while a walk is running */
+constexpr int deliveryInterval = 100; // ms
+
+/*  identifies a file with several links */
+struct FileId {
+    std::uint64_t device;
+    std::uint64_t inode;
+
+    bool operator==(FileId const& other) const { return device == other.device && inode == other.inode; }
+};
+
+struct FileIdHash {
+    std::size_t operator()(FileId const& id) const { return std::hash<std::uint64_t>{}(id.inode * 31 + id.device); }
+};
+
+std::int64_t modificationTime(struct stat const& st) {
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/*  the space allocated to a file, which is what du(1) counts */
+std::uint64_t allocatedBytes(struct stat const& st) {
+    return static_cast<std::uint64_t>(st.st_blocks) * 512;
+}
+
+}
+
+/*
+state shared by all the tasks of one walk
+*/
+struct tffm::SizeEngine::Walk {
+    QString root;
+    int rootFd = -1;
+    std::uint64_t device = 0;           // of the root; other file systems aren't walked
+    bool useCache = true;
+    std::atomic<qint64> directoriesRead{0};
+    std::atomic<qint64> bytesSoFar{0};
+    std::atomic<bool> cancelled{false};
+    qint64 bytes = 0;                   // the total, once the walk is done
+    QMutex linksMutex;
+    std::unordered_set<FileId, FileIdHash> linkedFiles; // files with several links already counted
+    QMutex sizesMutex;
+    QStringList newNames;               // sub-directories of the root done since the last delivery
+    QVector<qint64> newSizes;           // ... and their sizes
+
+    bool countLink(std::uint64_t device, std::uint64_t inode) {
+        QMutexLocker lock{&linksMutex};
+        return linkedFiles.insert(FileId{device, inode}).second;
+    }
+
+    ~Walk() {
+        if (rootFd >= 0) close(rootFd);
+    }
+};
+
+/*
+a directory being added up
+
+It's done once the task reading it and those of all its sub-directories are.
+*/
+struct tffm::SizeEngine::Directory {
+    std::shared_ptr<Directory> parent;  // null for the root
+    std::string path;                   // relative to the root, empty for the root itself
+    std::string name;
+    std::atomic<int> pending{1};
+    std::atomic<std::uint64_t> bytes{0};
+};
+
+tffm::SizeEngine::SizeEngine(QObject* parent) : QObject{parent}, _cacheLoaded{false} {
+    _pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+
+    _deliveryTimer.setInterval(deliveryInterval);
+    connect(&_deliveryTimer, &QTimer::timeout, this, &SizeEngine::deliverSizes);
+}
+
+tffm::SizeEngine::~SizeEngine() {
+    if (_walk) _walk->cancelled = true;
+    _pool.waitForDone();
+}
+
+/*
+sets the file the cache is loaded from, before the first walk, and saved to after each one
+*/
+void tffm::SizeEngine::setCacheFile(QString const& path) {
+    _cacheFile = path;
+    _cacheLoaded = false;
+}
+
+/*
+starts computing the space taken by `root` and each of its sub-directories, cancelling any walk that's still running
+*/
+void tffm::SizeEngine::start(QString const& root, bool useCache) {
+    if (_walk) {
+        // its queued tasks return without reading anything; they aren't waited for, and `finishWalk` drops
+        // the walk as superseded when the last one is done
+        auto previous = std::move(_walk);
+        previous->cancelled = true;
+        emit finished(previous->root, 0, previous->directoriesRead, true);
+    }
+
+    auto walk = std::make_shared<Walk>();
+    walk->root = root;
+    walk->useCache = useCache;
+    walk->rootFd = open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct stat st;
+    if (walk->rootFd < 0 || fstat(walk->rootFd, &st) != 0) {
+        emit finished(root, 0, 0, false);
+        return;
+    }
+    walk->device = st.st_dev;
+
+    _walk = walk;
+    _deliveryTimer.start();
+    const bool loadCache = !_cacheLoaded && !_cacheFile.isEmpty();
+    _cacheLoaded = true;
+    const auto cacheFile = _cacheFile;
+    _pool.start(new FunctionTask{[this, walk, loadCache, cacheFile]() {
+        if (loadCache) _cache.load(cacheFile);
+        readDirectory(walk, std::make_shared<Directory>());
+    }});
+}
+
+/*
+stops the running walk, if any; `finished` is still emitted
+*/
+void tffm::SizeEngine::cancel() {
+    if (_walk) _walk->cancelled = true;
+}
+
+/*
+adds up the entries of `dir` (or takes them from the cache) and queues its sub-directories
+
+A directory whose modification time is the one in the cache has the same
+entries as when it was read, so only its sub-directories are visited. Files
+with several links are counted by the first directory of the walk that has
+them, whether it was read or cached.
+*/
+void tffm::SizeEngine::readDirectory(std::shared_ptr<Walk> const& walk, std::shared_ptr<Directory> const& dir) {
+    const int fd = walk->cancelled ? -1 : openat(walk->rootFd, dir->path.empty() ? "." : dir->path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_dev != walk->device) {
+        if (fd >= 0) close(fd);
+        release(walk, dir);
+        return;
+    }
+
+    auto record = SizeCache::Record{};
+    if (!walk->useCache || !_cache.lookup(st.st_dev, st.st_ino, modificationTime(st), record)) {
+        record.modificationTime = modificationTime(st);
+        record.ownBytes = allocatedBytes(st);
+        auto listing = DirectoryListing{};
+        listing.read(fd);
+        for (DirectoryListing::size_type i = 0; i < listing.size(); ++i) {
+            struct stat entry;
+            if (fstatat(fd, listing.name(i), &entry, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            if (S_ISDIR(entry.st_mode)) {
+                if (entry.st_dev == walk->device) record.subdirectories.emplace_back(listing.name(i), listing.nameLength(i));
+            }
+            else if (entry.st_nlink <= 1) {
+                record.ownBytes += allocatedBytes(entry);
+            }
+            else {
+                record.linkedFiles.push_back(SizeCache::LinkedFile{static_cast<std::uint64_t>(entry.st_dev), static_cast<std::uint64_t>(entry.st_ino), allocatedBytes(entry)});
+            }
+        }
+        _cache.insert(st.st_dev, st.st_ino, record);
+    }
+    close(fd);
+
+    auto bytes = record.ownBytes;
+    for (auto&& file : record.linkedFiles) {
+        if (walk->countLink(file.device, file.inode)) bytes += file.bytes;
+    }
+    ++walk->directoriesRead;
+    walk->bytesSoFar += static_cast<qint64>(bytes);
+    dir->bytes += bytes;
+
+    for (auto&& name : record.subdirectories) {
+        auto subdirectory = std::make_shared<Directory>();
+        subdirectory->parent = dir;
+        subdirectory->path = dir->path.empty() ? name : dir->path + '/' + name;
+        subdirectory->name = name;
+        ++dir->pending;
+        _pool.start(new FunctionTask{[this, walk, subdirectory]() { readDirectory(walk, subdirectory); }});
+    }
+    release(walk, dir);
+}
+
+/*
+marks one task working on `dir` as done; the last one adds its total to its parent's
+*/
+void tffm::SizeEngine::release(std::shared_ptr<Walk> const& walk, std::shared_ptr<Directory> const& dir) {
+    if (--dir->pending > 0) return;
+
+    const auto bytes = dir->bytes.load();
+    if (dir->parent) {
+        dir->parent->bytes += bytes;
+        if (!dir->parent->parent && !walk->cancelled) {
+            QMutexLocker lock{&walk->sizesMutex};
+            walk->newNames << QFile::decodeName(dir->name.c_str());
+            walk->newSizes << static_cast<qint64>(bytes);
+        }
+        release(walk, dir->parent);
+    }
+    else {
+        walk->bytes = static_cast<qint64>(bytes);
+        QMetaObject::invokeMethod(this, [this, walk]() { finishWalk(walk); }, Qt::QueuedConnection);
+    }
+}
+
+void tffm::SizeEngine::finishWalk(std::shared_ptr<Walk> const& walk) {
+    if (walk != _walk) return; // superseded; `start()` has already reported it
+
+    deliverSizes();
+    _deliveryTimer.stop();
+    _walk.reset();
+    if (!_cacheFile.isEmpty()) {
+        const auto cacheFile = _cacheFile;
+        _pool.start(new FunctionTask{[this, cacheFile]() { _cache.save(cacheFile); }});
+    }
+    emit finished(walk->root, walk->cancelled ? 0 : walk->bytes, walk->directoriesRead, walk->cancelled);
+}
+
+/*
+emits the sizes computed since the last delivery, and the progress of the walk
+*/
+void tffm::SizeEngine::deliverSizes() {
+    if (!_walk) return;
+
+    auto names = QStringList{};
+    auto sizes = QVector<qint64>{};
+    {
+        QMutexLocker lock{&_walk->sizesMutex};
+        names.swap(_walk->newNames);
+        sizes.swap(_walk->newSizes);
+    }
+    if (!names.isEmpty()) emit sizesComputed(_walk->root, names, sizes);
+    emit progress(_walk->directoriesRead, _walk->bytesSoFar);
+}
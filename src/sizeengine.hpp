@@ -0,0 +1,119 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef SIZEENGINE_HPP
+#define SIZEENGINE_HPP
+
+// project headers
+#include "sizecache.hpp"
+
+// standard libraries
+#include <memory>
+#include <string>
+
+// Qt classes
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+
+namespace tffm { class SizeEngine; }
+
+/*
+computes the space taken by the trees under a directory, for `:du`
+
+Every directory is a task on a pool of worker threads: it's opened relative
+to the root, its entries are `fstatat`ed relative to it and its
+sub-directories are handed to the pool as tasks of their own. A directory's
+total is added to its parent's by whichever task finishes last, as with
+`DeleteEngine`, so the size of each child of the root is known (and handed
+over, in batches, while the walk goes on) as soon as its own tree is done.
+Space is counted in allocated blocks, as du(1) does, files with several links
+are counted once, and the walk stays on the root's file system.
+
+What's read is kept in a `SizeCache`, saved to `setCacheFile()` after each
+walk, so walking a tree again only checks its directories.
+*/
+class tffm::SizeEngine : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit SizeEngine(QObject* parent = nullptr);
+        ~SizeEngine() override;
+
+        void setCacheFile(QString const& path);
+        /*  sets the file the cache is loaded from, before the first walk, and saved to after each one */
+
+        void start(QString const& root, bool useCache);
+        /*  starts computing the space taken by `root` and each of its sub-directories, cancelling any
+            walk that's still running; unless `useCache` is set, every directory is read again */
+
+        void cancel();
+        /*  stops the running walk, if any; `finished` is still emitted */
+
+        bool isRunning() const { return static_cast<bool>(_walk); }
+
+    signals:
+        void sizesComputed(QString const& root, QStringList const& names, QVector<qint64> const& bytes);
+        /*  emitted with the space taken by a batch of sub-directories of `root`, called `names` */
+
+        void progress(qint64 directoriesRead, qint64 bytes);
+        void finished(QString const& root, qint64 bytes, qint64 directoriesRead, bool cancelled);
+
+    private:
+        struct Walk;
+        struct Directory;
+
+        std::shared_ptr<Walk> _walk;
+        SizeCache _cache;
+        QString _cacheFile;
+        bool _cacheLoaded;
+        QTimer _deliveryTimer;
+        QThreadPool _pool;
+
+        void readDirectory(std::shared_ptr<Walk> const& walk, std::shared_ptr<Directory> const& dir);
+        /*  adds up the entries of `dir` (or takes them from the cache) and queues its sub-directories (runs on the pool) */
+
+        void release(std::shared_ptr<Walk> const& walk, std::shared_ptr<Directory> const& dir);
+        /*  marks one task working on `dir` as done; the last one adds its total to its parent's */
+
+        void finishWalk(std::shared_ptr<Walk> const& walk);
+
+        void deliverSizes();
+        /*  emits the sizes computed since the last delivery, and the progress of the walk */
+};
+
+#endif // SIZEENGINE_HPP
@@ -0,0 +1,356 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "sortkeys.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+// Qt classes
+#include <QMutexLocker>
+
+namespace {
+
+/*  ranges at most this long are sorted with comparisons instead of a radix sort */
+constexpr std::size_t maxComparisonSort = 1024;
+
+/*  how many entries ahead the keys to sort are prefetched */
+constexpr std::size_t prefetchDistance = 16;
+
+char fold(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/*  maps a signed time to an unsigned value in the same order */
+std::uint64_t timeKey(std::int64_t nanoseconds) {
+    return static_cast<std::uint64_t>(nanoseconds) ^ (std::uint64_t{1} << 63);
+}
+
+/*
+stable LSD radix sort of `items` by key; `scratch` must have room for as many
+items. Passes over digits that are the same in every key are skipped, which
+is most of them for sizes and times.
+*/
+template <typename Item>
+void radixSort(Item* items, Item* scratch, std::size_t size) {
+    const unsigned bits = size >= (std::size_t{1} << 16) ? 16 : 8;
+    const std::size_t buckets = std::size_t{1} << bits;
+    const std::uint64_t mask = buckets - 1;
+    const unsigned passes = 64 / bits;
+
+    auto counts = std::vector<std::uint32_t>(passes * buckets, 0);
+    for (std::size_t i = 0; i < size; ++i) {
+        const auto key = items[i].key;
+        for (unsigned p = 0; p < passes; ++p) {
+            ++counts[p * buckets + ((key >> (p * bits)) & mask)];
+        }
+    }
+
+    Item* from = items;
+    Item* to = scratch;
+    for (unsigned p = 0; p < passes; ++p) {
+        auto count = counts.data() + p * buckets;
+        const auto shift = p * bits;
+        if (count[(from[0].key >> shift) & mask] == size) continue;
+
+        std::uint32_t offset = 0;
+        for (std::size_t b = 0; b < buckets; ++b) {
+            const auto c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (std::size_t i = 0; i < size; ++i) {
+            to[count[(from[i].key >> shift) & mask]++] = from[i];
+        }
+        std::swap(from, to);
+    }
+    if (from != items) std::copy(from, from + size, items);
+}
+
+}
+
+struct tffm::SortKeys::Item {
+    std::uint64_t key;
+    EntryIndex entry;
+};
+
+tffm::SortKeys::SortKeys(std::shared_ptr<EntryMetadata> metadata) : _listing{metadata->listing()}, _metadata{std::move(metadata)} {}
+
+tffm::SortKeys::SortKeys(SortKeys const& keys, std::shared_ptr<EntryMetadata> metadata) : SortKeys{std::move(metadata)} {
+    QMutexLocker lock{&keys._mutex};
+    std::copy(std::begin(keys._textKeys), std::end(keys._textKeys), std::begin(_textKeys));
+    std::copy(std::begin(keys._sortedEntries), std::end(keys._sortedEntries), std::begin(_sortedEntries));
+}
+
+/*
+returns the indices of all the entries, directories first, each group sorted by `order`
+*/
+auto tffm::SortKeys::sorted(Order const& order) const -> std::vector<EntryIndex> {
+    const auto sortedEntries = this->sortedEntries(order.key);
+    auto entries = sortedEntries->entries;
+    const bool byMetadata = usesMetadata(order.key);
+    if (byMetadata) _metadata->readAll();
+
+    const auto size = entries.size();
+    auto items = std::unique_ptr<Item[]>{byMetadata ? new Item[size] : nullptr};
+    auto scratch = std::unique_ptr<Item[]>{byMetadata ? new Item[size] : nullptr};
+    const std::pair<std::size_t, std::size_t> groups[] = {{0, sortedEntries->directories}, {sortedEntries->directories, size}};
+    for (auto&& group : groups) {
+        const auto first = entries.data() + group.first;
+        const auto last = entries.data() + group.second;
+        if (byMetadata && last - first > 1) {
+            // the radix sort is stable, so entries of the same size (or time) stay in name order
+            for (auto e = first; e != last; ++e) {
+                const auto key = order.key == Key::Size ? _metadata->size(*e) : timeKey(_metadata->modificationTime(*e));
+                items[static_cast<std::size_t>(e - first)] = Item{key, *e};
+            }
+            radixSort(items.get(), scratch.get(), static_cast<std::size_t>(last - first));
+            for (auto e = first; e != last; ++e) {
+                *e = items[static_cast<std::size_t>(e - first)].entry;
+            }
+        }
+        if (order.reversed) std::reverse(first, last);
+    }
+    return entries;
+}
+
+auto tffm::SortKeys::comparator(Order const& order) const -> Comparator {
+    auto comparator = Comparator{};
+    comparator._listing = _listing;
+    comparator._textKeys = textKeys(order.key);
+    if (usesMetadata(order.key)) comparator._metadata = _metadata;
+    comparator._key = order.key;
+    comparator._reversed = order.reversed;
+    return comparator;
+}
+
+std::size_t tffm::SortKeys::memoryUsage() const {
+    QMutexLocker lock{&_mutex};
+    std::size_t bytes = 0;
+    for (auto&& keys : _textKeys) {
+        if (keys) bytes += keys->bytes.capacity() + keys->offsets.capacity() * sizeof(std::uint32_t);
+    }
+    for (auto&& sorted : _sortedEntries) {
+        if (sorted) bytes += sorted->entries.capacity() * sizeof(EntryIndex);
+    }
+    return bytes + _metadata->memoryUsage();
+}
+
+auto tffm::SortKeys::textKeys(Key key) const -> std::shared_ptr<const TextKeys> {
+    const auto k = textKeyIndex(key);
+    {
+        QMutexLocker lock{&_mutex};
+        if (_textKeys[k]) return _textKeys[k];
+    }
+
+    // built without holding the lock, as it takes a while; two threads may both build them
+    auto keys = buildTextKeys(key);
+    QMutexLocker lock{&_mutex};
+    if (!_textKeys[k]) _textKeys[k] = std::move(keys);
+    return _textKeys[k];
+}
+
+auto tffm::SortKeys::sortedEntries(Key key) const -> std::shared_ptr<const SortedEntries> {
+    const auto k = textKeyIndex(key);
+    {
+        QMutexLocker lock{&_mutex};
+        if (_sortedEntries[k]) return _sortedEntries[k];
+    }
+
+    const auto keys = textKeys(key);
+    const auto size = _listing->size();
+    auto sorted = std::make_shared<SortedEntries>();
+    sorted->entries.reserve(size);
+    for (EntryIndex i = 0; i < size; ++i) {
+        if (_listing->isDirectory(i)) sorted->entries.push_back(i);
+    }
+    sorted->directories = sorted->entries.size();
+    for (EntryIndex i = 0; i < size; ++i) {
+        if (!_listing->isDirectory(i)) sorted->entries.push_back(i);
+    }
+
+    auto items = std::unique_ptr<Item[]>{new Item[size]};
+    auto scratch = std::unique_ptr<Item[]>{new Item[size]};
+    const auto entries = sorted->entries.data();
+    sortByText(entries, entries + sorted->directories, *keys, items.get(), scratch.get(), 0);
+    sortByText(entries + sorted->directories, entries + size, *keys, items.get(), scratch.get(), 0);
+
+    QMutexLocker lock{&_mutex};
+    if (!_sortedEntries[k]) _sortedEntries[k] = std::move(sorted);
+    return _sortedEntries[k];
+}
+
+auto tffm::SortKeys::buildTextKeys(Key key) const -> std::shared_ptr<const TextKeys> {
+    const auto size = _listing->size();
+    auto keys = std::make_shared<TextKeys>();
+    keys->offsets.reserve(size + 1);
+
+    if (key != Key::Natural && key != Key::Extension) {
+        // the folded names are laid out like the names, so the whole arena is folded in one go
+        const char* names = _listing->nameData();
+        const auto namesSize = _listing->nameDataSize();
+        keys->bytes.resize(namesSize + 8);
+        std::transform(names, names + namesSize, keys->bytes.begin(), fold);
+        for (EntryIndex i = 0; i < size; ++i) {
+            keys->offsets.push_back(static_cast<std::uint32_t>(_listing->name(i) - names));
+        }
+        keys->offsets.push_back(static_cast<std::uint32_t>(namesSize));
+        return keys;
+    }
+
+    // written through a pointer, making room for the longest key a name can give first
+    std::size_t position = 0;
+    for (EntryIndex i = 0; i < size; ++i) {
+        const char* name = _listing->name(i);
+        const auto length = _listing->nameLength(i);
+        if (keys->bytes.size() < position + 3 * length + 2) keys->bytes.resize(std::max(2 * keys->bytes.size(), position + 3 * length + 2));
+        keys->offsets.push_back(static_cast<std::uint32_t>(position));
+        char* out = keys->bytes.data() + position;
+
+        if (key == Key::Natural) {
+            // each run of digits becomes '0', its length (without leading zeros) and its digits,
+            // so shorter numbers come first and numbers of the same length compare digit by digit
+            for (std::size_t c = 0; c < length;) {
+                if (!isDigit(name[c])) {
+                    *out++ = fold(name[c++]);
+                    continue;
+                }
+                auto start = c;
+                while (c < length && isDigit(name[c])) ++c;
+                while (start + 1 < c && name[start] == '0') ++start;
+                *out++ = '0';
+                *out++ = static_cast<char>(std::min<std::size_t>(c - start, 255));
+                out = std::copy(name + start, name + c, out);
+            }
+        }
+        else {
+            // no extension sorts first; "\1" ends the extension so "c" comes before "cpp"
+            const char* dot = static_cast<const char*>(memrchr(name + 1, '.', length > 0 ? length - 1 : 0));
+            if (dot) out = std::transform(dot + 1, name + length, out, fold);
+            *out++ = '\1';
+            out = std::transform(name, name + length, out, fold);
+        }
+        *out++ = '\0';
+        position = static_cast<std::size_t>(out - keys->bytes.data());
+    }
+    keys->offsets.push_back(static_cast<std::uint32_t>(position));
+    keys->bytes.resize(position + 8); // so eight bytes can be read from any key
+    keys->bytes.shrink_to_fit();
+    return keys;
+}
+
+/*
+sorts the entries in [`first`, `last`) by their keys, which are known to be
+the same up to `depth`; `items` and `scratch` must have room for as many items
+
+The first eight bytes (after `depth`) of each key are packed into an integer,
+which are radix sorted. Runs of equal integers are then sorted by the next
+eight bytes, unless their keys end within these, in which case only the exact
+names can tell them apart.
+*/
+void tffm::SortKeys::sortByText(EntryIndex* first, EntryIndex* last, TextKeys const& keys, Item* items, Item* scratch, std::size_t depth) const {
+    const auto size = static_cast<std::size_t>(last - first);
+    if (size < 2) return;
+
+    // the keys are all over the arena by now, so they (and their offsets, further ahead) are prefetched
+    for (std::size_t i = 0; i < size; ++i) {
+        if (i + 2 * prefetchDistance < size) __builtin_prefetch(&keys.offsets[first[i + 2 * prefetchDistance]]);
+        if (i + prefetchDistance < size) __builtin_prefetch(keys.key(first[i + prefetchDistance]) + depth);
+        const auto e = first[i];
+        const auto length = keys.length(e);
+        std::uint64_t word = 0;
+        if (depth < length) {
+            const auto bytes = reinterpret_cast<const unsigned char*>(keys.key(e) + depth);
+            for (unsigned b = 0; b < 8; ++b) {
+                word = (word << 8) | bytes[b];
+            }
+            const auto remaining = length - depth;
+            if (remaining < 8) word &= ~std::uint64_t{0} << (8 * (8 - remaining));
+        }
+        items[i] = Item{word, e};
+    }
+    if (size <= maxComparisonSort) std::sort(items, items + size, [](Item const& a, Item const& b) { return a.key < b.key; });
+    else radixSort(items, scratch, size);
+    for (std::size_t i = 0; i < size; ++i) {
+        first[i] = items[i].entry;
+    }
+
+    auto const& listing = *_listing;
+    for (std::size_t i = 0; i < size;) {
+        auto j = i + 1;
+        while (j < size && items[j].key == items[i].key) ++j;
+        if (j - i > 1) {
+            // keys never contain NUL, so a zero last byte means they all ended (the same way)
+            if (items[i].key & 0xff) sortByText(first + i, first + j, keys, items + i, scratch + i, depth + 8);
+            else std::sort(first + i, first + j, [&listing](EntryIndex a, EntryIndex b) { return std::strcmp(listing.name(a), listing.name(b)) < 0; });
+        }
+        i = j;
+    }
+}
+
+int tffm::SortKeys::textKeyIndex(Key key) {
+    switch (key) {
+    case Key::Natural: return 1;
+    case Key::Extension: return 2;
+    default: return 0;
+    }
+}
+
+bool tffm::SortKeys::Comparator::operator()(EntryIndex a, EntryIndex b) const {
+    const bool aIsDir = _listing->isDirectory(a);
+    if (aIsDir != _listing->isDirectory(b)) return aIsDir;
+    if (_reversed) std::swap(a, b);
+
+    if (_metadata) {
+        if (_key == Key::Size) {
+            if (_metadata->size(a) != _metadata->size(b)) return _metadata->size(a) < _metadata->size(b);
+        }
+        else if (_metadata->modificationTime(a) != _metadata->modificationTime(b)) {
+            return _metadata->modificationTime(a) < _metadata->modificationTime(b);
+        }
+    }
+    return textPrecedes(a, b);
+}
+
+bool tffm::SortKeys::Comparator::textPrecedes(EntryIndex a, EntryIndex b) const {
+    const int c = std::strcmp(_textKeys->key(a), _textKeys->key(b));
+    return c != 0 ? c < 0 : std::strcmp(_listing->name(a), _listing->name(b)) < 0;
+}
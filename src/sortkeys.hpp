@@ -0,0 +1,166 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef SORTKEYS_HPP
+#define SORTKEYS_HPP
+
+// project headers
+#include "directorylisting.hpp"
+#include "entrymetadata.hpp"
+
+// standard libraries
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Qt classes
+#include <QMutex>
+
+namespace tffm { class SortKeys; }
+
+/*
+the sort keys of the entries of a `DirectoryListing`, for each of the orders
+they can be shown in
+
+Names are compared through byte strings made so that comparing them with
+`strcmp` gives the wanted order: the ASCII case-folded name, the same with
+every run of digits turned into its length and its value (so "file9" comes
+before "file10"), or the folded extension followed by the folded name. Ties
+are broken by the exact names. Those keys are laid out in an arena of their
+own and sorted eight bytes at a time with a radix sort, going deeper only
+into the runs of keys that share their first bytes. Sizes and modification
+times come from the listing's `EntryMetadata` (whatever hasn't been read yet
+is read the first time an order needs them), and are sorted with a (stable)
+radix sort of the name order.
+
+Each kind of key is only built, and sorted, the first time it's needed; the
+sorted order is kept, so switching back to an order (or reversing it) is a
+copy. Keys are shared between threads: a sort can run on a loader thread
+while the GUI thread compares entries.
+*/
+class tffm::SortKeys {
+    public:
+        using EntryIndex = DirectoryListing::size_type;
+
+        enum class Key { Name, Natural, Size, ModificationTime, Extension };
+
+        /*  an order to show entries in; directories always come first */
+        struct Order {
+            Key key = Key::Name;
+            bool reversed = false;
+
+            bool operator==(Order const& other) const { return key == other.key && reversed == other.reversed; }
+            bool operator!=(Order const& other) const { return !(*this == other); }
+        };
+
+        explicit SortKeys(std::shared_ptr<EntryMetadata> metadata);
+        /*  makes the keys of the listing `metadata` belongs to */
+
+        SortKeys(SortKeys const& keys, std::shared_ptr<EntryMetadata> metadata);
+        /*  shares the keys (and sorted orders) `keys` has built, but takes sizes and times from `metadata`,
+            which must belong to the same listing */
+
+        std::shared_ptr<const DirectoryListing> const& listing() const { return _listing; }
+        std::shared_ptr<EntryMetadata> const& metadata() const { return _metadata; }
+
+        std::vector<EntryIndex> sorted(Order const& order) const;
+        /*  returns the indices of all the entries, directories first, each group sorted by `order` */
+
+        class Comparator;
+
+        Comparator comparator(Order const& order) const;
+        /*  returns a predicate telling whether an entry comes before another in `order` (as `sorted` would
+            put them); entries whose metadata hasn't been read compare as empty and from the epoch */
+
+        std::size_t memoryUsage() const;
+        /*  returns the number of bytes allocated to the keys built so far */
+
+        static bool usesMetadata(Key key) { return key == Key::Size || key == Key::ModificationTime; }
+
+    private:
+        /*  byte string keys of every entry, each followed by a NUL (and eight more after the last) */
+        struct TextKeys {
+            std::vector<char> bytes;
+            std::vector<std::uint32_t> offsets; // with one past the end, so the last key's length is known
+
+            const char* key(EntryIndex i) const { return bytes.data() + offsets[i]; }
+            std::uint32_t length(EntryIndex i) const { return offsets[i + 1] - offsets[i] - 1; }
+        };
+
+        /*  the entries sorted by some text keys, directories first */
+        struct SortedEntries {
+            std::vector<EntryIndex> entries;
+            std::size_t directories = 0;
+        };
+
+        struct Item;    // an entry and (part of) its key, while sorting
+
+        std::shared_ptr<const DirectoryListing> _listing;
+        std::shared_ptr<EntryMetadata> _metadata;
+        mutable QMutex _mutex;  // guards the pointers below, not what they point to
+        mutable std::shared_ptr<const TextKeys> _textKeys[3]; // by `textKeyIndex`
+        mutable std::shared_ptr<const SortedEntries> _sortedEntries[3];
+
+        std::shared_ptr<const TextKeys> textKeys(Key key) const;
+        /*  returns the text keys that give `key`'s order (the folded names for size and time), building them if needed */
+
+        std::shared_ptr<const SortedEntries> sortedEntries(Key key) const;
+        /*  returns the entries sorted by the text keys of `key`, sorting them if needed */
+
+        std::shared_ptr<const TextKeys> buildTextKeys(Key key) const;
+
+        void sortByText(EntryIndex* first, EntryIndex* last, TextKeys const& keys, Item* items, Item* scratch, std::size_t depth) const;
+
+        static int textKeyIndex(Key key);
+};
+
+/*
+compares entries of a listing in a given order; keeps the keys it needs alive
+*/
+class tffm::SortKeys::Comparator {
+    public:
+        bool operator()(EntryIndex a, EntryIndex b) const;
+
+    private:
+        friend class SortKeys;
+
+        std::shared_ptr<const DirectoryListing> _listing;
+        std::shared_ptr<const TextKeys> _textKeys;
+        std::shared_ptr<const EntryMetadata> _metadata; // null unless the order uses it
+        Key _key;
+        bool _reversed;
+
+        bool textPrecedes(EntryIndex a, EntryIndex b) const;
+};
+
+#endif // SORTKEYS_HPP
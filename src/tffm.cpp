@@ -32,14 +32,46 @@ License:
 */
 
 #include "mainwindow.hpp"
+#include "filemanager.hpp"
+#include "commandpipe.hpp"
+#include "tracing.hpp"
+
+#include <cstdio>
+#include <cstring>
 
 #include <QApplication>
+#include <QFile>
 
 int main(int argc, char** argv) {
+    // `--commands FILE` runs the commands in FILE (a FIFO, or `-` for stdin) without a window
+    const char* commandsPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--commands") == 0 && i + 1 < argc) commandsPath = argv[++i];
+    }
+    if (commandsPath && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication a{argc, argv};
 
-    tffm::MainWindow w;
-    w.show();
+    // TFFM_TRACE=FILE records a trace of the whole session, for chrome://tracing or Perfetto
+    const auto tracePath = qgetenv("TFFM_TRACE");
+    if (!tracePath.isEmpty()) tffm::tracing::startTrace(tracePath.toStdString());
 
-    return a.exec();
+    auto status = 0;
+    if (commandsPath) {
+        tffm::FileManager fileManager;
+        tffm::CommandPipe pipe{&fileManager};
+        if (!pipe.open(QFile::decodeName(commandsPath))) {
+            std::fprintf(stderr, "tffm: %s\n", qPrintable(pipe.errorString()));
+            return 2;
+        }
+        QObject::connect(&pipe, &tffm::CommandPipe::finished, &a, &QApplication::exit);
+        status = a.exec();
+    }
+    else {
+        tffm::MainWindow w;
+        w.show();
+        status = a.exec();
+    }
+    tffm::tracing::stopTrace();
+    return status;
 }
@@ -0,0 +1,231 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// project headers
+#include "tracing.hpp"
+
+// standard libraries
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+// Qt classes
+#include <QMutex>
+#include <QMutexLocker>
+
+// system headers
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+using tffm::tracing::Clock;
+using tffm::tracing::Operation;
+
+/*  every power of two of microseconds is split in 2^`subBucketBits` buckets */
+constexpr int subBucketBits = 2;
+constexpr int bucketCount = 40 << subBucketBits; // up to 2^40 us, about 12 days
+
+/*  how much of the trace is kept in memory before it's written out */
+constexpr std::size_t traceBufferSize = 64 << 10;
+
+const char* const operationNames[tffm::tracing::operationCount] = {
+    "cd", "select", "keystroke", "search", "sort", "copy", "copy walk", "remove", "paint"
+};
+
+struct Histogram {
+    std::atomic<std::uint64_t> buckets[bucketCount];
+    std::atomic<std::uint64_t> count;
+    std::atomic<std::uint64_t> totalMicroseconds;
+    std::atomic<std::uint64_t> maxMicroseconds;
+};
+
+// static, so zeroed before anything can record
+Histogram histograms[tffm::tracing::operationCount];
+
+std::atomic<bool> tracingEnabled{false};
+QMutex traceMutex;
+std::FILE* traceFile = nullptr;
+Clock::time_point traceStart;
+std::string traceBuffer;
+
+int bucketOf(std::uint64_t microseconds) {
+    if (microseconds < (1u << subBucketBits)) return static_cast<int>(microseconds);
+    const int log = 63 - __builtin_clzll(microseconds);
+    const auto sub = static_cast<int>((microseconds >> (log - subBucketBits)) & ((1u << subBucketBits) - 1));
+    return std::min(((log - subBucketBits + 1) << subBucketBits) + sub, bucketCount - 1);
+}
+
+/*  returns the (exclusive) upper bound of `bucket`, in microseconds */
+std::uint64_t bucketLimit(int bucket) {
+    if (bucket < (1 << subBucketBits)) return static_cast<std::uint64_t>(bucket) + 1;
+    const int log = (bucket >> subBucketBits) + subBucketBits - 1;
+    const auto sub = static_cast<std::uint64_t>(bucket & ((1 << subBucketBits) - 1));
+    return ((std::uint64_t{1} << subBucketBits) + sub + 1) << (log - subBucketBits);
+}
+
+long threadId() {
+    thread_local const long id = static_cast<long>(syscall(SYS_gettid));
+    return id;
+}
+
+void flushTrace() {
+    std::fwrite(traceBuffer.data(), 1, traceBuffer.size(), traceFile);
+    traceBuffer.clear();
+}
+
+void traceEvent(Operation operation, Clock::time_point start, Clock::time_point end) {
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    const auto tid = threadId();
+
+    // `traceStart` is written by `startTrace()` under the same lock
+    QMutexLocker lock{&traceMutex};
+    if (!traceFile) return; // stopped since the check in `record()`
+    char event[256];
+    const auto length = std::snprintf(event, sizeof event,
+        ",\n{\"name\":\"%s\",\"cat\":\"tffm\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld}",
+        operationNames[static_cast<int>(operation)], Microseconds(start - traceStart).count(), Microseconds(end - start).count(),
+        static_cast<long>(getpid()), tid);
+    traceBuffer.append(event, static_cast<std::size_t>(length));
+    if (traceBuffer.size() >= traceBufferSize) flushTrace();
+}
+
+}
+
+const char* tffm::tracing::name(Operation operation) {
+    return operationNames[static_cast<int>(operation)];
+}
+
+/*
+adds an occurrence of `operation` to its histogram, and to the trace if one is being written
+*/
+void tffm::tracing::record(Operation operation, Clock::time_point start, Clock::time_point end) {
+    const auto microseconds = static_cast<std::uint64_t>(std::max<std::int64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), 0));
+
+    auto& histogram = histograms[static_cast<int>(operation)];
+    histogram.buckets[bucketOf(microseconds)].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+    auto max = histogram.maxMicroseconds.load(std::memory_order_relaxed);
+    while (microseconds > max && !histogram.maxMicroseconds.compare_exchange_weak(max, microseconds, std::memory_order_relaxed)) {}
+
+    if (tracingEnabled.load(std::memory_order_relaxed)) traceEvent(operation, start, end);
+}
+
+/*
+returns a summary of every operation that has occurred since the start (or the last `reset()`)
+*/
+std::vector<tffm::tracing::Summary> tffm::tracing::summaries() {
+    auto result = std::vector<Summary>{};
+    for (int op = 0; op < operationCount; ++op) {
+        auto const& histogram = histograms[op];
+
+        // the buckets are read one by one while others may be recording, so they're counted again
+        std::uint64_t counts[bucketCount];
+        std::uint64_t count = 0;
+        for (int b = 0; b < bucketCount; ++b) {
+            counts[b] = histogram.buckets[b].load(std::memory_order_relaxed);
+            count += counts[b];
+        }
+        if (count == 0) continue;
+
+        const auto percentile = [&counts, count](double p) {
+            const auto rank = std::max<std::uint64_t>(static_cast<std::uint64_t>(p * static_cast<double>(count) + 0.999999), 1);
+            std::uint64_t seen = 0;
+            for (int b = 0; b < bucketCount; ++b) {
+                seen += counts[b];
+                if (seen >= rank) return static_cast<double>(bucketLimit(b)) / 1000;
+            }
+            return static_cast<double>(bucketLimit(bucketCount - 1)) / 1000;
+        };
+        auto summary = Summary{};
+        summary.operation = static_cast<Operation>(op);
+        summary.count = count;
+        summary.max = static_cast<double>(histogram.maxMicroseconds.load(std::memory_order_relaxed)) / 1000;
+        summary.p50 = std::min(percentile(0.50), summary.max);
+        summary.p90 = std::min(percentile(0.90), summary.max);
+        summary.p99 = std::min(percentile(0.99), summary.max);
+        summary.mean = static_cast<double>(histogram.totalMicroseconds.load(std::memory_order_relaxed)) / 1000 / static_cast<double>(count);
+        result.push_back(summary);
+    }
+    return result;
+}
+
+/*
+empties the histograms
+*/
+void tffm::tracing::reset() {
+    for (auto&& histogram : histograms) {
+        for (auto&& bucket : histogram.buckets) bucket.store(0, std::memory_order_relaxed);
+        histogram.count.store(0, std::memory_order_relaxed);
+        histogram.totalMicroseconds.store(0, std::memory_order_relaxed);
+        histogram.maxMicroseconds.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*
+starts writing every operation to the trace file `path`, replacing it; returns false if it can't be written
+*/
+bool tffm::tracing::startTrace(std::string const& path) {
+    stopTrace();
+
+    QMutexLocker lock{&traceMutex};
+    traceFile = std::fopen(path.c_str(), "w");
+    if (!traceFile) return false;
+
+    // events are written with a leading comma, so the array starts with the process name instead
+    traceStart = Clock::now();
+    traceBuffer.reserve(traceBufferSize + 256);
+    traceBuffer = "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(getpid()) + ",\"args\":{\"name\":\"tffm\"}}";
+    tracingEnabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+/*
+finishes the trace file being written, if any
+*/
+void tffm::tracing::stopTrace() {
+    tracingEnabled.store(false, std::memory_order_relaxed);
+
+    QMutexLocker lock{&traceMutex};
+    if (!traceFile) return;
+    traceBuffer += "\n]\n";
+    flushTrace();
+    std::fclose(traceFile);
+    traceFile = nullptr;
+}
+
+bool tffm::tracing::isTracing() {
+    return tracingEnabled.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,134 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef TRACING_HPP
+#define TRACING_HPP
+
+// standard libraries
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+latency histograms of the operations a user waits on, and an optional trace
+
+Every instrumented operation feeds a histogram (with buckets a quarter of a
+power of two wide), which `:stats` summarizes; recording one costs two clock
+reads and a few relaxed atomic additions, so it's always on. Writing a trace
+of every operation, in the Chrome trace event format (for chrome://tracing or
+Perfetto), is opt-in with `startTrace()`; when it's off, all it costs is one
+more relaxed load.
+
+Everything here can be used from any thread.
+*/
+namespace tffm { namespace tracing {
+
+enum class Operation {
+    ChangeDirectory,    // from a `cd` until the directory is shown
+    SelectFirst,        // selecting an item once a directory is loaded
+    Keystroke,          // handling a keystroke of a search
+    Search,             // finding the next match of a search
+    Sort,               // from a `:sort` until the rows are in order
+    Copy,               // a whole copy job
+    CopyWalk,           // walking a tree to be copied
+    Remove,             // from confirming a removal until it's done
+    Paint,              // painting the list
+};
+constexpr int operationCount = static_cast<int>(Operation::Paint) + 1;
+
+using Clock = std::chrono::steady_clock;
+
+const char* name(Operation operation);
+
+void record(Operation operation, Clock::time_point start, Clock::time_point end);
+/*  adds an occurrence of `operation` to its histogram, and to the trace if one is being written */
+
+/*  times the scope it's declared in */
+class Scope {
+    public:
+        explicit Scope(Operation operation) : _operation{operation}, _start{Clock::now()} {}
+        ~Scope() { record(_operation, _start, Clock::now()); }
+
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        Operation _operation;
+        Clock::time_point _start;
+};
+
+/*  times an operation that ends in a later event, such as a load that ends once the directory is read */
+class Span {
+    public:
+        void begin(Operation operation) { _operation = operation; _start = Clock::now(); _active = true; }
+        /*  starts timing `operation`, forgetting the one being timed, if any */
+
+        void end() { if (_active) record(_operation, _start, Clock::now()); _active = false; }
+        /*  stops timing, if an operation is being timed */
+
+        bool isActive() const { return _active; }
+
+    private:
+        Operation _operation = Operation::ChangeDirectory;
+        Clock::time_point _start;
+        bool _active = false;
+};
+
+struct Summary {
+    Operation operation;
+    std::uint64_t count;
+    double p50;     // in ms, like the other times; percentiles are the upper bounds of their buckets
+    double p90;
+    double p99;
+    double max;
+    double mean;
+};
+
+std::vector<Summary> summaries();
+/*  returns a summary of every operation that has occurred since the start (or the last `reset()`) */
+
+void reset();
+/*  empties the histograms */
+
+bool startTrace(std::string const& path);
+/*  starts writing every operation to the trace file `path`, replacing it; returns false if it can't be written */
+
+void stopTrace();
+/*  finishes the trace file being written, if any */
+
+bool isTracing();
+
+}}
+
+#endif // TRACING_HPP
@@ -0,0 +1,129 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "workstealingqueues.hpp"
+
+// Qt classes
+#include <QMutexLocker>
+
+tffm::WorkStealingQueues::WorkStealingQueues(std::size_t walkers) : _pending{0}, _queued{0}, _cancelled{false}, _idleWalkers{0} {
+    for (std::size_t i = 0; i < walkers; ++i) {
+        _queues.push_back(std::make_unique<Queue>());
+    }
+}
+
+/*
+queues `items` (moved from) for walker `self`
+*/
+void tffm::WorkStealingQueues::push(std::size_t self, std::vector<std::string>& items) {
+    if (items.empty()) return;
+
+    // counted as pending first, so that the walk can't look over while they're being queued
+    _pending += static_cast<qint64>(items.size());
+    {
+        auto& own = *_queues[self];
+        QMutexLocker lock{&own.mutex};
+        for (auto&& item : items) {
+            own.items.push_back(std::move(item));
+        }
+    }
+    _queued += static_cast<qint64>(items.size());
+    wakeIdle();
+}
+
+/*
+makes the walkers stop after the item they're handling
+*/
+void tffm::WorkStealingQueues::cancel() {
+    _cancelled = true;
+    QMutexLocker lock{&_idleMutex};
+    _workAvailable.wakeAll();
+}
+
+/*
+pops the next item for walker `self`, stealing one if its queue is empty
+*/
+bool tffm::WorkStealingQueues::take(std::size_t self, std::string& item) {
+    {
+        auto& own = *_queues[self];
+        QMutexLocker lock{&own.mutex};
+        if (!own.items.empty()) {
+            item = std::move(own.items.back());
+            own.items.pop_back();
+            --_queued;
+            return true;
+        }
+    }
+    const auto count = _queues.size();
+    for (std::size_t k = 1; k < count; ++k) {
+        auto& victim = *_queues[(self + k) % count];
+        QMutexLocker lock{&victim.mutex};
+        if (!victim.items.empty()) {
+            item = std::move(victim.items.front());
+            victim.items.pop_front();
+            --_queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void tffm::WorkStealingQueues::finishItem() {
+    if (--_pending == 0) wakeIdle();
+}
+
+/*
+waits until there may be an item to steal; returns false if the walk is over
+*/
+bool tffm::WorkStealingQueues::waitForWork() {
+    if (_pending == 0) return false;
+
+    QMutexLocker lock{&_idleMutex};
+    ++_idleWalkers;
+    while (!_cancelled && _pending > 0 && _queued <= 0) {
+        _workAvailable.wait(&_idleMutex);
+    }
+    --_idleWalkers;
+    return true;
+}
+
+/*
+wakes the walkers waiting for an item to steal, if any; the lock makes sure a walker that's about to wait sees what changed
+*/
+void tffm::WorkStealingQueues::wakeIdle() {
+    if (_idleWalkers == 0) return;
+    QMutexLocker lock{&_idleMutex};
+    _workAvailable.wakeAll();
+}
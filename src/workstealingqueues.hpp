@@ -0,0 +1,125 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef WORKSTEALINGQUEUES_HPP
+#define WORKSTEALINGQUEUES_HPP
+
+// standard libraries
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Qt classes
+#include <QMutex>
+#include <QWaitCondition>
+
+namespace tffm { class WorkStealingQueues; }
+
+/*
+the items (paths relative to the root of a walk) waiting to be handled by the
+threads walking a tree, one queue per thread
+
+A walker pushes the items it finds onto its own queue and takes its next item
+from there, depth first; when it runs dry it steals the oldest item (usually
+the biggest subtree left) from another walker's queue. A walker with nothing
+to do waits until an item is queued somewhere, until no item is queued or
+being handled anywhere (those being handled may still add more), or until the
+walk is cancelled.
+*/
+class tffm::WorkStealingQueues {
+    public:
+        explicit WorkStealingQueues(std::size_t walkers);
+        /*  sets up the queues of `walkers` walkers, numbered from 0 */
+
+        WorkStealingQueues(WorkStealingQueues const&) = delete;
+        WorkStealingQueues& operator=(WorkStealingQueues const&) = delete;
+
+        std::size_t walkers() const { return _queues.size(); }
+
+        template <typename HANDLER>
+        void run(std::size_t self, HANDLER handle);
+        /*  hands the items of walker `self`'s queue, or stolen from others, to `handle` until none are left
+            or the walk is cancelled */
+
+        void push(std::size_t self, std::vector<std::string>& items);
+        /*  queues `items` (moved from) for walker `self`; walkers only push while handling an item, apart
+            from the first items, pushed before any of them starts */
+
+        void cancel();
+        /*  makes the walkers stop after the item they're handling */
+
+        bool isCancelled() const { return _cancelled; }
+
+    private:
+        /*  its owner pushes and pops at the back; thieves take from the front */
+        struct Queue {
+            QMutex mutex;
+            std::deque<std::string> items;
+        };
+
+        std::vector<std::unique_ptr<Queue>> _queues;
+        std::atomic<qint64> _pending;       // queued or being handled
+        std::atomic<qint64> _queued;        // queued only
+        std::atomic<bool> _cancelled;
+        std::atomic<int> _idleWalkers;
+        QMutex _idleMutex;
+        QWaitCondition _workAvailable;      // items were queued, the walk is over or it was cancelled
+
+        bool take(std::size_t self, std::string& item);
+        /*  pops the next item for walker `self`, stealing one if its queue is empty */
+
+        void finishItem();
+
+        bool waitForWork();
+        /*  waits until there may be an item to steal; returns false if the walk is over */
+
+        void wakeIdle();
+};
+
+template <typename HANDLER>
+void tffm::WorkStealingQueues::run(std::size_t self, HANDLER handle) {
+    auto item = std::string{};
+    while (!_cancelled) {
+        if (take(self, item)) {
+            handle(item);
+            finishItem();
+        }
+        else if (!waitForWork()) {
+            break;
+        }
+    }
+}
+
+#endif // WORKSTEALINGQUEUES_HPP
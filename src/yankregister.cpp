@@ -0,0 +1,101 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// project headers
+#include "yankregister.hpp"
+
+// standard libraries
+#include <utility>
+
+// Qt classes
+#include <QApplication>
+#include <QClipboard>
+#include <QFile>
+#include <QList>
+#include <QMimeData>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+tffm::YankRegister::YankRegister() : _paths{std::make_shared<const Paths>()} {}
+
+tffm::YankRegister& tffm::YankRegister::instance() {
+    static YankRegister yankRegister;
+    return yankRegister;
+}
+
+void tffm::YankRegister::set(std::shared_ptr<const Paths> paths) {
+    _paths = paths ? std::move(paths) : std::make_shared<const Paths>();
+}
+
+/*
+puts the yanked paths in the clipboard, as a `text/uri-list` and as text, one per line
+*/
+void tffm::YankRegister::exportToClipboard() const {
+    auto urls = QList<QUrl>{};
+    auto text = QStringList{};
+    urls.reserve(static_cast<int>(_paths->size()));
+    for (auto&& path : *_paths) {
+        const auto decodedPath = QFile::decodeName(path.c_str());
+        urls << QUrl::fromLocalFile(decodedPath);
+        text << decodedPath;
+    }
+
+    auto data = new QMimeData;
+    data->setUrls(urls);
+    data->setText(text.join(QChar('\n')));
+    QApplication::clipboard()->setMimeData(data); // takes ownership
+}
+
+/*
+replaces the yanked paths by the local files in the clipboard, returning false if there weren't any
+*/
+bool tffm::YankRegister::importFromClipboard() {
+    auto paths = std::make_shared<Paths>();
+    const auto data = QApplication::clipboard()->mimeData();
+    if (data && data->hasUrls()) {
+        for (auto&& url : data->urls()) {
+            if (url.isLocalFile()) paths->push_back(QFile::encodeName(url.toLocalFile()).toStdString());
+        }
+    }
+    else if (data && data->hasText()) {
+        for (auto&& line : data->text().split(QChar('\n'), QString::SkipEmptyParts)) {
+            if (line.startsWith(QChar('/'))) paths->push_back(QFile::encodeName(line).toStdString());
+        }
+    }
+    if (paths->empty()) return false;
+
+    _paths = std::move(paths);
+    return true;
+}
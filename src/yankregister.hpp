@@ -0,0 +1,81 @@
+/*
+Project: tffm
+Author: Leonardo Banderali
+
+Description:
+    tffm is a simple, keyboard-centric file manager intended for use with tiling
+    window managers such as Xmonad.
+
+License:
+
+    MIT License
+
+    Copyright (c) 2016 Leonardo Banderali
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef YANKREGISTER_HPP
+#define YANKREGISTER_HPP
+
+// standard libraries
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tffm { class YankRegister; }
+
+/*
+the items yanked with `yy`, for `p` to put
+
+The paths are kept (as they are on the file system, not decoded) in an
+immutable vector that's shared rather than copied, so putting a hundred
+thousand items hands the copy engine a pointer instead of building, parsing
+and checking a huge string, and names may contain `:` or newlines. The system
+clipboard is only written by `exportToClipboard()` and read by
+`importFromClipboard()`, as a `text/uri-list`.
+
+There's a single register, shared by everything in the process.
+*/
+class tffm::YankRegister {
+    public:
+        using Paths = std::vector<std::string>;
+
+        static YankRegister& instance();
+
+        std::shared_ptr<const Paths> paths() const { return _paths; }
+        /*  returns the yanked paths (never null) */
+
+        void set(std::shared_ptr<const Paths> paths);
+
+        void exportToClipboard() const;
+        /*  puts the yanked paths in the clipboard, as a `text/uri-list` and as text, one per line */
+
+        bool importFromClipboard();
+        /*  replaces the yanked paths by the local files of the clipboard's `text/uri-list` or, if it has
+            none, by the absolute paths in its text, one per line; returns false if there weren't any */
+
+    private:
+        YankRegister();
+
+        std::shared_ptr<const Paths> _paths;
+};
+
+#endif // YANKREGISTER_HPP